@@ -17,6 +17,8 @@ target_sources(
     components/AudioCaptureToolbar.cpp
     components/AudioCaptureToolbar.hpp
     components/BalanceSlider.hpp
+    components/BibleIndex.cpp
+    components/BibleIndex.hpp
     components/BrowserToolbar.cpp
     components/BrowserToolbar.hpp
     components/ClickableLabel.hpp
@@ -89,4 +91,8 @@ target_sources(
     components/VolumeSlider.hpp
     components/WindowCaptureToolbar.cpp
     components/WindowCaptureToolbar.hpp
+    components/WorshipFolderStore.cpp
+    components/WorshipFolderStore.hpp
+    components/WorshipPack.cpp
+    components/WorshipPack.hpp
 )
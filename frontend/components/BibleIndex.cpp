@@ -0,0 +1,501 @@
+#include "BibleIndex.hpp"
+#include "WorshipPack.hpp"
+
+#include <QHash>
+#include <QSet>
+#include <QStringView>
+#include <algorithm>
+#include <climits>
+#include <numeric>
+
+namespace {
+
+// 개역 성경 약어의 정경 순서 (bible.json 키의 책 이름)
+const char *const canonicalBooks[] = {
+    "창", "출", "레", "민", "신", "수", "삿", "룻", "삼상", "삼하",
+    "왕상", "왕하", "대상", "대하", "스", "느", "에", "욥", "시", "잠",
+    "전", "아", "사", "렘", "애", "겔", "단", "호", "욜", "암",
+    "옵", "욘", "미", "나", "합", "습", "학", "슥", "말",
+    "마", "막", "눅", "요", "행", "롬", "고전", "고후", "갈", "엡",
+    "빌", "골", "살전", "살후", "딤전", "딤후", "딛", "몬", "히", "약",
+    "벧전", "벧후", "요일", "요이", "요삼", "유", "계",
+};
+
+int CanonicalRank(const QString &book)
+{
+    static const QHash<QString, int> ranks = [] {
+        QHash<QString, int> map;
+        int rank = 0;
+        for (const char *name : canonicalBooks) {
+            map.insert(QString::fromUtf8(name), rank++);
+        }
+        return map;
+    }();
+    return ranks.value(book, INT_MAX);
+}
+
+inline uint64_t MakeVerseKey(uint32_t book, uint32_t chapter, uint32_t verse)
+{
+    return (uint64_t(book) << 32) | (uint64_t(chapter) << 16) | verse;
+}
+
+inline uint64_t MakeVerseKey(const BibleIndex::Verse &v)
+{
+    return MakeVerseKey(v.book, v.chapter, v.verse);
+}
+
+// 접힌(case folded) 문자열의 연속된 두 글자를 하나의 키로 만든다.
+// 공백을 포함한 2-gram 은 검색어를 공백으로 나누므로 색인하지 않는다.
+template<typename Func> void ForEachGram(const QString &folded, Func &&func)
+{
+    for (qsizetype i = 0; i + 1 < folded.size(); ++i) {
+        const QChar a = folded[i];
+        const QChar b = folded[i + 1];
+        if (a.isSpace() || b.isSpace()) {
+            continue;
+        }
+        func((uint32_t(a.unicode()) << 16) | b.unicode());
+    }
+}
+
+// 한 글자 키는 상위 16비트가 0 이므로 2-gram 키와 겹치지 않는다
+template<typename Func> void ForEachUnigram(const QString &folded, Func &&func)
+{
+    for (const QChar c : folded) {
+        if (!c.isSpace()) {
+            func(uint32_t(c.unicode()));
+        }
+    }
+}
+
+} // namespace
+
+void BibleIndex::ResetViews()
+{
+    text = nullptr;
+    textSize = 0;
+    verseData = nullptr;
+    verseCount = 0;
+    keyData = nullptr;
+    offsetData = nullptr;
+    keyCount = 0;
+    postingData = nullptr;
+    postingCount = 0;
+}
+
+void BibleIndex::Clear()
+{
+    ResetViews();
+    pending.clear();
+    books.clear();
+    bookFirstVerse.clear();
+    textData.clear();
+    verses.clear();
+    gramKeys.clear();
+    gramOffsets.clear();
+    postings.clear();
+    pack.reset();
+}
+
+bool BibleIndex::ParseReference(const QString &reference, QString &book, int &chapter, int &verse)
+{
+    const qsizetype size = reference.size();
+    qsizetype digits = 0;
+    while (digits < size && !reference[digits].isDigit()) {
+        ++digits;
+    }
+    if (digits == 0 || digits == size) {
+        return false;
+    }
+
+    const qsizetype colon = reference.indexOf(QChar(':'), digits);
+    if (colon < 0) {
+        return false;
+    }
+
+    bool chapterOk = false;
+    bool verseOk = false;
+    const int parsedChapter = QStringView(reference).mid(digits, colon - digits).toInt(&chapterOk);
+    const int parsedVerse = QStringView(reference).mid(colon + 1).toInt(&verseOk);
+    if (!chapterOk || !verseOk) {
+        return false;
+    }
+
+    book = reference.left(digits);
+    chapter = parsedChapter;
+    verse = parsedVerse;
+    return true;
+}
+
+bool BibleIndex::AddVerse(const QString &reference, const QString &text)
+{
+    PendingVerse entry;
+    if (!ParseReference(reference, entry.book, entry.chapter, entry.verse)) {
+        return false;
+    }
+    if (entry.chapter <= 0 || entry.chapter > UINT16_MAX || entry.verse <= 0 || entry.verse > UINT16_MAX) {
+        return false;
+    }
+
+    entry.text = text;
+    pending.push_back(std::move(entry));
+    return true;
+}
+
+void BibleIndex::Finalize()
+{
+    ResetViews();
+    books.clear();
+    bookFirstVerse.clear();
+    textData.clear();
+    verses.clear();
+    gramKeys.clear();
+    gramOffsets.clear();
+    postings.clear();
+    pack.reset();
+
+    // 책 목록: 정경 순서, 알 수 없는 책은 뒤쪽에 이름순
+    QSet<QString> uniqueBooks;
+    for (const PendingVerse &entry : pending) {
+        uniqueBooks.insert(entry.book);
+    }
+    books = QStringList(uniqueBooks.begin(), uniqueBooks.end());
+    std::sort(books.begin(), books.end(), [](const QString &a, const QString &b) {
+        const int rankA = CanonicalRank(a);
+        const int rankB = CanonicalRank(b);
+        if (rankA != rankB) return rankA < rankB;
+        return a < b;
+    });
+
+    QHash<QString, uint16_t> bookIds;
+    for (qsizetype i = 0; i < books.size(); ++i) {
+        bookIds.insert(books[i], uint16_t(i));
+    }
+
+    std::vector<uint64_t> keys(pending.size());
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const PendingVerse &entry = pending[i];
+        keys[i] = MakeVerseKey(bookIds.value(entry.book), entry.chapter, entry.verse);
+    }
+
+    std::vector<uint32_t> order(pending.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+    // 1-gram/2-gram 항목: (키 << 32) | 구절 ID
+    std::vector<uint64_t> grams;
+    verses.reserve(order.size());
+
+    for (uint32_t idx : order) {
+        const PendingVerse &entry = pending[idx];
+
+        // 중복 참조는 먼저 추가된 구절만 유지
+        if (!verses.empty() && MakeVerseKey(verses.back()) == keys[idx]) {
+            continue;
+        }
+
+        const QByteArray utf8 = entry.text.toUtf8();
+        const uint32_t id = uint32_t(verses.size());
+
+        Verse verse;
+        verse.offset = uint32_t(textData.size());
+        verse.length = uint32_t(utf8.size());
+        verse.book = bookIds.value(entry.book);
+        verse.chapter = uint16_t(entry.chapter);
+        verse.verse = uint16_t(entry.verse);
+        verse.reserved = 0;
+        verses.push_back(verse);
+        textData.append(utf8);
+
+        const QString folded = entry.text.toCaseFolded();
+        auto add = [&](uint32_t key) { grams.push_back((uint64_t(key) << 32) | id); };
+        ForEachUnigram(folded, add);
+        ForEachGram(folded, add);
+    }
+
+    pending.clear();
+    pending.shrink_to_fit();
+    textData.squeeze();
+
+    bookFirstVerse.assign(books.size() + 1, uint32_t(verses.size()));
+    for (size_t i = verses.size(); i > 0; --i) {
+        bookFirstVerse[verses[i - 1].book] = uint32_t(i - 1);
+    }
+    for (size_t i = books.size(); i > 0; --i) {
+        bookFirstVerse[i - 1] = std::min(bookFirstVerse[i - 1], bookFirstVerse[i]);
+    }
+
+    // 같은 구절 안의 중복 키 제거 후 CSR 포스팅 리스트로 변환
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+
+    postings.reserve(grams.size());
+    for (uint64_t gram : grams) {
+        const uint32_t key = uint32_t(gram >> 32);
+        if (gramKeys.empty() || gramKeys.back() != key) {
+            gramKeys.push_back(key);
+            gramOffsets.push_back(uint32_t(postings.size()));
+        }
+        postings.push_back(uint32_t(gram));
+    }
+    gramOffsets.push_back(uint32_t(postings.size()));
+
+    text = textData.constData();
+    textSize = size_t(textData.size());
+    verseData = verses.data();
+    verseCount = verses.size();
+    keyData = gramKeys.data();
+    offsetData = gramOffsets.data();
+    keyCount = gramKeys.size();
+    postingData = postings.data();
+    postingCount = postings.size();
+}
+
+bool BibleIndex::Attach(std::shared_ptr<const WorshipPack> source)
+{
+    Clear();
+
+    if (!source || !source->IsOpen()) {
+        return false;
+    }
+
+    const WorshipPack::BookEntry *entries = source->GetBooks();
+    const size_t bookCount = source->GetBookCount();
+    const size_t count = source->GetVerseCount();
+
+    // 책 이름표만 복사하고 나머지는 매핑된 섹션을 그대로 사용
+    bookFirstVerse.reserve(bookCount + 1);
+    for (size_t i = 0; i < bookCount; ++i) {
+        QString name;
+        if (!source->GetString(entries[i].nameOffset, entries[i].nameLength, name) ||
+            entries[i].firstVerse > count ||
+            (!bookFirstVerse.empty() && entries[i].firstVerse < bookFirstVerse.back())) {
+            Clear();
+            return false;
+        }
+        books.append(name);
+        bookFirstVerse.push_back(entries[i].firstVerse);
+    }
+    bookFirstVerse.push_back(uint32_t(count));
+
+    text = source->GetText();
+    textSize = source->GetTextSize();
+    verseData = static_cast<const Verse *>(source->GetVerses());
+    verseCount = count;
+    keyData = source->GetGramKeys();
+    offsetData = source->GetGramOffsets();
+    keyCount = source->GetGramKeyCount();
+    postingData = source->GetPostings();
+    postingCount = source->GetPostingCount();
+
+    pack = std::move(source);
+    return true;
+}
+
+int BibleIndex::FindBook(const QString &book) const
+{
+    return books.indexOf(book);
+}
+
+QString BibleIndex::GetVerseText(uint32_t id) const
+{
+    const Verse &v = verseData[id];
+    if (v.offset > textSize || v.length > textSize - v.offset) {
+        return QString();
+    }
+    return QString::fromUtf8(text + v.offset, v.length);
+}
+
+QString BibleIndex::GetVerseReference(uint32_t id) const
+{
+    const Verse &v = verseData[id];
+    return QString("%1%2:%3").arg(books.value(v.book)).arg(v.chapter).arg(v.verse);
+}
+
+int64_t BibleIndex::FindVerse(int book, int chapter, int verse) const
+{
+    if (book < 0 || chapter <= 0 || verse <= 0) {
+        return -1;
+    }
+
+    const Verse *end = verseData + verseCount;
+    const uint64_t key = MakeVerseKey(book, chapter, verse);
+    const Verse *it = std::lower_bound(verseData, end, key,
+                                       [](const Verse &v, uint64_t k) { return MakeVerseKey(v) < k; });
+    if (it == end || MakeVerseKey(*it) != key) {
+        return -1;
+    }
+    return int64_t(it - verseData);
+}
+
+int64_t BibleIndex::FindVerse(const QString &reference) const
+{
+    QString book;
+    int chapter = 0;
+    int verse = 0;
+    if (!ParseReference(reference, book, chapter, verse)) {
+        return -1;
+    }
+    return FindVerse(FindBook(book), chapter, verse);
+}
+
+void BibleIndex::GetChapterRange(int book, int chapter, uint32_t &first, uint32_t &last) const
+{
+    first = last = 0;
+    if (book < 0 || book >= books.size() || chapter <= 0) {
+        return;
+    }
+
+    const Verse *begin = verseData + bookFirstVerse[book];
+    const Verse *end = verseData + bookFirstVerse[book + 1];
+    auto lower = [](const Verse &v, uint64_t k) { return MakeVerseKey(v) < k; };
+
+    const Verse *from = std::lower_bound(begin, end, MakeVerseKey(book, chapter, 0), lower);
+    const Verse *to = std::lower_bound(from, end, MakeVerseKey(book, chapter + 1, 0), lower);
+    first = uint32_t(from - verseData);
+    last = uint32_t(to - verseData);
+}
+
+bool BibleIndex::GetPostings(uint32_t key, const uint32_t *&begin, const uint32_t *&end) const
+{
+    const uint32_t *keyEnd = keyData + keyCount;
+    const uint32_t *it = std::lower_bound(keyData, keyEnd, key);
+    if (it == keyEnd || *it != key) {
+        return false;
+    }
+
+    const size_t slot = size_t(it - keyData);
+    const uint32_t first = offsetData[slot];
+    const uint32_t last = offsetData[slot + 1];
+    if (first > last || last > postingCount) {
+        return false;
+    }
+
+    begin = postingData + first;
+    end = postingData + last;
+    return true;
+}
+
+bool BibleIndex::VerseContains(uint32_t id, const QStringList &terms) const
+{
+    const QString text = GetVerseText(id);
+    for (const QString &term : terms) {
+        if (!text.contains(term, Qt::CaseInsensitive)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<uint32_t> BibleIndex::Search(const QString &query, int maxResults, int *totalMatches) const
+{
+    std::vector<uint32_t> results;
+    int total = 0;
+
+    const QStringList terms = query.simplified().toCaseFolded().split(QChar(' '), Qt::SkipEmptyParts);
+    if (terms.isEmpty() || verseCount == 0) {
+        if (totalMatches) *totalMatches = 0;
+        return results;
+    }
+
+    // 모든 검색어의 포스팅 리스트 수집. 하나라도 없으면 결과 없음
+    std::vector<std::pair<const uint32_t *, const uint32_t *>> lists;
+    bool needVerify = false;
+    bool missing = false;
+
+    auto addPostings = [&](uint32_t key) {
+        const uint32_t *begin = nullptr;
+        const uint32_t *end = nullptr;
+        if (GetPostings(key, begin, end)) {
+            lists.emplace_back(begin, end);
+        } else {
+            missing = true;
+        }
+    };
+
+    for (const QString &term : terms) {
+        if (!keyCount) {
+            // 색인 없는 팩: 전체 구절 확인으로 대체
+            needVerify = true;
+            continue;
+        }
+        // 한두 글자 검색어는 키 존재 자체가 부분 문자열 일치와 같다
+        if (term.size() == 1) {
+            ForEachUnigram(term, addPostings);
+            continue;
+        }
+        if (term.size() != 2) {
+            needVerify = true;
+        }
+        ForEachGram(term, addPostings);
+    }
+
+    if (missing) {
+        if (totalMatches) *totalMatches = 0;
+        return results;
+    }
+
+    const size_t limit = maxResults < 0 ? SIZE_MAX : size_t(maxResults);
+
+    if (lists.empty()) {
+        // 색인이 없는 경우: 전체 구절 확인
+        for (uint32_t id = 0; id < verseCount; ++id) {
+            if (!VerseContains(id, terms)) continue;
+            ++total;
+            if (results.size() < limit) {
+                results.push_back(id);
+            } else if (!totalMatches) {
+                break;
+            }
+        }
+        if (totalMatches) *totalMatches = total;
+        return results;
+    }
+
+    // 짧은 리스트부터 교집합 (모두 구절 ID 오름차순)
+    std::sort(lists.begin(), lists.end(), [](const auto &a, const auto &b) {
+        return (a.second - a.first) < (b.second - b.first);
+    });
+
+    // 범위를 벗어난 ID 는 손상된 팩에서만 나오므로 첫 리스트에서 걸러낸다
+    std::vector<uint32_t> candidates;
+    candidates.reserve(size_t(lists[0].second - lists[0].first));
+    for (const uint32_t *it = lists[0].first; it != lists[0].second; ++it) {
+        if (*it < verseCount) candidates.push_back(*it);
+    }
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+        const uint32_t *pos = lists[i].first;
+        const uint32_t *end = lists[i].second;
+        size_t count = 0;
+
+        for (size_t j = 0; j < candidates.size(); ++j) {
+            const uint32_t id = candidates[j];
+            pos = std::lower_bound(pos, end, id);
+            if (pos == end) break;
+            if (*pos == id) candidates[count++] = id;
+        }
+        candidates.resize(count);
+    }
+
+    if (!needVerify) {
+        total = int(candidates.size());
+        if (candidates.size() > limit) {
+            candidates.resize(limit);
+        }
+        if (totalMatches) *totalMatches = total;
+        return candidates;
+    }
+
+    for (uint32_t id : candidates) {
+        if (!VerseContains(id, terms)) continue;
+        ++total;
+        if (results.size() < limit) {
+            results.push_back(id);
+        } else if (!totalMatches) {
+            break;
+        }
+    }
+
+    if (totalMatches) *totalMatches = total;
+    return results;
+}
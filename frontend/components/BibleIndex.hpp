@@ -0,0 +1,114 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class WorshipPack;
+
+// 성경 구절 저장소 + 역색인
+//
+// 본문은 하나의 연속된 UTF-8 버퍼에 정경 순서(창세기 → 요한계시록, 장, 절)로
+// 저장되고, 각 구절은 (책, 장, 절) 키와 버퍼 오프셋만 가진다. 구절 ID는
+// 정경 순서의 인덱스이므로 색인 결과는 별도 정렬 없이 그대로 정경 순서가 된다.
+//
+// 키워드 검색용으로 대소문자 접기(case folding)된 본문의 1-gram 과 2-gram
+// (한글은 음절 하나와 두 개) 역색인을 만든다. 한 글자 검색어는 1-gram,
+// 그 외에는 모든 2-gram 포스팅 리스트를 교집합한 뒤 실제 부분 문자열 여부를
+// 후보에 대해서만 확인한다.
+//
+// 데이터는 AddVerse()/Finalize() 로 메모리에서 만들거나, Attach() 로 매핑된
+// WorshipPack 을 복사 없이 그대로 사용한다.
+class BibleIndex {
+public:
+    struct Verse {
+        uint32_t offset;   // textData 내 시작 위치
+        uint32_t length;   // UTF-8 바이트 길이
+        uint16_t book;     // books 인덱스 (정경 순서)
+        uint16_t chapter;
+        uint16_t verse;
+        uint16_t reserved;
+    };
+
+    BibleIndex() = default;
+    BibleIndex(const BibleIndex &) = delete;
+    BibleIndex &operator=(const BibleIndex &) = delete;
+
+    void Clear();
+    bool IsEmpty() const { return verseCount == 0; }
+
+    // 구절 추가 후 Finalize() 를 호출해야 검색 가능
+    bool AddVerse(const QString &reference, const QString &text);
+    void Finalize();
+
+    // 팩의 섹션을 직접 참조 (팩은 이 색인이 살아있는 동안 유지됨)
+    bool Attach(std::shared_ptr<const WorshipPack> pack);
+
+    size_t GetVerseCount() const { return verseCount; }
+    const QStringList &GetBooks() const { return books; }
+    int FindBook(const QString &book) const;
+
+    const Verse &GetVerse(uint32_t id) const { return verseData[id]; }
+    QString GetVerseText(uint32_t id) const;
+    QString GetVerseReference(uint32_t id) const;
+    QString GetVerseBook(uint32_t id) const { return books.value(verseData[id].book); }
+
+    // 정확한 (책, 장, 절) 조회. 없으면 -1
+    int64_t FindVerse(int book, int chapter, int verse) const;
+    int64_t FindVerse(const QString &reference) const;
+
+    // [first, last) 구절 ID 범위. 해당 장이 없으면 first == last
+    void GetChapterRange(int book, int chapter, uint32_t &first, uint32_t &last) const;
+
+    // 공백으로 구분된 모든 검색어를 포함하는 구절 (AND). 결과는 정경 순서.
+    // maxResults < 0 이면 제한 없음, totalMatches 에는 전체 일치 수를 기록
+    std::vector<uint32_t> Search(const QString &query, int maxResults = -1, int *totalMatches = nullptr) const;
+
+    // "창1:1" 형태의 참조를 정규식 없이 파싱
+    static bool ParseReference(const QString &reference, QString &book, int &chapter, int &verse);
+
+private:
+    struct PendingVerse {
+        QString book;
+        int chapter;
+        int verse;
+        QString text;
+    };
+
+    std::vector<PendingVerse> pending;
+
+    // 현재 데이터 뷰 (메모리 저장소 또는 매핑된 팩을 가리킴)
+    const char *text = nullptr;
+    size_t textSize = 0;
+    const Verse *verseData = nullptr;
+    size_t verseCount = 0;
+
+    // 1-gram/2-gram 역색인 (CSR 형식): keyData[i] 의 포스팅은
+    // postingData[offsetData[i] .. offsetData[i + 1])
+    const uint32_t *keyData = nullptr;
+    const uint32_t *offsetData = nullptr;
+    size_t keyCount = 0;
+    const uint32_t *postingData = nullptr;
+    size_t postingCount = 0;
+
+    QStringList books;
+    std::vector<uint32_t> bookFirstVerse;  // books.size() + 1 개
+
+    // Finalize() 로 만든 메모리 저장소
+    QByteArray textData;
+    std::vector<Verse> verses;
+    std::vector<uint32_t> gramKeys;
+    std::vector<uint32_t> gramOffsets;
+    std::vector<uint32_t> postings;
+
+    std::shared_ptr<const WorshipPack> pack;
+
+    void ResetViews();
+
+    bool GetPostings(uint32_t key, const uint32_t *&begin, const uint32_t *&end) const;
+    bool VerseContains(uint32_t id, const QStringList &terms) const;
+};
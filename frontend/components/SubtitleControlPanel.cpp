@@ -239,6 +239,7 @@ void SubtitleControlPanel::RefreshSourceList()
         if (strcmp(id, "text_gdiplus") == 0 || 
             strcmp(id, "text_ft2_source") == 0 ||
             strcmp(id, "text_pango_source") == 0 ||
+            strcmp(id, "subtitle_slideshow_source") == 0 ||
             strstr(id, "text") != nullptr) {
             combo->addItem(QString::fromUtf8(name), QString::fromUtf8(name));
         }
@@ -1010,11 +1011,12 @@ void BibleSearchDialog::UpdateSearchResults()
         return;
     }
     
-    QList<BibleVerse> results = subtitleManager->SearchBible(keyword);
+    // 최대 100개 결과만 표시 (전체 개수는 색인에서 함께 계산)
+    int totalCount = 0;
+    QList<BibleVerse> results = subtitleManager->SearchBible(keyword, 100, &totalCount);
     currentResults = results;
     
-    // 최대 100개 결과만 표시
-    int displayCount = qMin(results.size(), 100);
+    int displayCount = results.size();
     
     for (int i = 0; i < displayCount; ++i) {
         const BibleVerse &verse = results[i];
@@ -1025,8 +1027,8 @@ void BibleSearchDialog::UpdateSearchResults()
         searchResultsList->addItem(item);
     }
     
-    QString countText = QString("검색 결과: %1개").arg(results.size());
-    if (results.size() > 100) {
+    QString countText = QString("검색 결과: %1개").arg(totalCount);
+    if (totalCount > displayCount) {
         countText += " (처음 100개만 표시)";
     }
     resultCountLabel->setText(countText);
@@ -1084,8 +1086,8 @@ QString BibleSearchDialog::GetSelectedTitle() const
 }
 
 // HymnSearchDialog 구현
-HymnSearchDialog::HymnSearchDialog(QWidget *parent)
-    : QDialog(parent)
+HymnSearchDialog::HymnSearchDialog(SubtitleManager *manager, QWidget *parent)
+    : QDialog(parent), subtitleManager(manager)
 {
     setWindowTitle("찬송가 검색");
     setModal(true);
@@ -1156,40 +1158,24 @@ void HymnSearchDialog::OnSearchButtonClicked()
 
 void HymnSearchDialog::LoadHymnData(int hymnNumber)
 {
-    QString filePath = GetHymnFilePath(hymnNumber);
-    QFile file(filePath);
+    QString content;
+    QString errorText;
     
-    if (!file.exists()) {
-        previewText->setPlainText(QString("찬송가 %1장을 찾을 수 없습니다.").arg(hymnNumber));
-        currentHymnContent.clear();
-        currentHymnTitle.clear();
-        
-        QPushButton *okButton = buttonBox->button(QDialogButtonBox::Ok);
-        if (okButton) {
-            okButton->setEnabled(false);
+    // 팩이 로드되어 있으면 파일 I/O 없이 바로 조회
+    if (subtitleManager && subtitleManager->HasHymnData()) {
+        if (!subtitleManager->GetHymnText(hymnNumber, content)) {
+            errorText = QString("찬송가 %1장을 찾을 수 없습니다.").arg(hymnNumber);
         }
-        return;
+    } else {
+        ReadHymnFile(hymnNumber, content, errorText);
     }
     
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        previewText->setPlainText(QString("찬송가 %1장 파일을 읽을 수 없습니다.").arg(hymnNumber));
-        currentHymnContent.clear();
-        currentHymnTitle.clear();
-        
-        QPushButton *okButton = buttonBox->button(QDialogButtonBox::Ok);
-        if (okButton) {
-            okButton->setEnabled(false);
-        }
-        return;
+    if (errorText.isEmpty() && content.isEmpty()) {
+        errorText = QString("찬송가 %1장이 비어있습니다.").arg(hymnNumber);
     }
     
-    QTextStream stream(&file);
-    stream.setEncoding(QStringConverter::Encoding::Utf8);
-    QString content = stream.readAll();
-    file.close();
-    
-    if (content.isEmpty()) {
-        previewText->setPlainText(QString("찬송가 %1장이 비어있습니다.").arg(hymnNumber));
+    if (!errorText.isEmpty()) {
+        previewText->setPlainText(errorText);
         currentHymnContent.clear();
         currentHymnTitle.clear();
         
@@ -1226,6 +1212,28 @@ void HymnSearchDialog::LoadHymnData(int hymnNumber)
     }
 }
 
+bool HymnSearchDialog::ReadHymnFile(int hymnNumber, QString &content, QString &errorText) const
+{
+    QString filePath = GetHymnFilePath(hymnNumber);
+    QFile file(filePath);
+    
+    if (!file.exists()) {
+        errorText = QString("찬송가 %1장을 찾을 수 없습니다.").arg(hymnNumber);
+        return false;
+    }
+    
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        errorText = QString("찬송가 %1장 파일을 읽을 수 없습니다.").arg(hymnNumber);
+        return false;
+    }
+    
+    QTextStream stream(&file);
+    stream.setEncoding(QStringConverter::Encoding::Utf8);
+    content = stream.readAll();
+    file.close();
+    return true;
+}
+
 QString HymnSearchDialog::GetHymnFilePath(int hymnNumber) const
 {
     QString fileName = QString("%1.txt").arg(hymnNumber, 3, 10, QChar('0'));
@@ -231,13 +231,15 @@ private:
     
     QString currentHymnContent;
     QString currentHymnTitle;
+    SubtitleManager *subtitleManager;
     
     void SetupUI();
     void LoadHymnData(int hymnNumber);
+    bool ReadHymnFile(int hymnNumber, QString &content, QString &errorText) const;
     QString GetHymnFilePath(int hymnNumber) const;
 
 public:
-    explicit HymnSearchDialog(QWidget *parent = nullptr);
+    explicit HymnSearchDialog(SubtitleManager *manager, QWidget *parent = nullptr);
     
     QString GetSelectedText() const;
     QString GetSelectedTitle() const;
@@ -284,7 +284,7 @@ void SubtitleEditingPanel::OnBibleSearch()
 void SubtitleEditingPanel::OnHymnSearch()
 {
     // 찬송가 검색 다이얼로그 열기
-    HymnSearchDialog dialog(this);
+    HymnSearchDialog dialog(subtitleManager, this);
     if (dialog.exec() == QDialog::Accepted) {
         QString selectedText = dialog.GetSelectedText();
         QString selectedTitle = dialog.GetSelectedTitle();
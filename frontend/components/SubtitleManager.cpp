@@ -9,6 +9,7 @@
 #include <QDir>
 #include <QSet>
 #include <algorithm>
+#include <climits>
 #include <obs.hpp>
 #include <OBSApp.hpp>
 #include <qt-wrappers.hpp>
@@ -23,9 +24,18 @@ SubtitleManager::SubtitleManager(QObject *parent)
       settings(nullptr),
       bibleDataLoaded(false)
 {
+    calldata_init(&textCallData);
+    
     // 설정 파일 경로 설정
     QString configPath = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation);
     settings = new QSettings(configPath + "/subtitle-manager.ini", QSettings::IniFormat, this);
+    folderStore = std::make_unique<WorshipFolderStore>(configPath + "/subtitle-folders", worshipFolders);
+    
+    // 자막 전환마다 디스크에 쓰지 않도록 설정 저장을 모아서 처리
+    settingsSaveTimer = new QTimer(this);
+    settingsSaveTimer->setSingleShot(true);
+    settingsSaveTimer->setInterval(500);
+    connect(settingsSaveTimer, &QTimer::timeout, this, &SubtitleManager::SaveSettings);
     
     LoadSettings();
     LoadWorshipFolders();
@@ -67,8 +77,11 @@ SubtitleManager::~SubtitleManager()
     signal_handler_disconnect(signalHandler, "source_rename", nullptr, this);
     signal_handler_disconnect(signalHandler, "source_remove", nullptr, this);
     
+    settingsSaveTimer->stop();
     SaveSettings();
-    SaveWorshipFolders();
+    folderStore->FlushAndWait();
+    
+    calldata_free(&textCallData);
 }
 
 void SubtitleManager::SaveSettings()
@@ -93,6 +106,13 @@ void SubtitleManager::SaveSettings()
     settings->sync();
 }
 
+void SubtitleManager::ScheduleSaveSettings()
+{
+    if (!settingsSaveTimer->isActive()) {
+        settingsSaveTimer->start();
+    }
+}
+
 void SubtitleManager::LoadSettings()
 {
     if (!settings) return;
@@ -123,70 +143,92 @@ void SubtitleManager::UpdateTextSource()
 {
     if (targetSourceName.isEmpty()) return;
     
-    // 안전한 소스 접근을 위해 weak reference 사용
-    OBSSourceAutoRelease source = obs_get_source_by_name(targetSourceName.toUtf8().constData());
+    // 자막 전환마다 이름으로 검색하지 않고 보관 중인 weak reference 사용
+    OBSSourceAutoRelease source = obs_weak_source_get_source(targetSource);
     if (!source) {
-        blog(LOG_WARNING, "[SubtitleManager] Source '%s' not found", 
-             targetSourceName.toUtf8().constData());
-        return;
+        source = obs_get_source_by_name(targetSourceName.toUtf8().constData());
+        if (!source) {
+            blog(LOG_WARNING, "[SubtitleManager] Source '%s' not found", 
+                 targetSourceName.toUtf8().constData());
+            return;
+        }
+        targetSource = OBSGetWeakRef(source);
     }
     
-    // 소스가 유효한지 다시 한번 확인
-    if (!obs_source_get_ref(source)) {
-        blog(LOG_WARNING, "[SubtitleManager] Source '%s' is being destroyed", 
-             targetSourceName.toUtf8().constData());
+    // 슬라이드쇼 소스는 폴더 전체를 미리 렌더링해 두고 인덱스만 전환
+    if (strcmp(obs_source_get_id(source), "subtitle_slideshow_source") == 0) {
+        UpdateSlideshowSource(source);
         return;
     }
     
-    QString text = "";
+    QByteArray text;
     if (currentIndex >= 0 && currentIndex < subtitles.size()) {
         if (subtitles[currentIndex].enabled) {
-            text = subtitles[currentIndex].content;
+            text = subtitles[currentIndex].content.toUtf8();
         }
     }
     
-    const char *sourceId = obs_source_get_id(source);
-    if (!sourceId) {
-        blog(LOG_WARNING, "[SubtitleManager] Source ID is null for '%s'", 
-             targetSourceName.toUtf8().constData());
+    // 이미 표시 중인 텍스트면 소스를 건드리지 않음
+    OBSDataAutoRelease current = obs_source_get_settings(source);
+    if (strcmp(obs_data_get_string(current, "text"), text.constData()) == 0) {
         return;
     }
     
-    OBSDataAutoRelease settings = obs_data_create();
+    // text_ft2_source 는 set_text 로 텍스트만 교체 (글꼴/효과를 다시 읽지 않음)
+    calldata_set_string(&textCallData, "text", text.constData());
+    proc_handler_t *ph = obs_source_get_proc_handler(source);
+    if (!proc_handler_call(ph, "set_text", &textCallData)) {
+        // 기타 텍스트 소스 (text_gdiplus 등) 는 일반 업데이트
+        OBSDataAutoRelease settings = obs_data_create();
+        obs_data_set_string(settings, "text", text.constData());
+        obs_source_update(source, settings);
+    }
     
-    // 소스 타입에 따라 올바른 속성명 사용
-    if (strcmp(sourceId, "text_gdiplus") == 0) {
-        obs_data_set_string(settings, "text", text.toUtf8().constData());
-    } else if (strcmp(sourceId, "text_ft2_source") == 0) {
-        obs_data_set_string(settings, "text", text.toUtf8().constData());
-    } else {
-        // 기타 텍스트 소스들에 대한 fallback
-        obs_data_set_string(settings, "text", text.toUtf8().constData());
+    blog(LOG_DEBUG, "[SubtitleManager] Source '%s' updated with text: '%s'", 
+         targetSourceName.toUtf8().constData(), text.constData());
+}
+
+void SubtitleManager::UpdateSlideshowSource(obs_source_t *source)
+{
+    proc_handler_t *ph = obs_source_get_proc_handler(source);
+    
+    QStringList slides;
+    slides.reserve(subtitles.size());
+    for (const SubtitleItem &item : subtitles) {
+        slides.append(item.enabled ? item.content : QString());
     }
     
-    // 안전한 업데이트 수행
-    try {
-        obs_source_update(source, settings);
+    // 슬라이드 목록이 바뀌었거나 소스가 새로 만들어졌을 때만 다시 전달
+    if (slides != pushedSlides || !obs_weak_source_references_source(pushedSlideSource, source)) {
+        QJsonArray slideArray;
+        for (const QString &slide : slides) {
+            QJsonObject slideObj;
+            slideObj["text"] = slide;
+            slideArray.append(slideObj);
+        }
         
-        // 소스가 활성화되어 있는지 확인하고 로그 출력
-        bool sourceActive = obs_source_active(source);
-        bool sourceShowing = obs_source_showing(source);
+        QJsonObject root;
+        root["slides"] = slideArray;
         
-        blog(LOG_INFO, "[SubtitleManager] Source '%s' updated with text: '%s' (Active: %s, Showing: %s)", 
-             targetSourceName.toUtf8().constData(), 
-             text.toUtf8().constData(),
-             sourceActive ? "Yes" : "No",
-             sourceShowing ? "Yes" : "No");
-    } catch (...) {
-        blog(LOG_ERROR, "[SubtitleManager] Exception occurred while updating source '%s'", 
-             targetSourceName.toUtf8().constData());
+        const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Compact);
+        calldata_set_string(&textCallData, "slides", json.constData());
+        proc_handler_call(ph, "set_slides", &textCallData);
+        
+        pushedSlides = slides;
+        pushedSlideSource = OBSGetWeakRef(source);
     }
+    
+    calldata_set_int(&textCallData, "index", currentIndex);
+    proc_handler_call(ph, "set_index", &textCallData);
+    
+    blog(LOG_DEBUG, "[SubtitleManager] Slideshow '%s' switched to slide %d", 
+         targetSourceName.toUtf8().constData(), currentIndex);
 }
 
 void SubtitleManager::AddSubtitle(const QString &title, const QString &content)
 {
     subtitles.append(SubtitleItem(title, content, true));
-    SaveSettings();
+    ScheduleSaveSettings();
     emit SubtitleListChanged();
 }
 
@@ -201,7 +243,7 @@ void SubtitleManager::UpdateSubtitle(int index, const QString &title, const QStr
             UpdateTextSource();
         }
         
-        SaveSettings();
+        ScheduleSaveSettings();
         emit SubtitleListChanged();
     }
 }
@@ -219,7 +261,7 @@ void SubtitleManager::RemoveSubtitle(int index)
             currentIndex--;
         }
         
-        SaveSettings();
+        ScheduleSaveSettings();
         emit SubtitleListChanged();
         emit SubtitleChanged(currentIndex);
     }
@@ -230,7 +272,7 @@ void SubtitleManager::ClearSubtitles()
     subtitles.clear();
     currentIndex = -1;
     UpdateTextSource();
-    SaveSettings();
+    ScheduleSaveSettings();
     emit SubtitleListChanged();
     emit SubtitleChanged(currentIndex);
 }
@@ -240,7 +282,7 @@ void SubtitleManager::SetCurrentSubtitle(int index)
     if (index >= -1 && index < subtitles.size()) {
         currentIndex = index;
         UpdateTextSource();
-        SaveSettings();
+        ScheduleSaveSettings();
         emit SubtitleChanged(currentIndex);
     }
 }
@@ -295,7 +337,7 @@ void SubtitleManager::SetTargetSource(const QString &sourceName)
         }
         
         UpdateTextSource();
-        SaveSettings();
+        ScheduleSaveSettings();
         emit TargetSourceChanged(sourceName);
     }
 }
@@ -332,7 +374,7 @@ void SubtitleManager::ImportFromFile(const QString &filePath)
     
     currentIndex = -1;
     UpdateTextSource();
-    SaveSettings();
+    ScheduleSaveSettings();
     emit SubtitleListChanged();
     emit SubtitleChanged(currentIndex);
 }
@@ -365,7 +407,7 @@ void SubtitleManager::OnSourceRename(const QString &oldName, const QString &newN
 {
     if (targetSourceName == oldName) {
         targetSourceName = newName;
-        SaveSettings();
+        ScheduleSaveSettings();
         emit TargetSourceChanged(newName);
     }
 }
@@ -375,7 +417,7 @@ void SubtitleManager::OnSourceRemoved(const QString &sourceName)
     if (targetSourceName == sourceName) {
         targetSourceName = "";
         targetSource = nullptr;
-        SaveSettings();
+        ScheduleSaveSettings();
         emit TargetSourceChanged("");
     }
 }
@@ -397,45 +439,32 @@ void SubtitleManager::CheckTargetSource()
 }
 
 // 예배 폴더 관리 구현
-void SubtitleManager::SaveWorshipFolders()
+void SubtitleManager::LoadWorshipFolders()
 {
-    if (!settings) return;
-    
-    settings->beginGroup("WorshipFolders");
-    settings->beginWriteArray("folders");
+    worshipFolders.clear();
     
-    for (int i = 0; i < worshipFolders.size(); ++i) {
-        settings->setArrayIndex(i);
-        const WorshipFolder &folder = worshipFolders[i];
-        
-        settings->setValue("id", folder.id);
-        settings->setValue("date", folder.date);
-        settings->setValue("theme", folder.theme);
-        settings->setValue("displayName", folder.displayName);
-        settings->setValue("createdDate", folder.createdDate);
-        settings->setValue("modifiedDate", folder.modifiedDate);
+    if (folderStore->Load(worshipFolders)) {
+        blog(LOG_INFO, "[SubtitleManager] Loaded %d worship folders", (int)worshipFolders.size());
+    } else if (LoadLegacyWorshipFolders()) {
+        // 이전 버전의 QSettings 배열을 폴더별 파일로 한 번만 이전
+        folderStore->MarkAllDirty();
+        folderStore->FlushAndWait();
+        settings->remove("WorshipFolders");
+        ScheduleSaveSettings();
         
-        // 폴더 내 자막들 저장
-        settings->beginWriteArray("subtitles");
-        for (int j = 0; j < folder.subtitles.size(); ++j) {
-            settings->setArrayIndex(j);
-            settings->setValue("title", folder.subtitles[j].title);
-            settings->setValue("content", folder.subtitles[j].content);
-            settings->setValue("enabled", folder.subtitles[j].enabled);
-        }
-        settings->endArray();
+        blog(LOG_INFO, "[SubtitleManager] Migrated %d worship folders from settings", 
+             (int)worshipFolders.size());
     }
     
-    settings->endArray();
-    settings->endGroup();
-    settings->sync();
+    // 현재 폴더가 설정되어 있다면 동기화
+    if (!currentFolderId.isEmpty()) {
+        SyncCurrentSubtitles();
+    }
 }
 
-void SubtitleManager::LoadWorshipFolders()
+bool SubtitleManager::LoadLegacyWorshipFolders()
 {
-    if (!settings) return;
-    
-    worshipFolders.clear();
+    if (!settings) return false;
     
     settings->beginGroup("WorshipFolders");
     int size = settings->beginReadArray("folders");
@@ -468,10 +497,7 @@ void SubtitleManager::LoadWorshipFolders()
     settings->endArray();
     settings->endGroup();
     
-    // 현재 폴더가 설정되어 있다면 동기화
-    if (!currentFolderId.isEmpty()) {
-        SyncCurrentSubtitles();
-    }
+    return size > 0;
 }
 
 WorshipFolder* SubtitleManager::GetCurrentFolder()
@@ -505,7 +531,8 @@ QString SubtitleManager::CreateWorshipFolder(const QString &date, const QString
 {
     WorshipFolder folder(date, theme);
     worshipFolders.append(folder);
-    SaveWorshipFolders();
+    folderStore->MarkFolderDirty(folder.id);
+    folderStore->MarkOrderDirty();
     
     blog(LOG_INFO, "[SubtitleManager] Created worship folder: %s", 
          folder.displayName.toUtf8().constData());
@@ -523,7 +550,7 @@ void SubtitleManager::UpdateWorshipFolder(const QString &folderId, const QString
             worshipFolders[i].updateDisplayName();
             worshipFolders[i].modifiedDate = QDateTime::currentDateTime();
             
-            SaveWorshipFolders();
+            folderStore->MarkFolderDirty(folderId);
             emit WorshipFoldersChanged();
             
             blog(LOG_INFO, "[SubtitleManager] Updated worship folder: %s", 
@@ -549,7 +576,7 @@ void SubtitleManager::RemoveWorshipFolder(const QString &folderId)
                 emit SubtitleChanged(currentIndex);
             }
             
-            SaveWorshipFolders();
+            folderStore->MarkFolderRemoved(folderId);
             emit WorshipFoldersChanged();
             
             blog(LOG_INFO, "[SubtitleManager] Removed worship folder: %s", 
@@ -568,6 +595,7 @@ void SubtitleManager::SetCurrentFolder(const QString &folderId)
             if (prevFolder) {
                 prevFolder->subtitles = subtitles;
                 prevFolder->modifiedDate = QDateTime::currentDateTime();
+                folderStore->MarkFolderDirty(prevFolder->id);
             }
         }
         
@@ -576,8 +604,7 @@ void SubtitleManager::SetCurrentFolder(const QString &folderId)
         
         SyncCurrentSubtitles();
         UpdateTextSource();
-        SaveSettings();
-        SaveWorshipFolders();
+        ScheduleSaveSettings();
         
         emit CurrentFolderChanged(folderId);
         emit SubtitleListChanged();
@@ -606,7 +633,7 @@ void SubtitleManager::AddSubtitleToCurrentFolder(const QString &title, const QSt
         folder->subtitles.append(SubtitleItem(title, content, true));
         folder->modifiedDate = QDateTime::currentDateTime();
         SyncCurrentSubtitles();
-        SaveWorshipFolders();
+        folderStore->MarkFolderDirty(folder->id);
         emit SubtitleListChanged();
     } else {
         // 폴더가 없으면 기존 방식으로 추가
@@ -628,7 +655,7 @@ void SubtitleManager::UpdateSubtitleInCurrentFolder(int index, const QString &ti
         }
         
         SyncCurrentSubtitles();
-        SaveWorshipFolders();
+        folderStore->MarkFolderDirty(folder->id);
         emit SubtitleListChanged();
     } else {
         // 폴더가 없으면 기존 방식으로 업데이트
@@ -652,7 +679,7 @@ void SubtitleManager::RemoveSubtitleFromCurrentFolder(int index)
         }
         
         SyncCurrentSubtitles();
-        SaveWorshipFolders();
+        folderStore->MarkFolderDirty(folder->id);
         emit SubtitleListChanged();
         emit SubtitleChanged(currentIndex);
     } else {
@@ -670,7 +697,7 @@ void SubtitleManager::ClearCurrentFolderSubtitles()
         currentIndex = -1;
         SyncCurrentSubtitles();
         UpdateTextSource();
-        SaveWorshipFolders();
+        folderStore->MarkFolderDirty(folder->id);
         emit SubtitleListChanged();
         emit SubtitleChanged(currentIndex);
     } else {
@@ -683,12 +710,19 @@ void SubtitleManager::ClearCurrentFolderSubtitles()
 void SubtitleManager::LoadBibleData()
 {
     bibleDataLoaded = false;
-    bibleData.clear();
+    bibleIndex.Clear();
+    worshipPack.reset();
     bookNames.clear();
     
-    // 성경 파일 경로 - 실행 파일 기준 상대경로로 설정
-    QString bibleFilePath = QCoreApplication::applicationDirPath() + "/../../data/parser/bible.json";
-    bibleFilePath = QDir::cleanPath(bibleFilePath);
+    // 데이터 경로 - 실행 파일 기준 상대경로로 설정
+    QString parserDir = QDir::cleanPath(QCoreApplication::applicationDirPath() + "/../../data/parser");
+    
+    // 사전 컴파일된 팩이 있으면 매핑만 하고 끝 (파싱 없음)
+    if (LoadWorshipPack(parserDir + "/worship.pack")) {
+        return;
+    }
+    
+    QString bibleFilePath = parserDir + "/bible.json";
     
     QFile file(bibleFilePath);
     if (!file.open(QIODevice::ReadOnly)) {
@@ -706,29 +740,50 @@ void SubtitleManager::LoadBibleData()
     }
     
     QJsonObject obj = doc.object();
-    QSet<QString> uniqueBooks;
     
     for (auto it = obj.begin(); it != obj.end(); ++it) {
-        QString reference = it.key();
-        QString text = it.value().toString();
-        
-        bibleData[reference] = text;
-        
-        // 책 이름 추출
-        QRegularExpression regex("([^0-9]+)\\d+:\\d+");
-        QRegularExpressionMatch match = regex.match(reference);
-        if (match.hasMatch()) {
-            QString book = match.captured(1);
-            uniqueBooks.insert(book);
+        if (!bibleIndex.AddVerse(it.key(), it.value().toString())) {
+            blog(LOG_DEBUG, "[SubtitleManager] Skipping invalid bible reference: %s", 
+                 it.key().toUtf8().constData());
         }
     }
     
-    bookNames = QStringList(uniqueBooks.begin(), uniqueBooks.end());
-    bookNames.sort();
-    bibleDataLoaded = true;
+    // 정경 순서로 정렬하고 연속 본문 버퍼와 검색 색인 생성
+    bibleIndex.Finalize();
+    
+    bookNames = bibleIndex.GetBooks();
+    bibleDataLoaded = !bibleIndex.IsEmpty();
     
     blog(LOG_INFO, "[SubtitleManager] Bible data loaded: %d verses, %d books", 
-         bibleData.size(), bookNames.size());
+         (int)bibleIndex.GetVerseCount(), (int)bookNames.size());
+}
+
+bool SubtitleManager::LoadWorshipPack(const QString &packPath)
+{
+    if (!QFile::exists(packPath)) {
+        return false;
+    }
+    
+    auto pack = std::make_shared<WorshipPack>();
+    if (!pack->Open(packPath) || !bibleIndex.Attach(pack)) {
+        blog(LOG_WARNING, "[SubtitleManager] Failed to load worship pack, falling back to bible.json: %s", 
+             packPath.toUtf8().constData());
+        bibleIndex.Clear();
+        return false;
+    }
+    
+    worshipPack = pack;
+    bookNames = bibleIndex.GetBooks();
+    bibleDataLoaded = !bibleIndex.IsEmpty();
+    
+    blog(LOG_INFO, "[SubtitleManager] Worship pack mapped: %d verses, %d books, %d hymns", 
+         (int)bibleIndex.GetVerseCount(), (int)bookNames.size(), worshipPack->GetHymnCount());
+    return true;
+}
+
+bool SubtitleManager::GetHymnText(int hymnNumber, QString &content) const
+{
+    return worshipPack && worshipPack->GetHymn(hymnNumber, content);
 }
 
 void SubtitleManager::ReloadBibleData()
@@ -736,76 +791,64 @@ void SubtitleManager::ReloadBibleData()
     LoadBibleData();
 }
 
+BibleVerse SubtitleManager::MakeBibleVerse(uint32_t id) const
+{
+    const BibleIndex::Verse &verse = bibleIndex.GetVerse(id);
+    return BibleVerse(bibleIndex.GetVerseBook(id), verse.chapter, verse.verse,
+                      bibleIndex.GetVerseText(id));
+}
+
 BibleVerse SubtitleManager::GetBibleVerse(const QString &reference) const
 {
-    if (bibleData.contains(reference)) {
-        return BibleVerse(reference, bibleData[reference]);
+    int64_t id = bibleIndex.FindVerse(reference);
+    if (id >= 0) {
+        return MakeBibleVerse(uint32_t(id));
     }
     return BibleVerse();
 }
 
-QList<BibleVerse> SubtitleManager::SearchBible(const QString &keyword) const
+QList<BibleVerse> SubtitleManager::SearchBible(const QString &keyword, int maxResults, int *totalMatches) const
 {
     QList<BibleVerse> results;
     
     if (keyword.isEmpty() || !bibleDataLoaded) {
+        if (totalMatches) *totalMatches = 0;
         return results;
     }
     
-    for (auto it = bibleData.begin(); it != bibleData.end(); ++it) {
-        QString reference = it.key();
-        QString text = it.value();
-        
-        if (text.contains(keyword, Qt::CaseInsensitive)) {
-            results.append(BibleVerse(reference, text));
-        }
+    // 색인 결과는 이미 참조순(창1:1, 창1:2, ...)이므로 정렬 불필요
+    const std::vector<uint32_t> ids = bibleIndex.Search(keyword, maxResults, totalMatches);
+    results.reserve(qsizetype(ids.size()));
+    for (uint32_t id : ids) {
+        results.append(MakeBibleVerse(id));
     }
     
-    // 참조순으로 정렬 (창1:1, 창1:2, ... 순서)
-    std::sort(results.begin(), results.end(), [](const BibleVerse &a, const BibleVerse &b) {
-        if (a.book != b.book) return a.book < b.book;
-        if (a.chapter != b.chapter) return a.chapter < b.chapter;
-        return a.verse < b.verse;
-    });
-    
     return results;
 }
 
 QList<BibleVerse> SubtitleManager::GetBibleChapter(const QString &book, int chapter) const
 {
-    QList<BibleVerse> results;
-    
-    if (!bibleDataLoaded) return results;
-    
-    for (auto it = bibleData.begin(); it != bibleData.end(); ++it) {
-        QString reference = it.key();
-        QString text = it.value();
-        
-        BibleVerse verse(reference, text);
-        if (verse.book == book && verse.chapter == chapter) {
-            results.append(verse);
-        }
-    }
-    
-    // 절 순으로 정렬
-    std::sort(results.begin(), results.end(), [](const BibleVerse &a, const BibleVerse &b) {
-        return a.verse < b.verse;
-    });
-    
-    return results;
+    return GetBibleVerses(book, chapter, 1, INT_MAX);
 }
 
 QList<BibleVerse> SubtitleManager::GetBibleVerses(const QString &book, int chapter, int startVerse, int endVerse) const
 {
-    QList<BibleVerse> allVerses = GetBibleChapter(book, chapter);
     QList<BibleVerse> results;
     
+    if (!bibleDataLoaded) return results;
+    
     if (endVerse == -1) endVerse = startVerse;
     
-    for (const BibleVerse &verse : allVerses) {
-        if (verse.verse >= startVerse && verse.verse <= endVerse) {
-            results.append(verse);
-        }
+    uint32_t first = 0;
+    uint32_t last = 0;
+    bibleIndex.GetChapterRange(bibleIndex.FindBook(book), chapter, first, last);
+    
+    // 장 안의 구절은 절 순서로 저장되어 있음
+    for (uint32_t id = first; id < last; ++id) {
+        int verse = bibleIndex.GetVerse(id).verse;
+        if (verse < startVerse) continue;
+        if (verse > endVerse) break;
+        results.append(MakeBibleVerse(id));
     }
     
     return results;
@@ -13,6 +13,12 @@
 #include <QRegularExpression>
 #include <obs.hpp>
 
+#include "BibleIndex.hpp"
+#include "WorshipPack.hpp"
+#include "WorshipFolderStore.hpp"
+
+#include <memory>
+
 struct SubtitleItem {
     QString title;
     QString content;
@@ -56,19 +62,16 @@ struct BibleVerse {
     
     BibleVerse() : chapter(0), verse(0) {}
     BibleVerse(const QString &ref, const QString &txt) 
-        : reference(ref), text(txt) {
+        : reference(ref), text(txt), chapter(0), verse(0) {
         parseReference(ref);
     }
+    BibleVerse(const QString &b, int c, int v, const QString &txt)
+        : reference(QString("%1%2:%3").arg(b).arg(c).arg(v)), text(txt),
+          book(b), chapter(c), verse(v) {}
     
     void parseReference(const QString &ref) {
         // "창1:1" 형태를 파싱
-        QRegularExpression regex("([^0-9]+)(\\d+):(\\d+)");
-        QRegularExpressionMatch match = regex.match(ref);
-        if (match.hasMatch()) {
-            book = match.captured(1);
-            chapter = match.captured(2).toInt();
-            verse = match.captured(3).toInt();
-        }
+        BibleIndex::ParseReference(ref, book, chapter, verse);
     }
     
     QString getDisplayText() const {
@@ -82,27 +85,37 @@ class SubtitleManager : public QObject {
 private:
     QList<SubtitleItem> subtitles;  // 현재 활성 자막 리스트 (레거시 호환)
     QList<WorshipFolder> worshipFolders;  // 예배 폴더들
+    std::unique_ptr<WorshipFolderStore> folderStore;  // 폴더별 파일 저장 (worshipFolders 보다 먼저 해제)
     QString currentFolderId;  // 현재 선택된 폴더 ID
     int currentIndex;
     QString targetSourceName;
     OBSWeakSource targetSource;
+    calldata_t textCallData;  // 자막 전환마다 재사용 (set_text 호출용)
+    OBSWeakSource pushedSlideSource;  // 슬라이드 목록을 마지막으로 전달한 슬라이드쇼 소스
+    QStringList pushedSlides;
     QSettings *settings;
+    QTimer *settingsSaveTimer;
     
     // 성경 데이터
-    QMap<QString, QString> bibleData;  // 성경 구절 데이터 (키: "창1:1", 값: 본문)
-    QStringList bookNames;  // 성경 책 이름 목록
+    BibleIndex bibleIndex;  // 성경 구절 저장소 + 키워드 역색인
+    std::shared_ptr<WorshipPack> worshipPack;  // 매핑된 성경/찬송가 팩 (없으면 bible.json 사용)
+    QStringList bookNames;  // 성경 책 이름 목록 (정경 순서)
     bool bibleDataLoaded;
     
     void SaveSettings();
+    void ScheduleSaveSettings();
     void LoadSettings();
-    void SaveWorshipFolders();
     void LoadWorshipFolders();
+    bool LoadLegacyWorshipFolders();
     void UpdateTextSource();
+    void UpdateSlideshowSource(obs_source_t *source);
     WorshipFolder* GetCurrentFolder();
     void SyncCurrentSubtitles();
     
     // 성경 데이터 관리
     void LoadBibleData();
+    bool LoadWorshipPack(const QString &packPath);
+    BibleVerse MakeBibleVerse(uint32_t id) const;
     void ParseBibleReference(const QString &reference, QString &book, int &chapter, int &verse);
     QList<BibleVerse> SearchBibleByKeyword(const QString &keyword);
     QList<BibleVerse> SearchBibleByRange(const QString &book, int startChapter, int startVerse, int endChapter = -1, int endVerse = -1);
@@ -157,9 +170,13 @@ public:
     void ReloadBibleData();
     QStringList GetBibleBooks() const { return bookNames; }
     BibleVerse GetBibleVerse(const QString &reference) const;
-    QList<BibleVerse> SearchBible(const QString &keyword) const;
+    QList<BibleVerse> SearchBible(const QString &keyword, int maxResults = -1, int *totalMatches = nullptr) const;
     QList<BibleVerse> GetBibleChapter(const QString &book, int chapter) const;
     QList<BibleVerse> GetBibleVerses(const QString &book, int chapter, int startVerse, int endVerse = -1) const;
+    
+    // 찬송가 (팩이 로드된 경우에만 사용 가능)
+    bool HasHymnData() const { return worshipPack && worshipPack->GetHymnCount() > 0; }
+    bool GetHymnText(int hymnNumber, QString &content) const;
 
 signals:
     void SubtitleChanged(int index);
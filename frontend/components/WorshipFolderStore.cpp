@@ -0,0 +1,294 @@
+#include "WorshipFolderStore.hpp"
+#include "SubtitleManager.hpp"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <obs.h>
+#include <util/platform.h>
+
+namespace {
+
+constexpr int flushDelayMs = 500;
+constexpr int storeVersion = 1;
+
+struct FolderWriteTask {
+    std::string path;
+    QByteArray data;
+    bool remove;
+};
+
+void RunFolderWriteTask(void *param)
+{
+    std::unique_ptr<FolderWriteTask> task(static_cast<FolderWriteTask *>(param));
+
+    if (task->remove) {
+        os_unlink(task->path.c_str());
+        os_unlink((task->path + ".bak").c_str());
+        return;
+    }
+
+    // 임시 파일에 기록 후 교체 (config_save_safe 와 같은 방식)
+    if (!os_quick_write_utf8_file_safe(task->path.c_str(), task->data.constData(), size_t(task->data.size()),
+                                       false, "tmp", "bak")) {
+        blog(LOG_WARNING, "[WorshipFolderStore] Failed to write '%s'", task->path.c_str());
+    }
+}
+
+QJsonObject FolderToJson(const WorshipFolder &folder)
+{
+    QJsonArray subtitleArray;
+    for (const SubtitleItem &item : folder.subtitles) {
+        QJsonObject subtitleObj;
+        subtitleObj["title"] = item.title;
+        subtitleObj["content"] = item.content;
+        subtitleObj["enabled"] = item.enabled;
+        subtitleArray.append(subtitleObj);
+    }
+
+    QJsonObject obj;
+    obj["id"] = folder.id;
+    obj["date"] = folder.date;
+    obj["theme"] = folder.theme;
+    obj["displayName"] = folder.displayName;
+    obj["createdDate"] = folder.createdDate.toString(Qt::ISODateWithMs);
+    obj["modifiedDate"] = folder.modifiedDate.toString(Qt::ISODateWithMs);
+    obj["subtitles"] = subtitleArray;
+    return obj;
+}
+
+bool FolderFromJson(const QJsonObject &obj, WorshipFolder &folder)
+{
+    folder.id = obj["id"].toString();
+    if (folder.id.isEmpty()) {
+        return false;
+    }
+
+    folder.date = obj["date"].toString();
+    folder.theme = obj["theme"].toString();
+    folder.displayName = obj["displayName"].toString();
+
+    QDateTime created = QDateTime::fromString(obj["createdDate"].toString(), Qt::ISODateWithMs);
+    QDateTime modified = QDateTime::fromString(obj["modifiedDate"].toString(), Qt::ISODateWithMs);
+    folder.createdDate = created.isValid() ? created : QDateTime::currentDateTime();
+    folder.modifiedDate = modified.isValid() ? modified : QDateTime::currentDateTime();
+
+    folder.subtitles.clear();
+    const QJsonArray subtitleArray = obj["subtitles"].toArray();
+    folder.subtitles.reserve(subtitleArray.size());
+    for (const QJsonValue &value : subtitleArray) {
+        QJsonObject subtitleObj = value.toObject();
+        folder.subtitles.append(SubtitleItem(subtitleObj["title"].toString(), subtitleObj["content"].toString(),
+                                             subtitleObj["enabled"].toBool(true)));
+    }
+    return true;
+}
+
+// 본 파일이 손상되었으면 .bak 으로 복구
+bool ReadJsonObject(const QString &path, QJsonObject &obj)
+{
+    for (const QString &candidate : {path, path + ".bak"}) {
+        QFile file(candidate);
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+        if (doc.isObject()) {
+            obj = doc.object();
+            return true;
+        }
+        blog(LOG_WARNING, "[WorshipFolderStore] Ignoring corrupt file '%s'", candidate.toUtf8().constData());
+    }
+    return false;
+}
+
+} // namespace
+
+WorshipFolderStore::WorshipFolderStore(const QString &directory_, const QList<WorshipFolder> &folders_)
+    : directory(directory_), folders(folders_), flushTimer(new QTimer()), writeQueue(os_task_queue_create())
+{
+    os_mkdirs(directory.toUtf8().constData());
+
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(flushDelayMs);
+    QObject::connect(flushTimer, &QTimer::timeout, flushTimer, [this]() { Flush(); });
+}
+
+WorshipFolderStore::~WorshipFolderStore()
+{
+    FlushAndWait();
+    os_task_queue_destroy(writeQueue);
+    delete flushTimer;
+}
+
+QString WorshipFolderStore::GetIndexPath() const
+{
+    return directory + "/index.json";
+}
+
+QString WorshipFolderStore::GetFolderPath(const QString &folderId) const
+{
+    // 폴더 ID 는 UUID 이지만 이전 설정에서 온 값일 수 있으므로 파일명으로 안전하게
+    QString fileName = folderId;
+    for (QChar &ch : fileName) {
+        if (!ch.isLetterOrNumber() && ch != u'-' && ch != u'_') {
+            ch = u'_';
+        }
+    }
+    return directory + "/" + fileName + ".json";
+}
+
+bool WorshipFolderStore::Load(QList<WorshipFolder> &loaded) const
+{
+    QJsonObject index;
+    if (!ReadJsonObject(GetIndexPath(), index)) {
+        return false;
+    }
+
+    loaded.clear();
+    QSet<QString> seen;
+    QSet<QString> listedFiles;
+
+    const QJsonArray order = index["folders"].toArray();
+    for (const QJsonValue &value : order) {
+        const QString folderId = value.toString();
+        QJsonObject obj;
+        WorshipFolder folder;
+        if (folderId.isEmpty() || seen.contains(folderId) || !ReadJsonObject(GetFolderPath(folderId), obj) ||
+            !FolderFromJson(obj, folder)) {
+            continue;
+        }
+        seen.insert(folder.id);
+        listedFiles.insert(QFileInfo(GetFolderPath(folderId)).fileName());
+        loaded.append(folder);
+    }
+
+    // 폴더 파일은 기록됐지만 index.json 기록 전에 종료된 경우: 뒤에 붙여서 복구
+    QList<WorshipFolder> orphans;
+    const QStringList files = QDir(directory).entryList({"*.json"}, QDir::Files);
+    for (const QString &fileName : files) {
+        if (fileName == QFileInfo(GetIndexPath()).fileName() || listedFiles.contains(fileName)) {
+            continue;
+        }
+
+        QJsonObject obj;
+        WorshipFolder folder;
+        if (ReadJsonObject(directory + "/" + fileName, obj) && FolderFromJson(obj, folder) &&
+            !seen.contains(folder.id)) {
+            seen.insert(folder.id);
+            orphans.append(folder);
+        }
+    }
+
+    std::sort(orphans.begin(), orphans.end(), [](const WorshipFolder &a, const WorshipFolder &b) {
+        return a.createdDate < b.createdDate;
+    });
+    loaded.append(orphans);
+
+    return true;
+}
+
+void WorshipFolderStore::ScheduleFlush()
+{
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
+}
+
+void WorshipFolderStore::MarkFolderDirty(const QString &folderId)
+{
+    removedFolders.remove(folderId);
+    dirtyFolders.insert(folderId);
+    ScheduleFlush();
+}
+
+void WorshipFolderStore::MarkFolderRemoved(const QString &folderId)
+{
+    dirtyFolders.remove(folderId);
+    removedFolders.insert(folderId);
+    orderDirty = true;
+    ScheduleFlush();
+}
+
+void WorshipFolderStore::MarkOrderDirty()
+{
+    orderDirty = true;
+    ScheduleFlush();
+}
+
+void WorshipFolderStore::MarkAllDirty()
+{
+    for (const WorshipFolder &folder : folders) {
+        dirtyFolders.insert(folder.id);
+    }
+    orderDirty = true;
+    ScheduleFlush();
+}
+
+void WorshipFolderStore::QueueWrite(const QString &path, const QByteArray &data)
+{
+    auto *task = new FolderWriteTask{path.toUtf8().toStdString(), data, false};
+    if (!os_task_queue_queue_task(writeQueue, RunFolderWriteTask, task)) {
+        RunFolderWriteTask(task);
+    }
+}
+
+void WorshipFolderStore::QueueRemove(const QString &path)
+{
+    auto *task = new FolderWriteTask{path.toUtf8().toStdString(), QByteArray(), true};
+    if (!os_task_queue_queue_task(writeQueue, RunFolderWriteTask, task)) {
+        RunFolderWriteTask(task);
+    }
+}
+
+void WorshipFolderStore::Flush()
+{
+    flushTimer->stop();
+
+    if (dirtyFolders.isEmpty() && removedFolders.isEmpty() && !orderDirty) {
+        return;
+    }
+
+    // 변경된 폴더만 직렬화 (UI 스레드), 파일 기록은 작업 스레드
+    for (const WorshipFolder &folder : folders) {
+        if (dirtyFolders.contains(folder.id)) {
+            QueueWrite(GetFolderPath(folder.id), QJsonDocument(FolderToJson(folder)).toJson(QJsonDocument::Compact));
+        }
+    }
+
+    // 폴더 파일 → 삭제 → index.json 순서로 기록해야 중간 종료 시에도 데이터가 남는다.
+    // 삭제를 index.json 보다 먼저 해야 목록에 없는 파일을 복구할 때 지운 폴더가 되살아나지 않는다.
+    for (const QString &folderId : removedFolders) {
+        QueueRemove(GetFolderPath(folderId));
+    }
+
+    if (orderDirty) {
+        QJsonArray order;
+        for (const WorshipFolder &folder : folders) {
+            order.append(folder.id);
+        }
+
+        QJsonObject index;
+        index["version"] = storeVersion;
+        index["folders"] = order;
+        QueueWrite(GetIndexPath(), QJsonDocument(index).toJson(QJsonDocument::Compact));
+    }
+
+    dirtyFolders.clear();
+    removedFolders.clear();
+    orderDirty = false;
+}
+
+void WorshipFolderStore::FlushAndWait()
+{
+    Flush();
+    os_task_queue_wait(writeQueue);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <util/task.h>
+
+struct WorshipFolder;
+class QTimer;
+
+// 예배 폴더 저장소
+//
+// 폴더마다 <id>.json 파일 하나, 폴더 순서는 index.json 에 저장한다.
+// 편집 시에는 변경된 폴더만 dirty 로 표시하고, 잠시 후(디바운스) 해당
+// 폴더만 직렬화해서 os_task_queue 작업 스레드에서 기록한다. 파일은
+// 임시 파일에 쓴 뒤 이름을 바꾸므로(.bak 유지) 중간에 종료되어도 안전하다.
+class WorshipFolderStore {
+public:
+    WorshipFolderStore(const QString &directory, const QList<WorshipFolder> &folders);
+    ~WorshipFolderStore();
+
+    WorshipFolderStore(const WorshipFolderStore &) = delete;
+    WorshipFolderStore &operator=(const WorshipFolderStore &) = delete;
+
+    // 저장소가 아직 없으면 false (QSettings 에서 이전 필요)
+    bool Load(QList<WorshipFolder> &folders) const;
+
+    void MarkFolderDirty(const QString &folderId);
+    void MarkFolderRemoved(const QString &folderId);
+    void MarkOrderDirty();
+    void MarkAllDirty();
+
+    // 대기 중인 변경을 작업 스레드로 넘김 / 디스크 기록 완료까지 대기
+    void Flush();
+    void FlushAndWait();
+
+private:
+    QString directory;
+    const QList<WorshipFolder> &folders;
+
+    QTimer *flushTimer;
+    os_task_queue_t *writeQueue;
+
+    QSet<QString> dirtyFolders;
+    QSet<QString> removedFolders;
+    bool orderDirty = false;
+
+    void ScheduleFlush();
+    QString GetFolderPath(const QString &folderId) const;
+    QString GetIndexPath() const;
+    void QueueWrite(const QString &path, const QByteArray &data);
+    void QueueRemove(const QString &path);
+};
@@ -0,0 +1,201 @@
+#include "WorshipPack.hpp"
+#include "BibleIndex.hpp"
+
+#include <cstring>
+#include <obs.h>
+
+namespace {
+
+constexpr char packMagic[8] = {'O', 'B', 'S', 'W', 'P', 'A', 'C', 'K'};
+
+constexpr uint32_t MakeSectionId(char a, char b, char c, char d)
+{
+    return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) |
+           (uint32_t(uint8_t(d)) << 24);
+}
+
+constexpr uint32_t sectionText = MakeSectionId('T', 'E', 'X', 'T');
+constexpr uint32_t sectionVerses = MakeSectionId('V', 'R', 'S', 'E');
+constexpr uint32_t sectionBooks = MakeSectionId('B', 'O', 'O', 'K');
+constexpr uint32_t sectionGramKeys = MakeSectionId('G', 'K', 'E', 'Y');
+constexpr uint32_t sectionGramOffsets = MakeSectionId('G', 'O', 'F', 'F');
+constexpr uint32_t sectionPostings = MakeSectionId('P', 'O', 'S', 'T');
+constexpr uint32_t sectionHymns = MakeSectionId('H', 'Y', 'M', 'N');
+
+struct PackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+};
+
+struct PackSection {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+static_assert(sizeof(PackHeader) == 16, "pack header layout");
+static_assert(sizeof(PackSection) == 24, "pack section layout");
+static_assert(sizeof(BibleIndex::Verse) == 16, "pack verse layout");
+static_assert(sizeof(WorshipPack::BookEntry) == 16, "pack book layout");
+static_assert(sizeof(WorshipPack::HymnEntry) == 8, "pack hymn layout");
+
+} // namespace
+
+WorshipPack::~WorshipPack()
+{
+    Close();
+}
+
+void WorshipPack::Close()
+{
+    os_unmap_file(mapping);
+    mapping = nullptr;
+
+    text = nullptr;
+    textSize = 0;
+    verses = nullptr;
+    verseCount = 0;
+    books = nullptr;
+    bookCount = 0;
+    gramKeys = nullptr;
+    gramOffsets = nullptr;
+    gramKeyCount = 0;
+    postings = nullptr;
+    postingCount = 0;
+    hymns = nullptr;
+    hymnCount = 0;
+}
+
+bool WorshipPack::Open(const QString &path)
+{
+    Close();
+
+    mapping = os_map_file(path.toUtf8().constData());
+    if (!mapping) {
+        return false;
+    }
+
+    const uint8_t *base = static_cast<const uint8_t *>(os_mapped_file_data(mapping));
+    const size_t size = os_mapped_file_size(mapping);
+
+    // 헤더와 섹션표만 검사하고 본문 페이지는 건드리지 않는다.
+    // 구절/포스팅/찬송가 항목의 번호는 읽을 때마다 범위를 확인한다
+    PackHeader header;
+    if (size < sizeof(header)) {
+        blog(LOG_WARNING, "[WorshipPack] '%s' is too small", path.toUtf8().constData());
+        Close();
+        return false;
+    }
+    memcpy(&header, base, sizeof(header));
+
+    if (memcmp(header.magic, packMagic, sizeof(packMagic)) != 0 || header.version != Version) {
+        blog(LOG_WARNING, "[WorshipPack] '%s' has an unsupported format (version %u)",
+             path.toUtf8().constData(), header.version);
+        Close();
+        return false;
+    }
+
+    if (header.sectionCount > (size - sizeof(header)) / sizeof(PackSection)) {
+        blog(LOG_WARNING, "[WorshipPack] '%s' has a truncated section table", path.toUtf8().constData());
+        Close();
+        return false;
+    }
+
+    size_t gramOffsetCount = 0;
+    bool valid = true;
+
+    for (uint32_t i = 0; i < header.sectionCount; ++i) {
+        PackSection section;
+        memcpy(&section, base + sizeof(header) + i * sizeof(section), sizeof(section));
+
+        if (section.offset > size || section.size > size - section.offset || (section.offset & 3) != 0) {
+            valid = false;
+            break;
+        }
+
+        const void *data = base + section.offset;
+        const size_t bytes = size_t(section.size);
+
+        switch (section.id) {
+        case sectionText:
+            text = static_cast<const char *>(data);
+            textSize = bytes;
+            break;
+        case sectionVerses:
+            verses = data;
+            verseCount = bytes / sizeof(BibleIndex::Verse);
+            valid = valid && bytes % sizeof(BibleIndex::Verse) == 0;
+            break;
+        case sectionBooks:
+            books = static_cast<const BookEntry *>(data);
+            bookCount = bytes / sizeof(BookEntry);
+            valid = valid && bytes % sizeof(BookEntry) == 0;
+            break;
+        case sectionGramKeys:
+            gramKeys = static_cast<const uint32_t *>(data);
+            gramKeyCount = bytes / sizeof(uint32_t);
+            break;
+        case sectionGramOffsets:
+            gramOffsets = static_cast<const uint32_t *>(data);
+            gramOffsetCount = bytes / sizeof(uint32_t);
+            break;
+        case sectionPostings:
+            postings = static_cast<const uint32_t *>(data);
+            postingCount = bytes / sizeof(uint32_t);
+            break;
+        case sectionHymns:
+            hymns = static_cast<const HymnEntry *>(data);
+            hymnCount = bytes / sizeof(HymnEntry);
+            break;
+        default:
+            // 알 수 없는 섹션은 이후 버전 호환을 위해 무시
+            break;
+        }
+    }
+
+    // 색인 섹션은 모두 있거나 모두 없어야 한다
+    const bool hasIndex = gramKeys || gramOffsets || postings;
+    if (hasIndex) {
+        valid = valid && gramKeys && gramOffsets && postings && gramOffsetCount == gramKeyCount + 1 &&
+                gramOffsets[0] == 0 && gramOffsets[gramKeyCount] == postingCount;
+    }
+
+    if (!valid || !text || (verseCount && !books)) {
+        blog(LOG_WARNING, "[WorshipPack] '%s' is corrupt", path.toUtf8().constData());
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+bool WorshipPack::GetString(uint32_t offset, uint32_t length, QString &out) const
+{
+    if (!text || offset > textSize || length > textSize - offset) {
+        return false;
+    }
+
+    out = QString::fromUtf8(text + offset, qsizetype(length));
+    return true;
+}
+
+bool WorshipPack::GetHymn(int number, QString &content) const
+{
+    if (number <= 0 || size_t(number) > hymnCount) {
+        return false;
+    }
+
+    const HymnEntry &entry = hymns[number - 1];
+    if (entry.textOffset == HymnAbsent) {
+        return false;
+    }
+
+    if (!entry.textLength) {
+        content.clear();
+        return true;
+    }
+
+    return GetString(entry.textOffset, entry.textLength, content);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+#include <util/platform.h>
+
+// 사전 컴파일된 성경/찬송가 팩 (parser/make-worship-pack.py 로 생성)
+//
+// 파일 전체를 os_map_file 로 읽기 전용 매핑하므로 시작 시 파싱 비용이 없고,
+// 실제로 접근한 페이지만 필요할 때 읽힌다. Open() 은 헤더와 섹션표만
+// 검사하므로 섹션 안의 번호(구절 오프셋, 포스팅 등)는 사용하는 쪽에서
+// 접근할 때 범위를 확인해야 한다. 모든 정수는 리틀 엔디언이며
+// 각 섹션은 4바이트 정렬되어 있다.
+//
+//   헤더   : char magic[8] "OBSWPACK", u32 version, u32 sectionCount
+//   섹션표 : { u32 id, u32 reserved, u64 offset, u64 size } * sectionCount
+//   TEXT  : 구절/찬송가/책 이름 UTF-8 본문
+//   VRSE  : BibleIndex::Verse 배열 (정경 순서)
+//   BOOK  : BookEntry 배열 (정경 순서)
+//   GKEY, GOFF, POST : 1-gram/2-gram 역색인 (BibleIndex 와 같은 CSR 형식)
+//   HYMN  : HymnEntry 배열, 인덱스 = 찬송가 번호 - 1
+class WorshipPack {
+public:
+    static constexpr uint32_t Version = 3;
+    static constexpr uint32_t HymnAbsent = 0xFFFFFFFF;
+
+    struct BookEntry {
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t firstVerse;
+        uint32_t reserved;
+    };
+
+    struct HymnEntry {
+        uint32_t textOffset;  // HymnAbsent 이면 해당 번호 없음
+        uint32_t textLength;  // 0 이면 빈 찬송가
+    };
+
+    WorshipPack() = default;
+    ~WorshipPack();
+
+    WorshipPack(const WorshipPack &) = delete;
+    WorshipPack &operator=(const WorshipPack &) = delete;
+
+    bool Open(const QString &path);
+    void Close();
+    bool IsOpen() const { return mapping != nullptr; }
+
+    const char *GetText() const { return text; }
+    size_t GetTextSize() const { return textSize; }
+
+    const void *GetVerses() const { return verses; }
+    size_t GetVerseCount() const { return verseCount; }
+
+    const BookEntry *GetBooks() const { return books; }
+    size_t GetBookCount() const { return bookCount; }
+
+    const uint32_t *GetGramKeys() const { return gramKeys; }
+    const uint32_t *GetGramOffsets() const { return gramOffsets; }
+    size_t GetGramKeyCount() const { return gramKeyCount; }
+    const uint32_t *GetPostings() const { return postings; }
+    size_t GetPostingCount() const { return postingCount; }
+
+    int GetHymnCount() const { return int(hymnCount); }
+    bool GetHymn(int number, QString &content) const;
+
+    // TEXT 섹션 범위 확인 후 문자열 변환
+    bool GetString(uint32_t offset, uint32_t length, QString &out) const;
+
+private:
+    os_mapped_file_t *mapping = nullptr;
+
+    const char *text = nullptr;
+    size_t textSize = 0;
+    const void *verses = nullptr;
+    size_t verseCount = 0;
+    const BookEntry *books = nullptr;
+    size_t bookCount = 0;
+    const uint32_t *gramKeys = nullptr;
+    const uint32_t *gramOffsets = nullptr;
+    size_t gramKeyCount = 0;
+    const uint32_t *postings = nullptr;
+    size_t postingCount = 0;
+    const HymnEntry *hymns = nullptr;
+    size_t hymnCount = 0;
+};
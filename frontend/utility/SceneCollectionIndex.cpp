@@ -0,0 +1,423 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "SceneCollectionIndex.hpp"
+
+#include <obs.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <system_error>
+
+// MARK: Constant Expressions
+
+static constexpr std::string_view IndexFileName = "scene_collections.index";
+static constexpr int IndexVersion = 1;
+
+// MARK: - Anonymous Namespace
+namespace {
+
+/* Tracks just enough JSON structure to pick top level values out of a file
+ * while it streams past, nothing is ever built into a tree. */
+class CollectionScanner {
+	enum class State { Value, Key, Colon, Next };
+
+	OBS::SceneCollectionIndex::Entry &entry_;
+
+	State state_ = State::Value;
+	int depth_ = 0;
+	bool inString_ = false;
+	bool escape_ = false;
+	int unicodeDigits_ = 0;
+	uint32_t unicode_ = 0;
+	uint32_t highSurrogate_ = 0;
+
+	std::string key_;
+	std::string string_;
+	bool stringIsKey_ = false;
+	bool capture_ = false;
+
+	bool inName_ = false;
+	bool inSources_ = false;
+	bool sourcesEmpty_ = true;
+	bool complete_ = false;
+	bool failed_ = false;
+
+	void appendCodePoint(uint32_t cp)
+	{
+		if (cp < 0x80) {
+			string_ += static_cast<char>(cp);
+		} else if (cp < 0x800) {
+			string_ += static_cast<char>(0xC0 | (cp >> 6));
+			string_ += static_cast<char>(0x80 | (cp & 0x3F));
+		} else if (cp < 0x10000) {
+			string_ += static_cast<char>(0xE0 | (cp >> 12));
+			string_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			string_ += static_cast<char>(0x80 | (cp & 0x3F));
+		} else {
+			string_ += static_cast<char>(0xF0 | (cp >> 18));
+			string_ += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+			string_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			string_ += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+	}
+
+	void unicodeEscape()
+	{
+		if (unicode_ >= 0xD800 && unicode_ < 0xDC00) {
+			highSurrogate_ = unicode_;
+			return;
+		}
+
+		if (unicode_ >= 0xDC00 && unicode_ < 0xE000 && highSurrogate_) {
+			appendCodePoint(0x10000 + ((highSurrogate_ - 0xD800) << 10) + (unicode_ - 0xDC00));
+		} else {
+			appendCodePoint(unicode_);
+		}
+		highSurrogate_ = 0;
+	}
+
+	void stringChar(char c)
+	{
+		if (unicodeDigits_) {
+			int digit = (c >= '0' && c <= '9')   ? c - '0'
+				    : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+				    : (c >= 'A' && c <= 'F') ? c - 'A' + 10
+							     : -1;
+			if (digit < 0) {
+				failed_ = true;
+				return;
+			}
+
+			unicode_ = (unicode_ << 4) | static_cast<uint32_t>(digit);
+			if (--unicodeDigits_ == 0 && capture_)
+				unicodeEscape();
+			return;
+		}
+
+		if (escape_) {
+			escape_ = false;
+
+			switch (c) {
+			case 'b':
+				c = '\b';
+				break;
+			case 'f':
+				c = '\f';
+				break;
+			case 'n':
+				c = '\n';
+				break;
+			case 'r':
+				c = '\r';
+				break;
+			case 't':
+				c = '\t';
+				break;
+			case 'u':
+				unicodeDigits_ = 4;
+				unicode_ = 0;
+				return;
+			}
+
+			if (capture_)
+				string_ += c;
+			return;
+		}
+
+		if (c == '\\') {
+			escape_ = true;
+		} else if (c == '"') {
+			inString_ = false;
+			endString();
+		} else if (capture_) {
+			string_ += c;
+		}
+	}
+
+	void endString()
+	{
+		if (stringIsKey_) {
+			key_.swap(string_);
+			state_ = State::Colon;
+		} else {
+			if (inName_)
+				entry_.name = string_;
+			endValue();
+		}
+
+		string_.clear();
+		capture_ = false;
+	}
+
+	/* a top level value or an element of the top level sources array
+	 * ended */
+	void endValue()
+	{
+		inName_ = false;
+		state_ = State::Next;
+	}
+
+	void beginValue()
+	{
+		if (depth_ == 1) {
+			inName_ = key_ == "name";
+			inSources_ = key_ == "sources";
+			sourcesEmpty_ = true;
+		} else if (depth_ == 2 && inSources_ && sourcesEmpty_) {
+			sourcesEmpty_ = false;
+			entry_.sourceCount = 1;
+		}
+	}
+
+public:
+	explicit CollectionScanner(OBS::SceneCollectionIndex::Entry &entry) : entry_(entry) {}
+
+	bool complete() const { return complete_ && !failed_; }
+	bool failed() const { return failed_; }
+
+	void feed(const char *data, size_t size)
+	{
+		for (size_t i = 0; i < size && !failed_; i++) {
+			char c = data[i];
+
+			if (inString_) {
+				stringChar(c);
+				continue;
+			}
+
+			switch (c) {
+			case ' ':
+			case '\t':
+			case '\r':
+			case '\n':
+				break;
+
+			case '"':
+				if (state_ == State::Value)
+					beginValue();
+
+				inString_ = true;
+				stringIsKey_ = depth_ == 1 && state_ == State::Key;
+				capture_ = stringIsKey_ || (depth_ == 1 && inName_);
+				break;
+
+			case '{':
+			case '[':
+				if (complete_) {
+					failed_ = true;
+					break;
+				}
+				if (depth_ == 0 && c != '{') {
+					failed_ = true;
+					break;
+				}
+
+				beginValue();
+				depth_++;
+				state_ = (c == '{' && depth_ == 1) ? State::Key : State::Value;
+				break;
+
+			case '}':
+			case ']':
+				if (depth_ == 0) {
+					failed_ = true;
+					break;
+				}
+
+				depth_--;
+				if (depth_ == 1 && inSources_)
+					inSources_ = false;
+				if (depth_ == 0)
+					complete_ = true;
+				endValue();
+				break;
+
+			case ':':
+				if (depth_ == 1 && state_ != State::Colon) {
+					failed_ = true;
+					break;
+				}
+				state_ = State::Value;
+				break;
+
+			case ',':
+				if (depth_ == 2 && inSources_)
+					entry_.sourceCount++;
+				state_ = depth_ == 1 ? State::Key : State::Value;
+				break;
+
+			default:
+				/* numbers, true, false and null */
+				if (state_ == State::Value)
+					beginValue();
+				if (depth_ == 1)
+					inName_ = false;
+				break;
+			}
+		}
+	}
+};
+
+/* FNV-1a */
+constexpr uint64_t HashBasis = 0xcbf29ce484222325ULL;
+constexpr uint64_t HashPrime = 0x100000001b3ULL;
+
+uint64_t hashBytes(uint64_t hash, const char *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= HashPrime;
+	}
+	return hash;
+}
+
+std::optional<OBS::SceneCollectionIndex::Entry> scanSingleFile(const std::filesystem::path &filePath)
+{
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file.is_open()) {
+		return {};
+	}
+
+	OBS::SceneCollectionIndex::Entry entry{};
+	CollectionScanner scanner{entry};
+	uint64_t hash = HashBasis;
+	char buffer[64 * 1024];
+
+	while (file && !scanner.failed()) {
+		file.read(buffer, sizeof(buffer));
+		std::streamsize count = file.gcount();
+		if (count <= 0) {
+			break;
+		}
+
+		scanner.feed(buffer, static_cast<size_t>(count));
+		hash = hashBytes(hash, buffer, static_cast<size_t>(count));
+		entry.size += static_cast<uint64_t>(count);
+	}
+
+	if (!scanner.complete()) {
+		return {};
+	}
+
+	entry.hash = hash;
+	return entry;
+}
+
+int64_t fileTimeToInt(std::filesystem::file_time_type time)
+{
+	return static_cast<int64_t>(time.time_since_epoch().count());
+}
+} // namespace
+
+namespace OBS {
+SceneCollectionIndex::SceneCollectionIndex(const std::filesystem::path &directory)
+	: indexPath_(directory / std::filesystem::u8path(IndexFileName))
+{
+	load();
+}
+
+void SceneCollectionIndex::load()
+{
+	OBSDataAutoRelease data = obs_data_create_from_json_file_safe(indexPath_.u8string().c_str(), "bak");
+	if (!data || obs_data_get_int(data, "version") != IndexVersion) {
+		return;
+	}
+
+	OBSDataArrayAutoRelease files = obs_data_get_array(data, "files");
+	size_t count = obs_data_array_count(files);
+
+	for (size_t i = 0; i < count; i++) {
+		OBSDataAutoRelease item = obs_data_array_item(files, i);
+		Entry entry{};
+
+		entry.name = obs_data_get_string(item, "name");
+		entry.modifiedTime = obs_data_get_int(item, "mtime");
+		entry.size = static_cast<uint64_t>(obs_data_get_int(item, "size"));
+		entry.sourceCount = static_cast<uint64_t>(obs_data_get_int(item, "sources"));
+		entry.hash = strtoull(obs_data_get_string(item, "hash"), nullptr, 16);
+
+		entries_.insert_or_assign(obs_data_get_string(item, "file"), std::move(entry));
+	}
+}
+
+const SceneCollectionIndex::Entry &SceneCollectionIndex::lookup(const std::filesystem::directory_entry &file)
+{
+	const std::string fileName = file.path().filename().u8string();
+	std::error_code error;
+
+	int64_t modifiedTime = fileTimeToInt(file.last_write_time(error));
+	uint64_t size = error ? 0 : static_cast<uint64_t>(file.file_size(error));
+
+	seen_[fileName] = true;
+
+	auto found = entries_.find(fileName);
+	if (!error && found != entries_.end() && found->second.modifiedTime == modifiedTime &&
+	    found->second.size == size) {
+		return found->second;
+	}
+
+	Entry entry = scanFile(file.path()).value_or(Entry{});
+	entry.modifiedTime = modifiedTime;
+	entry.size = size;
+
+	dirty_ = true;
+	return entries_.insert_or_assign(fileName, std::move(entry)).first->second;
+}
+
+void SceneCollectionIndex::save()
+{
+	for (auto it = entries_.begin(); it != entries_.end();) {
+		if (seen_.find(it->first) == seen_.end()) {
+			it = entries_.erase(it);
+			dirty_ = true;
+		} else {
+			++it;
+		}
+	}
+
+	if (!dirty_) {
+		return;
+	}
+
+	OBSDataAutoRelease data = obs_data_create();
+	OBSDataArrayAutoRelease files = obs_data_array_create();
+
+	for (const auto &[fileName, entry] : entries_) {
+		OBSDataAutoRelease item = obs_data_create();
+		char hash[17];
+
+		snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(entry.hash));
+
+		obs_data_set_string(item, "file", fileName.c_str());
+		obs_data_set_string(item, "name", entry.name.c_str());
+		obs_data_set_int(item, "mtime", entry.modifiedTime);
+		obs_data_set_int(item, "size", static_cast<long long>(entry.size));
+		obs_data_set_int(item, "sources", static_cast<long long>(entry.sourceCount));
+		obs_data_set_string(item, "hash", hash);
+		obs_data_array_push_back(files, item);
+	}
+
+	obs_data_set_int(data, "version", IndexVersion);
+	obs_data_set_array(data, "files", files);
+
+	if (obs_data_save_json_safe(data, indexPath_.u8string().c_str(), "tmp", "bak")) {
+		dirty_ = false;
+	} else {
+		blog(LOG_WARNING, "Failed to save scene collection index '%s'", indexPath_.u8string().c_str());
+	}
+}
+
+std::optional<SceneCollectionIndex::Entry> SceneCollectionIndex::scanFile(const std::filesystem::path &filePath)
+{
+	std::optional<Entry> entry = scanSingleFile(filePath);
+
+	if (!entry) {
+		std::filesystem::path backupFilePath = filePath;
+		backupFilePath += ".bak";
+		entry = scanSingleFile(backupFilePath);
+	}
+
+	return entry;
+}
+} // namespace OBS
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace OBS {
+
+/* Metadata of the scene collection files in a directory, kept in a sidecar
+ * file next to them.  An entry is only trusted while the size and the
+ * modification time of its file are unchanged, otherwise the file is scanned
+ * again without parsing it into obs_data. */
+class SceneCollectionIndex {
+public:
+	struct Entry {
+		std::string name;
+		int64_t modifiedTime = 0;
+		uint64_t size = 0;
+		uint64_t sourceCount = 0;
+		uint64_t hash = 0;
+	};
+
+private:
+	std::filesystem::path indexPath_;
+	std::unordered_map<std::string, Entry> entries_;
+	std::unordered_map<std::string, bool> seen_;
+	bool dirty_ = false;
+
+	void load();
+
+public:
+	explicit SceneCollectionIndex(const std::filesystem::path &directory);
+
+	/* returns the entry of a collection file, rescanning it if it changed */
+	const Entry &lookup(const std::filesystem::directory_entry &file);
+
+	/* writes the index back if anything changed, files that were not
+	 * looked up since it was loaded are dropped from it */
+	void save();
+
+	/* reads the top level name and the number of sources of a collection
+	 * file in one streaming pass, falling back to the backup file if the
+	 * file is incomplete */
+	static std::optional<Entry> scanFile(const std::filesystem::path &filePath);
+};
+} // namespace OBS
@@ -717,6 +717,7 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_bool(activeConfiguration, "AdvOut", "RecRB", false);
 	config_set_default_uint(activeConfiguration, "AdvOut", "RecRBTime", 20);
 	config_set_default_int(activeConfiguration, "AdvOut", "RecRBSize", 512);
+	config_set_default_int(activeConfiguration, "AdvOut", "RecRBMemory", 0);
 
 	config_set_default_uint(activeConfiguration, "Video", "BaseCX", cx);
 	config_set_default_uint(activeConfiguration, "Video", "BaseCY", cy);
@@ -779,6 +780,7 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_string(activeConfiguration, "Video", "ColorRange", "Partial");
 	config_set_default_uint(activeConfiguration, "Video", "SdrWhiteLevel", 300);
 	config_set_default_uint(activeConfiguration, "Video", "HdrNominalPeakLevel", 1000);
+	config_set_default_bool(activeConfiguration, "Video", "ParallelRawEncoders", false);
 
 	config_set_default_string(activeConfiguration, "Audio", "MonitoringDeviceId", "default");
 	config_set_default_string(activeConfiguration, "Audio", "MonitoringDeviceName",
@@ -1538,6 +1540,12 @@ int OBSBasic::ResetVideo()
 		const float hdr_nominal_peak_level =
 			(float)config_get_uint(activeConfiguration, "Video", "HdrNominalPeakLevel");
 		obs_set_video_levels(sdr_white_level, hdr_nominal_peak_level);
+
+		/* raw encoders (x264, recording at another resolution, ...)
+		 * scale and encode on their own threads */
+		const bool parallel_inputs = config_get_bool(activeConfiguration, "Video", "ParallelRawEncoders");
+		video_output_set_parallel_inputs(obs_get_video(), parallel_inputs);
+
 		OBSBasicStats::InitializeValues();
 		OBSProjector::UpdateMultiviewProjectors();
 
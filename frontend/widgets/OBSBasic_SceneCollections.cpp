@@ -21,6 +21,7 @@
 #include <importer/OBSImporter.hpp>
 #include <models/SceneCollection.hpp>
 #include <utility/item-widget-helpers.hpp>
+#include <utility/SceneCollectionIndex.hpp>
 
 #include <qt-wrappers.hpp>
 
@@ -39,6 +40,7 @@ extern std::string opt_starting_scene;
 
 using SceneCoordinateMode = OBS::SceneCoordinateMode;
 using SceneCollection = OBS::SceneCollection;
+using SceneCollectionIndex = OBS::SceneCollectionIndex;
 
 // MARK: Constant Expressions
 
@@ -437,6 +439,9 @@ void OBSBasic::RefreshSceneCollectionCache()
 		return;
 	}
 
+	/* only files that changed since the last refresh are read at all */
+	SceneCollectionIndex index{collectionsPath};
+
 	for (const auto &entry : std::filesystem::directory_iterator(collectionsPath)) {
 		if (entry.is_directory()) {
 			continue;
@@ -446,11 +451,8 @@ void OBSBasic::RefreshSceneCollectionCache()
 			continue;
 		}
 
-		OBSDataAutoRelease collectionData =
-			obs_data_create_from_json_file_safe(entry.path().u8string().c_str(), "bak");
-
 		std::string candidateName;
-		std::string collectionName = obs_data_get_string(collectionData, "name");
+		std::string collectionName = index.lookup(entry).name;
 
 		if (collectionName.empty()) {
 			candidateName = entry.path().stem().u8string();
@@ -461,6 +463,8 @@ void OBSBasic::RefreshSceneCollectionCache()
 		foundCollections.try_emplace(candidateName, candidateName, entry.path());
 	}
 
+	index.save();
+
 	collections.swap(foundCollections);
 }
 
@@ -1293,7 +1297,11 @@ void OBSBasic::LoadData(obs_data_t *data, SceneCollection &collection)
 	updateRemigrationMenuItem(collection.getCoordinateMode(), ui->actionRemigrateSceneCollection);
 
 	obs_missing_files_t *files = obs_missing_files_create();
-	obs_load_sources(sources, AddMissingFiles, files);
+	/* Sources that can be created in parallel are queued first if the
+	 * preview or program shows them, the whole collection is still loaded
+	 * before this returns. */
+	const char *priorityScenes[] = {sceneName, programSceneName, nullptr};
+	obs_load_sources2(sources, priorityScenes, AddMissingFiles, files);
 
 	if (resetVideo)
 		ResetVideo();
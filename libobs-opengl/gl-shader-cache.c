@@ -0,0 +1,471 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include "gl-subsystem.h"
+
+/*
+ * Linked program binaries are cached on disk, one file per vertex/pixel
+ * shader pair.  Files are named after the hashes of the generated GLSL of
+ * both shaders, and live in a subdirectory named after the hash of the
+ * driver vendor/renderer/version strings, so a driver update simply starts
+ * a new cache.  Hybrid GPU systems switch between drivers, so the caches of
+ * the few most recently used drivers are kept and only older ones are
+ * removed.  Any shader that appears in a cached pair is known to have
+ * compiled before, so its compilation is deferred until a program binary
+ * using it is actually rejected by the driver.
+ */
+
+#define SHADER_CACHE_MAGIC 0x43534C47 /* "GLSC" */
+#define SHADER_CACHE_VERSION 1
+#define SHADER_CACHE_MAX_SIZE (64 * 1024 * 1024)
+#define SHADER_CACHE_MAX_DRIVERS 4
+#define SHADER_CACHE_STAMP "last-used"
+
+struct shader_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t vertex_hash;
+	uint64_t pixel_hash;
+	uint32_t format;
+	uint32_t size;
+};
+
+static uint64_t hash_str(uint64_t hash, const char *str)
+{
+	/* 64-bit FNV-1a */
+	if (str) {
+		while (*str) {
+			hash ^= (uint8_t)*(str++);
+			hash *= 0x100000001B3ULL;
+		}
+	}
+
+	/* separate consecutive strings */
+	hash ^= 0xFF;
+	hash *= 0x100000001B3ULL;
+	return hash;
+}
+
+#define HASH_SEED 0xCBF29CE484222325ULL
+
+uint64_t gl_shader_cache_hash(const char *str)
+{
+	return hash_str(HASH_SEED, str);
+}
+
+static inline bool is_binary_supported(void)
+{
+	GLint num_formats = 0;
+
+	if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+		return false;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+	return gl_success("glGetIntegerv") && num_formats > 0;
+}
+
+void gl_shader_cache_init(gs_device_t *device)
+{
+	struct gl_shader_cache *cache = &device->shader_cache;
+	uint64_t hash = HASH_SEED;
+
+	hash = hash_str(hash, (const char *)glGetString(GL_VENDOR));
+	hash = hash_str(hash, (const char *)glGetString(GL_RENDERER));
+	hash = hash_str(hash, (const char *)glGetString(GL_VERSION));
+	hash = hash_str(hash, (const char *)glGetString(GL_SHADING_LANGUAGE_VERSION));
+
+	cache->driver_hash = hash;
+	cache->supported = is_binary_supported();
+}
+
+void gl_shader_cache_free(gs_device_t *device)
+{
+	struct gl_shader_cache *cache = &device->shader_cache;
+
+	if (cache->path) {
+		blog(LOG_INFO, "Shader cache: %" PRIu32 " hits, %" PRIu32 " misses, %" PRIu32 " rejected", cache->hits,
+		     cache->misses, cache->rejected);
+	}
+
+	da_free(cache->known_shaders);
+	bfree(cache->path);
+	memset(cache, 0, sizeof(*cache));
+}
+
+static size_t find_known_shader(const struct gl_shader_cache *cache, uint64_t hash)
+{
+	size_t lo = 0;
+	size_t hi = cache->known_shaders.num;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (cache->known_shaders.array[mid] < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void add_known_shader(struct gl_shader_cache *cache, uint64_t hash)
+{
+	size_t idx = find_known_shader(cache, hash);
+
+	if (idx < cache->known_shaders.num && cache->known_shaders.array[idx] == hash)
+		return;
+
+	da_insert(cache->known_shaders, idx, &hash);
+}
+
+bool gl_shader_cache_known(gs_device_t *device, uint64_t hash)
+{
+	const struct gl_shader_cache *cache = &device->shader_cache;
+	size_t idx;
+
+	if (!cache->path)
+		return false;
+
+	idx = find_known_shader(cache, hash);
+	return idx < cache->known_shaders.num && cache->known_shaders.array[idx] == hash;
+}
+
+static void scan_known_shaders(struct gl_shader_cache *cache)
+{
+	os_dir_t *dir = os_opendir(cache->path);
+	struct os_dirent *ent;
+
+	if (!dir)
+		return;
+
+	while ((ent = os_readdir(dir)) != NULL) {
+		unsigned long long vertex_hash;
+		unsigned long long pixel_hash;
+		char ext[5] = {0};
+
+		if (ent->directory)
+			continue;
+		if (sscanf(ent->d_name, "%16llx-%16llx.%4s", &vertex_hash, &pixel_hash, ext) != 3 ||
+		    strcmp(ext, "bin") != 0)
+			continue;
+
+		add_known_shader(cache, (uint64_t)vertex_hash);
+		add_known_shader(cache, (uint64_t)pixel_hash);
+	}
+
+	os_closedir(dir);
+}
+
+static bool is_driver_dir_name(const char *name)
+{
+	size_t len = strlen(name);
+
+	if (len != 16)
+		return false;
+
+	for (size_t i = 0; i < len; i++) {
+		if (!isxdigit((unsigned char)name[i]))
+			return false;
+	}
+
+	return true;
+}
+
+static void remove_dir_files(const char *path)
+{
+	os_dir_t *dir = os_opendir(path);
+	struct os_dirent *ent;
+	struct dstr file = {0};
+
+	if (!dir)
+		return;
+
+	while ((ent = os_readdir(dir)) != NULL) {
+		if (ent->directory)
+			continue;
+
+		dstr_printf(&file, "%s/%s", path, ent->d_name);
+		os_unlink(file.array);
+	}
+
+	os_closedir(dir);
+	dstr_free(&file);
+}
+
+struct driver_cache {
+	char name[17];
+	time_t last_used;
+};
+
+/* the stamp file is rewritten whenever a cache is opened, caches without one
+ * count as the oldest */
+static time_t get_last_used(const char *path, const char *driver_dir)
+{
+	struct dstr stamp = {0};
+	struct stat stats;
+	time_t last_used = 0;
+
+	dstr_printf(&stamp, "%s/%s/" SHADER_CACHE_STAMP, path, driver_dir);
+	if (os_stat(stamp.array, &stats) == 0)
+		last_used = stats.st_mtime;
+
+	dstr_free(&stamp);
+	return last_used;
+}
+
+static int cmp_last_used(const void *a, const void *b)
+{
+	const struct driver_cache *cache_a = a;
+	const struct driver_cache *cache_b = b;
+
+	if (cache_a->last_used != cache_b->last_used)
+		return cache_a->last_used > cache_b->last_used ? -1 : 1;
+	return 0;
+}
+
+/* keeps the caches of the most recently used drivers besides the current one,
+ * the others are unlikely to be used again */
+static void prune_stale_caches(const char *path, const char *driver_dir)
+{
+	os_dir_t *dir = os_opendir(path);
+	struct os_dirent *ent;
+	DARRAY(struct driver_cache) caches;
+	struct dstr stale = {0};
+
+	if (!dir)
+		return;
+
+	da_init(caches);
+
+	while ((ent = os_readdir(dir)) != NULL) {
+		struct driver_cache *cache;
+
+		if (!ent->directory || !is_driver_dir_name(ent->d_name))
+			continue;
+		if (astrcmpi(ent->d_name, driver_dir) == 0)
+			continue;
+
+		cache = da_push_back_new(caches);
+		strcpy(cache->name, ent->d_name);
+		cache->last_used = get_last_used(path, ent->d_name);
+	}
+
+	os_closedir(dir);
+
+	if (caches.num)
+		qsort(caches.array, caches.num, sizeof(*caches.array), cmp_last_used);
+
+	for (size_t i = SHADER_CACHE_MAX_DRIVERS - 1; i < caches.num; i++) {
+		dstr_printf(&stale, "%s/%s", path, caches.array[i].name);
+		remove_dir_files(stale.array);
+		if (os_rmdir(stale.array) == 0)
+			blog(LOG_INFO, "Shader cache: removed stale cache '%s'", stale.array);
+	}
+
+	da_free(caches);
+	dstr_free(&stale);
+}
+
+static void touch_stamp(const char *driver_path)
+{
+	struct dstr stamp = {0};
+
+	dstr_printf(&stamp, "%s/" SHADER_CACHE_STAMP, driver_path);
+	os_quick_write_utf8_file(stamp.array, "", 0, false);
+	dstr_free(&stamp);
+}
+
+void device_set_shader_cache_path(gs_device_t *device, const char *path)
+{
+	struct gl_shader_cache *cache = &device->shader_cache;
+	struct dstr dir = {0};
+
+	da_free(cache->known_shaders);
+	bfree(cache->path);
+	cache->path = NULL;
+
+	if (!path || !*path)
+		return;
+
+	if (!cache->supported) {
+		blog(LOG_INFO, "Shader cache: program binaries are not "
+			       "supported by this driver, cache disabled");
+		return;
+	}
+
+	dstr_printf(&dir, "%s/%016" PRIx64, path, cache->driver_hash);
+
+	if (os_mkdirs(dir.array) == MKDIR_ERROR) {
+		blog(LOG_WARNING, "Shader cache: failed to create '%s'", dir.array);
+		dstr_free(&dir);
+		return;
+	}
+
+	touch_stamp(dir.array);
+	prune_stale_caches(path, dir.array + dir.len - 16);
+
+	cache->path = dir.array;
+	scan_known_shaders(cache);
+
+	blog(LOG_INFO, "Shader cache: using '%s' (%zu known shaders)", cache->path, cache->known_shaders.num);
+}
+
+static void get_program_path(struct dstr *path, const struct gs_program *program)
+{
+	dstr_printf(path, "%s/%016" PRIx64 "-%016" PRIx64 ".bin", program->device->shader_cache.path,
+		    program->vertex_shader->hash, program->pixel_shader->hash);
+}
+
+static bool read_program_binary(const char *path, const struct gs_program *program,
+				struct shader_cache_header *header, uint8_t **binary)
+{
+	FILE *file = os_fopen(path, "rb");
+	bool success = false;
+
+	if (!file)
+		return false;
+
+	if (fread(header, sizeof(*header), 1, file) != 1)
+		goto fail;
+	if (header->magic != SHADER_CACHE_MAGIC || header->version != SHADER_CACHE_VERSION)
+		goto fail;
+	if (header->vertex_hash != program->vertex_shader->hash || header->pixel_hash != program->pixel_shader->hash)
+		goto fail;
+	if (!header->size || header->size > SHADER_CACHE_MAX_SIZE)
+		goto fail;
+
+	*binary = bmalloc(header->size);
+	success = fread(*binary, 1, header->size, file) == header->size;
+
+fail:
+	fclose(file);
+	return success;
+}
+
+static void reset_program(struct gs_program *program)
+{
+	glDeleteProgram(program->obj);
+	gl_success("glDeleteProgram");
+
+	program->obj = glCreateProgram();
+	gl_success("glCreateProgram");
+}
+
+bool gl_shader_cache_load(struct gs_program *program)
+{
+	struct gl_shader_cache *cache = &program->device->shader_cache;
+	struct shader_cache_header header;
+	struct dstr path = {0};
+	uint8_t *binary = NULL;
+	GLint linked = GL_FALSE;
+
+	if (!cache->path)
+		return false;
+
+	get_program_path(&path, program);
+
+	if (!os_file_exists(path.array)) {
+		cache->misses++;
+		goto miss;
+	}
+
+	if (!read_program_binary(path.array, program, &header, &binary))
+		goto reject;
+
+	/* a driver refusing a binary is expected, so don't log it as an error */
+	glProgramBinary(program->obj, header.format, binary, header.size);
+	if (glGetError() == GL_NO_ERROR) {
+		glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
+		if (!gl_success("glGetProgramiv"))
+			linked = GL_FALSE;
+	}
+
+	if (linked == GL_FALSE)
+		goto reject;
+
+	cache->hits++;
+	bfree(binary);
+	dstr_free(&path);
+	return true;
+
+reject:
+	/* the driver changed without its version strings changing, or the
+	 * file is damaged: drop it and rebuild the program from source */
+	blog(LOG_DEBUG, "Shader cache: rejected '%s'", path.array);
+	cache->rejected++;
+	os_unlink(path.array);
+	reset_program(program);
+
+miss:
+	glProgramParameteri(program->obj, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	gl_success("glProgramParameteri");
+
+	bfree(binary);
+	dstr_free(&path);
+	return false;
+}
+
+void gl_shader_cache_save(struct gs_program *program)
+{
+	struct gl_shader_cache *cache = &program->device->shader_cache;
+	struct shader_cache_header header = {0};
+	struct dstr path = {0};
+	struct dstr temp_path = {0};
+	uint8_t *binary = NULL;
+	GLint size = 0;
+	GLsizei written = 0;
+	GLenum format = 0;
+	bool success;
+	FILE *file;
+
+	if (!cache->path)
+		return;
+
+	glGetProgramiv(program->obj, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (!gl_success("glGetProgramiv") || size <= 0 || size > SHADER_CACHE_MAX_SIZE)
+		return;
+
+	binary = bmalloc(size);
+	glGetProgramBinary(program->obj, size, &written, &format, binary);
+	if (!gl_success("glGetProgramBinary") || written <= 0)
+		goto fail;
+
+	header.magic = SHADER_CACHE_MAGIC;
+	header.version = SHADER_CACHE_VERSION;
+	header.vertex_hash = program->vertex_shader->hash;
+	header.pixel_hash = program->pixel_shader->hash;
+	header.format = format;
+	header.size = (uint32_t)written;
+
+	get_program_path(&path, program);
+	dstr_copy_dstr(&temp_path, &path);
+	dstr_cat(&temp_path, ".tmp");
+
+	file = os_fopen(temp_path.array, "wb");
+	if (!file)
+		goto fail;
+
+	success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		  fwrite(binary, 1, header.size, file) == header.size;
+	success = fclose(file) == 0 && success;
+
+	if (success)
+		success = os_rename(temp_path.array, path.array) == 0;
+	if (!success) {
+		blog(LOG_WARNING, "Shader cache: failed to write '%s'", path.array);
+		os_unlink(temp_path.array);
+	} else {
+		add_known_shader(cache, header.vertex_hash);
+		add_known_shader(cache, header.pixel_hash);
+	}
+
+fail:
+	dstr_free(&temp_path);
+	dstr_free(&path);
+	bfree(binary);
+}
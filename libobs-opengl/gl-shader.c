@@ -174,8 +174,8 @@ static inline bool gl_process_attribs(struct gs_shader *shader, struct gl_shader
 	return true;
 }
 
-static bool gl_shader_init(struct gs_shader *shader, struct gl_shader_parser *glsp, const char *file,
-			   char **error_string)
+static bool gl_shader_compile(struct gs_shader *shader, const char *gl_string, const char *file,
+			      char **error_string)
 {
 	GLenum type = convert_shader_type(shader->type);
 	int compiled = 0;
@@ -185,7 +185,7 @@ static bool gl_shader_init(struct gs_shader *shader, struct gl_shader_parser *gl
 	if (!gl_success("glCreateShader") || !shader->obj)
 		return false;
 
-	glShaderSource(shader->obj, 1, (const GLchar **)&glsp->gl_string.array, 0);
+	glShaderSource(shader->obj, 1, (const GLchar **)&gl_string, 0);
 	if (!gl_success("glShaderSource"))
 		return false;
 
@@ -197,7 +197,7 @@ static bool gl_shader_init(struct gs_shader *shader, struct gl_shader_parser *gl
 	blog(LOG_DEBUG, "+++++++++++++++++++++++++++++++++++");
 	blog(LOG_DEBUG, "  GL shader string for: %s", file);
 	blog(LOG_DEBUG, "-----------------------------------");
-	blog(LOG_DEBUG, "%s", glsp->gl_string.array);
+	blog(LOG_DEBUG, "%s", gl_string);
 	blog(LOG_DEBUG, "+++++++++++++++++++++++++++++++++++");
 #endif
 
@@ -223,6 +223,35 @@ static bool gl_shader_init(struct gs_shader *shader, struct gl_shader_parser *gl
 	}
 
 	gl_get_shader_info(shader->obj, file, error_string);
+	return success;
+}
+
+static bool gl_shader_compile_deferred(struct gs_shader *shader)
+{
+	bool success;
+
+	if (!shader->deferred_source)
+		return true;
+
+	success = gl_shader_compile(shader, shader->deferred_source, "(deferred shader)", NULL);
+	bfree(shader->deferred_source);
+	shader->deferred_source = NULL;
+	return success;
+}
+
+static bool gl_shader_init(struct gs_shader *shader, struct gl_shader_parser *glsp, const char *file,
+			   char **error_string)
+{
+	bool success = true;
+
+	shader->hash = gl_shader_cache_hash(glsp->gl_string.array);
+
+	/* programs using this shader are in the shader cache, so only compile
+	 * it if one of their binaries ends up being rejected */
+	if (gl_shader_cache_known(shader->device, shader->hash))
+		shader->deferred_source = bstrdup(glsp->gl_string.array);
+	else
+		success = gl_shader_compile(shader, glsp->gl_string.array, file, error_string);
 
 	if (success)
 		success = gl_add_params(shader, glsp);
@@ -322,6 +351,7 @@ void gs_shader_destroy(gs_shader_t *shader)
 		gl_success("glDeleteShader");
 	}
 
+	bfree(shader->deferred_source);
 	da_free(shader->samplers);
 	da_free(shader->params);
 	da_free(shader->attribs);
@@ -598,38 +628,67 @@ static inline bool assign_program_params(struct gs_program *program)
 	return true;
 }
 
-struct gs_program *gs_program_create(struct gs_device *device)
+static bool gl_program_link(struct gs_program *program)
 {
-	struct gs_program *program = bzalloc(sizeof(*program));
+	struct gs_shader *vertex_shader = program->vertex_shader;
+	struct gs_shader *pixel_shader = program->pixel_shader;
 	int linked = false;
+	bool success = false;
 
-	program->device = device;
-	program->vertex_shader = device->cur_vertex_shader;
-	program->pixel_shader = device->cur_pixel_shader;
-
-	program->obj = glCreateProgram();
-	if (!gl_success("glCreateProgram"))
-		goto error_detach_neither;
+	if (!gl_shader_compile_deferred(vertex_shader))
+		return false;
+	if (!gl_shader_compile_deferred(pixel_shader))
+		return false;
 
-	glAttachShader(program->obj, program->vertex_shader->obj);
+	glAttachShader(program->obj, vertex_shader->obj);
 	if (!gl_success("glAttachShader (vertex)"))
-		goto error_detach_neither;
+		return false;
 
-	glAttachShader(program->obj, program->pixel_shader->obj);
+	glAttachShader(program->obj, pixel_shader->obj);
 	if (!gl_success("glAttachShader (pixel)"))
-		goto error_detach_vertex;
+		goto detach_vertex;
 
 	glLinkProgram(program->obj);
 	if (!gl_success("glLinkProgram"))
-		goto error;
+		goto detach_pixel;
 
 	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
 	if (!gl_success("glGetProgramiv"))
-		goto error;
+		goto detach_pixel;
 
-	if (linked == GL_FALSE) {
+	if (linked == GL_FALSE)
 		print_link_errors(program->obj);
+	else
+		success = true;
+
+detach_pixel:
+	glDetachShader(program->obj, pixel_shader->obj);
+	gl_success("glDetachShader (pixel)");
+
+detach_vertex:
+	glDetachShader(program->obj, vertex_shader->obj);
+	gl_success("glDetachShader (vertex)");
+
+	return success;
+}
+
+struct gs_program *gs_program_create(struct gs_device *device)
+{
+	struct gs_program *program = bzalloc(sizeof(*program));
+
+	program->device = device;
+	program->vertex_shader = device->cur_vertex_shader;
+	program->pixel_shader = device->cur_pixel_shader;
+
+	program->obj = glCreateProgram();
+	if (!gl_success("glCreateProgram"))
 		goto error;
+
+	if (!gl_shader_cache_load(program)) {
+		if (!gl_program_link(program))
+			goto error;
+
+		gl_shader_cache_save(program);
 	}
 
 	if (!assign_program_attribs(program))
@@ -637,12 +696,6 @@ struct gs_program *gs_program_create(struct gs_device *device)
 	if (!assign_program_params(program))
 		goto error;
 
-	glDetachShader(program->obj, program->vertex_shader->obj);
-	gl_success("glDetachShader (vertex)");
-
-	glDetachShader(program->obj, program->pixel_shader->obj);
-	gl_success("glDetachShader (pixel)");
-
 	program->next = device->first_program;
 	program->prev_next = &device->first_program;
 	device->first_program = program;
@@ -652,14 +705,6 @@ struct gs_program *gs_program_create(struct gs_device *device)
 	return program;
 
 error:
-	glDetachShader(program->obj, program->pixel_shader->obj);
-	gl_success("glDetachShader (pixel)");
-
-error_detach_vertex:
-	glDetachShader(program->obj, program->vertex_shader->obj);
-	gl_success("glDetachShader (vertex)");
-
-error_detach_neither:
 	gs_program_destroy(program);
 	return NULL;
 }
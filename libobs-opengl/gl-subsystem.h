@@ -472,6 +472,9 @@ struct gs_shader {
 	enum gs_shader_type type;
 	GLuint obj;
 
+	uint64_t hash;
+	char *deferred_source;
+
 	struct gs_shader_param *viewproj;
 	struct gs_shader_param *world;
 
@@ -624,6 +627,18 @@ static inline void fbo_info_destroy(struct fbo_info *fbo)
 	}
 }
 
+struct gl_shader_cache {
+	bool supported;
+	uint64_t driver_hash;
+	char *path;
+
+	DARRAY(uint64_t) known_shaders;
+
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t rejected;
+};
+
 struct gs_device {
 	struct gl_platform *plat;
 	enum copy_type copy_type;
@@ -656,12 +671,21 @@ struct gs_device {
 	DARRAY(struct matrix4) proj_stack;
 
 	struct fbo_info *cur_fbo;
+
+	struct gl_shader_cache shader_cache;
 };
 
 typedef void *gs_sync;
 
 extern struct fbo_info *get_fbo(gs_texture_t *tex, uint32_t width, uint32_t height);
 
+extern void gl_shader_cache_init(gs_device_t *device);
+extern void gl_shader_cache_free(gs_device_t *device);
+extern uint64_t gl_shader_cache_hash(const char *str);
+extern bool gl_shader_cache_known(gs_device_t *device, uint64_t hash);
+extern bool gl_shader_cache_load(struct gs_program *program);
+extern void gl_shader_cache_save(struct gs_program *program);
+
 extern void gl_update(gs_device_t *device);
 extern void gl_clear_context(gs_device_t *device);
 
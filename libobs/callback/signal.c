@@ -15,36 +15,65 @@
  */
 
 #include "../util/darray.h"
+#include "../util/platform.h"
 #include "../util/threading.h"
+#include "../util/uthash.h"
 
 #include "decl.h"
 #include "signal.h"
 
+/* Emitting a signal takes no locks.  Each signal publishes an immutable list
+ * of its callbacks, connecting and disconnecting swap in a modified copy, and
+ * an emission simply walks whichever list it loaded.  Emissions on different
+ * threads can therefore run the callbacks of one signal at the same time.
+ *
+ * Every list counts the emissions walking it.  A disconnect publishes the new
+ * list and then waits until no other emission walks a replaced list that
+ * still holds the callback, so the callback is never called once disconnect
+ * returns.  A replaced list is freed as soon as nobody walks it anymore, and
+ * a removed callback once no remaining list holds it. */
+
 struct signal_callback {
 	signal_callback_t callback;
 	void *data;
-	bool remove;
+	volatile bool remove;
 	bool keep_ref;
 };
 
+struct signal_callback_list {
+	volatile long readers;
+	size_t num;
+	struct signal_callback *callbacks[];
+};
+
 struct signal_info {
 	struct decl_info func;
-	DARRAY(struct signal_callback) callbacks;
+	UT_hash_handle hh;
+
 	pthread_mutex_t mutex;
-	bool signalling;
+	struct signal_callback_list *volatile list;
+	volatile long loading;
+	DARRAY(struct signal_callback_list *) retired_lists;
+	DARRAY(struct signal_callback *) retired_callbacks;
+};
 
-	struct signal_info *next;
+/* emissions running on the current thread, innermost first */
+struct signal_emission {
+	struct signal_info *sig;
+	struct signal_callback_list *list;
+	struct signal_callback *current;
+	bool removed;
+	struct signal_emission *prev;
 };
 
+static THREAD_LOCAL struct signal_emission *current_emission = NULL;
+
 static inline struct signal_info *signal_info_create(struct decl_info *info)
 {
-	struct signal_info *si = bmalloc(sizeof(struct signal_info));
+	struct signal_info *si = bzalloc(sizeof(struct signal_info));
 	si->func = *info;
-	si->next = NULL;
-	si->signalling = false;
-	da_init(si->callbacks);
 
-	if (pthread_mutex_init_recursive(&si->mutex) != 0) {
+	if (pthread_mutex_init(&si->mutex, NULL) != 0) {
 		blog(LOG_ERROR, "Could not create signal");
 
 		decl_info_free(&si->func);
@@ -58,23 +87,148 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 static inline void signal_info_destroy(struct signal_info *si)
 {
 	if (si) {
+		struct signal_callback_list *list = si->list;
+
+		if (list) {
+			for (size_t i = 0; i < list->num; i++)
+				bfree(list->callbacks[i]);
+			bfree(list);
+		}
+
+		for (size_t i = 0; i < si->retired_lists.num; i++)
+			bfree(si->retired_lists.array[i]);
+		for (size_t i = 0; i < si->retired_callbacks.num; i++)
+			bfree(si->retired_callbacks.array[i]);
+
+		da_free(si->retired_lists);
+		da_free(si->retired_callbacks);
 		pthread_mutex_destroy(&si->mutex);
 		decl_info_free(&si->func);
-		da_free(si->callbacks);
 		bfree(si);
 	}
 }
 
-static inline size_t signal_get_callback_idx(struct signal_info *si, signal_callback_t callback, void *data)
+static inline struct signal_callback_list *signal_get_list(struct signal_info *si)
 {
-	for (size_t i = 0; i < si->callbacks.num; i++) {
-		struct signal_callback *sc = si->callbacks.array + i;
+	return os_atomic_load_ptr((void *const volatile *)&si->list);
+}
 
-		if (sc->callback == callback && sc->data == data)
-			return i;
+static bool list_has_callback(const struct signal_callback_list *list, const struct signal_callback *sc)
+{
+	for (size_t i = 0; i < list->num; i++) {
+		if (list->callbacks[i] == sc)
+			return true;
 	}
 
-	return DARRAY_INVALID;
+	return false;
+}
+
+/* Frees the replaced lists that are no longer walked, and the removed
+ * callbacks that no remaining list holds.  Has to be called with the signal
+ * mutex held. */
+static void signal_reclaim(struct signal_info *si)
+{
+	/* an emission that loaded a replaced list might not have counted
+	 * itself as its reader yet */
+	if (os_atomic_load_long(&si->loading))
+		return;
+
+	for (size_t i = si->retired_lists.num; i > 0; i--) {
+		struct signal_callback_list *list = si->retired_lists.array[i - 1];
+
+		if (!os_atomic_load_long(&list->readers)) {
+			bfree(list);
+			da_erase(si->retired_lists, i - 1);
+		}
+	}
+
+	for (size_t i = si->retired_callbacks.num; i > 0; i--) {
+		struct signal_callback *sc = si->retired_callbacks.array[i - 1];
+		bool used = false;
+
+		for (size_t j = 0; j < si->retired_lists.num && !used; j++)
+			used = list_has_callback(si->retired_lists.array[j], sc);
+
+		if (!used) {
+			bfree(sc);
+			da_erase(si->retired_callbacks, i - 1);
+		}
+	}
+}
+
+/* has to be called with the signal mutex held */
+static struct signal_callback *signal_find_callback(struct signal_info *si, signal_callback_t callback, void *data)
+{
+	struct signal_callback_list *list = si->list;
+
+	if (!list)
+		return NULL;
+
+	for (size_t i = 0; i < list->num; i++) {
+		struct signal_callback *sc = list->callbacks[i];
+
+		if (sc->callback == callback && sc->data == data && !sc->remove)
+			return sc;
+	}
+
+	return NULL;
+}
+
+/* Publishes a copy of the callback list without the callbacks that are
+ * marked for removal, and with the new callback appended if there is one.
+ * Has to be called with the signal mutex held, counts the removed callbacks
+ * that held a handler reference. */
+static void signal_update(struct signal_info *si, struct signal_callback *add, long *remove_refs)
+{
+	struct signal_callback_list *old_list = si->list;
+	struct signal_callback_list *new_list;
+	size_t old_num = old_list ? old_list->num : 0;
+
+	new_list = bmalloc(sizeof(*new_list) + sizeof(struct signal_callback *) * (old_num + 1));
+	new_list->readers = 0;
+	new_list->num = 0;
+
+	for (size_t i = 0; i < old_num; i++) {
+		struct signal_callback *sc = old_list->callbacks[i];
+
+		if (!sc->remove) {
+			new_list->callbacks[new_list->num++] = sc;
+			continue;
+		}
+
+		if (sc->keep_ref && remove_refs)
+			(*remove_refs)++;
+		da_push_back(si->retired_callbacks, &sc);
+	}
+
+	if (add)
+		new_list->callbacks[new_list->num++] = add;
+
+	os_atomic_store_ptr((void *volatile *)&si->list, new_list);
+	if (old_list)
+		da_push_back(si->retired_lists, &old_list);
+
+	/* any emission that starts from here on loads the new list */
+	signal_reclaim(si);
+}
+
+/* waits until the replaced lists are only walked by emissions further up the
+ * stack of the current thread, those skip removed callbacks on their own.
+ * The caller keeps the lists alive by counting itself as one of their
+ * readers. */
+static void signal_wait_readers(struct signal_callback_list **lists, size_t num)
+{
+	for (size_t i = 0; i < num; i++) {
+		long own = 1;
+
+		for (struct signal_emission *e = current_emission; e; e = e->prev) {
+			if (e->list == lists[i])
+				own++;
+		}
+
+		while (os_atomic_load_long(&lists[i]->readers) > own)
+			os_sleep_ms(0);
+	}
 }
 
 struct global_callback_info {
@@ -85,29 +239,19 @@ struct global_callback_info {
 };
 
 struct signal_handler {
-	struct signal_info *first;
+	struct signal_info *signals;
 	pthread_mutex_t mutex;
 	volatile long refs;
 
 	DARRAY(struct global_callback_info) global_callbacks;
 	pthread_mutex_t global_callbacks_mutex;
+	volatile long num_global_callbacks;
 };
 
-static struct signal_info *getsignal(signal_handler_t *handler, const char *name, struct signal_info **p_last)
+static inline struct signal_info *getsignal(signal_handler_t *handler, const char *name)
 {
-	struct signal_info *signal, *last = NULL;
-
-	signal = handler->first;
-	while (signal != NULL) {
-		if (strcmp(signal->func.name, name) == 0)
-			break;
-
-		last = signal;
-		signal = signal->next;
-	}
-
-	if (p_last)
-		*p_last = last;
+	struct signal_info *signal;
+	HASH_FIND_STR(handler->signals, name, signal);
 	return signal;
 }
 
@@ -116,7 +260,7 @@ static struct signal_info *getsignal(signal_handler_t *handler, const char *name
 signal_handler_t *signal_handler_create(void)
 {
 	struct signal_handler *handler = bzalloc(sizeof(struct signal_handler));
-	handler->first = NULL;
+	handler->signals = NULL;
 	handler->refs = 1;
 
 	if (pthread_mutex_init(&handler->mutex, NULL) != 0) {
@@ -137,11 +281,11 @@ signal_handler_t *signal_handler_create(void)
 
 static void signal_handler_actually_destroy(signal_handler_t *handler)
 {
-	struct signal_info *sig = handler->first;
-	while (sig != NULL) {
-		struct signal_info *next = sig->next;
+	struct signal_info *sig, *tmp;
+
+	HASH_ITER (hh, handler->signals, sig, tmp) {
+		HASH_DELETE(hh, handler->signals, sig);
 		signal_info_destroy(sig);
-		sig = next;
 	}
 
 	da_free(handler->global_callbacks);
@@ -160,7 +304,7 @@ void signal_handler_destroy(signal_handler_t *handler)
 bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 {
 	struct decl_info func = {0};
-	struct signal_info *sig, *last;
+	struct signal_info *sig;
 	bool success = true;
 
 	if (!parse_decl_string(&func, signal_decl)) {
@@ -170,17 +314,17 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 
 	pthread_mutex_lock(&handler->mutex);
 
-	sig = getsignal(handler, func.name, &last);
+	sig = getsignal(handler, func.name);
 	if (sig) {
 		blog(LOG_WARNING, "Signal declaration '%s' exists", func.name);
 		decl_info_free(&func);
 		success = false;
 	} else {
 		sig = signal_info_create(&func);
-		if (!last)
-			handler->first = sig;
+		if (sig)
+			HASH_ADD_KEYPTR(hh, handler->signals, sig->func.name, strlen(sig->func.name), sig);
 		else
-			last->next = sig;
+			success = false;
 	}
 
 	pthread_mutex_unlock(&handler->mutex);
@@ -188,20 +332,35 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 	return success;
 }
 
+static inline struct signal_info *getsignal_locked(signal_handler_t *handler, const char *name)
+{
+	struct signal_info *sig;
+
+	if (!handler || !name)
+		return NULL;
+
+	pthread_mutex_lock(&handler->mutex);
+	sig = getsignal(handler, name);
+	pthread_mutex_unlock(&handler->mutex);
+
+	return sig;
+}
+
+struct signal_info *signal_handler_get_signal(signal_handler_t *handler, const char *signal)
+{
+	return getsignal_locked(handler, signal);
+}
+
 static void signal_handler_connect_internal(signal_handler_t *handler, const char *signal, signal_callback_t callback,
 					    void *data, bool keep_ref)
 {
-	struct signal_info *sig, *last;
-	struct signal_callback cb_data = {callback, data, false, keep_ref};
-	size_t idx;
+	struct signal_callback *cb_data;
+	struct signal_info *sig;
 
 	if (!handler)
 		return;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, signal, &last);
-	pthread_mutex_unlock(&handler->mutex);
-
+	sig = getsignal_locked(handler, signal);
 	if (!sig) {
 		blog(LOG_WARNING,
 		     "signal_handler_connect: "
@@ -217,9 +376,13 @@ static void signal_handler_connect_internal(signal_handler_t *handler, const cha
 	if (keep_ref)
 		os_atomic_inc_long(&handler->refs);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (keep_ref || idx == DARRAY_INVALID)
-		da_push_back(sig->callbacks, &cb_data);
+	if (keep_ref || !signal_find_callback(sig, callback, data)) {
+		cb_data = bzalloc(sizeof(*cb_data));
+		cb_data->callback = callback;
+		cb_data->data = data;
+		cb_data->keep_ref = keep_ref;
+		signal_update(sig, cb_data, NULL);
+	}
 
 	pthread_mutex_unlock(&sig->mutex);
 }
@@ -234,102 +397,120 @@ void signal_handler_connect_ref(signal_handler_t *handler, const char *signal, s
 	signal_handler_connect_internal(handler, signal, callback, data, true);
 }
 
-static inline struct signal_info *getsignal_locked(signal_handler_t *handler, const char *name)
-{
-	struct signal_info *sig;
-
-	if (!handler)
-		return NULL;
-
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, name, NULL);
-	pthread_mutex_unlock(&handler->mutex);
-
-	return sig;
-}
-
 void signal_handler_disconnect(signal_handler_t *handler, const char *signal, signal_callback_t callback, void *data)
 {
 	struct signal_info *sig = getsignal_locked(handler, signal);
-	bool keep_ref = false;
-	size_t idx;
+	DARRAY(struct signal_callback_list *) lists;
+	struct signal_callback *sc;
+	long remove_refs = 0;
 
 	if (!sig)
 		return;
 
+	da_init(lists);
 	pthread_mutex_lock(&sig->mutex);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx != DARRAY_INVALID) {
-		if (sig->signalling) {
-			sig->callbacks.array[idx].remove = true;
-		} else {
-			keep_ref = sig->callbacks.array[idx].keep_ref;
-			da_erase(sig->callbacks, idx);
+	sc = signal_find_callback(sig, callback, data);
+	if (sc) {
+		os_atomic_set_bool(&sc->remove, true);
+		signal_update(sig, NULL, &remove_refs);
+
+		for (size_t i = 0; i < sig->retired_lists.num; i++) {
+			struct signal_callback_list *list = sig->retired_lists.array[i];
+
+			if (list_has_callback(list, sc)) {
+				os_atomic_inc_long(&list->readers);
+				da_push_back(lists, &list);
+			}
 		}
 	}
 
 	pthread_mutex_unlock(&sig->mutex);
 
-	if (keep_ref && os_atomic_dec_long(&handler->refs) == 0) {
-		signal_handler_actually_destroy(handler);
+	if (!sc)
+		return;
+
+	signal_wait_readers(lists.array, lists.num);
+
+	pthread_mutex_lock(&sig->mutex);
+	for (size_t i = 0; i < lists.num; i++)
+		os_atomic_dec_long(&lists.array[i]->readers);
+	signal_reclaim(sig);
+	pthread_mutex_unlock(&sig->mutex);
+
+	da_free(lists);
+
+	for (; remove_refs > 0; remove_refs--) {
+		if (os_atomic_dec_long(&handler->refs) == 0)
+			signal_handler_actually_destroy(handler);
 	}
 }
 
-static THREAD_LOCAL struct signal_callback *current_signal_cb = NULL;
 static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
 
 void signal_handler_remove_current(void)
 {
-	if (current_signal_cb)
-		current_signal_cb->remove = true;
-	else if (current_global_cb)
+	if (current_emission && current_emission->current) {
+		os_atomic_set_bool(&current_emission->current->remove, true);
+		current_emission->removed = true;
+	} else if (current_global_cb) {
 		current_global_cb->remove = true;
+	}
 }
 
-void signal_handler_signal(signal_handler_t *handler, const char *signal, calldata_t *params)
+static void signal_emit(signal_handler_t *handler, struct signal_info *sig, calldata_t *params)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
+	struct signal_emission emission = {sig, NULL, NULL, false, current_emission};
+	struct signal_callback_list *list;
 	long remove_refs = 0;
 
-	if (!sig)
-		return;
+	/* only walk a list that was still published once counted as a reader,
+	 * otherwise a disconnect replacing it might not wait for us */
+	os_atomic_inc_long(&sig->loading);
+	for (;;) {
+		list = signal_get_list(sig);
+		if (!list)
+			break;
 
-	pthread_mutex_lock(&sig->mutex);
-	sig->signalling = true;
+		os_atomic_inc_long(&list->readers);
+		if (signal_get_list(sig) == list)
+			break;
+		os_atomic_dec_long(&list->readers);
+	}
+	os_atomic_dec_long(&sig->loading);
 
-	for (size_t i = 0; i < sig->callbacks.num; i++) {
-		struct signal_callback *cb = sig->callbacks.array + i;
-		if (!cb->remove) {
-			current_signal_cb = cb;
+	emission.list = list;
+	current_emission = &emission;
+
+	for (size_t i = 0; list && i < list->num; i++) {
+		struct signal_callback *cb = list->callbacks[i];
+		if (!os_atomic_load_bool(&cb->remove)) {
+			emission.current = cb;
 			cb->callback(cb->data, params);
-			current_signal_cb = NULL;
+			emission.current = NULL;
 		}
 	}
 
-	for (size_t i = sig->callbacks.num; i > 0; i--) {
-		struct signal_callback *cb = sig->callbacks.array + i - 1;
-		if (cb->remove) {
-			if (cb->keep_ref)
-				remove_refs++;
+	current_emission = emission.prev;
+	if (list)
+		os_atomic_dec_long(&list->readers);
 
-			da_erase(sig->callbacks, i - 1);
-		}
+	if (emission.removed) {
+		pthread_mutex_lock(&sig->mutex);
+		signal_update(sig, NULL, &remove_refs);
+		pthread_mutex_unlock(&sig->mutex);
 	}
 
-	sig->signalling = false;
-	pthread_mutex_unlock(&sig->mutex);
-
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
+	if (os_atomic_load_long(&handler->num_global_callbacks)) {
+		pthread_mutex_lock(&handler->global_callbacks_mutex);
 
-	if (handler->global_callbacks.num) {
 		for (size_t i = 0; i < handler->global_callbacks.num; i++) {
 			struct global_callback_info *cb = handler->global_callbacks.array + i;
 
 			if (!cb->remove) {
 				cb->signaling++;
 				current_global_cb = cb;
-				cb->callback(cb->data, signal, params);
+				cb->callback(cb->data, sig->func.name, params);
 				current_global_cb = NULL;
 				cb->signaling--;
 			}
@@ -341,15 +522,30 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal, callda
 			if (cb->remove && !cb->signaling)
 				da_erase(handler->global_callbacks, i - 1);
 		}
-	}
 
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+		os_atomic_set_long(&handler->num_global_callbacks, (long)handler->global_callbacks.num);
+		pthread_mutex_unlock(&handler->global_callbacks_mutex);
+	}
 
 	if (remove_refs) {
 		os_atomic_set_long(&handler->refs, os_atomic_load_long(&handler->refs) - remove_refs);
 	}
 }
 
+void signal_handler_signal(signal_handler_t *handler, const char *signal, calldata_t *params)
+{
+	struct signal_info *sig = getsignal_locked(handler, signal);
+
+	if (sig)
+		signal_emit(handler, sig, params);
+}
+
+void signal_handler_emit(signal_handler_t *handler, struct signal_info *signal, calldata_t *params)
+{
+	if (handler && signal)
+		signal_emit(handler, signal, params);
+}
+
 void signal_handler_connect_global(signal_handler_t *handler, global_signal_callback_t callback, void *data)
 {
 	struct global_callback_info cb_data = {callback, data, 0, false};
@@ -364,6 +560,7 @@ void signal_handler_connect_global(signal_handler_t *handler, global_signal_call
 	if (idx == DARRAY_INVALID)
 		da_push_back(handler->global_callbacks, &cb_data);
 
+	os_atomic_set_long(&handler->num_global_callbacks, (long)handler->global_callbacks.num);
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
 
@@ -387,5 +584,6 @@ void signal_handler_disconnect_global(signal_handler_t *handler, global_signal_c
 			da_erase(handler->global_callbacks, idx);
 	}
 
+	os_atomic_set_long(&handler->num_global_callbacks, (long)handler->global_callbacks.num);
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
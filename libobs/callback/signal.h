@@ -68,6 +68,15 @@ EXPORT void signal_handler_remove_current(void);
 
 EXPORT void signal_handler_signal(signal_handler_t *handler, const char *signal, calldata_t *params);
 
+/*
+ * Looks a signal up once, so that frequently emitted signals do not have to
+ * be found by name every time.  The result stays valid for as long as the
+ * handler exists.
+ */
+struct signal_info;
+EXPORT struct signal_info *signal_handler_get_signal(signal_handler_t *handler, const char *signal);
+EXPORT void signal_handler_emit(signal_handler_t *handler, struct signal_info *signal, calldata_t *params);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,4 +1,5 @@
 #include "graphics.h"
+#include "image-anim.h"
 
 #include "half.h"
 #include "srgb.h"
@@ -564,6 +565,165 @@ static inline enum gs_color_format convert_format(enum AVPixelFormat format)
 	}
 }
 
+struct ffmpeg_anim {
+	struct ffmpeg_image info;
+	char *file;
+	enum gs_image_alpha_mode alpha_mode;
+	int stream_idx;
+	AVRational time_base;
+	AVPacket *packet;
+	AVFrame *frame;
+	bool draining;
+};
+
+static bool ffmpeg_anim_open(struct ffmpeg_anim *anim)
+{
+	AVStream *stream;
+
+	if (!ffmpeg_image_init(&anim->info, anim->file))
+		return false;
+
+	anim->stream_idx = av_find_best_stream(anim->info.fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+	if (anim->stream_idx < 0) {
+		ffmpeg_image_free(&anim->info);
+		return false;
+	}
+
+	stream = anim->info.fmt_ctx->streams[anim->stream_idx];
+	anim->time_base = stream->time_base;
+	anim->draining = false;
+	return true;
+}
+
+static bool ffmpeg_anim_next_frame(void *data, uint8_t *dst, uint64_t *duration_ns)
+{
+	struct ffmpeg_anim *anim = data;
+	struct ffmpeg_image *info = &anim->info;
+	int64_t duration;
+	void *frame_data;
+	int ret;
+
+	if (!info->fmt_ctx)
+		return false;
+
+	for (;;) {
+		ret = avcodec_receive_frame(info->decoder_ctx, anim->frame);
+		if (ret == 0)
+			break;
+		if (ret != AVERROR(EAGAIN) || anim->draining)
+			return false;
+
+		ret = av_read_frame(info->fmt_ctx, anim->packet);
+		if (ret < 0) {
+			avcodec_send_packet(info->decoder_ctx, NULL);
+			anim->draining = true;
+			continue;
+		}
+
+		if (anim->packet->stream_index == anim->stream_idx)
+			ret = avcodec_send_packet(info->decoder_ctx, anim->packet);
+		av_packet_unref(anim->packet);
+
+		if (ret < 0 && ret != AVERROR(EAGAIN)) {
+			blog(LOG_WARNING, "Failed to decode frame for '%s': %s", info->file, av_err2str(ret));
+			return false;
+		}
+	}
+
+	if (anim->frame->width != info->cx || anim->frame->height != info->cy) {
+		av_frame_unref(anim->frame);
+		return false;
+	}
+
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 30, 100)
+	duration = anim->frame->duration;
+#else
+	duration = anim->frame->pkt_duration;
+#endif
+
+	/* reformatting replaces the format with the one it converted to */
+	info->format = anim->frame->format;
+	frame_data = ffmpeg_image_reformat_frame(info, anim->frame, anim->alpha_mode);
+	av_frame_unref(anim->frame);
+
+	if (!frame_data)
+		return false;
+
+	memcpy(dst, frame_data, (size_t)info->cx * info->cy * 4);
+	bfree(frame_data);
+
+	*duration_ns = duration > 0 ? (uint64_t)av_rescale_q(duration, anim->time_base, (AVRational){1, 1000000000})
+				    : 0;
+	return true;
+}
+
+static bool ffmpeg_anim_rewind(void *data)
+{
+	struct ffmpeg_anim *anim = data;
+
+	/* the image demuxers cannot seek, but reopening a small image file
+	 * once per loop is cheap */
+	ffmpeg_image_free(&anim->info);
+	return ffmpeg_anim_open(anim);
+}
+
+static void ffmpeg_anim_destroy(void *data)
+{
+	struct ffmpeg_anim *anim = data;
+
+	ffmpeg_image_free(&anim->info);
+	av_packet_free(&anim->packet);
+	av_frame_free(&anim->frame);
+	bfree(anim->file);
+	bfree(anim);
+}
+
+bool gs_image_anim_ffmpeg_source(const char *file, enum gs_image_alpha_mode alpha_mode,
+				 struct gs_image_anim_source *source, enum gs_color_format *format, uint32_t *cx,
+				 uint32_t *cy)
+{
+	struct ffmpeg_anim *anim = bzalloc(sizeof(*anim));
+
+	anim->file = bstrdup(file);
+	anim->alpha_mode = alpha_mode;
+	anim->packet = av_packet_alloc();
+	anim->frame = av_frame_alloc();
+
+	if (!anim->packet || !anim->frame || !ffmpeg_anim_open(anim)) {
+		ffmpeg_anim_destroy(anim);
+		return false;
+	}
+
+	if (anim->info.cx <= 0 || anim->info.cy <= 0 || anim->info.cx > 4096 || anim->info.cy > 4096) {
+		blog(LOG_WARNING, "Bad texture dimensions (%dx%d) in '%s'", anim->info.cx, anim->info.cy, file);
+		ffmpeg_anim_destroy(anim);
+		return false;
+	}
+
+	/* every frame ends up as 8 bits per channel, in the byte order that
+	 * the reformatting picks for the source format */
+	switch (anim->info.format) {
+	case AV_PIX_FMT_RGBA:
+	case AV_PIX_FMT_RGBA64BE:
+		*format = GS_RGBA;
+		break;
+	case AV_PIX_FMT_BGR0:
+		*format = GS_BGRX;
+		break;
+	default:
+		*format = GS_BGRA;
+	}
+
+	*cx = (uint32_t)anim->info.cx;
+	*cy = (uint32_t)anim->info.cy;
+
+	source->data = anim;
+	source->next_frame = ffmpeg_anim_next_frame;
+	source->rewind = ffmpeg_anim_rewind;
+	source->destroy = ffmpeg_anim_destroy;
+	return true;
+}
+
 uint8_t *gs_create_texture_file_data(const char *file, enum gs_color_format *format, uint32_t *cx_out, uint32_t *cy_out)
 {
 	struct ffmpeg_image image;
@@ -208,6 +208,8 @@ bool load_graphics_imports(struct gs_exports *exports, void *module, const char
 
 	GRAPHICS_IMPORT_OPTIONAL(gs_get_adapter_count);
 
+	GRAPHICS_IMPORT_OPTIONAL(device_set_shader_cache_path);
+
 	/* OSX/Cocoa specific functions */
 #ifdef __APPLE__
 	GRAPHICS_IMPORT(device_shared_texture_available);
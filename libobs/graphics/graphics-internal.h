@@ -218,6 +218,8 @@ struct gs_exports {
 
 	uint32_t (*gs_get_adapter_count)(void);
 
+	void (*device_set_shader_cache_path)(gs_device_t *device, const char *path);
+
 #ifdef __APPLE__
 	/* OSX/Cocoa specific functions */
 	gs_texture_t *(*device_texture_create_from_iosurface)(gs_device_t *dev, void *iosurf);
@@ -2994,6 +2994,17 @@ uint32_t gs_get_adapter_count(void)
 	return thread_graphics->exports.gs_get_adapter_count();
 }
 
+void gs_set_shader_cache_path(const char *path)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_set_shader_cache_path"))
+		return;
+
+	if (graphics->exports.device_set_shader_cache_path)
+		graphics->exports.device_set_shader_cache_path(graphics->device, path);
+}
+
 #ifdef __APPLE__
 
 /** Platform specific functions */
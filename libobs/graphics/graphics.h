@@ -510,6 +510,14 @@ EXPORT int gs_get_device_type(void);
 EXPORT uint32_t gs_get_adapter_count(void);
 EXPORT void gs_enum_adapters(bool (*callback)(void *param, const char *name, uint32_t id), void *param);
 
+/**
+ * Sets the directory used to cache compiled shader programs between runs,
+ * or disables the cache if path is NULL.  Only has an effect on graphics
+ * modules that support caching, and should be called before any shaders
+ * are created.
+ */
+EXPORT void gs_set_shader_cache_path(const char *path);
+
 EXPORT int gs_create(graphics_t **graphics, const char *module, uint32_t adapter);
 EXPORT void gs_destroy(graphics_t *graphics);
 
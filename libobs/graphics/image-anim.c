@@ -0,0 +1,360 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "image-anim.h"
+#include "../util/bmem.h"
+#include "../util/darray.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
+
+/* used when an image does not specify a frame duration */
+#define DEFAULT_DURATION 100000000ULL
+
+struct anim_frame {
+	uint8_t *data;
+	uint64_t duration;
+	int index;
+	int loop;
+};
+
+struct gs_image_anim {
+	struct gs_image_anim_source source;
+	int loops;
+	bool registered;
+
+	/* the frame at cur is on screen and only changes on tick, the queued
+	 * frames after it are ready to be shown, and the worker decodes into
+	 * the slot after those */
+	pthread_mutex_t mutex;
+	struct anim_frame frames[GS_IMAGE_ANIM_FRAMES];
+	size_t cur;
+	size_t queued;
+	uint64_t generation;
+	bool rewind;
+	bool restarted;
+
+	uint64_t cur_time;
+
+	/* worker only */
+	bool finished;
+	bool decoded;
+	int index;
+	int loop;
+};
+
+struct anim_worker {
+	pthread_t thread;
+	bool thread_active;
+	os_event_t *wake_event;
+	volatile bool stop;
+
+	/* held while decoding, so an animation is never destroyed while the
+	 * worker is in the middle of one of its frames */
+	pthread_mutex_t decode_mutex;
+	/* protects anims and next */
+	pthread_mutex_t mutex;
+	DARRAY(struct gs_image_anim *) anims;
+	size_t next;
+};
+
+/* serializes starting and stopping the worker, never taken by the worker */
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct anim_worker worker = {
+	.decode_mutex = PTHREAD_MUTEX_INITIALIZER,
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static bool anim_needs_frame(struct gs_image_anim *anim)
+{
+	bool rewind;
+	bool full;
+
+	pthread_mutex_lock(&anim->mutex);
+	rewind = anim->rewind;
+	full = anim->queued == GS_IMAGE_ANIM_FRAMES - 1;
+	pthread_mutex_unlock(&anim->mutex);
+
+	return rewind || (!full && !anim->finished);
+}
+
+/* animations take turns, so a slow one cannot starve the others */
+static struct gs_image_anim *next_anim(void)
+{
+	const size_t num = worker.anims.num;
+
+	for (size_t i = 0; i < num; i++) {
+		size_t idx = (worker.next + i) % num;
+		struct gs_image_anim *anim = worker.anims.array[idx];
+
+		if (anim_needs_frame(anim)) {
+			worker.next = idx + 1;
+			return anim;
+		}
+	}
+
+	return NULL;
+}
+
+static void decode_frame(struct gs_image_anim *anim)
+{
+	struct anim_frame *frame;
+	uint64_t generation;
+	uint64_t duration;
+	bool rewind;
+	bool full;
+
+	pthread_mutex_lock(&anim->mutex);
+	rewind = anim->rewind;
+	anim->rewind = false;
+	full = anim->queued == GS_IMAGE_ANIM_FRAMES - 1;
+	frame = &anim->frames[(anim->cur + anim->queued + 1) % GS_IMAGE_ANIM_FRAMES];
+	generation = anim->generation;
+	pthread_mutex_unlock(&anim->mutex);
+
+	if (rewind) {
+		anim->finished = !anim->source.rewind(anim->source.data);
+		anim->decoded = false;
+		anim->index = 0;
+		anim->loop = 0;
+	}
+
+	if (full || anim->finished)
+		return;
+
+	if (!anim->source.next_frame(anim->source.data, frame->data, &duration)) {
+		/* a pass without a single frame would spin forever */
+		anim->finished = !anim->decoded || (anim->loops && ++anim->loop >= anim->loops) ||
+				 !anim->source.rewind(anim->source.data);
+		anim->decoded = false;
+		anim->index = 0;
+		return;
+	}
+
+	anim->decoded = true;
+
+	pthread_mutex_lock(&anim->mutex);
+	if (generation == anim->generation) {
+		frame->duration = duration ? duration : DEFAULT_DURATION;
+		frame->index = anim->index;
+		frame->loop = anim->loop;
+		anim->queued++;
+	}
+	pthread_mutex_unlock(&anim->mutex);
+
+	anim->index++;
+}
+
+static void *anim_worker_thread(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	os_set_thread_name("gs_image_anim");
+
+	while (!os_atomic_load_bool(&worker.stop)) {
+		struct gs_image_anim *anim;
+
+		pthread_mutex_lock(&worker.decode_mutex);
+		pthread_mutex_lock(&worker.mutex);
+		anim = next_anim();
+		pthread_mutex_unlock(&worker.mutex);
+
+		if (anim)
+			decode_frame(anim);
+		pthread_mutex_unlock(&worker.decode_mutex);
+
+		if (!anim)
+			os_event_wait(worker.wake_event);
+	}
+
+	return NULL;
+}
+
+static bool worker_add(struct gs_image_anim *anim)
+{
+	bool success = true;
+
+	pthread_mutex_lock(&worker_mutex);
+
+	if (!worker.thread_active) {
+		if (os_event_init(&worker.wake_event, OS_EVENT_TYPE_AUTO) != 0) {
+			success = false;
+		} else if (pthread_create(&worker.thread, NULL, anim_worker_thread, NULL) != 0) {
+			os_event_destroy(worker.wake_event);
+			worker.wake_event = NULL;
+			success = false;
+		} else {
+			worker.thread_active = true;
+		}
+	}
+
+	if (success) {
+		pthread_mutex_lock(&worker.mutex);
+		da_push_back(worker.anims, &anim);
+		pthread_mutex_unlock(&worker.mutex);
+
+		os_event_signal(worker.wake_event);
+	}
+
+	pthread_mutex_unlock(&worker_mutex);
+	return success;
+}
+
+static void worker_remove(struct gs_image_anim *anim)
+{
+	bool empty;
+
+	pthread_mutex_lock(&worker_mutex);
+
+	pthread_mutex_lock(&worker.mutex);
+	da_erase_item(worker.anims, &anim);
+	empty = !worker.anims.num;
+	pthread_mutex_unlock(&worker.mutex);
+
+	/* waits for a frame that is still being decoded */
+	pthread_mutex_lock(&worker.decode_mutex);
+	pthread_mutex_unlock(&worker.decode_mutex);
+
+	if (empty) {
+		os_atomic_set_bool(&worker.stop, true);
+		os_event_signal(worker.wake_event);
+		pthread_join(worker.thread, NULL);
+		os_event_destroy(worker.wake_event);
+		da_free(worker.anims);
+
+		worker.wake_event = NULL;
+		worker.thread_active = false;
+		worker.next = 0;
+		os_atomic_set_bool(&worker.stop, false);
+	}
+
+	pthread_mutex_unlock(&worker_mutex);
+}
+
+static inline void wake_worker(void)
+{
+	/* only called for registered animations, which keep the worker
+	 * running */
+	os_event_signal(worker.wake_event);
+}
+
+struct gs_image_anim *gs_image_anim_create(const struct gs_image_anim_source *source, uint32_t cx, uint32_t cy,
+					   int loops)
+{
+	struct gs_image_anim *anim = bzalloc(sizeof(*anim));
+	const size_t frame_size = (size_t)cx * cy * 4;
+	uint64_t duration;
+
+	anim->source = *source;
+	anim->loops = loops;
+
+	for (size_t i = 0; i < GS_IMAGE_ANIM_FRAMES; i++)
+		anim->frames[i].data = bmalloc(frame_size);
+
+	if (pthread_mutex_init(&anim->mutex, NULL) != 0) {
+		if (source->destroy)
+			source->destroy(source->data);
+		for (size_t i = 0; i < GS_IMAGE_ANIM_FRAMES; i++)
+			bfree(anim->frames[i].data);
+		bfree(anim);
+		return NULL;
+	}
+
+	/* the first frame is decoded right away so that there is always
+	 * something to put into the texture */
+	if (!source->next_frame(source->data, anim->frames[0].data, &duration))
+		goto fail;
+	anim->frames[0].duration = duration ? duration : DEFAULT_DURATION;
+	anim->decoded = true;
+	anim->index = 1;
+
+	anim->registered = worker_add(anim);
+	if (!anim->registered)
+		goto fail;
+
+	return anim;
+
+fail:
+	gs_image_anim_destroy(anim);
+	return NULL;
+}
+
+void gs_image_anim_destroy(struct gs_image_anim *anim)
+{
+	if (!anim)
+		return;
+
+	if (anim->registered)
+		worker_remove(anim);
+
+	pthread_mutex_destroy(&anim->mutex);
+
+	if (anim->source.destroy)
+		anim->source.destroy(anim->source.data);
+
+	for (size_t i = 0; i < GS_IMAGE_ANIM_FRAMES; i++)
+		bfree(anim->frames[i].data);
+	bfree(anim);
+}
+
+bool gs_image_anim_tick(struct gs_image_anim *anim, uint64_t elapsed_time_ns)
+{
+	bool updated = false;
+	uint64_t duration;
+
+	pthread_mutex_lock(&anim->mutex);
+	anim->cur_time += elapsed_time_ns;
+
+	while (anim->queued) {
+		duration = anim->frames[anim->cur].duration;
+
+		if (anim->restarted) {
+			anim->restarted = false;
+			anim->cur_time = 0;
+		} else if (anim->cur_time > duration) {
+			anim->cur_time -= duration;
+		} else {
+			break;
+		}
+
+		anim->cur = (anim->cur + 1) % GS_IMAGE_ANIM_FRAMES;
+		anim->queued--;
+		updated = true;
+	}
+
+	/* the worker fell behind, hold the current frame rather than rushing
+	 * through the next ones once they arrive */
+	duration = anim->frames[anim->cur].duration;
+	if (!anim->queued && anim->cur_time > duration)
+		anim->cur_time = duration;
+	pthread_mutex_unlock(&anim->mutex);
+
+	if (updated)
+		wake_worker();
+	return updated;
+}
+
+const uint8_t *gs_image_anim_frame(struct gs_image_anim *anim)
+{
+	return anim->frames[anim->cur].data;
+}
+
+void gs_image_anim_restart(struct gs_image_anim *anim)
+{
+	pthread_mutex_lock(&anim->mutex);
+	anim->queued = 0;
+	anim->generation++;
+	anim->rewind = true;
+	anim->restarted = true;
+	anim->cur_time = 0;
+	pthread_mutex_unlock(&anim->mutex);
+
+	wake_worker();
+}
+
+void gs_image_anim_get_position(struct gs_image_anim *anim, int *frame, int *loop, uint64_t *time_ns)
+{
+	pthread_mutex_lock(&anim->mutex);
+	*frame = anim->frames[anim->cur].index;
+	*loop = anim->frames[anim->cur].loop;
+	*time_ns = anim->cur_time;
+	pthread_mutex_unlock(&anim->mutex);
+}
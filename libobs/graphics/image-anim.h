@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include "graphics.h"
+
+/* Streaming playback of animated images.
+ *
+ * Instead of decoding every frame up front, a worker thread shared by all
+ * animations decodes a few frames ahead of each into a small ring, so memory
+ * use only depends on the image size and not on the number of frames.
+ * Ticking never decodes or waits: if the worker falls behind, the current
+ * frame simply stays up a bit longer. */
+
+#define GS_IMAGE_ANIM_FRAMES 4
+
+struct gs_image_anim_source {
+	void *data;
+
+	/* decodes the next frame into dst as 4 bytes per pixel, returns false
+	 * once the end of the animation is reached */
+	bool (*next_frame)(void *data, uint8_t *dst, uint64_t *duration_ns);
+	/* goes back to the first frame */
+	bool (*rewind)(void *data);
+	void (*destroy)(void *data);
+};
+
+struct gs_image_anim;
+
+/* takes ownership of the source, also on failure.  loops is the number of
+ * times the animation plays, 0 for endlessly */
+struct gs_image_anim *gs_image_anim_create(const struct gs_image_anim_source *source, uint32_t cx, uint32_t cy,
+					   int loops);
+void gs_image_anim_destroy(struct gs_image_anim *anim);
+
+/* returns true if a new frame is due */
+bool gs_image_anim_tick(struct gs_image_anim *anim, uint64_t elapsed_time_ns);
+/* the frame on screen, valid until the next tick */
+const uint8_t *gs_image_anim_frame(struct gs_image_anim *anim);
+/* the first frame is shown on the first tick after it has been decoded */
+void gs_image_anim_restart(struct gs_image_anim *anim);
+/* index and loop of the frame on screen, and how long it has been up */
+void gs_image_anim_get_position(struct gs_image_anim *anim, int *frame, int *loop, uint64_t *time_ns);
+
+/* APNG and animated WebP, implemented next to the FFmpeg image loader */
+bool gs_image_anim_ffmpeg_source(const char *file, enum gs_image_alpha_mode alpha_mode,
+				 struct gs_image_anim_source *source, enum gs_color_format *format, uint32_t *cx,
+				 uint32_t *cy);
@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include "image-file.h"
+#include "image-anim.h"
 #include "../util/base.h"
 #include "../util/platform.h"
 #include "../util/dstr.h"
@@ -23,6 +24,11 @@
 
 #define blog(level, format, ...) blog(level, "%s: " format, __FUNCTION__, __VA_ARGS__)
 
+struct gs_image_file_private {
+	struct gs_image_anim *anim;
+	gs_texture_t *spare_texture;
+};
+
 static void *bi_def_bitmap_create(int width, int height)
 {
 	return bmalloc((size_t)4 * width * height);
@@ -55,26 +61,62 @@ static void bi_def_bitmap_modified(void *bitmap)
 	UNUSED_PARAMETER(bitmap);
 }
 
-static inline int get_full_decoded_gif_size(gs_image_file_t *image)
+static inline uint64_t get_time(gs_image_file_t *image, unsigned int i)
 {
-	return image->gif.width * image->gif.height * 4 * image->gif.frame_count;
+	return (uint64_t)image->gif.frames[i].frame_delay * 10000000ULL;
 }
 
-static inline void *alloc_mem(gs_image_file_t *image, uint64_t *mem_usage, size_t size)
+struct gif_source {
+	gs_image_file_t *image;
+	enum gs_image_alpha_mode alpha_mode;
+	unsigned int frame;
+};
+
+static bool gif_source_next_frame(void *data, uint8_t *dst, uint64_t *duration_ns)
 {
-	UNUSED_PARAMETER(image);
+	struct gif_source *gif = data;
+	gs_image_file_t *image = gif->image;
+	const size_t area = (size_t)image->cx * image->cy;
 
-	if (mem_usage)
-		*mem_usage += size;
-	return bzalloc(size);
+	if (gif->frame == image->gif.frame_count)
+		return false;
+
+	/* frames are decoded in order, so libnsgif only ever has to compose
+	 * each one onto the previous one */
+	if (gif_decode_frame(&image->gif, gif->frame) != GIF_OK)
+		blog(LOG_WARNING, "Couldn't decode frame %u", gif->frame);
+
+	memcpy(dst, image->gif.frame_image, area * 4);
+
+	if (gif->alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB) {
+		gs_premultiply_xyza_srgb_loop(dst, area);
+	} else if (gif->alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY) {
+		gs_premultiply_xyza_loop(dst, area);
+	}
+
+	*duration_ns = get_time(image, gif->frame++);
+	return true;
+}
+
+static bool gif_source_rewind(void *data)
+{
+	struct gif_source *gif = data;
+	gif->frame = 0;
+	return true;
+}
+
+static void gif_source_destroy(void *data)
+{
+	bfree(data);
 }
 
 static bool init_animated_gif(gs_image_file_t *image, const char *path, uint64_t *mem_usage,
 			      enum gs_image_alpha_mode alpha_mode)
 {
+	struct gs_image_anim_source source = {0};
+	struct gif_source *gif;
 	bool is_animated_gif = true;
 	gif_result result;
-	uint64_t max_size;
 	size_t size, size_read;
 	FILE *file;
 
@@ -120,43 +162,35 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path, uint64_t
 		goto fail;
 	}
 
-	max_size = (uint64_t)image->gif.width * (uint64_t)image->gif.height * (uint64_t)image->gif.frame_count * 4LLU;
-
-	if ((uint64_t)get_full_decoded_gif_size(image) != max_size) {
-		blog(LOG_WARNING, "Gif '%s' overflowed maximum pointer size", path);
-		goto fail;
-	}
-
 	image->is_animated_gif = (image->gif.frame_count > 1 && result >= 0);
 	if (image->is_animated_gif) {
-		gif_decode_frame(&image->gif, 0);
-
-		image->animation_frame_cache = alloc_mem(image, mem_usage, image->gif.frame_count * sizeof(uint8_t *));
-		image->animation_frame_data = alloc_mem(image, mem_usage, get_full_decoded_gif_size(image));
-
-		for (unsigned int i = 0; i < image->gif.frame_count; i++) {
-			if (gif_decode_frame(&image->gif, i) != GIF_OK)
-				blog(LOG_WARNING,
-				     "Couldn't decode frame %u "
-				     "of '%s'",
-				     i, path);
-		}
-
-		gif_decode_frame(&image->gif, 0);
+		int loops = image->gif.loop_count;
+		if (loops >= 0xFFFF)
+			loops = 0;
 
 		image->cx = (uint32_t)image->gif.width;
 		image->cy = (uint32_t)image->gif.height;
 		image->format = GS_RGBA;
 
-		if (mem_usage) {
-			*mem_usage += (size_t)4 * image->cx * image->cy;
-			*mem_usage += size;
+		gif = bzalloc(sizeof(*gif));
+		gif->image = image;
+		gif->alpha_mode = alpha_mode;
+
+		source.data = gif;
+		source.next_frame = gif_source_next_frame;
+		source.rewind = gif_source_rewind;
+		source.destroy = gif_source_destroy;
+
+		image->priv = bzalloc(sizeof(*image->priv));
+		image->priv->anim = gs_image_anim_create(&source, image->cx, image->cy, loops);
+		if (!image->priv->anim) {
+			blog(LOG_WARNING, "Failed to start decoding '%s'", path);
+			goto fail;
 		}
 
-		if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB) {
-			gs_premultiply_xyza_srgb_loop(image->gif.frame_image, (size_t)image->cx * image->cy);
-		} else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY) {
-			gs_premultiply_xyza_loop(image->gif.frame_image, (size_t)image->cx * image->cy);
+		if (mem_usage) {
+			*mem_usage += (size_t)4 * image->cx * image->cy * (GS_IMAGE_ANIM_FRAMES + 2);
+			*mem_usage += size;
 		}
 	} else {
 		gif_finalise(&image->gif);
@@ -178,6 +212,93 @@ not_animated:
 	return is_animated_gif;
 }
 
+static bool is_animated_png(FILE *file)
+{
+	uint8_t header[8];
+
+	if (fread(header, 1, 8, file) != 8 || memcmp(header, "\x89PNG\r\n\x1a\n", 8) != 0)
+		return false;
+
+	/* the animation control chunk has to come before the image data */
+	while (fread(header, 1, 8, file) == 8) {
+		uint32_t len = ((uint32_t)header[0] << 24) | ((uint32_t)header[1] << 16) | ((uint32_t)header[2] << 8) |
+			       header[3];
+
+		if (memcmp(header + 4, "acTL", 4) == 0)
+			return true;
+		if (memcmp(header + 4, "IDAT", 4) == 0)
+			return false;
+		if (os_fseeki64(file, (int64_t)len + 4, SEEK_CUR) != 0)
+			return false;
+	}
+
+	return false;
+}
+
+static bool is_animated_webp(FILE *file)
+{
+	uint8_t header[21];
+
+	if (fread(header, 1, sizeof(header), file) != sizeof(header))
+		return false;
+
+	/* only the extended format can hold an animation, which it announces
+	 * in its feature flags */
+	return memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WEBPVP8X", 8) == 0 && (header[20] & 0x02) != 0;
+}
+
+static bool is_animated_image(const char *path)
+{
+	size_t len = strlen(path);
+	bool animated = false;
+	FILE *file;
+
+	if (len <= 4)
+		return false;
+
+	if (astrcmpi(path + len - 4, ".png") != 0 && astrcmpi(path + len - 5, ".apng") != 0 &&
+	    astrcmpi(path + len - 5, ".webp") != 0)
+		return false;
+
+	file = os_fopen(path, "rb");
+	if (!file)
+		return false;
+
+	animated = is_animated_png(file);
+	if (!animated) {
+		rewind(file);
+		animated = is_animated_webp(file);
+	}
+
+	fclose(file);
+	return animated;
+}
+
+static bool init_animated_image(gs_image_file_t *image, const char *path, uint64_t *mem_usage,
+				enum gs_image_alpha_mode alpha_mode)
+{
+	struct gs_image_anim_source source = {0};
+
+	if (!gs_image_anim_ffmpeg_source(path, alpha_mode, &source, &image->format, &image->cx, &image->cy))
+		return false;
+
+	image->priv = bzalloc(sizeof(*image->priv));
+	image->priv->anim = gs_image_anim_create(&source, image->cx, image->cy, 0);
+	if (!image->priv->anim) {
+		blog(LOG_WARNING, "Failed to start decoding '%s'", path);
+		bfree(image->priv);
+		image->priv = NULL;
+		return false;
+	}
+
+	if (mem_usage)
+		*mem_usage += (size_t)4 * image->cx * image->cy * (GS_IMAGE_ANIM_FRAMES + 2);
+
+	image->is_animated_gif = true;
+	image->loaded = true;
+	return true;
+}
+
 static void gs_image_file_init_internal(gs_image_file_t *image, const char *file, uint64_t *mem_usage,
 					enum gs_color_space *space, enum gs_image_alpha_mode alpha_mode)
 {
@@ -197,6 +318,10 @@ static void gs_image_file_init_internal(gs_image_file_t *image, const char *file
 		if (init_animated_gif(image, file, mem_usage, alpha_mode)) {
 			return;
 		}
+	} else if (is_animated_image(file)) {
+		if (init_animated_image(image, file, mem_usage, alpha_mode)) {
+			return;
+		}
 	}
 
 	image->texture_data =
@@ -226,14 +351,16 @@ void gs_image_file_free(gs_image_file_t *image)
 
 	if (image->loaded) {
 		if (image->is_animated_gif) {
+			/* stops decoding before the decoder state goes away */
+			gs_image_anim_destroy(image->priv->anim);
 			gif_finalise(&image->gif);
-			bfree(image->animation_frame_cache);
-			bfree(image->animation_frame_data);
+			gs_texture_destroy(image->priv->spare_texture);
 		}
 
 		gs_texture_destroy(image->texture);
 	}
 
+	bfree(image->priv);
 	bfree(image->texture_data);
 	bfree(image->gif_data);
 	memset(image, 0, sizeof(*image));
@@ -265,8 +392,13 @@ void gs_image_file_init_texture(gs_image_file_t *image)
 		return;
 
 	if (image->is_animated_gif) {
-		image->texture = gs_texture_create(image->cx, image->cy, image->format, 1,
-						   (const uint8_t **)&image->gif.frame_image, GS_DYNAMIC);
+		const uint8_t *frame = gs_image_anim_frame(image->priv->anim);
+
+		/* frames alternate between two textures, so an upload never has
+		 * to wait for the GPU to finish with the previous frame */
+		image->texture = gs_texture_create(image->cx, image->cy, image->format, 1, &frame, GS_DYNAMIC);
+		image->priv->spare_texture =
+			gs_texture_create(image->cx, image->cy, image->format, 1, &frame, GS_DYNAMIC);
 
 	} else {
 		image->texture = gs_texture_create(image->cx, image->cy, image->format, 1,
@@ -276,145 +408,89 @@ void gs_image_file_init_texture(gs_image_file_t *image)
 	}
 }
 
-static inline uint64_t get_time(gs_image_file_t *image, int i)
-{
-	uint64_t val = (uint64_t)image->gif.frames[i].frame_delay * 10000000ULL;
-	if (!val)
-		val = 100000000;
-	return val;
-}
-
-static inline int calculate_new_frame(gs_image_file_t *image, uint64_t elapsed_time_ns, int loops)
-{
-	int new_frame = image->cur_frame;
-
-	image->cur_time += elapsed_time_ns;
-	for (;;) {
-		uint64_t t = get_time(image, new_frame);
-		if (image->cur_time <= t)
-			break;
-
-		image->cur_time -= t;
-		if ((unsigned int)++new_frame == image->gif.frame_count) {
-			if (!loops || ++image->cur_loop < loops) {
-				new_frame = 0;
-			} else if (image->cur_loop == loops) {
-				new_frame--;
-				break;
-			}
-		}
-	}
-
-	return new_frame;
-}
-
-static void decode_new_frame(gs_image_file_t *image, int new_frame, enum gs_image_alpha_mode alpha_mode)
-{
-	if (!image->animation_frame_cache[new_frame]) {
-		int last_frame;
-
-		/* if looped, decode frame 0 */
-		last_frame = (new_frame < image->last_decoded_frame) ? 0 : image->last_decoded_frame + 1;
-
-		/* decode missed frames */
-		for (int i = last_frame; i < new_frame; i++) {
-			if (gif_decode_frame(&image->gif, i) != GIF_OK)
-				return;
-		}
-
-		/* decode actual desired frame */
-		if (gif_decode_frame(&image->gif, new_frame) == GIF_OK) {
-			const size_t area = (size_t)image->gif.width * image->gif.height;
-			size_t pos = new_frame * area * 4;
-			image->animation_frame_cache[new_frame] = image->animation_frame_data + pos;
-
-			if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB) {
-				gs_premultiply_xyza_srgb_loop(image->gif.frame_image, area);
-			} else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY) {
-				gs_premultiply_xyza_loop(image->gif.frame_image, area);
-			}
-
-			memcpy(image->animation_frame_cache[new_frame], image->gif.frame_image, area * 4);
-
-			image->last_decoded_frame = new_frame;
-		}
-	}
-
-	image->cur_frame = new_frame;
-}
-
-static bool gs_image_file_tick_internal(gs_image_file_t *image, uint64_t elapsed_time_ns,
-					enum gs_image_alpha_mode alpha_mode)
+static bool gs_image_file_tick_internal(gs_image_file_t *image, uint64_t elapsed_time_ns)
 {
-	int loops;
+	struct gs_image_anim *anim;
+	int frame;
+	int loop;
+	bool updated;
 
 	if (!image->is_animated_gif || !image->loaded)
 		return false;
 
-	loops = image->gif.loop_count;
-	if (loops >= 0xFFFF)
-		loops = 0;
+	anim = image->priv->anim;
 
-	if (!loops || image->cur_loop < loops) {
-		int new_frame = calculate_new_frame(image, elapsed_time_ns, loops);
+	/* callers written before gs_image_file_restart rewind the animation
+	 * by resetting cur_frame */
+	gs_image_anim_get_position(anim, &frame, &loop, &image->cur_time);
+	if (image->cur_frame != frame)
+		gs_image_anim_restart(anim);
 
-		if (new_frame != image->cur_frame) {
-			decode_new_frame(image, new_frame, alpha_mode);
-			return true;
-		}
-	}
+	updated = gs_image_anim_tick(anim, elapsed_time_ns);
 
-	return false;
+	gs_image_anim_get_position(anim, &image->cur_frame, &image->cur_loop, &image->cur_time);
+	image->last_decoded_frame = image->cur_frame;
+	return updated;
 }
 
 bool gs_image_file_tick(gs_image_file_t *image, uint64_t elapsed_time_ns)
 {
-	return gs_image_file_tick_internal(image, elapsed_time_ns, false);
+	return gs_image_file_tick_internal(image, elapsed_time_ns);
 }
 
 bool gs_image_file2_tick(gs_image_file2_t *if2, uint64_t elapsed_time_ns)
 {
-	return gs_image_file_tick_internal(&if2->image, elapsed_time_ns, false);
+	return gs_image_file_tick_internal(&if2->image, elapsed_time_ns);
 }
 
 bool gs_image_file3_tick(gs_image_file3_t *if3, uint64_t elapsed_time_ns)
 {
-	return gs_image_file_tick_internal(&if3->image2.image, elapsed_time_ns, if3->alpha_mode);
+	return gs_image_file_tick_internal(&if3->image2.image, elapsed_time_ns);
 }
 
 bool gs_image_file4_tick(gs_image_file4_t *if4, uint64_t elapsed_time_ns)
 {
-	return gs_image_file_tick_internal(&if4->image3.image2.image, elapsed_time_ns, if4->image3.alpha_mode);
+	return gs_image_file_tick_internal(&if4->image3.image2.image, elapsed_time_ns);
 }
 
-static void gs_image_file_update_texture_internal(gs_image_file_t *image, enum gs_image_alpha_mode alpha_mode)
+void gs_image_file_restart(gs_image_file_t *image)
 {
 	if (!image->is_animated_gif || !image->loaded)
 		return;
 
-	if (!image->animation_frame_cache[image->cur_frame])
-		decode_new_frame(image, image->cur_frame, alpha_mode);
+	gs_image_anim_restart(image->priv->anim);
+}
+
+static void gs_image_file_update_texture_internal(gs_image_file_t *image)
+{
+	gs_texture_t *texture;
+
+	if (!image->is_animated_gif || !image->loaded || !image->priv->spare_texture)
+		return;
+
+	texture = image->priv->spare_texture;
+	gs_texture_set_image(texture, gs_image_anim_frame(image->priv->anim), image->cx * 4, false);
 
-	gs_texture_set_image(image->texture, image->animation_frame_cache[image->cur_frame], image->gif.width * 4,
-			     false);
+	image->priv->spare_texture = image->texture;
+	image->texture = texture;
 }
 
 void gs_image_file_update_texture(gs_image_file_t *image)
 {
-	gs_image_file_update_texture_internal(image, false);
+	gs_image_file_update_texture_internal(image);
 }
 
 void gs_image_file2_update_texture(gs_image_file2_t *if2)
 {
-	gs_image_file_update_texture_internal(&if2->image, false);
+	gs_image_file_update_texture_internal(&if2->image);
 }
 
 void gs_image_file3_update_texture(gs_image_file3_t *if3)
 {
-	gs_image_file_update_texture_internal(&if3->image2.image, if3->alpha_mode);
+	gs_image_file_update_texture_internal(&if3->image2.image);
 }
 
 void gs_image_file4_update_texture(gs_image_file4_t *if4)
 {
-	gs_image_file_update_texture_internal(&if4->image3.image2.image, if4->image3.alpha_mode);
+	gs_image_file_update_texture_internal(&if4->image3.image2.image);
 }
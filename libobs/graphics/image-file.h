@@ -24,19 +24,21 @@
 extern "C" {
 #endif
 
+struct gs_image_file_private;
+
 struct gs_image_file {
 	gs_texture_t *texture;
 	enum gs_color_format format;
 	uint32_t cx;
 	uint32_t cy;
-	bool is_animated_gif;
+	bool is_animated_gif; /* also set for animated PNG and WebP */
 	bool frame_updated;
 	bool loaded;
 
 	gif_animation gif;
 	uint8_t *gif_data;
-	uint8_t **animation_frame_cache;
-	uint8_t *animation_frame_data;
+	uint8_t **animation_frame_cache; /* unused, frames are no longer cached */
+	uint8_t *animation_frame_data;   /* unused */
 	uint64_t cur_time;
 	int cur_frame;
 	int cur_loop;
@@ -44,6 +46,8 @@ struct gs_image_file {
 
 	uint8_t *texture_data;
 	gif_bitmap_callback_vt bitmap_callbacks;
+
+	struct gs_image_file_private *priv;
 };
 
 struct gs_image_file2 {
@@ -72,6 +76,8 @@ EXPORT void gs_image_file_free(gs_image_file_t *image);
 EXPORT void gs_image_file_init_texture(gs_image_file_t *image);
 EXPORT bool gs_image_file_tick(gs_image_file_t *image, uint64_t elapsed_time_ns);
 EXPORT void gs_image_file_update_texture(gs_image_file_t *image);
+/* plays an animation from the start again */
+EXPORT void gs_image_file_restart(gs_image_file_t *image);
 
 EXPORT void gs_image_file2_init(gs_image_file2_t *if2, const char *file);
 
@@ -0,0 +1,109 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "audio-mix.h"
+
+#include "../util/sse-intrin.h"
+
+/* Two vectors per iteration keeps both load ports busy, the remainder is done
+ * with the scalar loop (AUDIO_OUTPUT_FRAMES is a multiple of 8, so this only
+ * happens for partial buffers). */
+
+void audio_mix_add(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a0 = _mm_loadu_ps(dst + i);
+		__m128 a1 = _mm_loadu_ps(dst + i + 4);
+		__m128 b0 = _mm_loadu_ps(src + i);
+		__m128 b1 = _mm_loadu_ps(src + i + 4);
+
+		_mm_storeu_ps(dst + i, _mm_add_ps(a0, b0));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(a1, b1));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+void audio_mix_add_gain(float *dst, const float *src, const float *gain, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a0 = _mm_loadu_ps(dst + i);
+		__m128 a1 = _mm_loadu_ps(dst + i + 4);
+		__m128 b0 = _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(gain + i));
+		__m128 b1 = _mm_mul_ps(_mm_loadu_ps(src + i + 4), _mm_loadu_ps(gain + i + 4));
+
+		_mm_storeu_ps(dst + i, _mm_add_ps(a0, b0));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(a1, b1));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i] * gain[i];
+}
+
+void audio_mix_scale(float *data, float vol, size_t count)
+{
+	const __m128 v = _mm_set1_ps(vol);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), v));
+		_mm_storeu_ps(data + i + 4, _mm_mul_ps(_mm_loadu_ps(data + i + 4), v));
+	}
+
+	for (; i < count; i++)
+		data[i] *= vol;
+}
+
+void audio_mix_mul(float *data, const float *gain, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), _mm_loadu_ps(gain + i)));
+		_mm_storeu_ps(data + i + 4, _mm_mul_ps(_mm_loadu_ps(data + i + 4), _mm_loadu_ps(gain + i + 4)));
+	}
+
+	for (; i < count; i++)
+		data[i] *= gain[i];
+}
+
+void audio_mix_clamp(float *data, size_t count)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 neg_one = _mm_set1_ps(-1.0f);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 val = _mm_loadu_ps(data + i);
+
+		/* zero out NaN first, min/max would pass it through */
+		val = _mm_and_ps(val, _mm_cmpord_ps(val, val));
+		val = _mm_max_ps(_mm_min_ps(val, one), neg_one);
+		_mm_storeu_ps(data + i, val);
+	}
+
+	for (; i < count; i++) {
+		float val = data[i];
+		val = (val == val) ? val : 0.0f;
+		val = (val > 1.0f) ? 1.0f : val;
+		val = (val < -1.0f) ? -1.0f : val;
+		data[i] = val;
+	}
+}
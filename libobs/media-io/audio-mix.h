@@ -0,0 +1,47 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Float audio mixing kernels (SSE2, NEON through simde on ARM)
+ *
+ * Buffers do not need to be aligned and may not overlap.
+ */
+
+/* dst[i] += src[i] */
+EXPORT void audio_mix_add(float *dst, const float *src, size_t count);
+
+/* dst[i] += src[i] * gain[i] */
+EXPORT void audio_mix_add_gain(float *dst, const float *src, const float *gain, size_t count);
+
+/* data[i] *= vol */
+EXPORT void audio_mix_scale(float *data, float vol, size_t count);
+
+/* data[i] *= gain[i] */
+EXPORT void audio_mix_mul(float *data, const float *gain, size_t count);
+
+/* data[i] = clamp(data[i], -1.0, 1.0), NaN becomes 0.0 */
+EXPORT void audio_mix_clamp(float *data, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -33,13 +33,26 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
 #define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
+#define MAX_INPUT_QUEUE 3
 
+/* The cache is a single-producer/single-consumer ring: the graphics thread
+ * (video_output_lock_frame/unlock_frame) only writes last_added and the
+ * video thread only writes first_added, and ownership of a slot is handed
+ * over through the atomic available_frames counter.  Neither side takes a
+ * lock, so a slow encoder callback can no longer stall rendering. */
 struct cached_frame_info {
 	struct video_data frame;
-	int skipped;
-	int count;
+	volatile long skipped;
+	volatile long count;
+
+	/* video thread + queued parallel input frames, the slot is done when
+	 * this drops to zero */
+	volatile long refs;
+	bool done; /* release_mutex */
 };
 
+struct video_input_worker;
+
 struct video_input {
 	struct video_scale_info conversion;
 	video_scaler_t *scaler;
@@ -58,6 +71,30 @@ struct video_input {
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
+
+	/* parallel mode: scaling and the callback run on this input's own
+	 * thread, the scaler and frames above then belong to the worker */
+	struct video_input_worker *worker;
+};
+
+struct queued_frame {
+	struct video_data frame;
+	struct cached_frame_info *cfi;
+};
+
+struct video_input_worker {
+	struct video_output *video;
+	struct video_input input;
+
+	pthread_t thread;
+	os_sem_t *sem;
+	pthread_mutex_t mutex;
+	struct queued_frame queue[MAX_INPUT_QUEUE];
+	size_t queue_start;
+	size_t queue_num;
+	volatile bool stop;
+
+	volatile long skipped_frames;
 };
 
 static inline void video_input_free(struct video_input *input)
@@ -71,7 +108,6 @@ struct video_output {
 	struct video_output_info info;
 
 	pthread_t thread;
-	pthread_mutex_t data_mutex;
 	bool stop;
 
 	os_sem_t *update_semaphore;
@@ -82,13 +118,24 @@ struct video_output {
 	pthread_mutex_t input_mutex;
 	DARRAY(struct video_input) inputs;
 
-	size_t available_frames;
-	size_t first_added;
-	size_t last_added;
+	/* workers of inputs that disconnected from their own callback, joined
+	 * by the video thread (input_mutex) */
+	DARRAY(struct video_input_worker *) retired_workers;
+	volatile bool has_retired_workers;
+
+	volatile long available_frames;
+	size_t first_added; /* video thread only */
+	size_t last_added;  /* graphics thread only */
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
 
+	/* parallel inputs finish slots out of order, they are handed back to
+	 * the graphics thread from here in ring order */
+	pthread_mutex_t release_mutex;
+	size_t first_held;
+
 	struct video_output *parent;
 
+	bool parallel_inputs;
 	volatile bool raw_active;
 	volatile long gpu_refs;
 };
@@ -123,20 +170,181 @@ static inline bool scale_video_output(struct video_input *input, struct video_da
 	return success;
 }
 
+/* hands slots back to the graphics thread once nothing references them.
+ * Inputs finish at their own pace, but the graphics thread always takes the
+ * slot after last_added, so a finished slot is only returned once every slot
+ * before it in the ring has been returned as well. */
+static void release_cached_frame(struct video_output *video, struct cached_frame_info *cfi)
+{
+	if (os_atomic_dec_long(&cfi->refs) != 0)
+		return;
+
+	pthread_mutex_lock(&video->release_mutex);
+	cfi->done = true;
+
+	while (video->cache[video->first_held].done) {
+		video->cache[video->first_held].done = false;
+		if (++video->first_held == video->info.cache_size)
+			video->first_held = 0;
+
+		os_atomic_inc_long(&video->available_frames);
+	}
+	pthread_mutex_unlock(&video->release_mutex);
+}
+
+static void *video_input_thread(void *param)
+{
+	struct video_input_worker *worker = param;
+	struct video_input *input = &worker->input;
+
+	os_set_thread_name("video-io: input worker");
+
+	while (os_sem_wait(worker->sem) == 0) {
+		struct queued_frame queued;
+
+		if (os_atomic_load_bool(&worker->stop))
+			break;
+
+		pthread_mutex_lock(&worker->mutex);
+		if (!worker->queue_num) {
+			pthread_mutex_unlock(&worker->mutex);
+			continue;
+		}
+		queued = worker->queue[worker->queue_start];
+		pthread_mutex_unlock(&worker->mutex);
+
+		if (scale_video_output(input, &queued.frame))
+			input->callback(input->param, &queued.frame);
+
+		/* the entry stays queued while in use so a full queue really
+		 * means this input is behind */
+		pthread_mutex_lock(&worker->mutex);
+		if (++worker->queue_start == MAX_INPUT_QUEUE)
+			worker->queue_start = 0;
+		worker->queue_num--;
+		pthread_mutex_unlock(&worker->mutex);
+
+		release_cached_frame(worker->video, queued.cfi);
+	}
+
+	return NULL;
+}
+
+/* never blocks the video thread: if this input is still busy with older
+ * frames, the frame is skipped for this input only */
+static void queue_input_frame(struct video_input_worker *worker, struct cached_frame_info *cfi,
+			      const struct video_data *frame)
+{
+	bool queued = false;
+
+	pthread_mutex_lock(&worker->mutex);
+	if (worker->queue_num < MAX_INPUT_QUEUE) {
+		size_t idx = (worker->queue_start + worker->queue_num) % MAX_INPUT_QUEUE;
+		worker->queue[idx].frame = *frame;
+		worker->queue[idx].cfi = cfi;
+		worker->queue_num++;
+		os_atomic_inc_long(&cfi->refs);
+		queued = true;
+	}
+	pthread_mutex_unlock(&worker->mutex);
+
+	if (queued)
+		os_sem_post(worker->sem);
+	else
+		os_atomic_inc_long(&worker->skipped_frames);
+}
+
+static struct video_input_worker *video_input_worker_create(struct video_output *video, struct video_input *input)
+{
+	struct video_input_worker *worker = bzalloc(sizeof(*worker));
+	worker->video = video;
+
+	if (pthread_mutex_init(&worker->mutex, NULL) != 0)
+		goto fail0;
+	if (os_sem_init(&worker->sem, 0) != 0)
+		goto fail1;
+
+	/* the scaler and conversion frames move to the worker */
+	worker->input = *input;
+	if (pthread_create(&worker->thread, NULL, video_input_thread, worker) != 0)
+		goto fail2;
+
+	input->scaler = NULL;
+	memset(input->frame, 0, sizeof(input->frame));
+	return worker;
+
+fail2:
+	os_sem_destroy(worker->sem);
+fail1:
+	pthread_mutex_destroy(&worker->mutex);
+fail0:
+	bfree(worker);
+	return NULL;
+}
+
+static void video_input_worker_destroy(struct video_input_worker *worker)
+{
+	os_atomic_set_bool(&worker->stop, true);
+	os_sem_post(worker->sem);
+	pthread_join(worker->thread, NULL);
+
+	/* frames that were never delivered still hold their cache slots */
+	for (size_t i = 0; i < worker->queue_num; i++) {
+		size_t idx = (worker->queue_start + i) % MAX_INPUT_QUEUE;
+		release_cached_frame(worker->video, worker->queue[idx].cfi);
+	}
+
+	long skipped = os_atomic_load_long(&worker->skipped_frames);
+	if (skipped)
+		blog(LOG_INFO, "video-io: input %p skipped %ld frames while busy", worker->input.param, skipped);
+
+	video_input_free(&worker->input);
+	os_sem_destroy(worker->sem);
+	pthread_mutex_destroy(&worker->mutex);
+	bfree(worker);
+}
+
+/* an input can disconnect from inside its own callback, for example when its
+ * encoder fails, and a worker cannot join itself.  It is only told to stop
+ * then, the video thread joins and frees it once the callback has returned. */
+static void video_input_worker_remove(struct video_output *video, struct video_input_worker *worker)
+{
+	if (!pthread_equal(pthread_self(), worker->thread)) {
+		video_input_worker_destroy(worker);
+		return;
+	}
+
+	os_atomic_set_bool(&worker->stop, true);
+	os_sem_post(worker->sem);
+
+	da_push_back(video->retired_workers, &worker);
+	os_atomic_set_bool(&video->has_retired_workers, true);
+}
+
+static void reap_input_workers(struct video_output *video)
+{
+	DARRAY(struct video_input_worker *) retired;
+	da_init(retired);
+
+	pthread_mutex_lock(&video->input_mutex);
+	da_move(retired, video->retired_workers);
+	os_atomic_set_bool(&video->has_retired_workers, false);
+	pthread_mutex_unlock(&video->input_mutex);
+
+	for (size_t i = 0; i < retired.num; i++)
+		video_input_worker_destroy(retired.array[i]);
+	da_free(retired);
+}
+
 static inline bool video_output_cur_frame(struct video_output *video)
 {
 	struct cached_frame_info *frame_info;
 	bool complete;
-	bool skipped;
-
-	/* -------------------------------- */
-
-	pthread_mutex_lock(&video->data_mutex);
 
+	/* first_added is only written by this thread and the slot is owned by
+	 * it until available_frames is incremented again */
 	frame_info = &video->cache[video->first_added];
 
-	pthread_mutex_unlock(&video->data_mutex);
-
 	/* -------------------------------- */
 
 	pthread_mutex_lock(&video->input_mutex);
@@ -155,7 +363,9 @@ static inline bool video_output_cur_frame(struct video_output *video)
 		if (skip)
 			continue;
 
-		if (scale_video_output(input, &frame))
+		if (input->worker)
+			queue_input_frame(input->worker, frame_info, &frame);
+		else if (scale_video_output(input, &frame))
 			input->callback(input->param, &frame);
 	}
 
@@ -163,27 +373,24 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->data_mutex);
-
 	frame_info->frame.timestamp += video->frame_time;
-	complete = --frame_info->count == 0;
-	skipped = frame_info->skipped > 0;
+	complete = os_atomic_dec_long(&frame_info->count) == 0;
 
 	if (complete) {
 		if (++video->first_added == video->info.cache_size)
 			video->first_added = 0;
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
-	} else if (skipped) {
-		--frame_info->skipped;
-		os_atomic_inc_long(&video->skipped_frames);
+		release_cached_frame(video, frame_info);
+	} else {
+		long skipped = os_atomic_load_long(&frame_info->skipped);
+		while (skipped > 0) {
+			if (os_atomic_compare_exchange_long(&frame_info->skipped, &skipped, skipped - 1)) {
+				os_atomic_inc_long(&video->skipped_frames);
+				break;
+			}
+		}
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
-
-	/* -------------------------------- */
-
 	return complete;
 }
 
@@ -208,6 +415,9 @@ static void *video_thread(void *param)
 		os_atomic_inc_long(&video->total_frames);
 		profile_end(video_thread_name);
 
+		if (os_atomic_load_bool(&video->has_retired_workers))
+			reap_input_workers(video);
+
 		profile_reenable_thread();
 	}
 
@@ -233,7 +443,10 @@ static inline void init_cache(struct video_output *video)
 		video_frame_init(frame, video->info.format, video->info.width, video->info.height);
 	}
 
-	video->available_frames = video->info.cache_size;
+	video->available_frames = (long)video->info.cache_size;
+	video->first_added = 0;
+	video->last_added = video->info.cache_size - 1;
+	video->first_held = 0;
 }
 
 int video_output_open(video_t **video, struct video_output_info *info)
@@ -250,26 +463,27 @@ int video_output_open(video_t **video, struct video_output_info *info)
 	memcpy(&out->info, info, sizeof(struct video_output_info));
 	out->frame_time = util_mul_div64(1000000000ULL, info->fps_den, info->fps_num);
 
-	if (pthread_mutex_init_recursive(&out->data_mutex) != 0)
-		goto fail0;
 	if (pthread_mutex_init_recursive(&out->input_mutex) != 0)
+		goto fail0;
+	if (pthread_mutex_init(&out->release_mutex, NULL) != 0)
 		goto fail1;
 	if (os_sem_init(&out->update_semaphore, 0) != 0)
 		goto fail2;
-	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
-		goto fail3;
 
 	init_cache(out);
 
+	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
+		goto fail3;
+
 	*video = out;
 	return VIDEO_OUTPUT_SUCCESS;
 
 fail3:
 	os_sem_destroy(out->update_semaphore);
 fail2:
-	pthread_mutex_destroy(&out->input_mutex);
+	pthread_mutex_destroy(&out->release_mutex);
 fail1:
-	pthread_mutex_destroy(&out->data_mutex);
+	pthread_mutex_destroy(&out->input_mutex);
 fail0:
 	bfree(out);
 	return VIDEO_OUTPUT_FAIL;
@@ -281,11 +495,15 @@ void video_output_close(video_t *video)
 		return;
 
 	video_output_stop(video);
+	reap_input_workers(video);
 
 	pthread_mutex_lock(&video->input_mutex);
 
-	for (size_t i = 0; i < video->inputs.num; i++)
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		if (video->inputs.array[i].worker)
+			video_input_worker_destroy(video->inputs.array[i].worker);
 		video_input_free(&video->inputs.array[i]);
+	}
 	da_free(video->inputs);
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
@@ -293,7 +511,7 @@ void video_output_close(video_t *video)
 
 	pthread_mutex_unlock(&video->input_mutex);
 	os_sem_destroy(video->update_semaphore);
-	pthread_mutex_destroy(&video->data_mutex);
+	pthread_mutex_destroy(&video->release_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
 
 	bfree(video);
@@ -432,6 +650,13 @@ bool video_output_connect2(video_t *video, const struct video_scale_info *conver
 			input.conversion.height = video->info.height;
 
 		success = video_input_init(&input, video);
+		if (success && video->parallel_inputs) {
+			input.worker = video_input_worker_create(video, &input);
+			if (!input.worker) {
+				video_input_free(&input);
+				success = false;
+			}
+		}
 		if (success) {
 			if (video->inputs.num == 0) {
 				if (!os_atomic_load_long(&video->gpu_refs)) {
@@ -478,6 +703,8 @@ bool video_output_disconnect2(video_t *video, void (*callback)(void *param, stru
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
+		if (video->inputs.array[idx].worker)
+			video_input_worker_remove(video, video->inputs.array[idx].worker);
 		video_input_free(video->inputs.array + idx);
 		da_erase(video->inputs, idx);
 
@@ -494,6 +721,18 @@ bool video_output_disconnect2(video_t *video, void (*callback)(void *param, stru
 	return idx != DARRAY_INVALID;
 }
 
+void video_output_set_parallel_inputs(video_t *video, bool parallel)
+{
+	if (!video)
+		return;
+
+	video = get_root(video);
+
+	pthread_mutex_lock(&video->input_mutex);
+	video->parallel_inputs = parallel;
+	pthread_mutex_unlock(&video->input_mutex);
+}
+
 bool video_output_active(const video_t *video)
 {
 	if (!video)
@@ -506,42 +745,74 @@ const struct video_output_info *video_output_get_info(const video_t *video)
 	return video ? &video->info : NULL;
 }
 
+static inline void add_long(volatile long *val, long n)
+{
+	long cur = os_atomic_load_long(val);
+	while (!os_atomic_compare_exchange_long(val, &cur, cur + n))
+		;
+}
+
+/* adds repeats to the newest queued frame, fails if the video thread released
+ * it in the meantime (the cache then has room again) */
+static inline bool repeat_last_frame(struct cached_frame_info *cfi, int count)
+{
+	long cur = os_atomic_load_long(&cfi->count);
+
+	/* raise skipped first so the video thread never outputs a repeat
+	 * without being able to account for it */
+	add_long(&cfi->skipped, count);
+
+	while (cur > 0) {
+		if (os_atomic_compare_exchange_long(&cfi->count, &cur, cur + count))
+			return true;
+	}
+
+	add_long(&cfi->skipped, -count);
+	return false;
+}
+
 bool video_output_lock_frame(video_t *video, struct video_frame *frame, int count, uint64_t timestamp)
 {
 	struct cached_frame_info *cfi;
-	bool locked;
 
 	if (!video)
 		return false;
 
 	video = get_root(video);
 
-	pthread_mutex_lock(&video->data_mutex);
-
-	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		video->cache[video->last_added].skipped += count;
-		locked = false;
+	if (os_atomic_load_long(&video->available_frames) == 0) {
+		/* cache full: the video thread will output the newest frame
+		 * again instead, counted as skipped */
+		if (repeat_last_frame(&video->cache[video->last_added], count))
+			return false;
 
-	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
+		/* the newest frame was already output but its slot has not
+		 * come back yet, in parallel mode an input that is behind can
+		 * hold it for a while.  Drop the frame rather than waiting on
+		 * the graphics thread */
+		if (os_atomic_load_long(&video->available_frames) == 0) {
+			add_long(&video->skipped_frames, count);
+			add_long(&video->total_frames, count);
+			return false;
 		}
-
-		cfi = &video->cache[video->last_added];
-		cfi->frame.timestamp = timestamp;
-		cfi->count = count;
-		cfi->skipped = 0;
-
-		memcpy(frame, &cfi->frame, sizeof(*frame));
-
-		locked = true;
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
-
-	return locked;
+	size_t next = video->last_added + 1;
+	if (next == video->info.cache_size)
+		next = 0;
+
+	/* slots come back in ring order, so the next one is free and nothing
+	 * holds a reference to it anymore.  It is not visible to the video
+	 * thread until video_output_unlock_frame publishes it */
+	video->last_added = next;
+	cfi = &video->cache[next];
+	cfi->frame.timestamp = timestamp;
+	os_atomic_set_long(&cfi->skipped, 0);
+	os_atomic_set_long(&cfi->refs, 1);
+	os_atomic_set_long(&cfi->count, count);
+
+	memcpy(frame, &cfi->frame, sizeof(*frame));
+	return true;
 }
 
 void video_output_unlock_frame(video_t *video)
@@ -551,12 +822,8 @@ void video_output_unlock_frame(video_t *video)
 
 	video = get_root(video);
 
-	pthread_mutex_lock(&video->data_mutex);
-
-	video->available_frames--;
+	os_atomic_dec_long(&video->available_frames);
 	os_sem_post(video->update_semaphore);
-
-	pthread_mutex_unlock(&video->data_mutex);
 }
 
 uint64_t video_output_get_frame_time(const video_t *video)
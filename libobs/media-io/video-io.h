@@ -308,6 +308,12 @@ EXPORT void video_output_disconnect(video_t *video, void (*callback)(void *param
 EXPORT bool video_output_disconnect2(video_t *video, void (*callback)(void *param, struct video_data *frame),
 				     void *param);
 
+/* Opt-in: inputs connected after this call get their own thread and a small
+ * frame queue, so scaling and raw encoding for different inputs run
+ * concurrently.  An input that falls behind skips frames on its own instead
+ * of delaying the others. */
+EXPORT void video_output_set_parallel_inputs(video_t *video, bool parallel);
+
 EXPORT bool video_output_active(const video_t *video);
 
 EXPORT const struct video_output_info *video_output_get_info(const video_t *video);
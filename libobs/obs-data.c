@@ -27,7 +27,9 @@
 #include "graphics/quat.h"
 #include "obs-data.h"
 
-#include <jansson.h>
+#include <errno.h>
+#include <locale.h>
+#include <math.h>
 
 struct obs_data_item {
 	volatile long ref;
@@ -439,148 +441,764 @@ static inline void obs_data_item_set_autoselect_data(struct obs_data_item **p_it
 }
 
 /* ------------------------------------------------------------------------- */
+/* JSON reading, builds the obs_data tree directly in a single pass */
+
+#define JSON_MAX_DEPTH 2048
+
+struct json_reader {
+	const char *start;
+	const char *pos;
+	struct dstr key;
+	struct dstr str;
+	size_t depth;
+	const char *error;
+	const char *error_pos;
+};
+
+static struct obs_data_item *get_item(struct obs_data *data, const char *name);
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key, json_t *json);
+static bool json_fail(struct json_reader *r, const char *error)
+{
+	if (!r->error) {
+		r->error = error;
+		r->error_pos = r->pos;
+	}
+	return false;
+}
+
+static inline void json_skip_ws(struct json_reader *r)
+{
+	while (*r->pos == ' ' || *r->pos == '\t' || *r->pos == '\n' || *r->pos == '\r')
+		r->pos++;
+}
 
-static inline void obs_data_add_json_object_data(obs_data_t *data, json_t *jobj)
+static inline void json_str_reset(struct dstr *str)
 {
-	const char *item_key;
-	json_t *jitem;
+	dstr_ensure_capacity(str, 1);
+	str->array[0] = 0;
+	str->len = 0;
+}
+
+/* returns the length of the UTF-8 sequence at str, or 0 if it is invalid */
+static size_t json_utf8_len(const uint8_t *str)
+{
+	uint32_t cp;
+	size_t len;
+
+	if (str[0] < 0x80)
+		return 1;
+
+	if (str[0] >= 0xC2 && str[0] <= 0xDF) {
+		len = 2;
+		cp = str[0] & 0x1F;
+	} else if (str[0] >= 0xE0 && str[0] <= 0xEF) {
+		len = 3;
+		cp = str[0] & 0x0F;
+	} else if (str[0] >= 0xF0 && str[0] <= 0xF4) {
+		len = 4;
+		cp = str[0] & 0x07;
+	} else {
+		return 0;
+	}
+
+	for (size_t i = 1; i < len; i++) {
+		if ((str[i] & 0xC0) != 0x80)
+			return 0;
+		cp = (cp << 6) | (str[i] & 0x3F);
+	}
+
+	if ((len == 3 && cp < 0x800) || (len == 4 && cp < 0x10000) || (cp >= 0xD800 && cp <= 0xDFFF) ||
+	    cp > 0x10FFFF)
+		return 0;
+
+	return len;
+}
+
+static void json_cat_utf8(struct dstr *str, uint32_t cp)
+{
+	char buf[4];
+	size_t len;
+
+	if (cp < 0x80) {
+		buf[0] = (char)cp;
+		len = 1;
+	} else if (cp < 0x800) {
+		buf[0] = (char)(0xC0 | (cp >> 6));
+		buf[1] = (char)(0x80 | (cp & 0x3F));
+		len = 2;
+	} else if (cp < 0x10000) {
+		buf[0] = (char)(0xE0 | (cp >> 12));
+		buf[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		buf[2] = (char)(0x80 | (cp & 0x3F));
+		len = 3;
+	} else {
+		buf[0] = (char)(0xF0 | (cp >> 18));
+		buf[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+		buf[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		buf[3] = (char)(0x80 | (cp & 0x3F));
+		len = 4;
+	}
+
+	dstr_ncat(str, buf, len);
+}
+
+static bool json_read_hex4(struct json_reader *r, uint32_t *val)
+{
+	*val = 0;
+
+	for (size_t i = 0; i < 4; i++) {
+		char c = r->pos[i];
 
-	json_object_foreach (jobj, item_key, jitem) {
-		obs_data_add_json_item(data, item_key, jitem);
+		if (c >= '0' && c <= '9')
+			*val = (*val << 4) | (uint32_t)(c - '0');
+		else if (c >= 'a' && c <= 'f')
+			*val = (*val << 4) | (uint32_t)(c - 'a' + 10);
+		else if (c >= 'A' && c <= 'F')
+			*val = (*val << 4) | (uint32_t)(c - 'A' + 10);
+		else
+			return json_fail(r, "invalid \\u escape");
 	}
+
+	r->pos += 4;
+	return true;
 }
 
-static inline void obs_data_add_json_object(obs_data_t *data, const char *key, json_t *jobj)
+static bool json_read_unicode_escape(struct json_reader *r, struct dstr *out)
 {
-	obs_data_t *sub_obj = obs_data_create();
+	uint32_t cp;
+
+	if (!json_read_hex4(r, &cp))
+		return false;
+
+	if (cp >= 0xD800 && cp <= 0xDBFF) {
+		uint32_t low;
+
+		if (r->pos[0] != '\\' || r->pos[1] != 'u')
+			return json_fail(r, "invalid Unicode surrogate pair");
+
+		r->pos += 2;
+		if (!json_read_hex4(r, &low))
+			return false;
+		if (low < 0xDC00 || low > 0xDFFF)
+			return json_fail(r, "invalid Unicode surrogate pair");
+
+		cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+
+	} else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+		return json_fail(r, "invalid Unicode surrogate pair");
 
-	obs_data_add_json_object_data(sub_obj, jobj);
-	obs_data_set_obj(data, key, sub_obj);
-	obs_data_release(sub_obj);
+	} else if (!cp) {
+		return json_fail(r, "\\u0000 is not allowed");
+	}
+
+	json_cat_utf8(out, cp);
+	return true;
 }
 
-static void obs_data_add_json_array(obs_data_t *data, const char *key, json_t *jarray)
+static bool json_read_string(struct json_reader *r, struct dstr *out)
 {
-	obs_data_array_t *array = obs_data_array_create();
-	size_t idx;
-	json_t *jitem;
+	json_str_reset(out);
+	r->pos++;
+
+	for (;;) {
+		const char *run = r->pos;
 
-	json_array_foreach (jarray, idx, jitem) {
-		obs_data_t *item;
+		while ((uint8_t)*r->pos >= 0x20 && *r->pos != '"' && *r->pos != '\\') {
+			size_t len = json_utf8_len((const uint8_t *)r->pos);
+			if (!len)
+				return json_fail(r, "invalid UTF-8 in string");
+			r->pos += len;
+		}
+
+		if (r->pos != run)
+			dstr_ncat(out, run, (size_t)(r->pos - run));
 
-		if (!json_is_object(jitem))
+		if (*r->pos == '"') {
+			r->pos++;
+			return true;
+		}
+		if (*r->pos != '\\')
+			return json_fail(r, *r->pos ? "control character in string" : "premature end of input");
+
+		r->pos++;
+
+		switch (*r->pos) {
+		case '"':
+		case '\\':
+		case '/':
+			dstr_cat_ch(out, *r->pos);
+			break;
+		case 'b':
+			dstr_cat_ch(out, '\b');
+			break;
+		case 'f':
+			dstr_cat_ch(out, '\f');
+			break;
+		case 'n':
+			dstr_cat_ch(out, '\n');
+			break;
+		case 'r':
+			dstr_cat_ch(out, '\r');
+			break;
+		case 't':
+			dstr_cat_ch(out, '\t');
+			break;
+		case 'u':
+			r->pos++;
+			if (!json_read_unicode_escape(r, out))
+				return false;
 			continue;
+		default:
+			return json_fail(r, "invalid escape");
+		}
 
-		item = obs_data_create();
-		obs_data_add_json_object_data(item, jitem);
-		obs_data_array_push_back(array, item);
-		obs_data_release(item);
+		r->pos++;
 	}
+}
 
-	obs_data_set_array(data, key, array);
-	obs_data_array_release(array);
+static inline bool json_is_digit(char c)
+{
+	return c >= '0' && c <= '9';
 }
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key, json_t *json)
+static bool json_read_number(struct json_reader *r, struct obs_data_number *num)
 {
-	if (json_is_object(json))
-		obs_data_add_json_object(data, key, json);
-	else if (json_is_array(json))
-		obs_data_add_json_array(data, key, json);
-	else if (json_is_string(json))
-		obs_data_set_string(data, key, json_string_value(json));
-	else if (json_is_integer(json))
-		obs_data_set_int(data, key, json_integer_value(json));
-	else if (json_is_real(json))
-		obs_data_set_double(data, key, json_real_value(json));
-	else if (json_is_true(json))
-		obs_data_set_bool(data, key, true);
-	else if (json_is_false(json))
-		obs_data_set_bool(data, key, false);
+	const char *start = r->pos;
+	bool real = false;
+
+	if (*r->pos == '-')
+		r->pos++;
+
+	if (*r->pos == '0') {
+		r->pos++;
+	} else if (json_is_digit(*r->pos)) {
+		while (json_is_digit(*r->pos))
+			r->pos++;
+	} else {
+		return json_fail(r, "invalid number");
+	}
+
+	if (*r->pos == '.') {
+		real = true;
+		r->pos++;
+		if (!json_is_digit(*r->pos))
+			return json_fail(r, "invalid number");
+		while (json_is_digit(*r->pos))
+			r->pos++;
+	}
+
+	if (*r->pos == 'e' || *r->pos == 'E') {
+		real = true;
+		r->pos++;
+		if (*r->pos == '+' || *r->pos == '-')
+			r->pos++;
+		if (!json_is_digit(*r->pos))
+			return json_fail(r, "invalid number");
+		while (json_is_digit(*r->pos))
+			r->pos++;
+	}
+
+	dstr_ncopy(&r->str, start, (size_t)(r->pos - start));
+	errno = 0;
+
+	if (!real) {
+		num->type = OBS_DATA_NUM_INT;
+		num->int_val = strtoll(r->str.array, NULL, 10);
+		if (errno == ERANGE)
+			return json_fail(r, "integer out of range");
+		return true;
+	}
+
+	/* strtod follows the locale's decimal point */
+	const char *point = localeconv()->decimal_point;
+	if (*point != '.') {
+		char *dot = strchr(r->str.array, '.');
+		if (dot)
+			*dot = *point;
+	}
+
+	num->type = OBS_DATA_NUM_DOUBLE;
+	num->double_val = strtod(r->str.array, NULL);
+	if (errno == ERANGE && isinf(num->double_val))
+		return json_fail(r, "real number overflow");
+	return true;
 }
 
-/* ------------------------------------------------------------------------- */
+static bool json_read_literal(struct json_reader *r, const char *literal, size_t len)
+{
+	if (strncmp(r->pos, literal, len) != 0)
+		return json_fail(r, "invalid token");
+
+	r->pos += len;
+	return true;
+}
+
+static bool json_read_object(struct json_reader *r, obs_data_t *obj);
+static bool json_read_array(struct json_reader *r, obs_data_array_t *array);
 
-static inline void set_json_string(json_t *json, const char *name, obs_data_item_t *item)
+/* reads a value and stores it in obj under key, values without an obj (array
+ * elements that are not objects) are only validated */
+static bool json_read_value(struct json_reader *r, obs_data_t *obj, const char *key)
 {
-	const char *val = obs_data_item_get_string(item);
-	json_object_set_new(json, name, json_string(val));
+	struct obs_data_number num;
+	bool success;
+
+	switch (*r->pos) {
+	case '{': {
+		obs_data_t *sub = obs_data_create();
+		if (obj)
+			obs_data_set_obj(obj, key, sub);
+		success = json_read_object(r, sub);
+		obs_data_release(sub);
+		return success;
+	}
+	case '[': {
+		obs_data_array_t *array = obs_data_array_create();
+		if (obj)
+			obs_data_set_array(obj, key, array);
+		success = json_read_array(r, array);
+		obs_data_array_release(array);
+		return success;
+	}
+	case '"':
+		if (!json_read_string(r, &r->str))
+			return false;
+		if (obj)
+			obs_data_set_string(obj, key, r->str.array);
+		return true;
+	case 't':
+		if (!json_read_literal(r, "true", 4))
+			return false;
+		if (obj)
+			obs_data_set_bool(obj, key, true);
+		return true;
+	case 'f':
+		if (!json_read_literal(r, "false", 5))
+			return false;
+		if (obj)
+			obs_data_set_bool(obj, key, false);
+		return true;
+	case 'n':
+		/* null values are left out */
+		return json_read_literal(r, "null", 4);
+	}
+
+	if (*r->pos != '-' && !json_is_digit(*r->pos))
+		return json_fail(r, *r->pos ? "invalid token" : "premature end of input");
+
+	if (!json_read_number(r, &num))
+		return false;
+
+	if (obj) {
+		if (num.type == OBS_DATA_NUM_INT)
+			obs_data_set_int(obj, key, num.int_val);
+		else
+			obs_data_set_double(obj, key, num.double_val);
+	}
+	return true;
 }
 
-static inline void set_json_number(json_t *json, const char *name, obs_data_item_t *item)
+static bool json_read_object(struct json_reader *r, obs_data_t *obj)
 {
-	enum obs_data_number_type type = obs_data_item_numtype(item);
+	if (++r->depth > JSON_MAX_DEPTH)
+		return json_fail(r, "maximum parsing depth reached");
 
-	if (type == OBS_DATA_NUM_INT) {
-		long long val = obs_data_item_get_int(item);
-		json_object_set_new(json, name, json_integer(val));
-	} else {
-		double val = obs_data_item_get_double(item);
-		json_object_set_new(json, name, json_real(val));
+	r->pos++;
+	json_skip_ws(r);
+
+	if (*r->pos == '}') {
+		r->pos++;
+		r->depth--;
+		return true;
+	}
+
+	for (;;) {
+		if (*r->pos != '"')
+			return json_fail(r, "string or '}' expected");
+		if (!json_read_string(r, &r->key))
+			return false;
+		if (get_item(obj, r->key.array))
+			return json_fail(r, "duplicate object key");
+
+		json_skip_ws(r);
+		if (*r->pos != ':')
+			return json_fail(r, "':' expected");
+
+		r->pos++;
+		json_skip_ws(r);
+
+		if (!json_read_value(r, obj, r->key.array))
+			return false;
+
+		json_skip_ws(r);
+		if (*r->pos == '}')
+			break;
+		if (*r->pos != ',')
+			return json_fail(r, "'}' or ',' expected");
+
+		r->pos++;
+		json_skip_ws(r);
 	}
+
+	r->pos++;
+	r->depth--;
+	return true;
 }
 
-static inline void set_json_bool(json_t *json, const char *name, obs_data_item_t *item)
+static bool json_read_array(struct json_reader *r, obs_data_array_t *array)
 {
-	bool val = obs_data_item_get_bool(item);
-	json_object_set_new(json, name, val ? json_true() : json_false());
+	if (++r->depth > JSON_MAX_DEPTH)
+		return json_fail(r, "maximum parsing depth reached");
+
+	r->pos++;
+	json_skip_ws(r);
+
+	if (*r->pos == ']') {
+		r->pos++;
+		r->depth--;
+		return true;
+	}
+
+	for (;;) {
+		/* only objects can be array elements */
+		if (*r->pos == '{') {
+			obs_data_t *item = obs_data_create();
+			bool success = json_read_object(r, item);
+
+			if (success)
+				obs_data_array_push_back(array, item);
+			obs_data_release(item);
+
+			if (!success)
+				return false;
+
+		} else if (!json_read_value(r, NULL, NULL)) {
+			return false;
+		}
+
+		json_skip_ws(r);
+		if (*r->pos == ']')
+			break;
+		if (*r->pos != ',')
+			return json_fail(r, "']' or ',' expected");
+
+		r->pos++;
+		json_skip_ws(r);
+	}
+
+	r->pos++;
+	r->depth--;
+	return true;
 }
 
-static json_t *obs_data_to_json(obs_data_t *data, bool with_defaults);
+static bool json_read_root(struct json_reader *r, obs_data_t *data)
+{
+	bool success;
+
+	json_skip_ws(r);
+
+	if (*r->pos == '{')
+		success = json_read_object(r, data);
+	else if (*r->pos == '[')
+		success = json_read_value(r, NULL, NULL);
+	else
+		return json_fail(r, "'[' or '{' expected");
+
+	if (!success)
+		return false;
+
+	json_skip_ws(r);
+	return *r->pos ? json_fail(r, "end of file expected") : true;
+}
 
-static inline void set_json_obj(json_t *json, const char *name, obs_data_item_t *item, bool with_defaults)
+static void json_get_error_location(struct json_reader *r, size_t *line, size_t *column)
 {
-	obs_data_t *obj = obs_data_item_get_obj(item);
-	json_object_set_new(json, name, obs_data_to_json(obj, with_defaults));
-	obs_data_release(obj);
+	*line = 1;
+	*column = 1;
+
+	for (const char *pos = r->start; pos < r->error_pos; pos++) {
+		if (*pos == '\n') {
+			(*line)++;
+			*column = 1;
+		} else {
+			(*column)++;
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* JSON writing, streams text straight out of the obs_data tree */
+
+#define JSON_FLUSH_SIZE (64 * 1024)
+
+struct json_writer {
+	struct dstr out;
+	FILE *file;
+	bool pretty;
+	bool with_defaults;
+	bool failed;
+};
+
+static void json_flush(struct json_writer *w)
+{
+	if (!w->file || !w->out.len)
+		return;
+
+	if (!w->failed && fwrite(w->out.array, w->out.len, 1, w->file) != 1)
+		w->failed = true;
+
+	w->out.array[0] = 0;
+	w->out.len = 0;
+}
+
+static inline void json_write(struct json_writer *w, const char *str, size_t len)
+{
+	if (len)
+		dstr_ncat(&w->out, str, len);
+}
+
+static void json_write_indent(struct json_writer *w, size_t depth)
+{
+	if (!w->pretty)
+		return;
+
+	dstr_cat_ch(&w->out, '\n');
+	for (size_t i = 0; i < depth * 4; i++)
+		dstr_cat_ch(&w->out, ' ');
+}
+
+static bool json_utf8_valid(const char *str)
+{
+	while (*str) {
+		size_t len = json_utf8_len((const uint8_t *)str);
+		if (!len)
+			return false;
+		str += len;
+	}
+
+	return true;
+}
+
+static void json_write_string(struct json_writer *w, const char *str)
+{
+	const char *run = str;
+
+	dstr_cat_ch(&w->out, '"');
+
+	for (; *str; str++) {
+		uint8_t c = (uint8_t)*str;
+		char seq[8];
+		const char *escape = seq;
+
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		json_write(w, run, (size_t)(str - run));
+		run = str + 1;
+
+		switch (c) {
+		case '"':
+			escape = "\\\"";
+			break;
+		case '\\':
+			escape = "\\\\";
+			break;
+		case '\b':
+			escape = "\\b";
+			break;
+		case '\f':
+			escape = "\\f";
+			break;
+		case '\n':
+			escape = "\\n";
+			break;
+		case '\r':
+			escape = "\\r";
+			break;
+		case '\t':
+			escape = "\\t";
+			break;
+		default:
+			snprintf(seq, sizeof(seq), "\\u%04X", c);
+		}
+
+		dstr_cat(&w->out, escape);
+	}
+
+	json_write(w, run, (size_t)(str - run));
+	dstr_cat_ch(&w->out, '"');
+}
+
+/* items that can't be represented in JSON are left out, like invalid UTF-8
+ * or non-finite numbers */
+static bool json_item_writable(struct json_writer *w, obs_data_item_t *item)
+{
+	enum obs_data_type type = obs_data_item_gettype(item);
+
+	if (!w->with_defaults && !obs_data_item_has_user_value(item))
+		return false;
+	if (!json_utf8_valid(get_item_name(item)))
+		return false;
+
+	switch (type) {
+	case OBS_DATA_STRING:
+		return json_utf8_valid(obs_data_item_get_string(item));
+	case OBS_DATA_NUMBER:
+		return obs_data_item_numtype(item) == OBS_DATA_NUM_INT || isfinite(obs_data_item_get_double(item));
+	case OBS_DATA_BOOLEAN:
+	case OBS_DATA_OBJECT:
+	case OBS_DATA_ARRAY:
+		return true;
+	default:
+		return false;
+	}
 }
 
-static inline void set_json_array(json_t *json, const char *name, obs_data_item_t *item, bool with_defaults)
+static void json_write_obj(struct json_writer *w, obs_data_t *data, size_t depth);
+
+static void json_write_array(struct json_writer *w, obs_data_array_t *array, size_t depth)
 {
-	json_t *jarray = json_array();
-	obs_data_array_t *array = obs_data_item_get_array(item);
 	size_t count = obs_data_array_count(array);
 
+	dstr_cat_ch(&w->out, '[');
+
 	for (size_t idx = 0; idx < count; idx++) {
 		obs_data_t *sub_item = obs_data_array_item(array, idx);
-		json_t *jitem = obs_data_to_json(sub_item, with_defaults);
-		json_array_append_new(jarray, jitem);
+
+		if (idx)
+			dstr_cat_ch(&w->out, ',');
+		json_write_indent(w, depth + 1);
+		json_write_obj(w, sub_item, depth + 1);
+
 		obs_data_release(sub_item);
 	}
 
-	json_object_set_new(json, name, jarray);
-	obs_data_array_release(array);
+	if (count)
+		json_write_indent(w, depth);
+	dstr_cat_ch(&w->out, ']');
 }
 
-static json_t *obs_data_to_json(obs_data_t *data, bool with_defaults)
+static void json_write_item(struct json_writer *w, obs_data_item_t *item, size_t depth)
 {
-	json_t *json = json_object();
+	enum obs_data_type type = obs_data_item_gettype(item);
+	char buf[64];
+
+	json_write_string(w, get_item_name(item));
+	json_write(w, w->pretty ? ": " : ":", w->pretty ? 2 : 1);
+
+	if (type == OBS_DATA_STRING) {
+		json_write_string(w, obs_data_item_get_string(item));
 
+	} else if (type == OBS_DATA_NUMBER) {
+		int len;
+
+		if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT)
+			len = snprintf(buf, sizeof(buf), "%lld", obs_data_item_get_int(item));
+		else
+			len = os_dtostr(obs_data_item_get_double(item), buf, sizeof(buf));
+
+		json_write(w, buf, len > 0 ? (size_t)len : 0);
+
+	} else if (type == OBS_DATA_BOOLEAN) {
+		dstr_cat(&w->out, obs_data_item_get_bool(item) ? "true" : "false");
+
+	} else if (type == OBS_DATA_OBJECT) {
+		obs_data_t *obj = obs_data_item_get_obj(item);
+		json_write_obj(w, obj, depth);
+		obs_data_release(obj);
+
+	} else if (type == OBS_DATA_ARRAY) {
+		obs_data_array_t *array = obs_data_item_get_array(item);
+		json_write_array(w, array, depth);
+		obs_data_array_release(array);
+	}
+}
+
+static void json_write_obj(struct json_writer *w, obs_data_t *data, size_t depth)
+{
 	obs_data_item_t *item = NULL;
 	obs_data_item_t *temp = NULL;
+	bool first = true;
 
-	HASH_ITER (hh, data->items, item, temp) {
-		enum obs_data_type type = obs_data_item_gettype(item);
-		const char *name = get_item_name(item);
+	dstr_cat_ch(&w->out, '{');
 
-		if (!with_defaults && !obs_data_item_has_user_value(item))
-			continue;
+	if (data) {
+		HASH_ITER (hh, data->items, item, temp) {
+			if (!json_item_writable(w, item))
+				continue;
 
-		if (type == OBS_DATA_STRING)
-			set_json_string(json, name, item);
-		else if (type == OBS_DATA_NUMBER)
-			set_json_number(json, name, item);
-		else if (type == OBS_DATA_BOOLEAN)
-			set_json_bool(json, name, item);
-		else if (type == OBS_DATA_OBJECT)
-			set_json_obj(json, name, item, with_defaults);
-		else if (type == OBS_DATA_ARRAY)
-			set_json_array(json, name, item, with_defaults);
+			if (!first)
+				dstr_cat_ch(&w->out, ',');
+			json_write_indent(w, depth + 1);
+			json_write_item(w, item, depth + 1);
+			first = false;
+
+			if (w->file && w->out.len >= JSON_FLUSH_SIZE)
+				json_flush(w);
+		}
 	}
 
-	return json;
+	if (!first)
+		json_write_indent(w, depth);
+	dstr_cat_ch(&w->out, '}');
+}
+
+static bool json_write_file(obs_data_t *data, const char *file, bool pretty)
+{
+	struct json_writer w = {.pretty = pretty};
+
+	w.file = os_fopen(file, "wb");
+	if (!w.file)
+		return false;
+
+	json_write_obj(&w, data, 0);
+	json_flush(&w);
+	dstr_free(&w.out);
+
+	if (fflush(w.file) != 0)
+		w.failed = true;
+	fclose(w.file);
+
+	return !w.failed;
+}
+
+static bool json_write_file_safe(obs_data_t *data, const char *file, bool pretty, const char *temp_ext,
+				 const char *backup_ext)
+{
+	struct dstr backup_path = {0};
+	struct dstr temp_path = {0};
+	bool success = false;
+
+	if (!temp_ext || !*temp_ext) {
+		blog(LOG_ERROR, "obs-data.c: [json_write_file_safe] invalid "
+				"temporary extension specified");
+		return false;
+	}
+
+	dstr_copy(&temp_path, file);
+	if (*temp_ext != '.')
+		dstr_cat(&temp_path, ".");
+	dstr_cat(&temp_path, temp_ext);
+
+	if (!json_write_file(data, temp_path.array, pretty)) {
+		blog(LOG_ERROR, "obs-data.c: [json_write_file_safe] failed to write to %s", temp_path.array);
+		goto cleanup;
+	}
+
+	if (backup_ext && *backup_ext) {
+		dstr_copy(&backup_path, file);
+		if (*backup_ext != '.')
+			dstr_cat(&backup_path, ".");
+		dstr_cat(&backup_path, backup_ext);
+	}
+
+	if (os_safe_replace(file, temp_path.array, backup_path.array) == 0)
+		success = true;
+
+cleanup:
+	dstr_free(&backup_path);
+	dstr_free(&temp_path);
+	return success;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -595,23 +1213,29 @@ obs_data_t *obs_data_create()
 
 obs_data_t *obs_data_create_from_json(const char *json_string)
 {
+	if (!json_string) {
+		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_json] "
+				"NULL json string");
+		return NULL;
+	}
+
+	struct json_reader r = {.start = json_string, .pos = json_string};
 	obs_data_t *data = obs_data_create();
 
-	json_error_t error;
-	json_t *root = json_loads(json_string, JSON_REJECT_DUPLICATES, &error);
+	if (!json_read_root(&r, data)) {
+		size_t line, column;
+		json_get_error_location(&r, &line, &column);
 
-	if (root) {
-		obs_data_add_json_object_data(data, root);
-		json_decref(root);
-	} else {
 		blog(LOG_ERROR,
 		     "obs-data.c: [obs_data_create_from_json] "
-		     "Failed reading json string (%d): %s",
-		     error.line, error.text);
+		     "Failed reading json string (%zu:%zu): %s",
+		     line, column, r.error);
 		obs_data_release(data);
 		data = NULL;
 	}
 
+	dstr_free(&r.key);
+	dstr_free(&r.str);
 	return data;
 }
 
@@ -672,8 +1296,7 @@ static inline void obs_data_destroy(struct obs_data *data)
 		obs_data_item_release(&item);
 	}
 
-	/* NOTE: don't use bfree for json text, allocated by json */
-	free(data->json);
+	bfree(data->json);
 	bfree(data);
 }
 
@@ -691,20 +1314,13 @@ static const char *obs_data_get_json_internal(obs_data_t *data, bool pretty, boo
 	if (!data)
 		return NULL;
 
-	size_t flags = JSON_PRESERVE_ORDER;
-
-	if (pretty)
-		flags |= JSON_INDENT(4);
-	else
-		flags |= JSON_COMPACT;
+	struct json_writer w = {.pretty = pretty, .with_defaults = with_defaults};
 
-	/* NOTE: don't use libobs bfree for json text */
-	free(data->json);
+	bfree(data->json);
 	data->json = NULL;
 
-	json_t *root = obs_data_to_json(data, with_defaults);
-	data->json = json_dumps(root, flags);
-	json_decref(root);
+	json_write_obj(&w, data, 0);
+	data->json = w.out.array;
 
 	return data->json;
 }
@@ -736,35 +1352,17 @@ const char *obs_data_get_last_json(obs_data_t *data)
 
 bool obs_data_save_json(obs_data_t *data, const char *file)
 {
-	const char *json = obs_data_get_json(data);
-
-	if (json && *json) {
-		return os_quick_write_utf8_file(file, json, strlen(json), false);
-	}
-
-	return false;
+	return data ? json_write_file(data, file, false) : false;
 }
 
 bool obs_data_save_json_safe(obs_data_t *data, const char *file, const char *temp_ext, const char *backup_ext)
 {
-	const char *json = obs_data_get_json(data);
-
-	if (json && *json) {
-		return os_quick_write_utf8_file_safe(file, json, strlen(json), false, temp_ext, backup_ext);
-	}
-
-	return false;
+	return data ? json_write_file_safe(data, file, false, temp_ext, backup_ext) : false;
 }
 
 bool obs_data_save_json_pretty_safe(obs_data_t *data, const char *file, const char *temp_ext, const char *backup_ext)
 {
-	const char *json = obs_data_get_json_pretty(data);
-
-	if (json && *json) {
-		return os_quick_write_utf8_file_safe(file, json, strlen(json), false, temp_ext, backup_ext);
-	}
-
-	return false;
+	return data ? json_write_file_safe(data, file, true, temp_ext, backup_ext) : false;
 }
 
 static void get_defaults_array_cb(obs_data_t *data, void *vp)
@@ -1291,10 +1291,41 @@ void full_stop(struct obs_encoder *encoder)
 	}
 }
 
+static inline void release_pooled_packet_data(struct obs_encoder *encoder)
+{
+	struct encoder_packet pkt = {.data = encoder->pooled_packet_data};
+
+	obs_encoder_packet_release(&pkt);
+	encoder->pooled_packet_data = NULL;
+}
+
+/* moves the payload into the pool unless the encoder already wrote it there,
+ * outputs then take references instead of copying it each */
+static void pool_packet_data(struct obs_encoder *encoder, struct encoder_packet *pkt)
+{
+	uint8_t *data;
+
+	if (pkt->data && pkt->data == encoder->pooled_packet_data) {
+		packet_pool_count_payload(true);
+		return;
+	}
+
+	release_pooled_packet_data(encoder);
+
+	data = packet_pool_alloc(pkt->size);
+	if (pkt->size)
+		memcpy(data, pkt->data, pkt->size);
+
+	pkt->data = data;
+	encoder->pooled_packet_data = data;
+	packet_pool_count_payload(false);
+}
+
 void send_off_encoder_packet(obs_encoder_t *encoder, bool success, bool received, struct encoder_packet *pkt)
 {
 	if (!success) {
 		blog(LOG_ERROR, "Error encoding with encoder '%s'", encoder->context.name);
+		release_pooled_packet_data(encoder);
 		full_stop(encoder);
 		return;
 	}
@@ -1336,6 +1367,8 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success, bool received
 				     pkt->pts);
 		}
 
+		pool_packet_data(encoder, pkt);
+
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
 		for (size_t i = encoder->callbacks.num; i > 0; i--) {
@@ -1350,6 +1383,8 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success, bool received
 		if (pkt->type == OBS_ENCODER_VIDEO)
 			encoder->encoded_frames++;
 	}
+
+	release_pooled_packet_data(encoder);
 }
 
 static const char *do_encode_name = "do_encode";
@@ -1739,12 +1774,16 @@ void obs_encoder_remove_output(struct obs_encoder *encoder, struct obs_output *o
 
 void obs_encoder_packet_create_instance(struct encoder_packet *dst, const struct encoder_packet *src)
 {
-	long *p_refs;
-
 	*dst = *src;
-	p_refs = bmalloc(src->size + sizeof(long));
-	dst->data = (void *)(p_refs + 1);
-	*p_refs = 1;
+
+	/* pooled by send_off_encoder_packet, shared between all outputs */
+	if (src->encoder && src->data && src->data == src->encoder->pooled_packet_data) {
+		long *p_refs = ((long *)src->data) - 1;
+		os_atomic_inc_long(p_refs);
+		return;
+	}
+
+	dst->data = packet_pool_alloc(src->size);
 	memcpy(dst->data, src->data, src->size);
 }
 
@@ -1768,13 +1807,30 @@ void obs_encoder_packet_release(struct encoder_packet *pkt)
 
 	if (pkt->data) {
 		long *p_refs = ((long *)pkt->data) - 1;
-		if (os_atomic_dec_long(p_refs) == 0)
+		long refs = os_atomic_dec_long(p_refs);
+
+		if (refs == PACKET_POOL_REF_FLAG)
+			packet_pool_release(p_refs);
+		else if (refs == 0)
 			bfree(p_refs);
 	}
 
 	memset(pkt, 0, sizeof(struct encoder_packet));
 }
 
+uint8_t *obs_encoder_packet_alloc(obs_encoder_t *encoder, struct encoder_packet *packet, size_t size)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_packet_alloc") || !packet)
+		return NULL;
+
+	release_pooled_packet_data(encoder);
+
+	encoder->pooled_packet_data = packet_pool_alloc(size);
+	packet->data = encoder->pooled_packet_data;
+	packet->size = size;
+	return packet->data;
+}
+
 void obs_encoder_set_preferred_video_format(obs_encoder_t *encoder, enum video_format format)
 {
 	if (!encoder || encoder->info.type != OBS_ENCODER_VIDEO)
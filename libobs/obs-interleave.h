@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include "obs.h"
+#include "util/deque.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_INTERLEAVE_TRACKS (MAX_OUTPUT_VIDEO_ENCODERS + MAX_OUTPUT_AUDIO_ENCODERS)
+
+/* Interleave queue used once an output has started.
+ *
+ * Encoders emit packets with monotonic dts per track, so each track only
+ * needs a FIFO.  The tracks are merged with a binary min-heap of the tracks
+ * that currently hold packets, keyed on their first packet, which makes both
+ * push and pop O(log tracks) regardless of how many packets are buffered. */
+struct interleave_queue {
+	struct deque tracks[MAX_INTERLEAVE_TRACKS];
+	uint8_t heap[MAX_INTERLEAVE_TRACKS];
+	size_t heap_size;
+	size_t num_packets;
+};
+
+static inline size_t interleave_track_slot(const struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO ? packet->track_idx : MAX_OUTPUT_VIDEO_ENCODERS + packet->track_idx;
+}
+
+/* sorts by dts, video before audio at the same dts, and video tracks with the
+ * same dts by track index (same rules as insert_interleaved_packet) */
+static inline bool interleave_packet_before(const struct encoder_packet *a, const struct encoder_packet *b)
+{
+	if (a->dts_usec != b->dts_usec)
+		return a->dts_usec < b->dts_usec;
+	if (a->type != b->type)
+		return a->type == OBS_ENCODER_VIDEO;
+	return a->track_idx < b->track_idx;
+}
+
+static inline struct encoder_packet *interleave_track_front(struct interleave_queue *iq, size_t slot)
+{
+	return (struct encoder_packet *)deque_data(&iq->tracks[slot], 0);
+}
+
+static inline bool interleave_heap_before(struct interleave_queue *iq, size_t a, size_t b)
+{
+	return interleave_packet_before(interleave_track_front(iq, iq->heap[a]), interleave_track_front(iq, iq->heap[b]));
+}
+
+static inline void interleave_heap_swap(struct interleave_queue *iq, size_t a, size_t b)
+{
+	uint8_t slot = iq->heap[a];
+	iq->heap[a] = iq->heap[b];
+	iq->heap[b] = slot;
+}
+
+static inline void interleave_heap_sift_up(struct interleave_queue *iq, size_t pos)
+{
+	while (pos > 0) {
+		size_t parent = (pos - 1) / 2;
+		if (!interleave_heap_before(iq, pos, parent))
+			break;
+
+		interleave_heap_swap(iq, pos, parent);
+		pos = parent;
+	}
+}
+
+static inline void interleave_heap_sift_down(struct interleave_queue *iq, size_t pos)
+{
+	for (;;) {
+		size_t left = pos * 2 + 1;
+		size_t right = left + 1;
+		size_t first = pos;
+
+		if (left < iq->heap_size && interleave_heap_before(iq, left, first))
+			first = left;
+		if (right < iq->heap_size && interleave_heap_before(iq, right, first))
+			first = right;
+		if (first == pos)
+			break;
+
+		interleave_heap_swap(iq, pos, first);
+		pos = first;
+	}
+}
+
+static inline void interleave_queue_push(struct interleave_queue *iq, const struct encoder_packet *packet)
+{
+	size_t slot = interleave_track_slot(packet);
+	struct deque *track = &iq->tracks[slot];
+	bool was_empty = track->size == 0;
+
+	deque_push_back(track, packet, sizeof(*packet));
+	iq->num_packets++;
+
+	/* the head of a non-empty track does not change, so the heap only
+	 * needs to know about tracks that just became non-empty */
+	if (was_empty) {
+		iq->heap[iq->heap_size] = (uint8_t)slot;
+		interleave_heap_sift_up(iq, iq->heap_size++);
+	}
+}
+
+static inline struct encoder_packet *interleave_queue_peek(struct interleave_queue *iq)
+{
+	return iq->heap_size ? interleave_track_front(iq, iq->heap[0]) : NULL;
+}
+
+static inline bool interleave_queue_pop(struct interleave_queue *iq, struct encoder_packet *packet)
+{
+	struct deque *track;
+
+	if (!iq->heap_size)
+		return false;
+
+	track = &iq->tracks[iq->heap[0]];
+	deque_pop_front(track, packet, sizeof(*packet));
+	iq->num_packets--;
+
+	if (!track->size)
+		iq->heap[0] = iq->heap[--iq->heap_size];
+	if (iq->heap_size)
+		interleave_heap_sift_down(iq, 0);
+	return true;
+}
+
+/* does not release packets, pop them first if they hold references */
+static inline void interleave_queue_free(struct interleave_queue *iq)
+{
+	for (size_t i = 0; i < MAX_INTERLEAVE_TRACKS; i++)
+		deque_free(&iq->tracks[i]);
+
+	iq->heap_size = 0;
+	iq->num_packets = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
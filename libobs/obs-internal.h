@@ -38,6 +38,7 @@
 #include "media-io/audio-io.h"
 
 #include "obs.h"
+#include "obs-interleave.h"
 
 #include <obsversion.h>
 #include <caption/caption.h>
@@ -501,6 +502,11 @@ struct obs_core {
 	signal_handler_t *signals;
 	proc_handler_t *procs;
 
+	/* emitted for every source update and volume change, so they are
+	 * only looked up once */
+	struct signal_info *source_update_signal;
+	struct signal_info *source_volume_signal;
+
 	char *locale;
 	char *module_config_path;
 	bool name_store_owned;
@@ -513,11 +519,15 @@ struct obs_core {
 	struct obs_core_data data;
 	struct obs_core_hotkeys hotkeys;
 
-	os_task_queue_t *destruction_task_thread;
+	os_task_pool_t *task_pool;
 
 	obs_task_handler_t ui_task_handler;
 };
 
+/* destroy tasks share one affinity key on the worker pool, so they still run
+ * one after another in queue order like on a single destruction thread */
+#define OBS_DESTROY_AFFINITY ((const void *)obs->task_pool)
+
 extern struct obs_core *obs;
 
 struct obs_graphics_context {
@@ -694,6 +704,14 @@ struct async_frame {
 	bool used;
 };
 
+/* frame whose planes belong to the source that output it */
+struct async_lent_frame {
+	struct obs_source_frame *frame;
+	obs_source_frame_release_t release;
+	void *param;
+	bool used;
+};
+
 enum audio_action_type {
 	AUDIO_ACTION_VOL,
 	AUDIO_ACTION_MUTE,
@@ -743,6 +761,18 @@ struct media_action {
 	};
 };
 
+enum media_signal_type {
+	MEDIA_SIGNAL_PLAY,
+	MEDIA_SIGNAL_PAUSE,
+	MEDIA_SIGNAL_RESTART,
+	MEDIA_SIGNAL_STOPPED,
+	MEDIA_SIGNAL_NEXT,
+	MEDIA_SIGNAL_PREVIOUS,
+	MEDIA_SIGNAL_STARTED,
+	MEDIA_SIGNAL_ENDED,
+	MEDIA_SIGNAL_COUNT,
+};
+
 struct obs_source {
 	struct obs_context_data context;
 	struct obs_source_info info;
@@ -758,6 +788,11 @@ struct obs_source {
 	/* signals to call the source update in the video thread */
 	long defer_update_count;
 
+	/* frequently emitted signals, looked up once */
+	struct signal_info *update_signal;
+	struct signal_info *volume_signal;
+	struct signal_info *media_signals[MEDIA_SIGNAL_COUNT];
+
 	/* ensures show/hide are only called once */
 	volatile long show_refs;
 
@@ -848,6 +883,7 @@ struct obs_source {
 	struct obs_source_frame *async_preload_frame;
 	DARRAY(struct async_frame) async_cache;
 	DARRAY(struct obs_source_frame *) async_frames;
+	DARRAY(struct async_lent_frame) async_lent;
 	pthread_mutex_t async_mutex;
 	uint32_t async_width;
 	uint32_t async_height;
@@ -962,6 +998,14 @@ extern obs_source_t *obs_source_create_set_last_ver(obs_canvas_t *canvas, const
 						    const char *uuid, obs_data_t *settings, obs_data_t *hotkey_data,
 						    uint32_t last_obs_ver, bool is_private);
 
+/* source creation split into steps so that loading can run the create
+ * callbacks of several sources at once */
+extern obs_source_t *obs_source_create_deferred(const char *id, const char *name, const char *uuid,
+						obs_data_t *settings, obs_data_t *hotkey_data, uint32_t last_obs_ver,
+						bool is_private);
+extern void obs_source_create_instance(obs_source_t *source);
+extern void obs_source_create_finish(obs_source_t *source, obs_canvas_t *canvas);
+
 extern void obs_source_destroy(struct obs_source *source);
 extern void obs_source_addref(obs_source_t *source);
 
@@ -978,6 +1022,21 @@ static inline void obs_source_dosignal(struct obs_source *source, const char *si
 		signal_handler_signal(source->context.signals, signal_source, &data);
 }
 
+/* same as obs_source_dosignal, for signals that have already been looked up */
+static inline void obs_source_emit(struct obs_source *source, struct signal_info *signal_obs,
+				   struct signal_info *signal_source)
+{
+	struct calldata data;
+	uint8_t stack[128];
+
+	calldata_init_fixed(&data, stack, sizeof(stack));
+	calldata_set_ptr(&data, "source", source);
+	if (signal_obs && !source->context.private)
+		signal_handler_emit(obs->signals, signal_obs, &data);
+	if (signal_source)
+		signal_handler_emit(source->context.signals, signal_source, &data);
+}
+
 static inline void obs_source_dosignal_canvas(struct obs_source *source, struct obs_canvas *canvas,
 					      const char *signal_obs, const char *signal_source)
 {
@@ -1164,7 +1223,12 @@ struct obs_output {
 	pthread_t end_data_capture_thread;
 	os_event_t *stopping_event;
 	pthread_mutex_t interleaved_mutex;
+	/* sorted startup buffer until all tracks have been received and
+	 * their offsets are known, after that (interleave_started) packets go
+	 * through the per-track interleave queue */
 	DARRAY(struct encoder_packet) interleaved_packets;
+	struct interleave_queue interleave_queue;
+	bool interleave_started;
 	int stop_code;
 
 	int reconnect_retry_sec;
@@ -1259,6 +1323,14 @@ extern const struct obs_output_info *find_output(const char *id);
 extern void obs_output_remove_encoder(struct obs_output *output, struct obs_encoder *encoder);
 
 extern void obs_encoder_packet_create_instance(struct encoder_packet *dst, const struct encoder_packet *src);
+
+/* pooled packet payloads, see obs-packet-pool.c */
+#define PACKET_POOL_REF_FLAG (1L << 30)
+
+extern uint8_t *packet_pool_alloc(size_t size);
+extern void packet_pool_release(long *p_refs);
+extern void packet_pool_count_payload(bool zero_copy);
+extern void packet_pool_free(void);
 void obs_output_destroy(obs_output_t *output);
 
 /* ------------------------------------------------------------------------- */
@@ -1370,6 +1442,10 @@ struct obs_encoder {
 
 	DARRAY(struct encoder_packet_time) encoder_packet_times;
 
+	/* payload allocated with obs_encoder_packet_alloc during the current
+	 * encode call, packets pointing to it are passed on without a copy */
+	uint8_t *pooled_packet_data;
+
 	struct pause_data pause;
 
 	const char *profile_encoder_encode_name;
@@ -228,9 +228,16 @@ fail:
 
 static inline void free_packets(struct obs_output *output)
 {
+	struct encoder_packet packet;
+
 	for (size_t i = 0; i < output->interleaved_packets.num; i++)
 		obs_encoder_packet_release(output->interleaved_packets.array + i);
 	da_free(output->interleaved_packets);
+	output->interleave_started = false;
+
+	while (interleave_queue_pop(&output->interleave_queue, &packet))
+		obs_encoder_packet_release(&packet);
+	interleave_queue_free(&output->interleave_queue);
 }
 
 static inline void clear_raw_audio_buffers(obs_output_t *output)
@@ -1646,17 +1653,18 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 
 static inline void send_interleaved(struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	struct encoder_packet *next = interleave_queue_peek(&output->interleave_queue);
+	struct encoder_packet out;
 	struct encoder_packet_time ept_local = {0};
 	bool found_ept = false;
 
 	/* do not send an interleaved packet if there's no packet of the
 	 * opposing type of a higher timestamp in the interleave buffer.
 	 * this ensures that the timestamps are monotonic */
-	if (!has_higher_opposing_ts(output, &out))
+	if (!next || !has_higher_opposing_ts(output, next))
 		return;
 
-	da_erase(output->interleaved_packets, 0);
+	interleave_queue_pop(&output->interleave_queue, &out);
 
 	if (out.type == OBS_ENCODER_VIDEO) {
 		output->total_frames++;
@@ -2022,44 +2030,54 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	return true;
 }
 
+/* whether a packet already in the startup buffer stays in front of a newly
+ * inserted one */
+static inline bool interleaved_packet_stays_before(const struct encoder_packet *cur_packet,
+						   const struct encoder_packet *out)
+{
+	if (out->dts_usec != cur_packet->dts_usec)
+		return cur_packet->dts_usec < out->dts_usec;
+
+	// sort video packets with same DTS by track index,
+	// to prevent the pruning logic from removing additional
+	// video tracks
+	if (out->type == OBS_ENCODER_VIDEO)
+		return cur_packet->type == OBS_ENCODER_VIDEO && out->track_idx > cur_packet->track_idx;
+
+	return true;
+}
+
 static inline void insert_interleaved_packet(struct obs_output *output, struct encoder_packet *out)
 {
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
+	size_t idx = 0;
+	size_t end = output->interleaved_packets.num;
 
-		// sort video packets with same DTS by track index,
-		// to prevent the pruning logic from removing additional
-		// video tracks
-		if (out->dts_usec == cur_packet->dts_usec && out->type == OBS_ENCODER_VIDEO &&
-		    cur_packet->type == OBS_ENCODER_VIDEO && out->track_idx > cur_packet->track_idx)
-			continue;
+	/* the startup buffer is kept sorted, so binary search the insert
+	 * position */
+	while (idx < end) {
+		size_t mid = idx + (end - idx) / 2;
 
-		if (out->dts_usec == cur_packet->dts_usec && out->type == OBS_ENCODER_VIDEO) {
-			break;
-		} else if (out->dts_usec < cur_packet->dts_usec) {
-			break;
-		}
+		if (interleaved_packet_stays_before(output->interleaved_packets.array + mid, out))
+			idx = mid + 1;
+		else
+			end = mid;
 	}
 
 	da_insert(output->interleaved_packets, idx, out);
 }
 
-static void resort_interleaved_packets(struct obs_output *output)
+/* moves the startup buffer into the interleave queue once offsets have been
+ * applied.  offsets are per track, so the order within each track holds */
+static void queue_interleaved_packets(struct obs_output *output)
 {
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0, sizeof(output->interleaved_packets));
-
-	for (size_t i = 0; i < old_array.num; i++) {
-		set_higher_ts(output, &old_array.array[i]);
+	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
+		set_higher_ts(output, &output->interleaved_packets.array[i]);
 
-		insert_interleaved_packet(output, &old_array.array[i]);
+		interleave_queue_push(&output->interleave_queue, &output->interleaved_packets.array[i]);
 	}
 
-	da_free(old_array);
+	da_free(output->interleaved_packets);
+	output->interleave_started = true;
 }
 
 static void discard_unused_audio_packets(struct obs_output *output, int64_t dts_usec)
@@ -2178,15 +2196,12 @@ static void interleave_packets(void *data, struct encoder_packet *packet, struct
 		return;
 	}
 
-	received_video = true;
-	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
-		if (output->video_encoders[i])
-			received_video = received_video && output->received_video[i];
-	}
-
 	check_encoder_group_keyframe_alignment(output, packet);
 
-	was_started = output->received_audio && received_video;
+	/* all tracks may have been received while the startup buffer could
+	 * not be initialized yet, packets keep going into the buffer until it
+	 * has been moved into the interleave queue */
+	was_started = output->interleave_started;
 
 	if (output->active_delay_ns)
 		out = *packet;
@@ -2203,7 +2218,10 @@ static void interleave_packets(void *data, struct encoder_packet *packet, struct
 	else
 		check_received(output, packet);
 
-	insert_interleaved_packet(output, &out);
+	if (was_started)
+		interleave_queue_push(&output->interleave_queue, &out);
+	else
+		insert_interleaved_packet(output, &out);
 
 	received_video = true;
 	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
@@ -2217,7 +2235,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet, struct
 		if (!was_started) {
 			if (prune_interleaved_packets(output)) {
 				if (initialize_interleaved_packets(output)) {
-					resort_interleaved_packets(output);
+					queue_interleaved_packets(output);
 					apply_ept_offsets(output);
 					send_interleaved(output);
 				}
@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "obs-internal.h"
+
+/* Encoder packet payloads are allocated from size classes and recycled when
+ * their last reference is released, instead of going through bmalloc/bfree
+ * for every packet of every output.
+ *
+ * The reference count stays right in front of the payload, like with packets
+ * created by other means, and has PACKET_POOL_REF_FLAG set so that
+ * obs_encoder_packet_release knows where to return the buffer.
+ *
+ * Size classes start at 256 bytes and have four steps per power of two, so at
+ * most a quarter of a buffer is wasted.  Payloads above 16 MiB are not cached
+ * but still use the same layout. */
+
+#define POOL_MIN_SHIFT 8
+#define POOL_MAX_SHIFT 24
+#define POOL_STEPS 4
+#define POOL_CLASSES ((POOL_MAX_SHIFT - POOL_MIN_SHIFT) * POOL_STEPS + 1)
+#define POOL_UNCACHED POOL_CLASSES
+
+/* idle buffers beyond this are freed */
+#define POOL_MAX_CACHED_BYTES (64 * 1024 * 1024)
+
+struct packet_buffer {
+	struct packet_buffer *next;
+	uint32_t size_class;
+	long refs; /* must come last, the payload directly follows it */
+};
+
+struct packet_pool {
+	pthread_mutex_t mutex;
+	struct packet_buffer *free_lists[POOL_CLASSES];
+	size_t cached_bytes;
+	long cached;
+	long reused;
+
+	volatile long allocs;
+	volatile long copies;
+	volatile long zero_copy;
+};
+
+static struct packet_pool pool = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+
+static inline uint8_t *buffer_data(struct packet_buffer *buf)
+{
+	return (uint8_t *)(&buf->refs + 1);
+}
+
+static inline struct packet_buffer *buffer_from_refs(long *p_refs)
+{
+	return (struct packet_buffer *)((uint8_t *)p_refs - offsetof(struct packet_buffer, refs));
+}
+
+static uint32_t get_size_class(size_t size, size_t *alloc_size)
+{
+	size_t shift = POOL_MIN_SHIFT;
+	size_t step, idx;
+
+	if (size <= ((size_t)1 << POOL_MIN_SHIFT)) {
+		*alloc_size = (size_t)1 << POOL_MIN_SHIFT;
+		return 0;
+	}
+
+	while ((size - 1) >> (shift + 1))
+		shift++;
+
+	if (shift >= POOL_MAX_SHIFT) {
+		*alloc_size = size;
+		return POOL_UNCACHED;
+	}
+
+	/* size is in (2^shift, 2^(shift + 1)] */
+	step = ((size_t)1 << shift) / POOL_STEPS;
+	idx = (size - 1 - ((size_t)1 << shift)) / step;
+
+	*alloc_size = ((size_t)1 << shift) + (idx + 1) * step;
+	return (uint32_t)(1 + (shift - POOL_MIN_SHIFT) * POOL_STEPS + idx);
+}
+
+static inline size_t class_size(uint32_t size_class)
+{
+	size_t shift, idx;
+
+	if (size_class == 0)
+		return (size_t)1 << POOL_MIN_SHIFT;
+
+	shift = POOL_MIN_SHIFT + (size_class - 1) / POOL_STEPS;
+	idx = (size_class - 1) % POOL_STEPS;
+	return ((size_t)1 << shift) + (idx + 1) * (((size_t)1 << shift) / POOL_STEPS);
+}
+
+uint8_t *packet_pool_alloc(size_t size)
+{
+	struct packet_buffer *buf = NULL;
+	size_t alloc_size;
+	uint32_t size_class = get_size_class(size, &alloc_size);
+
+	if (size_class != POOL_UNCACHED) {
+		pthread_mutex_lock(&pool.mutex);
+		buf = pool.free_lists[size_class];
+		if (buf) {
+			pool.free_lists[size_class] = buf->next;
+			pool.cached_bytes -= alloc_size;
+			pool.cached--;
+			pool.reused++;
+		}
+		pthread_mutex_unlock(&pool.mutex);
+	}
+
+	if (!buf) {
+		buf = bmalloc(offsetof(struct packet_buffer, refs) + sizeof(long) + alloc_size);
+		buf->size_class = size_class;
+	}
+
+	buf->next = NULL;
+	buf->refs = PACKET_POOL_REF_FLAG | 1;
+	os_atomic_inc_long(&pool.allocs);
+	return buffer_data(buf);
+}
+
+void packet_pool_release(long *p_refs)
+{
+	struct packet_buffer *buf = buffer_from_refs(p_refs);
+	size_t size;
+
+	os_atomic_dec_long(&pool.allocs);
+
+	if (buf->size_class == POOL_UNCACHED) {
+		bfree(buf);
+		return;
+	}
+
+	size = class_size(buf->size_class);
+
+	pthread_mutex_lock(&pool.mutex);
+	if (pool.cached_bytes + size <= POOL_MAX_CACHED_BYTES) {
+		buf->next = pool.free_lists[buf->size_class];
+		pool.free_lists[buf->size_class] = buf;
+		pool.cached_bytes += size;
+		pool.cached++;
+		buf = NULL;
+	}
+	pthread_mutex_unlock(&pool.mutex);
+
+	bfree(buf);
+}
+
+void packet_pool_count_payload(bool zero_copy)
+{
+	os_atomic_inc_long(zero_copy ? &pool.zero_copy : &pool.copies);
+}
+
+void packet_pool_free(void)
+{
+	pthread_mutex_lock(&pool.mutex);
+	for (size_t i = 0; i < POOL_CLASSES; i++) {
+		struct packet_buffer *buf = pool.free_lists[i];
+
+		while (buf) {
+			struct packet_buffer *next = buf->next;
+			bfree(buf);
+			buf = next;
+		}
+		pool.free_lists[i] = NULL;
+	}
+
+	pool.cached_bytes = 0;
+	pool.cached = 0;
+	pthread_mutex_unlock(&pool.mutex);
+}
+
+void obs_encoder_packet_pool_stats(struct obs_encoder_packet_pool_stats *stats)
+{
+	if (!stats)
+		return;
+
+	pthread_mutex_lock(&pool.mutex);
+	stats->cached = pool.cached;
+	stats->reused = pool.reused;
+	pthread_mutex_unlock(&pool.mutex);
+
+	stats->allocs = os_atomic_load_long(&pool.allocs);
+	stats->copies = os_atomic_load_long(&pool.copies);
+	stats->zero_copy = os_atomic_load_long(&pool.zero_copy);
+}
@@ -18,6 +18,7 @@
 
 #include "util/threading.h"
 #include "util/util_uint64.h"
+#include "media-io/audio-mix.h"
 #include "graphics/math-defs.h"
 #include "obs-scene.h"
 #include "obs-internal.h"
@@ -1590,27 +1591,6 @@ static void process_all_audio_actions(struct obs_scene_item *item, size_t sample
 		;
 }
 
-static void mix_audio_with_buf(float *p_out, float *p_in, float *buf_in, size_t pos, size_t count)
-{
-	register float *out = p_out + pos;
-	register float *buf = buf_in;
-	register float *in = p_in;
-	register float *end = in + count;
-
-	while (in < end)
-		*(out++) += *(in++) * *(buf++);
-}
-
-static inline void mix_audio(float *p_out, float *p_in, size_t pos, size_t count)
-{
-	register float *out = p_out + pos;
-	register float *in = p_in;
-	register float *end = in + count;
-
-	while (in < end)
-		*(out++) += *(in++);
-}
-
 static inline struct scene_source_mix *get_source_mix(struct obs_scene *scene, struct obs_source *source)
 {
 	for (size_t i = 0; i < scene->mix_sources.num; i++) {
@@ -1785,10 +1765,10 @@ static bool scene_audio_render_internal(struct obs_scene *scene, struct obs_scen
 				float *in = child_audio.output[mix].data[ch];
 
 				if (source_mix->apply_buf)
-					mix_audio_with_buf(out, in, source_mix->buf, source_mix->pos,
+					audio_mix_add_gain(out + source_mix->pos, in, source_mix->buf,
 							   source_mix->count);
 				else
-					mix_audio(out, in, source_mix->pos, source_mix->count);
+					audio_mix_add(out + source_mix->pos, in, source_mix->count);
 			}
 		}
 	}
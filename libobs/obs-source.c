@@ -21,6 +21,7 @@
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
 #include "media-io/audio-io.h"
+#include "media-io/audio-mix.h"
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/util_uint64.h"
@@ -115,13 +116,32 @@ static const char *source_signals[] = {
 	NULL,
 };
 
+/* indexed by enum media_signal_type */
+static const char *media_signals[] = {
+	"media_play",
+	"media_pause",
+	"media_restart",
+	"media_stopped",
+	"media_next",
+	"media_previous",
+	"media_started",
+	"media_ended",
+};
+
 bool obs_source_init_context(struct obs_source *source, obs_data_t *settings, const char *name, const char *uuid,
 			     obs_data_t *hotkey_data, bool private)
 {
 	if (!obs_context_data_init(&source->context, OBS_OBJ_TYPE_SOURCE, settings, name, uuid, hotkey_data, private))
 		return false;
+	if (!signal_handler_add_array(source->context.signals, source_signals))
+		return false;
 
-	return signal_handler_add_array(source->context.signals, source_signals);
+	source->update_signal = signal_handler_get_signal(source->context.signals, "update");
+	source->volume_signal = signal_handler_get_signal(source->context.signals, "volume");
+	for (size_t i = 0; i < MEDIA_SIGNAL_COUNT; i++)
+		source->media_signals[i] = signal_handler_get_signal(source->context.signals, media_signals[i]);
+
+	return true;
 }
 
 const char *obs_source_get_display_name(const char *id)
@@ -328,9 +348,8 @@ static void obs_source_init_audio_hotkeys(struct obs_source *source)
 							      obs_source_hotkey_push_to_talk, source);
 }
 
-static obs_source_t *obs_source_create_internal(const char *id, const char *name, const char *uuid,
-						obs_data_t *settings, obs_data_t *hotkey_data, bool private,
-						uint32_t last_obs_ver, obs_canvas_t *canvas)
+obs_source_t *obs_source_create_deferred(const char *id, const char *name, const char *uuid, obs_data_t *settings,
+					 obs_data_t *hotkey_data, uint32_t last_obs_ver, bool private)
 {
 	struct obs_source *source = bzalloc(sizeof(struct obs_source));
 
@@ -372,41 +391,68 @@ static obs_source_t *obs_source_create_internal(const char *id, const char *name
 	if (!obs_source_init(source))
 		goto fail;
 
-	/* Scenes need canvases, fall back to using default canvas if none provided here. */
-	if (requires_canvas(source) && !canvas) {
-		blog(LOG_WARNING, "Attempted to add Scene without specifying a canvas! Using default canvas instead.");
-		canvas = obs->data.main_canvas;
-	}
-
 	if (!private)
 		obs_source_init_audio_hotkeys(source);
 
+	return source;
+
+fail:
+	blog(LOG_ERROR, "obs_source_create failed");
+	obs_source_destroy(source);
+	return NULL;
+}
+
+/* Runs the create callback of a source made with obs_source_create_deferred.
+ * This only touches the source itself, so it may be called from any thread if
+ * the source type has OBS_SOURCE_PARALLEL_CREATE. */
+void obs_source_create_instance(obs_source_t *source)
+{
+	const char *name = source->context.name;
+
 	/* allow the source to be created even if creation fails so that the
 	 * user's data doesn't become lost */
-	if (info && info->create)
-		source->context.data = info->create(source->context.settings, source);
-	if ((!info || info->create) && !source->context.data)
+	if (source->info.create)
+		source->context.data = source->info.create(source->context.settings, source);
+	if ((source->owns_info_id || source->info.create) && !source->context.data)
 		blog(LOG_ERROR, "Failed to create source '%s'!", name);
 
-	blog(LOG_DEBUG, "%ssource '%s' (%s) created", private ? "private " : "", name, id);
+	blog(LOG_DEBUG, "%ssource '%s' (%s) created", source->context.private ? "private " : "", name,
+	     source->info.id);
+}
+
+/* Publishes a created source to the source lists and signals its creation */
+void obs_source_create_finish(obs_source_t *source, obs_canvas_t *canvas)
+{
+	/* Scenes need canvases, fall back to using default canvas if none provided here. */
+	if (requires_canvas(source) && !canvas) {
+		blog(LOG_WARNING, "Attempted to add Scene without specifying a canvas! Using default canvas instead.");
+		canvas = obs->data.main_canvas;
+	}
 
 	source->flags = source->default_flags;
 	source->enabled = true;
 
 	obs_source_init_finalize(source, canvas);
-	if (!private) {
+	if (!source->context.private) {
 		if (canvas)
 			obs_source_dosignal_canvas(source, canvas, "source_create_canvas", NULL);
 		if (!canvas || canvas == obs->data.main_canvas)
 			obs_source_dosignal(source, "source_create", NULL);
 	}
+}
 
-	return source;
+static obs_source_t *obs_source_create_internal(const char *id, const char *name, const char *uuid,
+						obs_data_t *settings, obs_data_t *hotkey_data, bool private,
+						uint32_t last_obs_ver, obs_canvas_t *canvas)
+{
+	obs_source_t *source =
+		obs_source_create_deferred(id, name, uuid, settings, hotkey_data, last_obs_ver, private);
+	if (!source)
+		return NULL;
 
-fail:
-	blog(LOG_ERROR, "obs_source_create failed");
-	obs_source_destroy(source);
-	return NULL;
+	obs_source_create_instance(source);
+	obs_source_create_finish(source, canvas);
+	return source;
 }
 
 obs_source_t *obs_source_create(const char *id, const char *name, obs_data_t *settings, obs_data_t *hotkey_data)
@@ -650,8 +696,11 @@ void obs_source_destroy(struct obs_source *source)
 
 	source_profiler_remove_source(source);
 
-	/* defer source destroy */
-	os_task_queue_queue_task(obs->destruction_task_thread, (os_task_t)obs_source_destroy_defer, source);
+	/* defer source destroy, only types that declare their destroy callback
+	 * thread-safe leave the destroy queue and run in parallel */
+	const void *affinity = (source->info.output_flags & OBS_SOURCE_PARALLEL_DESTROY) ? NULL : OBS_DESTROY_AFFINITY;
+	os_task_pool_queue_task(obs->task_pool, (os_task_t)obs_source_destroy_defer, source, OS_TASK_PRIORITY_LOW,
+				affinity);
 }
 
 static void obs_source_destroy_defer(struct obs_source *source)
@@ -679,6 +728,9 @@ static void obs_source_destroy_defer(struct obs_source *source)
 
 	for (i = 0; i < source->async_cache.num; i++)
 		obs_source_frame_decref(source->async_cache.array[i].frame);
+	/* the source returned the memory of these on destroy already */
+	for (i = 0; i < source->async_lent.num; i++)
+		bfree(source->async_lent.array[i].frame);
 
 	gs_enter_context(obs->video.graphics);
 	if (source->async_texrender)
@@ -713,6 +765,7 @@ static void obs_source_destroy_defer(struct obs_source *source)
 	da_free(source->caption_cb_list);
 	da_free(source->async_cache);
 	da_free(source->async_frames);
+	da_free(source->async_lent);
 	da_free(source->filters);
 	da_free(source->media_actions);
 	pthread_mutex_destroy(&source->filter_mutex);
@@ -951,7 +1004,7 @@ static void obs_source_deferred_update(obs_source_t *source)
 		long count = os_atomic_load_long(&source->defer_update_count);
 		source->info.update(source->context.data, source->context.settings);
 		os_atomic_compare_swap_long(&source->defer_update_count, count, 0);
-		obs_source_dosignal(source, "source_update", "update");
+		obs_source_emit(source, obs->source_update_signal, source->update_signal);
 	}
 }
 
@@ -968,7 +1021,7 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 		os_atomic_inc_long(&source->defer_update_count);
 	} else if (source->context.data && source->info.update) {
 		source->info.update(source->context.data, source->context.settings);
-		obs_source_dosignal(source, "source_update", "update");
+		obs_source_emit(source, obs->source_update_signal, source->update_signal);
 	}
 }
 
@@ -1154,10 +1207,32 @@ void obs_source_deactivate(obs_source_t *source, enum view_type type)
 
 static inline struct obs_source_frame *get_closest_frame(obs_source_t *source, uint64_t sys_time);
 
+static void unlend_frame(obs_source_t *source, struct obs_source_frame *frame);
+
+static inline bool has_async_filters(obs_source_t *source)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	for (size_t i = 0; i < source->filters.num && !found; i++) {
+		struct obs_source *filter = source->filters.array[i];
+		found = filter->enabled && filter->info.filter_video;
+	}
+
+	pthread_mutex_unlock(&source->filter_mutex);
+	return found;
+}
+
 static void filter_frame(obs_source_t *source, struct obs_source_frame **ref_frame)
 {
 	struct obs_source_frame *frame = *ref_frame;
 	if (frame) {
+		/* filters may hold on to frames for as long as they want,
+		 * which would starve the source of its own buffers */
+		if (source->async_lent.num && has_async_filters(source))
+			unlend_frame(source, frame);
+
 		os_atomic_inc_long(&frame->refs);
 		frame = filter_async_video(source, frame);
 		if (frame)
@@ -1188,27 +1263,27 @@ void process_media_actions(obs_source_t *source)
 			source->info.media_play_pause(source->context.data, action.pause);
 
 			if (action.pause)
-				obs_source_dosignal(source, NULL, "media_pause");
+				obs_source_emit(source, NULL, source->media_signals[MEDIA_SIGNAL_PAUSE]);
 			else
-				obs_source_dosignal(source, NULL, "media_play");
+				obs_source_emit(source, NULL, source->media_signals[MEDIA_SIGNAL_PLAY]);
 			break;
 
 		case MEDIA_ACTION_RESTART:
 			source->info.media_restart(source->context.data);
-			obs_source_dosignal(source, NULL, "media_restart");
+			obs_source_emit(source, NULL, source->media_signals[MEDIA_SIGNAL_RESTART]);
 			break;
 
 		case MEDIA_ACTION_STOP:
 			source->info.media_stop(source->context.data);
-			obs_source_dosignal(source, NULL, "media_stopped");
+			obs_source_emit(source, NULL, source->media_signals[MEDIA_SIGNAL_STOPPED]);
 			break;
 		case MEDIA_ACTION_NEXT:
 			source->info.media_next(source->context.data);
-			obs_source_dosignal(source, NULL, "media_next");
+			obs_source_emit(source, NULL, source->media_signals[MEDIA_SIGNAL_NEXT]);
 			break;
 		case MEDIA_ACTION_PREVIOUS:
 			source->info.media_previous(source->context.data);
-			obs_source_dosignal(source, NULL, "media_previous");
+			obs_source_emit(source, NULL, source->media_signals[MEDIA_SIGNAL_PREVIOUS]);
 			break;
 		case MEDIA_ACTION_SET_TIME:
 			source->info.media_set_time(source->context.data, action.ms);
@@ -3364,11 +3439,66 @@ static inline bool async_texture_changed(struct obs_source *source, const struct
 	return source->async_cache_width != frame->width || source->async_cache_height != frame->height || prev != cur;
 }
 
+static struct async_lent_frame *find_lent_frame(obs_source_t *source, const struct obs_source_frame *frame)
+{
+	for (size_t i = 0; i < source->async_lent.num; i++) {
+		if (source->async_lent.array[i].frame == frame)
+			return source->async_lent.array + i;
+	}
+
+	return NULL;
+}
+
+/* hands the memory back to the source once nothing uses the frame anymore,
+ * has to be called with the async mutex held */
+static void release_lent_frame(obs_source_t *source, struct async_lent_frame *lf)
+{
+	if (lf->used || os_atomic_load_long(&lf->frame->refs) > 1)
+		return;
+
+	lf->release(lf->param);
+	bfree(lf->frame);
+	da_erase(source->async_lent, (size_t)(lf - source->async_lent.array));
+}
+
+/* copies a lent frame that is still queued into memory of its own, which
+ * turns it into a regular cached frame.  Only safe while the frame is not
+ * referenced outside of the async mutex. */
+static void unlend_frame(obs_source_t *source, struct obs_source_frame *frame)
+{
+	struct async_lent_frame *lf = find_lent_frame(source, frame);
+	struct obs_source_frame *copy;
+	struct async_frame af;
+
+	if (!lf || os_atomic_load_long(&frame->refs) > 1)
+		return;
+
+	copy = obs_source_frame_create(frame->format, frame->width, frame->height);
+	copy_frame_data(copy, frame);
+	memcpy(frame->data, copy->data, sizeof(frame->data));
+	memcpy(frame->linesize, copy->linesize, sizeof(frame->linesize));
+	bfree(copy);
+
+	af.frame = frame;
+	af.used = lf->used;
+	af.unused_count = 0;
+	da_push_back(source->async_cache, &af);
+
+	lf->release(lf->param);
+	da_erase(source->async_lent, (size_t)(lf - source->async_lent.array));
+}
+
 static inline void free_async_cache(struct obs_source *source)
 {
 	for (size_t i = 0; i < source->async_cache.num; i++)
 		obs_source_frame_decref(source->async_cache.array[i].frame);
 
+	for (size_t i = source->async_lent.num; i > 0; i--) {
+		struct async_lent_frame *lf = &source->async_lent.array[i - 1];
+		lf->used = false;
+		release_lent_frame(source, lf);
+	}
+
 	da_resize(source->async_cache, 0);
 	da_resize(source->async_frames, 0);
 	source->cur_async_frame = NULL;
@@ -3392,6 +3522,19 @@ static void clean_cache(obs_source_t *source)
 	}
 }
 
+static inline void set_async_cache_format(struct obs_source *source, const struct obs_source_frame *frame)
+{
+	if (async_texture_changed(source, frame)) {
+		free_async_cache(source);
+		source->async_cache_width = frame->width;
+		source->async_cache_height = frame->height;
+	}
+
+	source->async_cache_format = frame->format;
+	source->async_cache_full_range = frame->full_range;
+	source->async_cache_trc = frame->trc;
+}
+
 #define MAX_ASYNC_FRAMES 30
 //if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
 static inline struct obs_source_frame *cache_video(struct obs_source *source, const struct obs_source_frame *frame)
@@ -3407,16 +3550,9 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source, co
 		return NULL;
 	}
 
-	if (async_texture_changed(source, frame)) {
-		free_async_cache(source);
-		source->async_cache_width = frame->width;
-		source->async_cache_height = frame->height;
-	}
+	set_async_cache_format(source, frame);
 
 	const enum video_format format = frame->format;
-	source->async_cache_format = format;
-	source->async_cache_full_range = frame->full_range;
-	source->async_cache_trc = frame->trc;
 
 	for (size_t i = 0; i < source->async_cache.num; i++) {
 		struct async_frame *af = &source->async_cache.array[i];
@@ -3533,6 +3669,88 @@ void obs_source_output_video2(obs_source_t *source, const struct obs_source_fram
 	obs_source_output_video_internal(source, &new_frame);
 }
 
+/* more than this and the source could run out of buffers to capture into */
+#define MAX_LENT_FRAMES 2
+
+void obs_source_output_video_lent(obs_source_t *source, const struct obs_source_frame *frame,
+				 obs_source_frame_release_t release, void *param)
+{
+	struct obs_source_frame new_frame;
+	struct obs_source_frame *lent = NULL;
+
+	if (!release || !frame) {
+		obs_source_output_video(source, frame);
+		return;
+	}
+	if (!obs_source_valid(source, "obs_source_output_video_lent") || destroying(source)) {
+		release(param);
+		return;
+	}
+
+	new_frame = *frame;
+	new_frame.full_range = format_is_yuv(frame->format) ? new_frame.full_range : true;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (source->async_lent.num < MAX_LENT_FRAMES && source->async_frames.num < MAX_ASYNC_FRAMES) {
+		struct async_lent_frame lf;
+
+		set_async_cache_format(source, &new_frame);
+
+		lent = bmalloc(sizeof(*lent));
+		*lent = new_frame;
+		lent->refs = 1;
+		lent->prev_frame = false;
+
+		lf.frame = lent;
+		lf.release = release;
+		lf.param = param;
+		lf.used = true;
+		da_push_back(source->async_lent, &lf);
+		da_push_back(source->async_frames, &lent);
+		source->async_active = true;
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+
+	if (lent) {
+		source_profiler_async_frame_received(source);
+	} else {
+		obs_source_output_video_internal(source, &new_frame);
+		release(param);
+	}
+}
+
+void obs_source_return_lent_video(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_return_lent_video"))
+		return;
+
+	for (;;) {
+		bool done;
+
+		pthread_mutex_lock(&source->async_mutex);
+
+		for (size_t i = source->async_lent.num; i > 0; i--) {
+			struct async_lent_frame *lf = &source->async_lent.array[i - 1];
+
+			if (lf->used)
+				unlend_frame(source, lf->frame);
+			else
+				release_lent_frame(source, lf);
+		}
+
+		done = !source->async_lent.num;
+		pthread_mutex_unlock(&source->async_mutex);
+
+		if (done)
+			break;
+
+		/* a frame is still being uploaded */
+		os_sleep_ms(1);
+	}
+}
+
 void obs_source_set_async_rotation(obs_source_t *source, long rotation)
 {
 	if (source)
@@ -3961,6 +4179,8 @@ void obs_source_output_audio(obs_source_t *source, const struct obs_source_audio
 
 void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 {
+	struct async_lent_frame *lf;
+
 	if (frame)
 		frame->prev_frame = false;
 
@@ -3969,9 +4189,15 @@ void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 
 		if (f->frame == frame) {
 			f->used = false;
-			break;
+			return;
 		}
 	}
+
+	lf = find_lent_frame(source, frame);
+	if (lf) {
+		lf->used = false;
+		release_lent_frame(source, lf);
+	}
 }
 
 /* #define DEBUG_ASYNC_FRAMES 1 */
@@ -4416,9 +4642,9 @@ void obs_source_set_volume(obs_source_t *source, float volume)
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_float(&data, "volume", volume);
 
-		signal_handler_signal(source->context.signals, "volume", &data);
+		signal_handler_emit(source->context.signals, source->volume_signal, &data);
 		if (!source->context.private)
-			signal_handler_signal(obs->signals, "source_volume", &data);
+			signal_handler_emit(obs->signals, obs->source_volume_signal, &data);
 
 		volume = (float)calldata_float(&data, "volume");
 
@@ -5106,23 +5332,13 @@ static float get_source_volume(obs_source_t *source, uint64_t os_time)
 
 static inline void multiply_output_audio(obs_source_t *source, size_t mix, size_t channels, float vol)
 {
-	register float *out = source->audio_output_buf[mix][0];
-	register float *end = out + AUDIO_OUTPUT_FRAMES * channels;
-
-	while (out < end)
-		*(out++) *= vol;
+	audio_mix_scale(source->audio_output_buf[mix][0], vol, AUDIO_OUTPUT_FRAMES * channels);
 }
 
 static inline void multiply_vol_data(obs_source_t *source, size_t mix, size_t channels, float *vol_data)
 {
-	for (size_t ch = 0; ch < channels; ch++) {
-		register float *out = source->audio_output_buf[mix][ch];
-		register float *end = out + AUDIO_OUTPUT_FRAMES;
-		register float *vol = vol_data;
-
-		while (out < end)
-			*(out++) *= *(vol++);
-	}
+	for (size_t ch = 0; ch < channels; ch++)
+		audio_mix_mul(source->audio_output_buf[mix][ch], vol_data, AUDIO_OUTPUT_FRAMES);
 }
 
 static inline void apply_audio_action(obs_source_t *source, const struct audio_action *action)
@@ -5758,7 +5974,7 @@ void obs_source_media_started(obs_source_t *source)
 	if ((source->info.output_flags & OBS_SOURCE_CONTROLLABLE_MEDIA) == 0)
 		return;
 
-	obs_source_dosignal(source, NULL, "media_started");
+	obs_source_emit(source, NULL, source->media_signals[MEDIA_SIGNAL_STARTED]);
 }
 
 void obs_source_media_ended(obs_source_t *source)
@@ -5768,7 +5984,7 @@ void obs_source_media_ended(obs_source_t *source)
 	if ((source->info.output_flags & OBS_SOURCE_CONTROLLABLE_MEDIA) == 0)
 		return;
 
-	obs_source_dosignal(source, NULL, "media_ended");
+	obs_source_emit(source, NULL, source->media_signals[MEDIA_SIGNAL_ENDED]);
 }
 
 obs_data_array_t *obs_source_backup_filters(obs_source_t *source)
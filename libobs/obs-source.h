@@ -208,6 +208,18 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_REQUIRES_CANVAS (1 << 17)
 
+/**
+ * Source type's create callback is thread-safe, so sources of this type can
+ * be created on worker threads while a scene collection loads
+ */
+#define OBS_SOURCE_PARALLEL_CREATE (1 << 18)
+
+/**
+ * Source type's destroy callback is thread-safe, so sources of this type can
+ * be destroyed on worker threads at the same time as other sources
+ */
+#define OBS_SOURCE_PARALLEL_DESTROY (1 << 19)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent, obs_source_t *child, void *param);
@@ -504,6 +504,13 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 	profile_start(shader_comp_name);
 	gs_enter_context(video->graphics);
 
+	if (obs->module_config_path) {
+		struct dstr cache_path = {0};
+		dstr_printf(&cache_path, "%s/%s/shader-cache", obs->module_config_path, ovi->graphics_module);
+		gs_set_shader_cache_path(cache_path.array);
+		dstr_free(&cache_path);
+	}
+
 	char *filename = obs_find_data_file("default.effect");
 	video->default_effect = gs_effect_create_from_file(filename, NULL);
 	bfree(filename);
@@ -1034,7 +1041,7 @@ static void obs_free_data(void)
 	FREE_OBS_HASH_TABLE(hh, &data->named_canvases, canvas);
 	FREE_OBS_HASH_TABLE(hh_uuid, &data->canvases, canvas);
 
-	os_task_queue_wait(obs->destruction_task_thread);
+	os_task_pool_wait(obs->task_pool);
 
 	pthread_mutex_destroy(&data->sources_mutex);
 	pthread_mutex_destroy(&data->audio_sources_mutex);
@@ -1077,6 +1084,7 @@ static const char *obs_signals[] = {
 	"void source_transition_start(ptr source)",
 	"void source_transition_video_stop(ptr source)",
 	"void source_transition_stop(ptr source)",
+	"void sources_load_progress(int created, int loaded, int total)",
 
 	"void channel_change(int channel, in out ptr source, ptr prev_source)",
 
@@ -1105,8 +1113,12 @@ static inline bool obs_init_handlers(void)
 	obs->procs = proc_handler_create();
 	if (!obs->procs)
 		return false;
+	if (!signal_handler_add_array(obs->signals, obs_signals))
+		return false;
 
-	return signal_handler_add_array(obs->signals, obs_signals);
+	obs->source_update_signal = signal_handler_get_signal(obs->signals, "source_update");
+	obs->source_volume_signal = signal_handler_get_signal(obs->signals, "source_volume");
+	return true;
 }
 
 static pthread_once_t obs_pthread_once_init_token = PTHREAD_ONCE_INIT;
@@ -1229,8 +1241,8 @@ static bool obs_init(const char *locale, const char *module_config_path, profile
 	if (!obs->data.main_canvas)
 		return false;
 
-	obs->destruction_task_thread = os_task_queue_create();
-	if (!obs->destruction_task_thread)
+	obs->task_pool = os_task_pool_create(0);
+	if (!obs->task_pool)
 		return false;
 
 	if (module_config_path)
@@ -1402,9 +1414,10 @@ void obs_shutdown(void)
 	obs->first_module = NULL;
 
 	obs_free_data();
+	packet_pool_free();
 	obs_free_audio();
 	obs_free_video();
-	os_task_queue_destroy(obs->destruction_task_thread);
+	os_task_pool_destroy(obs->task_pool);
 	obs_free_hotkeys();
 	obs_free_graphics();
 	proc_handler_destroy(obs->procs);
@@ -2211,9 +2224,10 @@ gs_texture_t *obs_get_main_texture(void)
 	return video->render_texture;
 }
 
-static obs_source_t *obs_load_source_type(obs_data_t *source_data, bool is_private)
+static obs_source_t *obs_load_source_type(obs_data_t *source_data, bool is_private);
+
+static obs_source_t *obs_load_source_begin(obs_data_t *source_data, bool is_private, obs_canvas_t **p_canvas)
 {
-	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
 	obs_source_t *source;
 	const char *name = obs_data_get_string(source_data, "name");
 	const char *uuid = obs_data_get_string(source_data, "uuid");
@@ -2222,16 +2236,7 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data, bool is_priva
 	obs_data_t *settings = obs_data_get_obj(source_data, "settings");
 	obs_data_t *hotkeys = obs_data_get_obj(source_data, "hotkeys");
 	obs_canvas_t *canvas = NULL;
-	double volume;
-	double balance;
-	int64_t sync;
 	uint32_t prev_ver;
-	uint32_t caps;
-	uint32_t flags;
-	uint32_t mixers;
-	int di_order;
-	int di_mode;
-	int monitoring_type;
 
 	prev_ver = (uint32_t)obs_data_get_int(source_data, "prev_ver");
 
@@ -2247,16 +2252,38 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data, bool is_priva
 		}
 	}
 
-	source = obs_source_create_set_last_ver(canvas, v_id, name, uuid, settings, hotkeys, prev_ver, is_private);
+	source = obs_source_create_deferred(v_id, name, uuid, settings, hotkeys, prev_ver, is_private);
 
-	if (source->owns_info_id) {
+	if (source && source->owns_info_id) {
 		bfree((void *)source->info.unversioned_id);
 		source->info.unversioned_id = bstrdup(id);
 	}
 
-	obs_canvas_release(canvas);
 	obs_data_release(hotkeys);
+	obs_data_release(settings);
+
+	*p_canvas = canvas;
+	return source;
+}
+
+static void obs_load_source_finish(obs_source_t *source, obs_data_t *source_data, obs_canvas_t *canvas)
+{
+	obs_data_array_t *filters;
+	double volume;
+	double balance;
+	int64_t sync;
+	uint32_t prev_ver;
+	uint32_t caps;
+	uint32_t flags;
+	uint32_t mixers;
+	int di_order;
+	int di_mode;
+	int monitoring_type;
+
+	obs_source_create_finish(source, canvas);
+	obs_canvas_release(canvas);
 
+	prev_ver = source->last_obs_ver;
 	caps = obs_source_get_output_flags(source);
 
 	obs_data_set_default_double(source_data, "volume", 1.0);
@@ -2319,6 +2346,7 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data, bool is_priva
 	if (!source->private_settings)
 		source->private_settings = obs_data_create();
 
+	filters = obs_data_get_array(source_data, "filters");
 	if (filters) {
 		size_t count = obs_data_array_count(filters);
 
@@ -2336,9 +2364,20 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data, bool is_priva
 
 		obs_data_array_release(filters);
 	}
+}
 
-	obs_data_release(settings);
+static obs_source_t *obs_load_source_type(obs_data_t *source_data, bool is_private)
+{
+	obs_canvas_t *canvas;
+	obs_source_t *source = obs_load_source_begin(source_data, is_private, &canvas);
 
+	if (!source) {
+		obs_canvas_release(canvas);
+		return NULL;
+	}
+
+	obs_source_create_instance(source);
+	obs_load_source_finish(source, source_data, canvas);
 	return source;
 }
 
@@ -2352,30 +2391,214 @@ obs_source_t *obs_load_private_source(obs_data_t *source_data)
 	return obs_load_source_type(source_data, true);
 }
 
-void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb, void *private_data)
+struct source_load_item {
+	obs_data_t *data;
+	obs_source_t *source;
+	obs_canvas_t *canvas;
+	os_sem_t *created;
+	volatile bool done;
+	bool priority;
+
+	UT_hash_handle hh;
+	UT_hash_handle hh_uuid;
+};
+
+static struct source_load_item *find_load_item(struct source_load_item *names, struct source_load_item *uuids,
+					       obs_data_t *item_data)
 {
-	DARRAY(obs_source_t *) sources;
-	size_t count;
-	size_t i;
+	const char *uuid = obs_data_get_string(item_data, "source_uuid");
+	const char *name = obs_data_get_string(item_data, "name");
+	struct source_load_item *item = NULL;
+
+	if (*uuid)
+		HASH_FIND(hh_uuid, uuids, uuid, strlen(uuid), item);
+	if (!item)
+		HASH_FIND(hh, names, name, strlen(name), item);
+	return item;
+}
+
+/* marks everything used by the given scenes, including nested scenes and
+ * groups, to be queued at a higher priority */
+static void mark_priority_sources(struct source_load_item *items, size_t count, const char *const *priority_scenes)
+{
+	struct source_load_item *names = NULL;
+	struct source_load_item *uuids = NULL;
+	DARRAY(struct source_load_item *) stack;
+
+	da_init(stack);
+
+	for (size_t i = 0; i < count; i++) {
+		struct source_load_item *item = &items[i];
+		struct source_load_item *found;
+		const char *name = obs_data_get_string(item->data, "name");
+		const char *uuid = obs_data_get_string(item->data, "uuid");
+
+		HASH_FIND(hh, names, name, strlen(name), found);
+		if (!found)
+			HASH_ADD_KEYPTR(hh, names, name, strlen(name), item);
+
+		if (*uuid) {
+			HASH_FIND(hh_uuid, uuids, uuid, strlen(uuid), found);
+			if (!found)
+				HASH_ADD_KEYPTR(hh_uuid, uuids, uuid, strlen(uuid), item);
+		}
+	}
 
-	da_init(sources);
+	for (; *priority_scenes; priority_scenes++) {
+		struct source_load_item *item;
+		const char *name = *priority_scenes;
+
+		HASH_FIND(hh, names, name, strlen(name), item);
+		if (item && !item->priority) {
+			item->priority = true;
+			da_push_back(stack, &item);
+		}
+	}
+
+	while (stack.num) {
+		struct source_load_item *scene = stack.array[stack.num - 1];
+		const char *id = obs_data_get_string(scene->data, "id");
+		da_pop_back(stack);
+
+		if (strcmp(id, scene_info.id) != 0 && strcmp(id, group_info.id) != 0)
+			continue;
+
+		obs_data_t *settings = obs_data_get_obj(scene->data, "settings");
+		obs_data_array_t *scene_items = obs_data_get_array(settings, "items");
+		size_t num_items = obs_data_array_count(scene_items);
+
+		for (size_t i = 0; i < num_items; i++) {
+			obs_data_t *item_data = obs_data_array_item(scene_items, i);
+			struct source_load_item *item = find_load_item(names, uuids, item_data);
+
+			if (item && !item->priority) {
+				item->priority = true;
+				da_push_back(stack, &item);
+			}
+
+			obs_data_release(item_data);
+		}
+
+		obs_data_array_release(scene_items);
+		obs_data_release(settings);
+	}
+
+	HASH_CLEAR(hh, names);
+	HASH_CLEAR(hh_uuid, uuids);
+	da_free(stack);
+}
+
+static inline bool parallel_create(const struct source_load_item *item)
+{
+	return (item->source->info.output_flags & OBS_SOURCE_PARALLEL_CREATE) != 0;
+}
+
+static void create_source_task(void *param)
+{
+	struct source_load_item *item = param;
+
+	obs_source_create_instance(item->source);
+	os_atomic_set_bool(&item->done, true);
+	os_sem_post(item->created);
+}
+
+static void signal_load_progress(size_t created, size_t loaded, size_t total)
+{
+	struct calldata data;
+	uint8_t stack[128];
+
+	calldata_init_fixed(&data, stack, sizeof(stack));
+	calldata_set_int(&data, "created", (long long)created);
+	calldata_set_int(&data, "loaded", (long long)loaded);
+	calldata_set_int(&data, "total", (long long)total);
+
+	signal_handler_signal(obs->signals, "sources_load_progress", &data);
+}
+
+void obs_load_sources2(obs_data_array_t *array, const char *const *priority_scenes, obs_load_source_cb cb,
+		       void *private_data)
+{
+	struct source_load_item *items;
+	os_sem_t *created = NULL;
+	size_t num_parallel = 0;
+	size_t num_waited = 0;
+	size_t num_created = 0;
+	size_t num_loaded = 0;
+	size_t count;
 
 	count = obs_data_array_count(array);
-	da_reserve(sources, count);
+	if (!count)
+		return;
+
+	items = bzalloc(sizeof(struct source_load_item) * count);
+
+	for (size_t i = 0; i < count; i++)
+		items[i].data = obs_data_array_item(array, i);
 
-	for (i = 0; i < count; i++) {
-		obs_data_t *source_data = obs_data_array_item(array, i);
-		obs_source_t *source = obs_load_source(source_data);
+	if (priority_scenes)
+		mark_priority_sources(items, count, priority_scenes);
+
+	/* set up every source without creating it yet, so that the create
+	 * callbacks of types that allow it can run on the task pool, the ones
+	 * used by the priority scenes first.  Nothing is deferred, every source
+	 * is created and loaded before this returns. */
+	for (size_t i = 0; i < count; i++)
+		items[i].source = obs_load_source_begin(items[i].data, false, &items[i].canvas);
+
+	bool use_pool = obs->task_pool && !os_task_pool_inside(obs->task_pool) && os_sem_init(&created, 0) == 0;
+
+	if (use_pool) {
+		for (size_t i = 0; i < count; i++) {
+			struct source_load_item *item = &items[i];
+			if (!item->source || !parallel_create(item))
+				continue;
 
-		da_push_back(sources, &source);
+			enum os_task_priority priority = item->priority ? OS_TASK_PRIORITY_HIGH : OS_TASK_PRIORITY_NORMAL;
 
-		obs_data_release(source_data);
+			item->created = created;
+			if (os_task_pool_queue_task(obs->task_pool, create_source_task, item, priority, NULL))
+				num_parallel++;
+			else
+				item->created = NULL;
+		}
 	}
 
+	/* publish in the saved order and create everything else right before
+	 * it is published, so create callbacks can still find the sources
+	 * before them by name */
+	for (size_t i = 0; i < count; i++) {
+		struct source_load_item *item = &items[i];
+		if (!item->source) {
+			obs_canvas_release(item->canvas);
+			continue;
+		}
+
+		if (item->created) {
+			while (!os_atomic_load_bool(&item->done)) {
+				os_sem_wait(created);
+				num_waited++;
+				signal_load_progress(++num_created, num_loaded, count);
+			}
+		} else {
+			obs_source_create_instance(item->source);
+			signal_load_progress(++num_created, num_loaded, count);
+		}
+
+		obs_load_source_finish(item->source, item->data, item->canvas);
+	}
+
+	/* a task may still be about to post after its source was published */
+	for (; num_waited < num_parallel; num_waited++) {
+		os_sem_wait(created);
+		signal_load_progress(++num_created, num_loaded, count);
+	}
+
+	os_sem_destroy(created);
+
 	/* tell sources that we want to load */
-	for (i = 0; i < sources.num; i++) {
-		obs_source_t *source = sources.array[i];
-		obs_data_t *source_data = obs_data_array_item(array, i);
+	for (size_t i = 0; i < count; i++) {
+		obs_source_t *source = items[i].source;
+		obs_data_t *source_data = items[i].data;
 		if (source) {
 			if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 				obs_transition_load(source, source_data);
@@ -2383,13 +2606,21 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb, void *priv
 			if (cb)
 				cb(private_data, source);
 		}
-		obs_data_release(source_data);
+
+		signal_load_progress(num_created, ++num_loaded, count);
 	}
 
-	for (i = 0; i < sources.num; i++)
-		obs_source_release(sources.array[i]);
+	for (size_t i = 0; i < count; i++) {
+		obs_source_release(items[i].source);
+		obs_data_release(items[i].data);
+	}
 
-	da_free(sources);
+	bfree(items);
+}
+
+void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb, void *private_data)
+{
+	obs_load_sources2(array, NULL, cb, private_data);
 }
 
 obs_data_t *obs_save_source(obs_source_t *source)
@@ -3243,7 +3474,9 @@ bool obs_in_task_thread(enum obs_task_type type)
 	else if (type == OBS_TASK_UI)
 		return is_ui_thread;
 	else if (type == OBS_TASK_DESTROY)
-		return os_task_queue_inside(obs->destruction_task_thread);
+		return os_task_pool_inside_affinity(obs->task_pool, OBS_DESTROY_AFFINITY);
+	else if (type == OBS_TASK_BACKGROUND)
+		return os_task_pool_inside(obs->task_pool);
 
 	assert(false);
 	return false;
@@ -3291,7 +3524,11 @@ void obs_queue_task(enum obs_task_type type, obs_task_t task, void *param, bool
 
 		} else if (type == OBS_TASK_DESTROY) {
 			os_task_t os_task = (os_task_t)task;
-			os_task_queue_queue_task(obs->destruction_task_thread, os_task, param);
+			os_task_pool_queue_task(obs->task_pool, os_task, param, OS_TASK_PRIORITY_LOW, OBS_DESTROY_AFFINITY);
+
+		} else if (type == OBS_TASK_BACKGROUND) {
+			os_task_t os_task = (os_task_t)task;
+			os_task_pool_queue_task(obs->task_pool, os_task, param, OS_TASK_PRIORITY_NORMAL, NULL);
 		}
 	}
 }
@@ -3312,7 +3549,7 @@ bool obs_wait_for_destroy_queue(void)
 	os_event_destroy(info.event);
 
 	/* wait for destroy task queue */
-	return os_task_queue_wait(obs->destruction_task_thread);
+	return os_task_pool_wait(obs->task_pool);
 }
 
 static void set_ui_thread(void *unused)
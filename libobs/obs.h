@@ -793,6 +793,16 @@ typedef void (*obs_load_source_cb)(void *private_data, obs_source_t *source);
 /** Loads sources from a data array */
 EXPORT void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb, void *private_data);
 
+/**
+ * Loads sources from a data array.  Source types with
+ * OBS_SOURCE_PARALLEL_CREATE are created on worker threads, and the ones used
+ * by the given NULL-terminated list of scene names are queued at a higher
+ * priority.  All other sources are created in order.  Nothing is deferred:
+ * every source is created and loaded before this returns.
+ */
+EXPORT void obs_load_sources2(obs_data_array_t *array, const char *const *priority_scenes, obs_load_source_cb cb,
+			      void *private_data);
+
 /** Saves sources to a data array */
 EXPORT obs_data_array_t *obs_save_sources(void);
 
@@ -870,7 +880,10 @@ enum obs_task_type {
 	OBS_TASK_UI,
 	OBS_TASK_GRAPHICS,
 	OBS_TASK_AUDIO,
+	/* runs one after another in queue order */
 	OBS_TASK_DESTROY,
+	/* runs on the libobs worker pool, tasks may run concurrently */
+	OBS_TASK_BACKGROUND,
 };
 
 EXPORT void obs_queue_task(enum obs_task_type type, obs_task_t task, void *param, bool wait);
@@ -1350,6 +1363,24 @@ EXPORT void obs_source_draw(gs_texture_t *image, int x, int y, uint32_t cx, uint
 EXPORT void obs_source_output_video(obs_source_t *source, const struct obs_source_frame *frame);
 EXPORT void obs_source_output_video2(obs_source_t *source, const struct obs_source_frame2 *frame);
 
+typedef void (*obs_source_frame_release_t)(void *param);
+
+/**
+ * Outputs asynchronous video data without copying it.  The planes of the frame
+ * have to stay valid until libobs calls release, which can happen on any
+ * thread and with internal locks held, so it must not call back into libobs.
+ * If libobs can not hold on to the frame it is copied and released right
+ * away.
+ */
+EXPORT void obs_source_output_video_lent(obs_source_t *source, const struct obs_source_frame *frame,
+					 obs_source_frame_release_t release, void *param);
+
+/**
+ * Releases all lent frames of the source, frames that are still needed are
+ * copied first.  Has to be called before the lent memory is freed.
+ */
+EXPORT void obs_source_return_lent_video(obs_source_t *source);
+
 EXPORT void obs_source_set_async_rotation(obs_source_t *source, long rotation);
 
 EXPORT void obs_source_output_cea708(obs_source_t *source, const struct obs_source_cea_708 *captions);
@@ -2370,6 +2401,25 @@ EXPORT uint32_t obs_encoder_get_caps(const obs_encoder_t *encoder);
 EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst, struct encoder_packet *src);
 EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
 
+/**
+ * Allocates a pooled payload of the given size for a packet and sets the
+ * packet's data and size to it.  Encoders can write their output straight
+ * into it from the encode callback, outputs then receive the packet without
+ * it being copied.  The buffer is only valid until the encode callback
+ * returns.
+ */
+EXPORT uint8_t *obs_encoder_packet_alloc(obs_encoder_t *encoder, struct encoder_packet *packet, size_t size);
+
+struct obs_encoder_packet_pool_stats {
+	long allocs;    /**< Pooled payloads currently referenced */
+	long cached;    /**< Idle payloads kept for reuse */
+	long reused;    /**< Allocations served from idle payloads */
+	long copies;    /**< Encoder packets copied into the pool */
+	long zero_copy; /**< Encoder packets written into the pool directly */
+};
+
+EXPORT void obs_encoder_packet_pool_stats(struct obs_encoder_packet_pool_stats *stats);
+
 EXPORT void *obs_encoder_create_rerouted(obs_encoder_t *encoder, const char *reroute_id);
 
 /** Returns whether encoder is paused */
@@ -27,6 +27,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -628,6 +630,61 @@ int os_safe_replace(const char *target, const char *from, const char *backup)
 	return rename(from, target);
 }
 
+struct os_mapped_file {
+	void *data;
+	size_t size;
+};
+
+os_mapped_file_t *os_map_file(const char *path)
+{
+	struct os_mapped_file *map;
+	struct stat st;
+	void *data;
+	int fd;
+
+	if (!path)
+		return NULL;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	map = bmalloc(sizeof(*map));
+	map->data = data;
+	map->size = (size_t)st.st_size;
+	return map;
+}
+
+void os_unmap_file(os_mapped_file_t *map)
+{
+	if (!map)
+		return;
+
+	munmap(map->data, map->size);
+	bfree(map);
+}
+
+const void *os_mapped_file_data(const os_mapped_file_t *map)
+{
+	return map ? map->data : NULL;
+}
+
+size_t os_mapped_file_size(const os_mapped_file_t *map)
+{
+	return map ? map->size : 0;
+}
+
 #if !defined(__APPLE__)
 os_performance_token_t *os_request_high_performance(const char *reason)
 {
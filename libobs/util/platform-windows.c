@@ -840,6 +840,70 @@ fail:
 	return code;
 }
 
+struct os_mapped_file {
+	void *data;
+	size_t size;
+};
+
+os_mapped_file_t *os_map_file(const char *path)
+{
+	struct os_mapped_file *map = NULL;
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	wchar_t *wpath = NULL;
+	LARGE_INTEGER size;
+	void *data;
+
+	if (!path || !os_utf8_to_wcs_ptr(path, 0, &wpath))
+		return NULL;
+
+	file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	bfree(wpath);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || (uint64_t)size.QuadPart > SIZE_MAX)
+		goto cleanup;
+
+	mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+		goto cleanup;
+
+	/* the view keeps the file and mapping objects alive */
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+		goto cleanup;
+
+	map = bmalloc(sizeof(*map));
+	map->data = data;
+	map->size = (size_t)size.QuadPart;
+
+cleanup:
+	if (mapping)
+		CloseHandle(mapping);
+	CloseHandle(file);
+	return map;
+}
+
+void os_unmap_file(os_mapped_file_t *map)
+{
+	if (!map)
+		return;
+
+	UnmapViewOfFile(map->data);
+	bfree(map);
+}
+
+const void *os_mapped_file_data(const os_mapped_file_t *map)
+{
+	return map ? map->data : NULL;
+}
+
+size_t os_mapped_file_size(const os_mapped_file_t *map)
+{
+	return map ? map->size : 0;
+}
+
 BOOL WINAPI DllMain(HINSTANCE hinst_dll, DWORD reason, LPVOID reserved)
 {
 	switch (reason) {
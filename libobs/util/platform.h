@@ -57,6 +57,15 @@ EXPORT bool os_quick_write_mbs_file(const char *path, const char *str, size_t le
 EXPORT int64_t os_get_file_size(const char *path);
 EXPORT int64_t os_get_free_space(const char *path);
 
+/* read-only memory mapping of an entire file; pages are loaded on demand */
+struct os_mapped_file;
+typedef struct os_mapped_file os_mapped_file_t;
+
+EXPORT os_mapped_file_t *os_map_file(const char *path);
+EXPORT void os_unmap_file(os_mapped_file_t *map);
+EXPORT const void *os_mapped_file_data(const os_mapped_file_t *map);
+EXPORT size_t os_mapped_file_size(const os_mapped_file_t *map);
+
 EXPORT size_t os_mbs_to_wcs(const char *str, size_t str_len, wchar_t *dst, size_t dst_size);
 EXPORT size_t os_utf8_to_wcs(const char *str, size_t len, wchar_t *dst, size_t dst_size);
 EXPORT size_t os_wcs_to_mbs(const wchar_t *str, size_t len, char *dst, size_t dst_size);
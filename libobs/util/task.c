@@ -2,6 +2,7 @@
 #include "bmem.h"
 #include "threading.h"
 #include "deque.h"
+#include "platform.h"
 
 struct os_task_queue {
 	pthread_t thread;
@@ -162,3 +163,285 @@ static void *tiny_tubular_task_thread(void *param)
 
 	return NULL;
 }
+
+/* ------------------------------------------------------------------------- */
+
+#define OS_TASK_PRIORITY_COUNT (OS_TASK_PRIORITY_HIGH + 1)
+
+struct os_task_worker {
+	struct os_task_pool *pool;
+	pthread_t thread;
+	bool thread_created;
+	os_sem_t *sem;
+	volatile bool idle;
+
+	pthread_mutex_t mutex;
+	/* tasks with an affinity key, these are never stolen */
+	struct deque pinned[OS_TASK_PRIORITY_COUNT];
+	struct deque tasks[OS_TASK_PRIORITY_COUNT];
+};
+
+struct os_task_pool {
+	struct os_task_worker *workers;
+	size_t num_workers;
+	volatile long next_worker;
+	volatile bool exit;
+
+	pthread_mutex_t wait_mutex;
+	long pending;
+	os_event_t *done_event;
+};
+
+static THREAD_LOCAL struct os_task_worker *current_worker = NULL;
+
+static void *task_pool_thread(void *param);
+
+static void task_pool_free(struct os_task_pool *pool)
+{
+	os_atomic_set_bool(&pool->exit, true);
+
+	for (size_t i = 0; i < pool->num_workers; i++) {
+		struct os_task_worker *w = pool->workers + i;
+		if (w->thread_created) {
+			os_sem_post(w->sem);
+			pthread_join(w->thread, NULL);
+		}
+	}
+
+	for (size_t i = 0; i < pool->num_workers; i++) {
+		struct os_task_worker *w = pool->workers + i;
+
+		for (size_t p = 0; p < OS_TASK_PRIORITY_COUNT; p++) {
+			deque_free(&w->pinned[p]);
+			deque_free(&w->tasks[p]);
+		}
+		os_sem_destroy(w->sem);
+		pthread_mutex_destroy(&w->mutex);
+	}
+
+	os_event_destroy(pool->done_event);
+	pthread_mutex_destroy(&pool->wait_mutex);
+	bfree(pool->workers);
+	bfree(pool);
+}
+
+os_task_pool_t *os_task_pool_create(size_t num_workers)
+{
+	struct os_task_pool *pool;
+
+	if (!num_workers) {
+		int cores = os_get_logical_cores();
+		num_workers = cores > 0 ? (size_t)cores : 1;
+	}
+
+	pool = bzalloc(sizeof(*pool));
+	pool->workers = bzalloc(sizeof(struct os_task_worker) * num_workers);
+
+	if (pthread_mutex_init(&pool->wait_mutex, NULL) != 0)
+		goto fail1;
+	if (os_event_init(&pool->done_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail2;
+
+	os_event_signal(pool->done_event);
+
+	for (size_t i = 0; i < num_workers; i++) {
+		struct os_task_worker *w = pool->workers + i;
+		w->pool = pool;
+
+		if (pthread_mutex_init(&w->mutex, NULL) != 0)
+			goto fail3;
+		if (os_sem_init(&w->sem, 0) != 0) {
+			pthread_mutex_destroy(&w->mutex);
+			goto fail3;
+		}
+
+		pool->num_workers++;
+	}
+
+	for (size_t i = 0; i < num_workers; i++) {
+		struct os_task_worker *w = pool->workers + i;
+		if (pthread_create(&w->thread, NULL, task_pool_thread, w) != 0)
+			goto fail3;
+		w->thread_created = true;
+	}
+
+	return pool;
+
+fail3:
+	task_pool_free(pool);
+	return NULL;
+
+fail2:
+	pthread_mutex_destroy(&pool->wait_mutex);
+fail1:
+	bfree(pool->workers);
+	bfree(pool);
+	return NULL;
+}
+
+static inline struct os_task_worker *affinity_worker(struct os_task_pool *pool, const void *affinity)
+{
+	uint64_t hash = (uint64_t)(uintptr_t)affinity * 0x9E3779B97F4A7C15ULL;
+	return pool->workers + (size_t)(hash >> 32) % pool->num_workers;
+}
+
+bool os_task_pool_queue_task(os_task_pool_t *pool, os_task_t task, void *param, enum os_task_priority priority,
+			     const void *affinity)
+{
+	struct os_task_info ti = {
+		task,
+		param,
+	};
+	struct os_task_worker *w;
+
+	if (!pool || !task)
+		return false;
+	if ((size_t)priority >= OS_TASK_PRIORITY_COUNT)
+		priority = OS_TASK_PRIORITY_NORMAL;
+
+	pthread_mutex_lock(&pool->wait_mutex);
+	if (pool->pending++ == 0)
+		os_event_reset(pool->done_event);
+	pthread_mutex_unlock(&pool->wait_mutex);
+
+	/* tasks queued from a worker stay on it unless they get stolen */
+	if (affinity)
+		w = affinity_worker(pool, affinity);
+	else if (current_worker && current_worker->pool == pool)
+		w = current_worker;
+	else
+		w = pool->workers + (size_t)os_atomic_inc_long(&pool->next_worker) % pool->num_workers;
+
+	pthread_mutex_lock(&w->mutex);
+	deque_push_back(affinity ? &w->pinned[priority] : &w->tasks[priority], &ti, sizeof(ti));
+	pthread_mutex_unlock(&w->mutex);
+	os_sem_post(w->sem);
+
+	/* wake up someone to steal it if its worker is busy */
+	if (!affinity && !os_atomic_load_bool(&w->idle)) {
+		for (size_t i = 0; i < pool->num_workers; i++) {
+			struct os_task_worker *other = pool->workers + i;
+
+			if (other != w && os_atomic_load_bool(&other->idle)) {
+				os_sem_post(other->sem);
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+void os_task_pool_destroy(os_task_pool_t *pool)
+{
+	if (!pool)
+		return;
+
+	/* nothing can queue new tasks once all of them are done */
+	os_task_pool_wait(pool);
+	task_pool_free(pool);
+}
+
+bool os_task_pool_wait(os_task_pool_t *pool)
+{
+	bool had_tasks;
+
+	if (!pool || os_task_pool_inside(pool))
+		return false;
+
+	pthread_mutex_lock(&pool->wait_mutex);
+	had_tasks = pool->pending != 0;
+	pthread_mutex_unlock(&pool->wait_mutex);
+
+	os_event_wait(pool->done_event);
+	return had_tasks;
+}
+
+bool os_task_pool_inside(os_task_pool_t *pool)
+{
+	return pool && current_worker && current_worker->pool == pool;
+}
+
+bool os_task_pool_inside_affinity(os_task_pool_t *pool, const void *affinity)
+{
+	return os_task_pool_inside(pool) && affinity && current_worker == affinity_worker(pool, affinity);
+}
+
+static bool pop_task(struct os_task_worker *w, struct os_task_info *ti)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&w->mutex);
+
+	for (size_t p = OS_TASK_PRIORITY_COUNT; p > 0 && !found; p--) {
+		struct deque *dq = w->pinned[p - 1].size ? &w->pinned[p - 1] : &w->tasks[p - 1];
+
+		if (dq->size) {
+			deque_pop_front(dq, ti, sizeof(*ti));
+			found = true;
+		}
+	}
+
+	pthread_mutex_unlock(&w->mutex);
+	return found;
+}
+
+/* takes the most recently queued task of another worker, which is the one
+ * that worker would get to last */
+static bool steal_task(struct os_task_worker *w, struct os_task_info *ti)
+{
+	struct os_task_pool *pool = w->pool;
+	size_t idx = (size_t)(w - pool->workers);
+
+	for (size_t i = 1; i < pool->num_workers; i++) {
+		struct os_task_worker *victim = pool->workers + (idx + i) % pool->num_workers;
+		bool found = false;
+
+		pthread_mutex_lock(&victim->mutex);
+
+		for (size_t p = OS_TASK_PRIORITY_COUNT; p > 0 && !found; p--) {
+			if (victim->tasks[p - 1].size) {
+				deque_pop_back(&victim->tasks[p - 1], ti, sizeof(*ti));
+				found = true;
+			}
+		}
+
+		pthread_mutex_unlock(&victim->mutex);
+
+		if (found)
+			return true;
+	}
+
+	return false;
+}
+
+static void *task_pool_thread(void *param)
+{
+	struct os_task_worker *w = param;
+	struct os_task_pool *pool = w->pool;
+	struct os_task_info ti;
+
+	current_worker = w;
+	os_set_thread_name(__FUNCTION__);
+
+	for (;;) {
+		while (pop_task(w, &ti) || steal_task(w, &ti)) {
+			ti.task(ti.param);
+
+			pthread_mutex_lock(&pool->wait_mutex);
+			if (--pool->pending == 0)
+				os_event_signal(pool->done_event);
+			pthread_mutex_unlock(&pool->wait_mutex);
+		}
+
+		if (os_atomic_load_bool(&pool->exit))
+			break;
+
+		os_atomic_set_bool(&w->idle, true);
+		os_sem_wait(w->sem);
+		os_atomic_set_bool(&w->idle, false);
+	}
+
+	current_worker = NULL;
+	return NULL;
+}
@@ -17,6 +17,32 @@ EXPORT void os_task_queue_destroy(os_task_queue_t *tt);
 EXPORT bool os_task_queue_wait(os_task_queue_t *tt);
 EXPORT bool os_task_queue_inside(os_task_queue_t *tt);
 
+/* Pool of worker threads for independent background jobs.  Every worker has
+ * its own queues and idle workers steal from busy ones.  Tasks that share a
+ * non-NULL affinity key always run on the same worker, one after another in
+ * the order they were queued.  Higher priority tasks of a worker run first. */
+
+struct os_task_pool;
+typedef struct os_task_pool os_task_pool_t;
+
+enum os_task_priority {
+	OS_TASK_PRIORITY_LOW,
+	OS_TASK_PRIORITY_NORMAL,
+	OS_TASK_PRIORITY_HIGH,
+};
+
+/* 0 workers creates one per logical core */
+EXPORT os_task_pool_t *os_task_pool_create(size_t num_workers);
+EXPORT bool os_task_pool_queue_task(os_task_pool_t *pool, os_task_t task, void *param, enum os_task_priority priority,
+				    const void *affinity);
+/* runs the remaining tasks first, must not be called from a pool task */
+EXPORT void os_task_pool_destroy(os_task_pool_t *pool);
+/* waits until the pool has no tasks left, returns true if there were any */
+EXPORT bool os_task_pool_wait(os_task_pool_t *pool);
+EXPORT bool os_task_pool_inside(os_task_pool_t *pool);
+/* true only on the worker that runs the tasks with this affinity key */
+EXPORT bool os_task_pool_inside_affinity(os_task_pool_t *pool, const void *affinity);
+
 #ifdef __cplusplus
 }
 #endif
@@ -140,3 +140,14 @@ static inline bool os_atomic_load_bool(const volatile bool *ptr)
 
 	return b;
 }
+
+static inline void os_atomic_store_ptr(void *volatile *ptr, void *val)
+{
+	_InterlockedExchangePointer(ptr, val);
+}
+
+static inline void *os_atomic_load_ptr(void *const volatile *ptr)
+{
+	/* a compare exchange that never swaps is a full barrier load */
+	return _InterlockedCompareExchangePointer((void *volatile *)ptr, NULL, NULL);
+}
@@ -0,0 +1,279 @@
+"""Build the precompiled Bible/hymn pack (worship.pack) used by SubtitleManager.
+
+The pack is memory-mapped at runtime (see frontend/components/WorshipPack.hpp
+for the layout), so everything the UI needs - verse text, book table, hymn
+table and the keyword search index - is computed here once instead of at
+every startup.
+
+The index must match BibleIndex::Finalize() in
+frontend/components/BibleIndex.cpp: keys are single case folded UTF-16 code
+units and pairs of them (unit << 16 | unit), whitespace is skipped.
+"""
+
+import argparse
+import json
+import logging
+import os
+import struct
+import sys
+import unicodedata
+
+PACK_MAGIC = b"OBSWPACK"
+PACK_VERSION = 3
+HYMN_ABSENT = 0xFFFFFFFF
+
+# Keep in sync with canonicalBooks in frontend/components/BibleIndex.cpp
+CANONICAL_BOOKS = [
+    "창", "출", "레", "민", "신", "수", "삿", "룻", "삼상", "삼하",
+    "왕상", "왕하", "대상", "대하", "스", "느", "에", "욥", "시", "잠",
+    "전", "아", "사", "렘", "애", "겔", "단", "호", "욜", "암",
+    "옵", "욘", "미", "나", "합", "습", "학", "슥", "말",
+    "마", "막", "눅", "요", "행", "롬", "고전", "고후", "갈", "엡",
+    "빌", "골", "살전", "살후", "딤전", "딤후", "딛", "몬", "히", "약",
+    "벧전", "벧후", "요일", "요이", "요삼", "유", "계",
+]  # fmt: skip
+
+BOOK_RANKS = {name: rank for rank, name in enumerate(CANONICAL_BOOKS)}
+
+
+def section_id(name: str) -> int:
+    return struct.unpack("<I", name.encode("ascii"))[0]
+
+
+def parse_reference(reference: str):
+    """Mirror BibleIndex::ParseReference ("창1:1" -> ("창", 1, 1))."""
+    digits = 0
+    while (
+        digits < len(reference) and unicodedata.category(reference[digits]) != "Nd"
+    ):
+        digits += 1
+    if digits == 0 or digits == len(reference):
+        return None
+
+    colon = reference.find(":", digits)
+    if colon < 0:
+        return None
+
+    try:
+        chapter = int(reference[digits:colon])
+        verse = int(reference[colon + 1 :])
+    except ValueError:
+        return None
+
+    if not (0 < chapter <= 0xFFFF and 0 < verse <= 0xFFFF):
+        return None
+    return reference[:digits], chapter, verse
+
+
+def fold_utf16(text: str):
+    """Simple (1:1) case folding like QString::toCaseFolded, as UTF-16 units."""
+    folded = []
+    for char in text:
+        candidate = char.casefold()
+        if len(candidate) != 1:
+            candidate = char.lower() if len(char.lower()) == 1 else char
+        folded.append(candidate)
+
+    data = "".join(folded).encode("utf-16-le")
+    return struct.unpack("<%dH" % (len(data) // 2), data)
+
+
+def is_space(unit: int) -> bool:
+    """Same set as QChar::isSpace for a single UTF-16 unit."""
+    if unit == 0x20 or 0x09 <= unit <= 0x0D:
+        return True
+    if unit < 0x80 or 0xD800 <= unit <= 0xDFFF:
+        return False
+    if unit in (0x85, 0xA0):
+        return True
+    return unicodedata.category(chr(unit)) in ("Zs", "Zl", "Zp")
+
+
+def verse_grams(text: str):
+    units = fold_utf16(text)
+    grams = {unit for unit in units if not is_space(unit)}
+    for a, b in zip(units, units[1:]):
+        if is_space(a) or is_space(b):
+            continue
+        grams.add((a << 16) | b)
+    return grams
+
+
+def load_hymns(hymn_dir: str):
+    hymns = {}
+    if not hymn_dir or not os.path.isdir(hymn_dir):
+        return hymns
+
+    for file_name in os.listdir(hymn_dir):
+        stem, ext = os.path.splitext(file_name)
+        if ext != ".txt" or not stem.isdigit():
+            continue
+
+        with open(
+            os.path.join(hymn_dir, file_name), "r", encoding="utf-8-sig", newline=""
+        ) as hymn_file:
+            hymns[int(stem)] = hymn_file.read().replace("\r\n", "\n")
+
+    return hymns
+
+
+def build_pack(bible: dict, hymns: dict) -> bytes:
+    logger = logging.getLogger()
+
+    entries = []
+    for reference, text in bible.items():
+        parsed = parse_reference(reference)
+        if not parsed:
+            logger.info(f"Skipping invalid bible reference: {reference}")
+            continue
+        entries.append((parsed, str(text)))
+
+    books = sorted(
+        {book for (book, _, _), _ in entries},
+        key=lambda name: (BOOK_RANKS.get(name, sys.maxsize), name),
+    )
+    book_ids = {name: index for index, name in enumerate(books)}
+
+    entries.sort(key=lambda entry: (book_ids[entry[0][0]], entry[0][1], entry[0][2]))
+
+    text_blob = bytearray()
+    verse_table = bytearray()
+    book_first = [None] * len(books)
+    postings = {}
+    previous_key = None
+
+    for (book, chapter, verse), text in entries:
+        key = (book_ids[book], chapter, verse)
+        if key == previous_key:
+            continue
+        previous_key = key
+
+        verse_id = len(verse_table) // 16
+        if book_first[key[0]] is None:
+            book_first[key[0]] = verse_id
+
+        utf8 = text.encode("utf-8")
+        verse_table += struct.pack(
+            "<IIHHHH", len(text_blob), len(utf8), key[0], chapter, verse, 0
+        )
+        text_blob += utf8
+
+        for gram in verse_grams(text):
+            postings.setdefault(gram, []).append(verse_id)
+
+    verse_count = len(verse_table) // 16
+
+    book_table = bytearray()
+    for index, name in enumerate(books):
+        utf8 = name.encode("utf-8")
+        first = book_first[index] if book_first[index] is not None else verse_count
+        book_table += struct.pack("<IIII", len(text_blob), len(utf8), first, 0)
+        text_blob += utf8
+
+    gram_keys = sorted(postings)
+    gram_offsets = [0]
+    posting_list = []
+    for gram in gram_keys:
+        posting_list.extend(postings[gram])
+        gram_offsets.append(len(posting_list))
+
+    hymn_table = bytearray()
+    for number in range(1, max(hymns, default=0) + 1):
+        if number not in hymns:
+            # Missing numbers are distinct from present-but-empty hymns
+            hymn_table += struct.pack("<II", HYMN_ABSENT, 0)
+            continue
+        utf8 = hymns[number].encode("utf-8")
+        hymn_table += struct.pack("<II", len(text_blob), len(utf8))
+        text_blob += utf8
+
+    sections = [
+        ("TEXT", bytes(text_blob)),
+        ("VRSE", bytes(verse_table)),
+        ("BOOK", bytes(book_table)),
+        ("GKEY", struct.pack("<%dI" % len(gram_keys), *gram_keys)),
+        ("GOFF", struct.pack("<%dI" % len(gram_offsets), *gram_offsets)),
+        ("POST", struct.pack("<%dI" % len(posting_list), *posting_list)),
+        ("HYMN", bytes(hymn_table)),
+    ]
+
+    header_size = 16 + 24 * len(sections)
+    offset = (header_size + 7) & ~7
+
+    table = bytearray()
+    body = bytearray()
+    for name, data in sections:
+        table += struct.pack("<IIQQ", section_id(name), 0, offset, len(data))
+        body += data
+        padding = (-len(data)) % 8
+        body += b"\0" * padding
+        offset += len(data) + padding
+
+    header = struct.pack("<8sII", PACK_MAGIC, PACK_VERSION, len(sections))
+    header_padding = b"\0" * (((header_size + 7) & ~7) - header_size)
+
+    logger.info(
+        f"{verse_count} verses, {len(books)} books, {len(hymns)} hymns, "
+        f"{len(gram_keys)} index keys, {len(posting_list)} postings"
+    )
+    return header + bytes(table) + header_padding + bytes(body)
+
+
+def main() -> int:
+    script_dir = os.path.dirname(os.path.abspath(__file__))
+
+    parser = argparse.ArgumentParser(description="Build precompiled worship pack")
+    parser.add_argument(
+        "--bible",
+        type=str,
+        help="bible.json with {reference: text} entries",
+        default=os.path.join(script_dir, "bible.json"),
+    )
+    parser.add_argument(
+        "--hymns",
+        type=str,
+        help="Directory with NNN.txt hymn files",
+        default=os.path.join(script_dir, "bible_songs"),
+    )
+    parser.add_argument(
+        "--output",
+        "-o",
+        type=str,
+        help="Output pack file",
+        default=os.path.join(script_dir, "worship.pack"),
+    )
+    parser.add_argument(
+        "--loglevel", type=str, help="Set log level", default="INFO", required=False
+    )
+
+    arguments = parser.parse_args()
+
+    logging.basicConfig(level=arguments.loglevel, format="%(message)s")
+    logger = logging.getLogger()
+
+    try:
+        with open(arguments.bible, "r", encoding="utf-8-sig") as bible_file:
+            bible = json.load(bible_file)
+    except (OSError, json.JSONDecodeError) as e:
+        logger.error(f"Unable to read {arguments.bible}: {e}")
+        return 1
+
+    if not isinstance(bible, dict):
+        logger.error(f"{arguments.bible} is not a JSON object")
+        return 1
+
+    pack = build_pack(bible, load_hymns(arguments.hymns))
+
+    # Write next to the target and rename so a running instance never maps a
+    # half-written pack.
+    temp_path = arguments.output + ".tmp"
+    with open(temp_path, "wb") as pack_file:
+        pack_file.write(pack)
+    os.replace(temp_path, arguments.output)
+
+    logger.info(f"Wrote {arguments.output} ({len(pack)} bytes)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
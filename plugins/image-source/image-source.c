@@ -147,14 +147,7 @@ static void restart_gif(void *data)
 	struct image_source *context = data;
 
 	if (context->if4.image3.image2.image.is_animated_gif) {
-		context->if4.image3.image2.image.cur_frame = 0;
-		context->if4.image3.image2.image.cur_loop = 0;
-		context->if4.image3.image2.image.cur_time = 0;
-
-		obs_enter_graphics();
-		gs_image_file4_update_texture(&context->if4);
-		obs_leave_graphics();
-
+		gs_image_file_restart(&context->if4.image3.image2.image);
 		context->restart_gif = false;
 	}
 }
@@ -363,7 +356,7 @@ static enum gs_color_space image_source_get_color_space(void *data, size_t count
 static struct obs_source_info image_source_info = {
 	.id = "image_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB | OBS_SOURCE_PARALLEL_CREATE | OBS_SOURCE_PARALLEL_DESTROY,
 	.get_name = image_source_get_name,
 	.create = image_source_create,
 	.destroy = image_source_destroy,
@@ -23,6 +23,7 @@
 #include "formats.h"
 
 #include <util/darray.h>
+#include <util/threading.h>
 
 #include <gio/gio.h>
 #include <gio/gunixfdlist.h>
@@ -105,6 +106,12 @@ struct _obs_pipewire_stream {
 	struct spa_hook stream_listener;
 	struct spa_source *reneg;
 
+	/* buffers libobs is done reading, queued again on the loop thread */
+	pthread_mutex_t returned_mutex;
+	DARRAY(struct pw_buffer *) returned;
+	struct spa_source *return_event;
+	volatile long lent;
+
 	struct spa_video_info format;
 
 	enum spa_meta_videotransform_value transform;
@@ -627,6 +634,41 @@ static enum video_range_type video_color_range_from_spa_color_range(enum spa_vid
 	}
 }
 
+/* called by libobs from any thread */
+static void release_lent_pw_buffer(void *param)
+{
+	struct pw_buffer *b = param;
+	obs_pipewire_stream *obs_pw_stream = b->user_data;
+
+	pthread_mutex_lock(&obs_pw_stream->returned_mutex);
+	da_push_back(obs_pw_stream->returned, &b);
+	pthread_mutex_unlock(&obs_pw_stream->returned_mutex);
+
+	os_atomic_dec_long(&obs_pw_stream->lent);
+	pw_loop_signal_event(pw_thread_loop_get_loop(obs_pw_stream->obs_pw->thread_loop), obs_pw_stream->return_event);
+}
+
+static void queue_returned_buffers(void *data, uint64_t expirations)
+{
+	UNUSED_PARAMETER(expirations);
+	obs_pipewire_stream *obs_pw_stream = data;
+
+	pthread_mutex_lock(&obs_pw_stream->returned_mutex);
+	for (size_t i = 0; i < obs_pw_stream->returned.num; i++) {
+		if (obs_pw_stream->stream)
+			pw_stream_queue_buffer(obs_pw_stream->stream, obs_pw_stream->returned.array[i]);
+	}
+	da_resize(obs_pw_stream->returned, 0);
+	pthread_mutex_unlock(&obs_pw_stream->returned_mutex);
+}
+
+/* takes back all buffers libobs still reads from, before they go away */
+static void return_lent_pw_buffers(obs_pipewire_stream *obs_pw_stream)
+{
+	if (os_atomic_load_long(&obs_pw_stream->lent))
+		obs_source_return_lent_video(obs_pw_stream->source);
+}
+
 static bool prepare_obs_frame(obs_pipewire_stream *obs_pw_stream, struct obs_source_frame *frame)
 {
 	struct obs_pw_video_format obs_pw_video_format;
@@ -691,7 +733,11 @@ static void process_video_async(obs_pipewire_stream *obs_pw_stream)
 	}
 #endif
 
-	obs_source_output_video(obs_pw_stream->source, &out);
+	/* the buffer is queued again once libobs released it */
+	b->user_data = obs_pw_stream;
+	os_atomic_inc_long(&obs_pw_stream->lent);
+	obs_source_output_video_lent(obs_pw_stream->source, &out, release_lent_pw_buffer, b);
+	return;
 
 done:
 	pw_stream_queue_buffer(obs_pw_stream->stream, b);
@@ -1051,6 +1097,17 @@ static void on_param_changed_cb(void *user_data, uint32_t id, const struct spa_p
 	obs_pw_stream->negotiated = true;
 }
 
+static void on_remove_buffer_cb(void *user_data, struct pw_buffer *buffer)
+{
+	obs_pipewire_stream *obs_pw_stream = user_data;
+
+	return_lent_pw_buffers(obs_pw_stream);
+
+	pthread_mutex_lock(&obs_pw_stream->returned_mutex);
+	da_erase_item(obs_pw_stream->returned, &buffer);
+	pthread_mutex_unlock(&obs_pw_stream->returned_mutex);
+}
+
 static void on_state_changed_cb(void *user_data, enum pw_stream_state old, enum pw_stream_state state,
 				const char *error)
 {
@@ -1066,6 +1123,7 @@ static const struct pw_stream_events stream_events = {
 	PW_VERSION_STREAM_EVENTS,
 	.state_changed = on_state_changed_cb,
 	.param_changed = on_param_changed_cb,
+	.remove_buffer = on_remove_buffer_cb,
 	.process = on_process_cb,
 };
 
@@ -1197,6 +1255,7 @@ obs_pipewire_stream *obs_pipewire_connect_stream(obs_pipewire *obs_pw, obs_sourc
 	obs_pw_stream->resolution.set = connect_info->video.resolution != NULL;
 	obs_pw_stream->sync.acquire_syncobj_fd = -1;
 	obs_pw_stream->sync.release_syncobj_fd = -1;
+	pthread_mutex_init(&obs_pw_stream->returned_mutex, NULL);
 
 	if (obs_pw_stream->framerate.set)
 		obs_pw_stream->framerate.fraction = *connect_info->video.framerate;
@@ -1213,6 +1272,9 @@ obs_pipewire_stream *obs_pipewire_connect_stream(obs_pipewire *obs_pw, obs_sourc
 		pw_loop_add_event(pw_thread_loop_get_loop(obs_pw->thread_loop), renegotiate_format, obs_pw_stream);
 	blog(LOG_DEBUG, "[pipewire] registered event %p", obs_pw_stream->reneg);
 
+	obs_pw_stream->return_event =
+		pw_loop_add_event(pw_thread_loop_get_loop(obs_pw->thread_loop), queue_returned_buffers, obs_pw_stream);
+
 	/* Stream */
 	obs_pw_stream->stream = pw_stream_new(obs_pw->core, connect_info->stream_name, connect_info->stream_properties);
 	pw_stream_add_listener(obs_pw_stream->stream, &obs_pw_stream->stream_listener, &stream_events, obs_pw_stream);
@@ -1224,7 +1286,9 @@ obs_pipewire_stream *obs_pipewire_connect_stream(obs_pipewire *obs_pw, obs_sourc
 	obs_get_video_info(&obs_pw_stream->video_info);
 
 	if (!build_format_params(obs_pw_stream, &pod_builder, &params, &n_params)) {
+		pw_loop_destroy_source(pw_thread_loop_get_loop(obs_pw->thread_loop), obs_pw_stream->return_event);
 		pw_thread_loop_unlock(obs_pw->thread_loop);
+		pthread_mutex_destroy(&obs_pw_stream->returned_mutex);
 		bfree(obs_pw_stream);
 		return NULL;
 	}
@@ -1394,8 +1458,10 @@ void obs_pipewire_stream_destroy(obs_pipewire_stream *obs_pw_stream)
 		return;
 
 	output_flags = obs_source_get_output_flags(obs_pw_stream->source);
-	if (output_flags & OBS_SOURCE_ASYNC_VIDEO)
+	if (output_flags & OBS_SOURCE_ASYNC_VIDEO) {
 		obs_source_output_video(obs_pw_stream->source, NULL);
+		return_lent_pw_buffers(obs_pw_stream);
+	}
 
 	g_ptr_array_remove(obs_pw_stream->obs_pw->streams, obs_pw_stream);
 
@@ -1408,8 +1474,12 @@ void obs_pipewire_stream_destroy(obs_pipewire_stream *obs_pw_stream)
 	if (obs_pw_stream->stream)
 		pw_stream_disconnect(obs_pw_stream->stream);
 	g_clear_pointer(&obs_pw_stream->stream, pw_stream_destroy);
+	pw_loop_destroy_source(pw_thread_loop_get_loop(obs_pw_stream->obs_pw->thread_loop), obs_pw_stream->return_event);
 	pw_thread_loop_unlock(obs_pw_stream->obs_pw->thread_loop);
 
+	da_free(obs_pw_stream->returned);
+	pthread_mutex_destroy(&obs_pw_stream->returned_mutex);
+
 	g_clear_fd(&obs_pw_stream->sync.acquire_syncobj_fd, NULL);
 	g_clear_fd(&obs_pw_stream->sync.release_syncobj_fd, NULL);
 
@@ -95,6 +95,12 @@ struct v4l2_data {
 	int timeout_frames;
 };
 
+/* mmap'd buffer that libobs reads from directly */
+struct v4l2_lent_buffer {
+	struct v4l2_data *data;
+	uint32_t index;
+};
+
 /* forward declarations */
 static void v4l2_init(struct v4l2_data *data);
 static void v4l2_terminate(struct v4l2_data *data);
@@ -154,6 +160,22 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data, struct obs_source_frame
 	}
 }
 
+/*
+ * Give a buffer back to the driver once libobs is done with it
+ */
+static void v4l2_release_buffer(void *param)
+{
+	struct v4l2_lent_buffer *lent = param;
+	struct v4l2_buffer buf = {0};
+
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = lent->index;
+
+	if (v4l2_ioctl(lent->data->dev, VIDIOC_QBUF, &buf) < 0)
+		blog(LOG_ERROR, "%s: failed to enqueue buffer", lent->data->device_id);
+}
+
 /*
  * Worker thread to get video data
  */
@@ -168,6 +190,7 @@ static void *v4l2_thread(void *vptr)
 	struct timeval tv;
 	struct v4l2_buffer buf;
 	struct obs_source_frame out;
+	struct v4l2_lent_buffer *lent = NULL;
 	size_t plane_offsets[MAX_AV_PLANES];
 	int fps_num, fps_denom;
 	float ffps;
@@ -190,6 +213,12 @@ static void *v4l2_thread(void *vptr)
 
 	blog(LOG_DEBUG, "%s: new capture started", data->device_id);
 
+	lent = bzalloc(sizeof(struct v4l2_lent_buffer) * data->buffers.count);
+	for (uint_fast32_t i = 0; i < data->buffers.count; ++i) {
+		lent[i].data = data;
+		lent[i].index = (uint32_t)i;
+	}
+
 	frames = 0;
 	first_ts = 0;
 	v4l2_prep_obs_frame(data, &out, plane_offsets);
@@ -222,6 +251,9 @@ static void *v4l2_thread(void *vptr)
 			}
 
 			if (data->auto_reset) {
+				/* restarting queues all buffers again */
+				obs_source_return_lent_video(data->source);
+
 				if (v4l2_reset_capture(data->dev, &data->buffers) == 0)
 					blog(LOG_INFO, "%s: stream reset successful", data->device_id);
 				else
@@ -266,6 +298,14 @@ static void *v4l2_thread(void *vptr)
 		} else {
 			for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
 				out.data[i] = start + plane_offsets[i];
+
+			/* the buffer is queued again once libobs released it,
+			 * unless there are too few to keep one for the driver */
+			if (data->buffers.count > 2) {
+				obs_source_output_video_lent(data->source, &out, v4l2_release_buffer, &lent[buf.index]);
+				frames++;
+				continue;
+			}
 		}
 		obs_source_output_video(data->source, &out);
 
@@ -281,6 +321,8 @@ static void *v4l2_thread(void *vptr)
 	blog(LOG_INFO, "%s: Stopped capture after %" PRIu64 " frames", data->device_id, frames);
 
 exit:
+	obs_source_return_lent_video(data->source);
+	bfree(lent);
 	v4l2_stop_capture(data->dev);
 	return NULL;
 }
@@ -8,6 +8,10 @@ if(NOT TARGET OBS::media-playback)
   add_subdirectory("${CMAKE_SOURCE_DIR}/shared/media-playback" "${CMAKE_BINARY_DIR}/shared/media-playback")
 endif()
 
+if(NOT TARGET OBS::mp4-mux)
+  add_subdirectory("${CMAKE_SOURCE_DIR}/shared/mp4-mux" "${CMAKE_BINARY_DIR}/shared/mp4-mux")
+endif()
+
 if(NOT TARGET OBS::opts-parser)
   add_subdirectory("${CMAKE_SOURCE_DIR}/shared/opts-parser" "${CMAKE_BINARY_DIR}/shared/opts-parser")
 endif()
@@ -0,0 +1,290 @@
+// SPDX-License-Identifier: ISC
+
+#include "ffmpeg-mux-ring.h"
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FFM_RING_VERSION 1
+#define CACHE_LINE 64
+
+/* the positions are free-running byte counts, the writer only moves
+ * write_pos and the reader only moves read_pos, each on its own cache line */
+struct ffm_ring_header {
+	uint32_t version;
+	uint32_t size;
+	uint8_t pad1[CACHE_LINE - 2 * sizeof(uint32_t)];
+
+	volatile long write_pos;
+	uint8_t pad2[CACHE_LINE - sizeof(long)];
+
+	volatile long read_pos;
+	volatile long reader_waiting;
+	uint8_t pad3[CACHE_LINE - 2 * sizeof(long)];
+};
+
+struct ffm_ring {
+	struct ffm_ring_header *header;
+	uint8_t *data;
+	size_t mask;
+	size_t map_size;
+	char name[FFM_RING_NAME_SIZE];
+	bool owner;
+#ifdef _WIN32
+	HANDLE handle;
+#endif
+};
+
+static volatile long ring_counter = 0;
+
+#ifdef _WIN32
+static void *map_ring(struct ffm_ring *ring, size_t size, bool create)
+{
+	wchar_t *wname = NULL;
+	MEMORY_BASIC_INFORMATION mbi;
+	DWORD error;
+	void *ptr;
+
+	os_utf8_to_wcs_ptr(ring->name, 0, &wname);
+	if (!wname)
+		return NULL;
+
+	if (create)
+		ring->handle = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32),
+						  (DWORD)size, wname);
+	else
+		ring->handle = OpenFileMappingW(FILE_MAP_ALL_ACCESS, false, wname);
+	error = GetLastError();
+	bfree(wname);
+
+	if (!ring->handle)
+		return NULL;
+	if (create && error == ERROR_ALREADY_EXISTS)
+		return NULL;
+
+	ptr = MapViewOfFile(ring->handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (!ptr)
+		return NULL;
+
+	if (VirtualQuery(ptr, &mbi, sizeof(mbi)) == 0) {
+		UnmapViewOfFile(ptr);
+		return NULL;
+	}
+
+	ring->map_size = create ? size : mbi.RegionSize;
+	return ptr;
+}
+
+static void unmap_ring(struct ffm_ring *ring)
+{
+	if (ring->header)
+		UnmapViewOfFile(ring->header);
+	if (ring->handle)
+		CloseHandle(ring->handle);
+}
+
+static void make_name(char *name, size_t name_size)
+{
+	snprintf(name, name_size, "Local\\obs-ffm-%lu-%ld", (unsigned long)GetCurrentProcessId(),
+		 os_atomic_inc_long(&ring_counter));
+}
+#else
+static void *map_ring(struct ffm_ring *ring, size_t size, bool create)
+{
+	struct stat st;
+	void *ptr;
+	int fd;
+
+	if (create)
+		fd = shm_open(ring->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	else
+		fd = shm_open(ring->name, O_RDWR, 0);
+	if (fd == -1)
+		return NULL;
+
+	if (create && ftruncate(fd, (off_t)size) != 0)
+		goto fail;
+	if (!create) {
+		/* nobody else needs to find it anymore */
+		shm_unlink(ring->name);
+
+		if (fstat(fd, &st) != 0)
+			goto fail;
+		size = (size_t)st.st_size;
+	}
+
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED)
+		goto fail;
+
+	close(fd);
+	ring->map_size = size;
+	return ptr;
+
+fail:
+	close(fd);
+	return NULL;
+}
+
+static void unmap_ring(struct ffm_ring *ring)
+{
+	if (ring->header)
+		munmap(ring->header, ring->map_size);
+	if (ring->owner)
+		shm_unlink(ring->name);
+}
+
+static void make_name(char *name, size_t name_size)
+{
+	/* short enough for the 31 character limit on macOS */
+	snprintf(name, name_size, "/obs-ffm-%ld-%ld", (long)getpid(), os_atomic_inc_long(&ring_counter));
+}
+#endif
+
+struct ffm_ring *ffm_ring_create(size_t size, char *name, size_t name_size)
+{
+	struct ffm_ring *ring;
+	size_t map_size = sizeof(struct ffm_ring_header) + size;
+
+	if (!size || (size & (size - 1)) != 0 || size > UINT32_MAX / 2)
+		return NULL;
+
+	ring = bzalloc(sizeof(*ring));
+	ring->owner = true;
+	make_name(ring->name, sizeof(ring->name));
+
+	ring->header = map_ring(ring, map_size, true);
+	if (!ring->header) {
+		ffm_ring_close(ring);
+		return NULL;
+	}
+
+	memset(ring->header, 0, sizeof(*ring->header));
+	ring->header->version = FFM_RING_VERSION;
+	ring->header->size = (uint32_t)size;
+	ring->data = (uint8_t *)(ring->header + 1);
+	ring->mask = size - 1;
+
+	snprintf(name, name_size, "%s", ring->name);
+	return ring;
+}
+
+struct ffm_ring *ffm_ring_open(const char *name)
+{
+	struct ffm_ring *ring = bzalloc(sizeof(*ring));
+	struct ffm_ring_header *header;
+	size_t size;
+
+	snprintf(ring->name, sizeof(ring->name), "%s", name);
+
+	header = ring->header = map_ring(ring, 0, false);
+	if (!header)
+		goto fail;
+
+	size = header->size;
+	if (header->version != FFM_RING_VERSION || !size || (size & (size - 1)) != 0 ||
+	    ring->map_size < sizeof(*header) + size)
+		goto fail;
+
+	ring->data = (uint8_t *)(header + 1);
+	ring->mask = size - 1;
+	return ring;
+
+fail:
+	ffm_ring_close(ring);
+	return NULL;
+}
+
+void ffm_ring_close(struct ffm_ring *ring)
+{
+	if (!ring)
+		return;
+
+	unmap_ring(ring);
+	bfree(ring);
+}
+
+size_t ffm_ring_write(struct ffm_ring *ring, const void *data, size_t size)
+{
+	struct ffm_ring_header *header = ring->header;
+	unsigned long write_pos = (unsigned long)header->write_pos;
+	unsigned long read_pos = (unsigned long)os_atomic_load_long(&header->read_pos);
+	size_t free_size = header->size - (size_t)(write_pos - read_pos);
+	size_t offset = write_pos & ring->mask;
+	size_t first;
+
+	if (size > free_size)
+		size = free_size;
+	if (!size)
+		return 0;
+
+	first = header->size - offset;
+	if (first > size)
+		first = size;
+
+	memcpy(ring->data + offset, data, first);
+	memcpy(ring->data, (const uint8_t *)data + first, size - first);
+
+	os_atomic_store_long(&header->write_pos, (long)(write_pos + size));
+	return size;
+}
+
+bool ffm_ring_wake_reader(struct ffm_ring *ring)
+{
+	return os_atomic_exchange_long(&ring->header->reader_waiting, 0) != 0;
+}
+
+size_t ffm_ring_read(struct ffm_ring *ring, void *data, size_t size)
+{
+	struct ffm_ring_header *header = ring->header;
+	unsigned long read_pos = (unsigned long)header->read_pos;
+	unsigned long write_pos = (unsigned long)os_atomic_load_long(&header->write_pos);
+	size_t used = (size_t)(write_pos - read_pos);
+	size_t offset = read_pos & ring->mask;
+	size_t first;
+
+	if (size > used)
+		size = used;
+	if (!size)
+		return 0;
+
+	first = header->size - offset;
+	if (first > size)
+		first = size;
+
+	memcpy(data, ring->data + offset, first);
+	memcpy((uint8_t *)data + first, ring->data, size - first);
+
+	os_atomic_store_long(&header->read_pos, (long)(read_pos + size));
+	return size;
+}
+
+bool ffm_ring_prepare_wait(struct ffm_ring *ring)
+{
+	struct ffm_ring_header *header = ring->header;
+
+	/* pairs with the writer publishing write_pos before checking the
+	 * flag, one of the two always sees the other */
+	os_atomic_store_long(&header->reader_waiting, 1);
+
+	if (os_atomic_load_long(&header->write_pos) != header->read_pos) {
+		os_atomic_store_long(&header->reader_waiting, 0);
+		return false;
+	}
+
+	return true;
+}
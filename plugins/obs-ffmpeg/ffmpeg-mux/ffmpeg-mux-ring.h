@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: ISC
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Shared memory byte ring between obs-ffmpeg and obs-ffmpeg-mux.
+ *
+ * When available it replaces the stdin pipe as the packet stream: the output
+ * copies packet headers and payloads straight into the ring, and the muxer
+ * reads them back with the same framing it would read from the pipe.  The pipe
+ * stays open as the control channel.  A byte is written to it only when the
+ * muxer went to sleep on an empty ring, so a busy muxer receives no doorbells
+ * at all, and closing the pipe still signals the end of the stream. */
+
+#define FFM_RING_SIZE (32 * 1024 * 1024)
+#define FFM_RING_NAME_SIZE 64
+
+struct ffm_ring;
+
+/* output side, size must be a power of two */
+struct ffm_ring *ffm_ring_create(size_t size, char *name, size_t name_size);
+/* writes as much as fits and returns the number of bytes written */
+size_t ffm_ring_write(struct ffm_ring *ring, const void *data, size_t size);
+/* returns true if the muxer is waiting for a doorbell, and clears the flag */
+bool ffm_ring_wake_reader(struct ffm_ring *ring);
+
+/* muxer side */
+struct ffm_ring *ffm_ring_open(const char *name);
+/* reads up to size bytes and returns the number of bytes read */
+size_t ffm_ring_read(struct ffm_ring *ring, void *data, size_t size);
+/* announces that the muxer is about to wait for a doorbell, returns false if
+ * data arrived in the meantime and it should read again instead */
+bool ffm_ring_prepare_wait(struct ffm_ring *ring);
+
+void ffm_ring_close(struct ffm_ring *ring);
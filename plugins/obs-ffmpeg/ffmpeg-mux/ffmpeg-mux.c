@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "ffmpeg-mux.h"
+#include "ffmpeg-mux-ring.h"
 
 #include <util/threading.h>
 #include <util/platform.h>
@@ -45,6 +46,11 @@
 
 static char *global_stream_key = "";
 
+/* packets arrive through shared memory when the output created it, stdin then
+ * only carries doorbells */
+static struct ffm_ring *global_ring = NULL;
+static bool stdin_closed = false;
+
 struct resize_buf {
 	uint8_t *buf;
 	size_t size;
@@ -97,6 +103,7 @@ struct main_params {
 	int max_luminance;
 	char *acodec;
 	char *muxer_settings;
+	char *ring_name;
 	int codec_tag;
 };
 
@@ -410,6 +417,9 @@ static bool init_params(int *argc, char ***argv, struct main_params *params, str
 
 	get_opt_str(argc, argv, &params->muxer_settings, "muxer settings");
 
+	if (*argc)
+		get_opt_str(argc, argv, &params->ring_name, "shared memory name");
+
 	return true;
 }
 
@@ -595,11 +605,41 @@ static void ffmpeg_mux_header(struct ffmpeg_mux *ffm, uint8_t *data, struct ffm_
 	}
 }
 
+static size_t ring_read(void *vdata, size_t size)
+{
+	uint8_t *data = vdata;
+	size_t total = size;
+
+	while (size > 0) {
+		size_t in_size = ffm_ring_read(global_ring, data, size);
+		if (in_size) {
+			size -= in_size;
+			data += in_size;
+			continue;
+		}
+
+		/* the output closes the pipe after its last write */
+		if (stdin_closed)
+			return 0;
+
+		if (ffm_ring_prepare_wait(global_ring)) {
+			uint8_t doorbell;
+			if (fread(&doorbell, 1, 1, stdin) == 0)
+				stdin_closed = true;
+		}
+	}
+
+	return total;
+}
+
 static size_t safe_read(void *vdata, size_t size)
 {
 	uint8_t *data = vdata;
 	size_t total = size;
 
+	if (global_ring)
+		return ring_read(vdata, size);
+
 	while (size > 0) {
 		size_t in_size = fread(data, 1, size, stdin);
 		if (in_size == 0)
@@ -994,6 +1034,14 @@ static int ffmpeg_mux_init_internal(struct ffmpeg_mux *ffm, int argc, char *argv
 	if (!init_params(&argc, &argv, &ffm->params, &ffm->audio))
 		return FFM_ERROR;
 
+	if (ffm->params.ring_name && !global_ring) {
+		global_ring = ffm_ring_open(ffm->params.ring_name);
+		if (!global_ring) {
+			fprintf(stderr, "Couldn't open shared memory '%s'\n", ffm->params.ring_name);
+			return FFM_ERROR;
+		}
+	}
+
 	if (ffm->params.tracks) {
 		ffm->audio_header = calloc(ffm->params.tracks, sizeof(*ffm->audio_header));
 	}
@@ -1186,6 +1234,7 @@ int main(int argc, char *argv[])
 	ffmpeg_mux_free(&ffm);
 	resize_buf_free(&rb);
 	resize_buf_free(&rb_filename);
+	ffm_ring_close(global_ring);
 
 #ifdef _WIN32
 	for (int i = 0; i < argc; i++)
@@ -17,11 +17,16 @@
 #include "ffmpeg-mux/ffmpeg-mux.h"
 #include "obs-ffmpeg-mux.h"
 #include "obs-ffmpeg-formats.h"
+#include <mp4-mux.h>
 
 #ifdef _WIN32
 #include "util/windows/win-version.h"
 #endif
 
+#include <util/buffered-file-serializer.h>
+
+#include <inttypes.h>
+
 #include <libavformat/avformat.h>
 
 #define do_log(level, format, ...) \
@@ -57,7 +62,6 @@ static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 	stream->cur_time = 0;
 	stream->max_size = 0;
 	stream->max_time = 0;
-	stream->save_ts = 0;
 	stream->keyframes = 0;
 }
 
@@ -73,7 +77,7 @@ static void ffmpeg_mux_destroy(void *data)
 	da_free(stream->mux_packets);
 	deque_free(&stream->packets);
 
-	os_process_pipe_destroy(stream->pipe);
+	stop_pipe(stream);
 	dstr_free(&stream->path);
 	dstr_free(&stream->printable_path);
 	dstr_free(&stream->stream_key);
@@ -305,9 +309,78 @@ static void build_command_line(struct ffmpeg_muxer *stream, os_process_args_t **
 void start_pipe(struct ffmpeg_muxer *stream, const char *path)
 {
 	os_process_args_t *args = NULL;
+	char ring_name[FFM_RING_NAME_SIZE];
+
 	build_command_line(stream, &args, path);
+
+	/* packets are passed through shared memory if possible, the pipe then
+	 * only wakes up the muxer */
+	stream->ring = ffm_ring_create(FFM_RING_SIZE, ring_name, sizeof(ring_name));
+	if (stream->ring)
+		os_process_args_add_arg(args, ring_name);
+	else
+		warn("Failed to create shared memory, writing packets to the pipe");
+
 	stream->pipe = os_process_pipe_create2(args, "w");
 	os_process_args_destroy(args);
+
+	if (!stream->pipe) {
+		ffm_ring_close(stream->ring);
+		stream->ring = NULL;
+	}
+}
+
+int stop_pipe(struct ffmpeg_muxer *stream)
+{
+	/* waits for the muxer to exit, so it is done with the ring */
+	int ret = os_process_pipe_destroy(stream->pipe);
+	stream->pipe = NULL;
+
+	ffm_ring_close(stream->ring);
+	stream->ring = NULL;
+	return ret;
+}
+
+/* the muxer only sleeps once the ring is empty, wake it up if it does */
+static bool ring_doorbell(struct ffmpeg_muxer *stream, bool force)
+{
+	const uint8_t doorbell = 0;
+
+	if (!stream->ring || (!ffm_ring_wake_reader(stream->ring) && !force))
+		return true;
+
+	return os_process_pipe_write(stream->pipe, &doorbell, 1) == 1;
+}
+
+#define RING_FULL_DOORBELL_NS 100000000ULL
+
+static bool write_data(struct ffmpeg_muxer *stream, const uint8_t *data, size_t size)
+{
+	uint64_t last_doorbell = 0;
+
+	if (!stream->ring)
+		return os_process_pipe_write(stream->pipe, data, size) == size;
+
+	for (;;) {
+		size_t written = ffm_ring_write(stream->ring, data, size);
+		uint64_t now;
+
+		data += written;
+		size -= written;
+		if (!size)
+			return true;
+
+		/* the ring is full, wait for the muxer to catch up.  ringing
+		 * now and then also notices if it exited in the meantime */
+		now = os_gettime_ns();
+		if (now - last_doorbell >= RING_FULL_DOORBELL_NS) {
+			if (!ring_doorbell(stream, true))
+				return false;
+			last_doorbell = now;
+		}
+
+		os_sleep_ms(1);
+	}
 }
 
 static void set_file_not_readable_error(struct ffmpeg_muxer *stream, obs_data_t *settings, const char *path)
@@ -466,8 +539,7 @@ int deactivate(struct ffmpeg_muxer *stream, int code)
 	}
 
 	if (active(stream)) {
-		ret = os_process_pipe_destroy(stream->pipe);
-		stream->pipe = NULL;
+		ret = stop_pipe(stream);
 
 		os_atomic_set_bool(&stream->active, false);
 		os_atomic_set_bool(&stream->sent_headers, false);
@@ -603,7 +675,6 @@ static void generate_filename(struct ffmpeg_muxer *stream, struct dstr *dst, boo
 bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
 {
 	bool is_video = packet->type == OBS_ENCODER_VIDEO;
-	size_t ret;
 
 	struct ffm_packet_info info = {.pts = packet->pts,
 				       .dts = packet->dts,
@@ -622,16 +693,14 @@ bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
 		}
 	}
 
-	ret = os_process_pipe_write(stream->pipe, (const uint8_t *)&info, sizeof(info));
-	if (ret != sizeof(info)) {
-		warn("os_process_pipe_write for info structure failed");
+	if (!write_data(stream, (const uint8_t *)&info, sizeof(info))) {
+		warn("Writing info structure to muxer failed");
 		signal_failure(stream);
 		return false;
 	}
 
-	ret = os_process_pipe_write(stream->pipe, packet->data, packet->size);
-	if (ret != packet->size) {
-		warn("os_process_pipe_write for packet data failed");
+	if (!write_data(stream, packet->data, packet->size) || !ring_doorbell(stream, false)) {
+		warn("Writing packet data to muxer failed");
 		signal_failure(stream);
 		return false;
 	}
@@ -711,20 +780,17 @@ static inline bool should_split(struct ffmpeg_muxer *stream, struct encoder_pack
 
 static bool send_new_filename(struct ffmpeg_muxer *stream, const char *filename)
 {
-	size_t ret;
 	uint32_t size = (uint32_t)strlen(filename);
 	struct ffm_packet_info info = {.type = FFM_PACKET_CHANGE_FILE, .size = size};
 
-	ret = os_process_pipe_write(stream->pipe, (const uint8_t *)&info, sizeof(info));
-	if (ret != sizeof(info)) {
-		warn("os_process_pipe_write for info structure failed");
+	if (!write_data(stream, (const uint8_t *)&info, sizeof(info))) {
+		warn("Writing info structure to muxer failed");
 		signal_failure(stream);
 		return false;
 	}
 
-	ret = os_process_pipe_write(stream->pipe, (const uint8_t *)filename, size);
-	if (ret != size) {
-		warn("os_process_pipe_write for packet data failed");
+	if (!write_data(stream, (const uint8_t *)filename, size) || !ring_doorbell(stream, false)) {
+		warn("Writing file name to muxer failed");
 		signal_failure(stream);
 		return false;
 	}
@@ -913,16 +979,8 @@ static const char *replay_buffer_getname(void *type)
 	return obs_module_text("ReplayBuffer");
 }
 
-static void replay_buffer_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed)
+static void replay_buffer_request_save(struct ffmpeg_muxer *stream, int64_t duration)
 {
-	UNUSED_PARAMETER(id);
-	UNUSED_PARAMETER(hotkey);
-
-	if (!pressed)
-		return;
-
-	struct ffmpeg_muxer *stream = data;
-
 	if (os_atomic_load_bool(&stream->active)) {
 		obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
 		if (obs_encoder_paused(vencoder)) {
@@ -930,21 +988,47 @@ static void replay_buffer_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hot
 			return;
 		}
 
-		stream->save_ts = os_gettime_ns() / 1000LL;
+		struct replay_request req = {.ts = os_gettime_ns() / 1000LL, .duration = duration};
+
+		pthread_mutex_lock(&stream->save_mutex);
+		da_push_back(stream->save_requests, &req);
+		pthread_mutex_unlock(&stream->save_mutex);
 	}
 }
 
+static void replay_buffer_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed)
+{
+	UNUSED_PARAMETER(id);
+	UNUSED_PARAMETER(hotkey);
+
+	if (!pressed)
+		return;
+
+	replay_buffer_request_save(data, 0);
+}
+
 static void save_replay_proc(void *data, calldata_t *cd)
 {
 	replay_buffer_hotkey(data, 0, NULL, true);
 	UNUSED_PARAMETER(cd);
 }
 
+static void save_last_replay_proc(void *data, calldata_t *cd)
+{
+	long long seconds = calldata_int(cd, "seconds");
+
+	if (seconds > 0)
+		replay_buffer_request_save(data, seconds * 1000000LL);
+}
+
 static void get_last_replay(void *data, calldata_t *cd)
 {
 	struct ffmpeg_muxer *stream = data;
-	if (!os_atomic_load_bool(&stream->muxing))
-		calldata_set_string(cd, "path", stream->path.array);
+
+	pthread_mutex_lock(&stream->save_mutex);
+	if (!dstr_is_empty(&stream->last_replay))
+		calldata_set_string(cd, "path", stream->last_replay.array);
+	pthread_mutex_unlock(&stream->save_mutex);
 }
 
 static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
@@ -953,27 +1037,122 @@ static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
 	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
 	stream->output = output;
 
+	if (pthread_mutex_init(&stream->save_mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&stream->save_file_mutex, NULL) != 0) {
+		pthread_mutex_destroy(&stream->save_mutex);
+		goto fail;
+	}
+
 	stream->hotkey = obs_hotkey_register_output(output, "ReplayBuffer.Save", obs_module_text("ReplayBuffer.Save"),
 						    replay_buffer_hotkey, stream);
 
 	proc_handler_t *ph = obs_output_get_proc_handler(output);
 	proc_handler_add(ph, "void save()", save_replay_proc, stream);
+	proc_handler_add(ph, "void save_last(int seconds)", save_last_replay_proc, stream);
 	proc_handler_add(ph, "void get_last_replay(out string path)", get_last_replay, stream);
 
 	signal_handler_t *sh = obs_output_get_signal_handler(output);
-	signal_handler_add(sh, "void saved()");
+	signal_handler_add(sh, "void saved(string path)");
+	signal_handler_add(sh, "void save_progress(string path, float progress)");
 
 	return stream;
+
+fail:
+	bfree(stream);
+	return NULL;
 }
 
+static void replay_saves_reap(struct ffmpeg_muxer *stream, bool wait);
+
 static void replay_buffer_destroy(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
 	if (stream->hotkey)
 		obs_hotkey_unregister(stream->hotkey);
+
+	replay_saves_reap(stream, true);
+	replay_spill_release(stream->spill);
+	da_free(stream->saves);
+	da_free(stream->save_requests);
+	dstr_free(&stream->last_replay);
+	pthread_mutex_destroy(&stream->save_mutex);
+	pthread_mutex_destroy(&stream->save_file_mutex);
+
 	ffmpeg_mux_destroy(data);
 }
 
+static bool native_replay_codec(obs_encoder_t *enc)
+{
+	static const char *codecs[] = {"h264", "hevc", "av1",       "aac",       "opus",
+				       "flac", "alac", "pcm_s16le", "pcm_s24le", "pcm_f32le"};
+	const char *codec;
+
+	if (!enc)
+		return true;
+
+	codec = obs_encoder_get_codec(enc);
+	for (size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+		if (strcmp(codec, codecs[i]) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/* replays are written in-process by the mp4 muxer from obs-outputs when it
+ * can handle the file, anything else still goes through ffmpeg-mux */
+static bool native_replay_supported(struct ffmpeg_muxer *stream, obs_data_t *settings)
+{
+	/* custom muxer settings only mean something to FFmpeg */
+	if (astrcmpi(obs_data_get_string(settings, "extension"), "mp4") != 0 ||
+	    *obs_data_get_string(settings, "muxer_settings"))
+		return false;
+
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		if (!native_replay_codec(obs_output_get_video_encoder2(stream->output, i)))
+			return false;
+	}
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		if (!native_replay_codec(obs_output_get_audio_encoder(stream->output, i)))
+			return false;
+	}
+
+	return true;
+}
+
+/* max_size_mb covers both tiers, max_memory_mb of it is kept in memory.  The
+ * file lives in the plugin's config directory rather than next to the
+ * recordings, and files left there by a crash are removed on the next start */
+static void replay_buffer_create_spill(struct ffmpeg_muxer *stream)
+{
+	if (!stream->native_replay) {
+		warn("Keeping older packets on disk requires a format the native mp4 writer supports");
+	} else if (stream->max_size <= stream->max_memory) {
+		warn("Maximum size has to be larger than the memory limit to keep older packets on disk");
+	} else {
+		char *dir = obs_module_config_path("replay-buffer");
+		struct dstr path = {0};
+
+		if (dir && os_mkdirs(dir) != MKDIR_ERROR) {
+			replay_spill_remove_stale(dir);
+
+			dstr_printf(&path, "%s/%" PRIu64 ".spill", dir, os_gettime_ns());
+			stream->spill =
+				replay_spill_create(path.array, (uint64_t)(stream->max_size - stream->max_memory));
+		} else {
+			warn("Failed to create the directory for older packets");
+		}
+
+		dstr_free(&path);
+		bfree(dir);
+	}
+
+	/* stay within the memory limit either way */
+	if (!stream->spill)
+		stream->max_size = stream->max_memory;
+}
+
 static bool replay_buffer_start(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -986,6 +1165,15 @@ static bool replay_buffer_start(void *data)
 	obs_data_t *s = obs_output_get_settings(stream->output);
 	stream->max_time = obs_data_get_int(s, "max_time_sec") * 1000000LL;
 	stream->max_size = obs_data_get_int(s, "max_size_mb") * (1024 * 1024);
+	stream->max_memory = obs_data_get_int(s, "max_memory_mb") * (1024 * 1024);
+	stream->native_replay = native_replay_supported(stream, s);
+
+	if (!stream->native_replay)
+		info("Replays are written through ffmpeg-mux");
+	if (stream->max_memory > 0)
+		replay_buffer_create_spill(stream);
+	stream->spill_dropped = 0;
+	stream->spill_dropping = false;
 	obs_data_release(s);
 
 	os_atomic_set_bool(&stream->active, true);
@@ -996,7 +1184,7 @@ static bool replay_buffer_start(void *data)
 	return true;
 }
 
-static bool purge_front(struct ffmpeg_muxer *stream)
+static bool purge_front(struct ffmpeg_muxer *stream, bool spill)
 {
 	struct encoder_packet pkt;
 	bool keyframe;
@@ -1021,13 +1209,16 @@ static bool purge_front(struct ffmpeg_muxer *stream)
 		stream->cur_size -= (int64_t)pkt.size;
 	}
 
+	if (spill)
+		replay_spill_push(stream->spill, &pkt);
+
 	obs_encoder_packet_release(&pkt);
 	return keyframe;
 }
 
-static inline void purge(struct ffmpeg_muxer *stream)
+static inline void purge(struct ffmpeg_muxer *stream, bool spill)
 {
-	if (purge_front(stream)) {
+	if (purge_front(stream, spill)) {
 		struct encoder_packet pkt;
 
 		for (;;) {
@@ -1037,45 +1228,120 @@ static inline void purge(struct ffmpeg_muxer *stream)
 			if (pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe)
 				return;
 
-			purge_front(stream);
+			purge_front(stream, spill);
 		}
 	}
 }
 
+#define REPLAY_SPILL_BACKLOG (64 * 1024 * 1024)
+
+/* only whole GOPs can be dropped without breaking the replay, anything that
+ * is older than them is discarded with them */
+static void replay_buffer_drop(struct ffmpeg_muxer *stream, int64_t limit, int64_t size)
+{
+	if (!stream->spill_dropping)
+		warn("Writing older packets to disk is falling behind, dropping them");
+	stream->spill_dropping = true;
+	stream->spill_dropped += replay_spill_discard(stream->spill);
+
+	while (stream->keyframes > 2 && (stream->cur_size + size) > limit) {
+		size_t num = stream->packets.size;
+		purge(stream, false);
+		stream->spill_dropped += (num - stream->packets.size) / sizeof(struct encoder_packet);
+	}
+}
+
+/* GOPs beyond the memory limit move to the disk tier instead of being
+ * dropped, the time limit is then applied to the disk tier.  While the disk
+ * tier is held up by a save, GOPs stay in memory for up to another
+ * REPLAY_SPILL_BACKLOG bytes. */
+static inline void replay_buffer_spill(struct ffmpeg_muxer *stream, struct encoder_packet *pkt)
+{
+	int64_t size = (int64_t)pkt->size;
+
+	/* not worth writing if they are already too old */
+	while (stream->keyframes > 2 && (pkt->dts_usec - stream->cur_time) > stream->max_time)
+		purge(stream, false);
+
+	while (stream->keyframes > 2 && (stream->cur_size + size) > stream->max_memory) {
+		if (replay_spill_busy(stream->spill))
+			break;
+
+		purge(stream, true);
+		stream->spill_dropping = false;
+	}
+
+	if (stream->keyframes > 2 && (stream->cur_size + size) > stream->max_memory + REPLAY_SPILL_BACKLOG)
+		replay_buffer_drop(stream, stream->max_memory, size);
+
+	replay_spill_trim(stream->spill, pkt->dts_usec - stream->max_time);
+}
+
 static inline void replay_buffer_purge(struct ffmpeg_muxer *stream, struct encoder_packet *pkt)
 {
+	if (stream->spill) {
+		replay_buffer_spill(stream, pkt);
+		return;
+	}
+
 	if (stream->max_size) {
 		if (!stream->packets.size || stream->keyframes <= 2)
 			return;
 
 		while ((stream->cur_size + (int64_t)pkt->size) > stream->max_size)
-			purge(stream);
+			purge(stream, false);
 	}
 
 	if (!stream->packets.size || stream->keyframes <= 2)
 		return;
 
 	while ((pkt->dts_usec - stream->cur_time) > stream->max_time)
-		purge(stream);
+		purge(stream, false);
+}
+
+/* saved replays start at zero, the offsets are taken from the first video
+ * packet and the first packet of each audio track */
+struct replay_offsets {
+	bool found_video;
+	bool found_audio[MAX_AUDIO_MIXES];
+	int64_t video_offset;
+	int64_t video_pts_offset;
+	int64_t audio_offsets[MAX_AUDIO_MIXES];
+	int64_t audio_dts_offsets[MAX_AUDIO_MIXES];
+};
+
+static void rebase_packet(struct replay_offsets *offsets, struct encoder_packet *pkt)
+{
+	if (pkt->type == OBS_ENCODER_VIDEO) {
+		if (!offsets->found_video) {
+			offsets->video_pts_offset = pkt->pts;
+			offsets->video_offset = offsets->video_pts_offset * 1000000 / pkt->timebase_den;
+			offsets->found_video = true;
+		}
+
+		pkt->dts_usec -= offsets->video_offset;
+		pkt->dts -= offsets->video_pts_offset;
+		pkt->pts -= offsets->video_pts_offset;
+	} else {
+		if (!offsets->found_audio[pkt->track_idx]) {
+			offsets->found_audio[pkt->track_idx] = true;
+			offsets->audio_offsets[pkt->track_idx] = pkt->dts_usec;
+			offsets->audio_dts_offsets[pkt->track_idx] = pkt->dts;
+		}
+
+		pkt->dts_usec -= offsets->audio_offsets[pkt->track_idx];
+		pkt->dts -= offsets->audio_dts_offsets[pkt->track_idx];
+		pkt->pts -= offsets->audio_dts_offsets[pkt->track_idx];
+	}
 }
 
-static void insert_packet(mux_packets_t *packets, struct encoder_packet *packet, int64_t video_offset,
-			  int64_t *audio_offsets, int64_t video_pts_offset, int64_t *audio_dts_offsets)
+static void insert_packet(mux_packets_t *packets, struct encoder_packet *packet, struct replay_offsets *offsets)
 {
 	struct encoder_packet pkt;
 	size_t idx;
 
 	obs_encoder_packet_ref(&pkt, packet);
-
-	if (pkt.type == OBS_ENCODER_VIDEO) {
-		pkt.dts_usec -= video_offset;
-		pkt.dts -= video_pts_offset;
-		pkt.pts -= video_pts_offset;
-	} else {
-		pkt.dts_usec -= audio_offsets[pkt.track_idx];
-		pkt.dts -= audio_dts_offsets[pkt.track_idx];
-		pkt.pts -= audio_dts_offsets[pkt.track_idx];
-	}
+	rebase_packet(offsets, &pkt);
 
 	for (idx = packets->num; idx > 0; idx--) {
 		struct encoder_packet *p = packets->array + (idx - 1);
@@ -1086,10 +1352,44 @@ static void insert_packet(mux_packets_t *packets, struct encoder_packet *packet,
 	da_insert(*packets, idx, &pkt);
 }
 
+static void signal_saved(struct ffmpeg_muxer *stream, const char *path)
+{
+	calldata_t cd = {0};
+	signal_handler_t *sh = obs_output_get_signal_handler(stream->output);
+
+	pthread_mutex_lock(&stream->save_mutex);
+	dstr_copy(&stream->last_replay, path);
+	pthread_mutex_unlock(&stream->save_mutex);
+
+	calldata_set_string(&cd, "path", path);
+	signal_handler_signal(sh, "saved", &cd);
+	calldata_free(&cd);
+}
+
+/* signals every tenth of the file, returns the new step */
+static int signal_save_progress(struct ffmpeg_muxer *stream, const char *path, uint64_t done, uint64_t total,
+				int step)
+{
+	int new_step = total ? (int)(done * 10 / total) : 10;
+
+	if (new_step > step) {
+		calldata_t cd = {0};
+		signal_handler_t *sh = obs_output_get_signal_handler(stream->output);
+
+		calldata_set_string(&cd, "path", path);
+		calldata_set_float(&cd, "progress", (double)done / (double)total);
+		signal_handler_signal(sh, "save_progress", &cd);
+		calldata_free(&cd);
+	}
+
+	return new_step;
+}
+
 static void *replay_buffer_mux_thread(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
 	bool error = false;
+	int step = 0;
 
 	start_pipe(stream, stream->path.array);
 
@@ -1113,68 +1413,262 @@ static void *replay_buffer_mux_thread(void *data)
 			goto error;
 		}
 		obs_encoder_packet_release(pkt);
+
+		step = signal_save_progress(stream, stream->path.array, i + 1, stream->mux_packets.num, step);
 	}
 
 	info("Wrote replay buffer to '%s'", stream->path.array);
 
 error:
-	os_process_pipe_destroy(stream->pipe);
-	stream->pipe = NULL;
+	stop_pipe(stream);
 	if (error) {
 		for (size_t i = 0; i < stream->mux_packets.num; i++)
 			obs_encoder_packet_release(&stream->mux_packets.array[i]);
 	}
 	da_free(stream->mux_packets);
+
+	if (!error)
+		signal_saved(stream, stream->path.array);
+
 	os_atomic_set_bool(&stream->muxing, false);
+	return NULL;
+}
 
-	if (!error) {
-		calldata_t cd = {0};
-		signal_handler_t *sh = obs_output_get_signal_handler(stream->output);
-		signal_handler_signal(sh, "saved", &cd);
+/* ------------------------------------------------------------------------ */
+/* in-process replay writer */
+
+struct replay_save {
+	struct ffmpeg_muxer *stream;
+	struct replay_spill_reader *reader;
+	mux_packets_t packets;
+	struct mp4_mux *muxer;
+	struct serializer serializer;
+	struct dstr path;
+	pthread_t thread;
+	volatile bool done;
+};
+
+static void replay_save_destroy_muxer_task(void *ptr)
+{
+	struct mp4_mux *muxer = ptr;
+	mp4_mux_destroy(muxer);
+}
+
+static void replay_save_free(struct replay_save *save)
+{
+	if (save->reader)
+		replay_spill_close(save->reader);
+
+	for (size_t i = 0; i < save->packets.num; i++)
+		obs_encoder_packet_release(&save->packets.array[i]);
+	da_free(save->packets);
+
+	/* releases the encoders, which must not happen on their own thread */
+	if (save->muxer)
+		obs_queue_task(OBS_TASK_DESTROY, replay_save_destroy_muxer_task, save->muxer, false);
+
+	dstr_free(&save->path);
+	bfree(save);
+}
+
+static bool replay_save_submit(struct replay_save *save, struct replay_offsets *offsets, struct encoder_packet *pkt)
+{
+	struct ffmpeg_muxer *stream = save->stream;
+
+	rebase_packet(offsets, pkt);
+	if (mp4_mux_submit_packet(save->muxer, pkt))
+		return true;
+
+	warn("Could not write packet for file '%s'", save->path.array);
+	return false;
+}
+
+static void *replay_save_thread(void *data)
+{
+	struct replay_save *save = data;
+	struct ffmpeg_muxer *stream = save->stream;
+	struct replay_offsets offsets = {0};
+	struct encoder_packet pkt;
+	uint64_t start_time = os_gettime_ns();
+	uint64_t written = 0;
+	uint64_t total = 0;
+	bool success = true;
+	int step = 0;
+
+	os_set_thread_name("replay-buffer: save_thread");
+
+	/* concurrent saves must not pick the same file name */
+	pthread_mutex_lock(&stream->save_file_mutex);
+	generate_filename(stream, &save->path, false);
+	if (!buffered_file_serializer_init_defaults(&save->serializer, save->path.array)) {
+		warn("Could not open '%s' for writing", save->path.array);
+		success = false;
+	}
+	pthread_mutex_unlock(&stream->save_file_mutex);
+
+	if (!success)
+		goto finish;
+
+	if (save->reader)
+		total = replay_spill_remaining(save->reader);
+	for (size_t i = 0; i < save->packets.num; i++)
+		total += save->packets.array[i].size;
+
+	/* the muxer holds on to its own references until a fragment is
+	 * written, ours are dropped right away */
+	while (success && save->reader && replay_spill_read(save->reader, &pkt)) {
+		written += pkt.size;
+		success = replay_save_submit(save, &offsets, &pkt);
+		obs_encoder_packet_release(&pkt);
+
+		step = signal_save_progress(stream, save->path.array, written, total, step);
+	}
+
+	if (save->reader) {
+		if (!replay_spill_close(save->reader))
+			success = false;
+		save->reader = NULL;
+	}
+
+	for (size_t i = 0; success && i < save->packets.num; i++) {
+		struct encoder_packet *pkt = &save->packets.array[i];
+
+		written += pkt->size;
+		success = replay_save_submit(save, &offsets, pkt);
+		obs_encoder_packet_release(pkt);
+
+		step = signal_save_progress(stream, save->path.array, written, total, step);
+	}
+
+	if (!mp4_mux_finalise(save->muxer))
+		success = false;
+	buffered_file_serializer_free(&save->serializer);
+
+	if (success) {
+		info("Wrote replay buffer to '%s' in %" PRIu64 " ms", save->path.array,
+		     (os_gettime_ns() - start_time) / 1000000);
+		signal_saved(stream, save->path.array);
+	} else {
+		warn("Failed to write replay buffer to '%s'", save->path.array);
 	}
 
+finish:
+	os_atomic_set_bool(&save->done, true);
 	return NULL;
 }
 
-static void replay_buffer_save(struct ffmpeg_muxer *stream)
+static void replay_saves_reap(struct ffmpeg_muxer *stream, bool wait)
+{
+	for (size_t i = stream->saves.num; i > 0; i--) {
+		struct replay_save *save = stream->saves.array[i - 1];
+
+		if (!wait && !os_atomic_load_bool(&save->done))
+			continue;
+
+		pthread_join(save->thread, NULL);
+		replay_save_free(save);
+		da_erase(stream->saves, i - 1);
+	}
+}
+
+/* ------------------------------------------------------------------------ */
+
+static void reorder_packets(struct ffmpeg_muxer *stream, mux_packets_t *packets, size_t start)
 {
 	const size_t size = sizeof(struct encoder_packet);
 	size_t num_packets = stream->packets.size / size;
 
-	da_reserve(stream->mux_packets, num_packets);
+	struct replay_offsets offsets = {0};
+
+	da_reserve(*packets, num_packets - start);
 
-	/* ---------------------------- */
-	/* reorder packets */
+	for (size_t i = start; i < num_packets; i++)
+		insert_packet(packets, deque_data(&stream->packets, i * size), &offsets);
+}
 
-	bool found_video = false;
-	bool found_audio[MAX_AUDIO_MIXES] = {0};
-	int64_t video_offset = 0;
-	int64_t video_pts_offset = 0;
-	int64_t audio_offsets[MAX_AUDIO_MIXES] = {0};
-	int64_t audio_dts_offsets[MAX_AUDIO_MIXES] = {0};
+/* for "save last N seconds" requests, finds the last keyframe that still
+ * covers the whole duration, false if the memory tier does not reach back
+ * that far */
+static bool replay_start_index(struct ffmpeg_muxer *stream, int64_t cutoff, size_t *start)
+{
+	const size_t size = sizeof(struct encoder_packet);
 
-	for (size_t i = 0; i < num_packets; i++) {
-		struct encoder_packet *pkt;
-		pkt = deque_data(&stream->packets, i * size);
+	*start = 0;
+	if (cutoff == INT64_MIN)
+		return false;
 
-		if (pkt->type == OBS_ENCODER_VIDEO) {
-			if (!found_video) {
-				video_pts_offset = pkt->pts;
-				video_offset = video_pts_offset * 1000000 / pkt->timebase_den;
-				found_video = true;
-			}
-		} else {
-			if (!found_audio[pkt->track_idx]) {
-				found_audio[pkt->track_idx] = true;
-				audio_offsets[pkt->track_idx] = pkt->dts_usec;
-				audio_dts_offsets[pkt->track_idx] = pkt->dts;
-			}
+	for (size_t i = stream->packets.size / size; i > 0; i--) {
+		struct encoder_packet *pkt = deque_data(&stream->packets, (i - 1) * size);
+		if (pkt->type == OBS_ENCODER_VIDEO && pkt->keyframe && pkt->dts_usec <= cutoff) {
+			*start = i - 1;
+			return true;
 		}
+	}
+
+	return false;
+}
+
+static int64_t replay_cutoff(struct ffmpeg_muxer *stream, int64_t duration)
+{
+	const size_t size = sizeof(struct encoder_packet);
+	struct encoder_packet *pkt;
+
+	if (!duration || !stream->packets.size)
+		return INT64_MIN;
+
+	pkt = deque_data(&stream->packets, stream->packets.size - size);
+	return pkt->dts_usec - duration;
+}
+
+static void replay_save_start(struct ffmpeg_muxer *stream, int64_t cutoff)
+{
+	const size_t size = sizeof(struct encoder_packet);
+	struct replay_save *save = bzalloc(sizeof(*save));
+	size_t num_packets = stream->packets.size / size;
+	size_t start;
+
+	save->stream = stream;
+
+	/* older packets are read back from disk on the save thread */
+	if (!replay_start_index(stream, cutoff, &start) && stream->spill)
+		save->reader = replay_spill_open(stream->spill, cutoff);
+
+	da_reserve(save->packets, num_packets - start);
+	for (size_t i = start; i < num_packets; i++)
+		obs_encoder_packet_ref(da_push_back_new(save->packets), deque_data(&stream->packets, i * size));
+
+	save->muxer = mp4_mux_create(stream->output, &save->serializer, MP4_USE_NEGATIVE_CTS);
+
+	if (pthread_create(&save->thread, NULL, replay_save_thread, save) != 0) {
+		warn("Failed to create replay save thread");
+		replay_save_free(save);
+		return;
+	}
+
+	da_push_back(stream->saves, &save);
+}
+
+/* returns false if the save has to wait for the previous one */
+static bool replay_buffer_save(struct ffmpeg_muxer *stream, int64_t duration)
+{
+	int64_t cutoff = replay_cutoff(stream, duration);
+	size_t start;
+
+	if (stream->native_replay) {
+		replay_save_start(stream, cutoff);
+		return true;
+	}
+
+	if (os_atomic_load_bool(&stream->muxing))
+		return false;
 
-		insert_packet(&stream->mux_packets, pkt, video_offset, audio_offsets, video_pts_offset,
-			      audio_dts_offsets);
+	if (stream->mux_thread_joinable) {
+		pthread_join(stream->mux_thread, NULL);
+		stream->mux_thread_joinable = false;
 	}
 
+	replay_start_index(stream, cutoff, &start);
+	reorder_packets(stream, &stream->mux_packets, start);
 	generate_filename(stream, &stream->path, true);
 
 	os_atomic_set_bool(&stream->muxing, true);
@@ -1183,6 +1677,28 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 		warn("Failed to create muxer thread");
 		os_atomic_set_bool(&stream->muxing, false);
 	}
+
+	return true;
+}
+
+static bool next_save_request(struct ffmpeg_muxer *stream, int64_t sys_dts_usec, struct replay_request *req)
+{
+	bool due;
+
+	pthread_mutex_lock(&stream->save_mutex);
+	due = stream->save_requests.num && stream->save_requests.array[0].ts <= sys_dts_usec;
+	if (due)
+		*req = stream->save_requests.array[0];
+	pthread_mutex_unlock(&stream->save_mutex);
+
+	return due;
+}
+
+static void pop_save_request(struct ffmpeg_muxer *stream)
+{
+	pthread_mutex_lock(&stream->save_mutex);
+	da_erase(stream->save_requests, 0);
+	pthread_mutex_unlock(&stream->save_mutex);
 }
 
 static void deactivate_replay_buffer(struct ffmpeg_muxer *stream, int code)
@@ -1197,11 +1713,23 @@ static void deactivate_replay_buffer(struct ffmpeg_muxer *stream, int code)
 	os_atomic_set_bool(&stream->sent_headers, false);
 	os_atomic_set_bool(&stream->stopping, false);
 	replay_buffer_clear(stream);
+
+	if (stream->spill_dropped)
+		warn("Dropped %" PRIu64 " packets because writing them to disk fell behind", stream->spill_dropped);
+
+	/* saves that are still reading keep it alive */
+	replay_spill_release(stream->spill);
+	stream->spill = NULL;
+
+	pthread_mutex_lock(&stream->save_mutex);
+	da_clear(stream->save_requests);
+	pthread_mutex_unlock(&stream->save_mutex);
 }
 
 static void replay_buffer_data(void *data, struct encoder_packet *packet)
 {
 	struct ffmpeg_muxer *stream = data;
+	struct replay_request req;
 	struct encoder_packet pkt;
 
 	if (!active(stream))
@@ -1232,17 +1760,12 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
 		stream->keyframes++;
 
-	if (stream->save_ts && packet->sys_dts_usec >= stream->save_ts) {
-		if (os_atomic_load_bool(&stream->muxing))
-			return;
-
-		if (stream->mux_thread_joinable) {
-			pthread_join(stream->mux_thread, NULL);
-			stream->mux_thread_joinable = false;
-		}
+	replay_saves_reap(stream, false);
 
-		stream->save_ts = 0;
-		replay_buffer_save(stream);
+	while (next_save_request(stream, packet->sys_dts_usec, &req)) {
+		if (!replay_buffer_save(stream, req.duration))
+			break;
+		pop_save_request(stream);
 	}
 }
 
@@ -1250,6 +1773,7 @@ static void replay_buffer_defaults(obs_data_t *s)
 {
 	obs_data_set_default_int(s, "max_time_sec", 15);
 	obs_data_set_default_int(s, "max_size_mb", 500);
+	obs_data_set_default_int(s, "max_memory_mb", 0);
 	obs_data_set_default_string(s, "format", "%CCYY-%MM-%DD %hh-%mm-%ss");
 	obs_data_set_default_string(s, "extension", "mp4");
 	obs_data_set_default_bool(s, "allow_spaces", true);
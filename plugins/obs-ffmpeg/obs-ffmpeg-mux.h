@@ -9,11 +9,22 @@
 #include <util/platform.h>
 #include <util/threading.h>
 
+#include "ffmpeg-mux/ffmpeg-mux-ring.h"
+#include "replay-spill.h"
+
 typedef DARRAY(struct encoder_packet) mux_packets_t;
 
+struct replay_request {
+	int64_t ts;
+	int64_t duration;
+};
+
+struct replay_save;
+
 struct ffmpeg_muxer {
 	obs_output_t *output;
 	os_process_pipe_t *pipe;
+	struct ffm_ring *ring;
 	int64_t stop_ts;
 	uint64_t total_bytes;
 	bool sent_headers;
@@ -32,11 +43,20 @@ struct ffmpeg_muxer {
 	int64_t max_time;
 
 	/* replay buffer */
-	int64_t save_ts;
 	int keyframes;
 	obs_hotkey_id hotkey;
 	volatile bool muxing;
 	mux_packets_t mux_packets;
+	bool native_replay;
+	int64_t max_memory;
+	struct replay_spill *spill;
+	uint64_t spill_dropped;
+	bool spill_dropping;
+	pthread_mutex_t save_mutex;
+	pthread_mutex_t save_file_mutex;
+	DARRAY(struct replay_request) save_requests;
+	DARRAY(struct replay_save *) saves;
+	struct dstr last_replay;
 
 	/* split file */
 	bool found_video;
@@ -69,6 +89,7 @@ struct ffmpeg_muxer {
 bool stopping(struct ffmpeg_muxer *stream);
 bool active(struct ffmpeg_muxer *stream);
 void start_pipe(struct ffmpeg_muxer *stream, const char *path);
+int stop_pipe(struct ffmpeg_muxer *stream);
 bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet);
 bool send_headers(struct ffmpeg_muxer *stream);
 int deactivate(struct ffmpeg_muxer *stream, int code);
@@ -234,14 +234,15 @@ bool ffmpeg_video_encode(struct ffmpeg_video_encoder *enc, struct encoder_frame
 		if (enc->on_first_packet && enc->first_packet) {
 			enc->on_first_packet(enc->parent, &av_pkt, &enc->buffer.da);
 			enc->first_packet = false;
+
+			packet->data = enc->buffer.array;
+			packet->size = enc->buffer.num;
 		} else {
-			da_copy_array(enc->buffer, av_pkt.data, av_pkt.size);
+			memcpy(obs_encoder_packet_alloc(enc->encoder, packet, av_pkt.size), av_pkt.data, av_pkt.size);
 		}
 
 		packet->pts = av_pkt.pts;
 		packet->dts = av_pkt.dts;
-		packet->data = enc->buffer.array;
-		packet->size = enc->buffer.num;
 		packet->type = OBS_ENCODER_VIDEO;
 		packet->keyframe = !!(av_pkt.flags & AV_PKT_FLAG_KEY);
 		*received_packet = true;
@@ -0,0 +1,739 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "replay-spill.h"
+
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/deque.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#define do_log(level, format, ...) blog(level, "[replay buffer spill] " format, ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
+#define SPILL_BATCH_SIZE (4 * 1024 * 1024)
+#define SPILL_READ_SIZE (4 * 1024 * 1024)
+#define SPILL_PENDING_MAX (64 * 1024 * 1024)
+
+struct spill_record {
+	int64_t pts;
+	int64_t dts;
+	int64_t dts_usec;
+	int64_t sys_dts_usec;
+	int32_t timebase_num;
+	int32_t timebase_den;
+	int32_t priority;
+	int32_t drop_priority;
+	uint32_t size;
+	uint8_t type;
+	uint8_t keyframe;
+	uint8_t track_idx;
+	uint8_t reserved;
+};
+
+/* positions are free-running byte counts, the file offset is the position
+ * modulo the capacity */
+struct spill_gop {
+	uint64_t start;
+	uint64_t end;
+	int64_t dts_usec;
+};
+
+typedef DARRAY(struct encoder_packet) spill_packets_t;
+
+struct replay_spill {
+	volatile long refs;
+	struct dstr path;
+	FILE *file;
+	uint64_t capacity;
+
+	pthread_t thread;
+	bool thread_active;
+	volatile bool stop;
+	os_sem_t *write_sem;
+	os_event_t *unpin_event;
+
+	pthread_mutex_t mutex;
+	uint64_t write_pos;
+	struct deque gops;
+	struct deque pending;
+	uint64_t pending_bytes;
+	size_t writing;
+	uint64_t generation;
+	DARRAY(struct replay_spill_reader *) readers;
+	obs_encoder_t *video[MAX_OUTPUT_VIDEO_ENCODERS];
+	obs_encoder_t *audio[MAX_OUTPUT_AUDIO_ENCODERS];
+	bool failed;
+
+	/* writer thread only */
+	uint64_t batch_generation;
+	spill_packets_t batch_packets;
+	DARRAY(uint8_t) batch;
+};
+
+struct replay_spill_reader {
+	struct replay_spill *spill;
+	FILE *file;
+
+	/* pos is protected by the spill mutex, the writer does not overwrite
+	 * anything at or after it */
+	uint64_t pos;
+	uint64_t end;
+
+	uint8_t *buf;
+	size_t buf_size;
+	size_t buf_start;
+	size_t buf_end;
+
+	spill_packets_t pending;
+	size_t pending_idx;
+	bool failed;
+};
+
+static inline uint64_t spill_min(uint64_t a, uint64_t b)
+{
+	return a < b ? a : b;
+}
+
+static inline struct spill_gop *oldest_gop(struct replay_spill *spill)
+{
+	return spill->gops.size ? deque_data(&spill->gops, 0) : NULL;
+}
+
+static inline struct spill_gop *newest_gop(struct replay_spill *spill)
+{
+	return spill->gops.size ? deque_data(&spill->gops, spill->gops.size - sizeof(struct spill_gop)) : NULL;
+}
+
+static bool gop_pinned(struct replay_spill *spill, struct spill_gop *gop)
+{
+	for (size_t i = 0; i < spill->readers.num; i++) {
+		if (spill->readers.array[i]->pos < gop->end)
+			return true;
+	}
+
+	return false;
+}
+
+/* readers can be left without a GOP after replay_spill_discard, so their
+ * positions are checked as well */
+static uint64_t used_from(struct replay_spill *spill, struct spill_gop *gop)
+{
+	uint64_t tail = gop ? gop->start : spill->write_pos;
+
+	for (size_t i = 0; i < spill->readers.num; i++) {
+		struct replay_spill_reader *reader = spill->readers.array[i];
+		if (reader->pos < reader->end && reader->pos < tail)
+			tail = reader->pos;
+	}
+
+	return tail;
+}
+
+#ifdef _WIN32
+static inline bool lock_file(FILE *file)
+{
+	/* files that are still open cannot be deleted on Windows */
+	UNUSED_PARAMETER(file);
+	return true;
+}
+
+static bool remove_unused_file(const char *path)
+{
+	return os_unlink(path) == 0;
+}
+#else
+/* held for as long as the file is open, so that another process sharing the
+ * directory does not take it for a leftover */
+static inline bool lock_file(FILE *file)
+{
+	return flock(fileno(file), LOCK_EX | LOCK_NB) == 0;
+}
+
+static bool remove_unused_file(const char *path)
+{
+	FILE *file = os_fopen(path, "rb");
+	bool removed;
+
+	if (!file)
+		return false;
+
+	/* deleted while still holding the lock */
+	removed = lock_file(file) && os_unlink(path) == 0;
+	fclose(file);
+	return removed;
+}
+#endif
+
+static bool preallocate(FILE *file, uint64_t size)
+{
+#ifdef _WIN32
+	return _chsize_s(_fileno(file), (__int64)size) == 0;
+#elif defined(__linux__)
+	return posix_fallocate(fileno(file), 0, (off_t)size) == 0;
+#else
+	return ftruncate(fileno(file), (off_t)size) == 0;
+#endif
+}
+
+/* ------------------------------------------------------------------------ */
+/* writer */
+
+static size_t collect_batch(struct replay_spill *spill)
+{
+	const size_t size = sizeof(struct encoder_packet);
+	size_t num = spill->pending.size / size;
+	uint64_t limit = spill_min(SPILL_BATCH_SIZE, spill->capacity);
+	size_t bytes = 0;
+
+	da_resize(spill->batch_packets, 0);
+
+	for (size_t i = 0; i < num; i++) {
+		struct encoder_packet *pkt = deque_data(&spill->pending, i * size);
+		size_t rec_size = sizeof(struct spill_record) + pkt->size;
+
+		if (i && bytes + rec_size > limit)
+			break;
+
+		da_push_back(spill->batch_packets, pkt);
+		bytes += rec_size;
+	}
+
+	spill->writing = spill->batch_packets.num;
+	spill->batch_generation = spill->generation;
+	return bytes;
+}
+
+static void serialize_batch(struct replay_spill *spill)
+{
+	da_resize(spill->batch, 0);
+
+	for (size_t i = 0; i < spill->batch_packets.num; i++) {
+		struct encoder_packet *pkt = &spill->batch_packets.array[i];
+		struct spill_record rec = {
+			.pts = pkt->pts,
+			.dts = pkt->dts,
+			.dts_usec = pkt->dts_usec,
+			.sys_dts_usec = pkt->sys_dts_usec,
+			.timebase_num = pkt->timebase_num,
+			.timebase_den = pkt->timebase_den,
+			.priority = pkt->priority,
+			.drop_priority = pkt->drop_priority,
+			.size = (uint32_t)pkt->size,
+			.type = (uint8_t)pkt->type,
+			.keyframe = pkt->keyframe,
+			.track_idx = (uint8_t)pkt->track_idx,
+		};
+
+		da_push_back_array(spill->batch, (uint8_t *)&rec, sizeof(rec));
+		da_push_back_array(spill->batch, pkt->data, pkt->size);
+	}
+}
+
+/* evicts the oldest GOPs until size bytes fit, waits for readers that still
+ * need them, called with the mutex held */
+static bool make_room(struct replay_spill *spill, uint64_t size)
+{
+	for (;;) {
+		struct spill_gop *gop = oldest_gop(spill);
+		uint64_t tail = used_from(spill, gop);
+
+		if (spill->capacity - (spill->write_pos - tail) >= size)
+			return true;
+
+		if (gop && !gop_pinned(spill, gop)) {
+			deque_pop_front(&spill->gops, NULL, sizeof(struct spill_gop));
+			continue;
+		}
+
+		pthread_mutex_unlock(&spill->mutex);
+		os_event_timedwait(spill->unpin_event, 100);
+		pthread_mutex_lock(&spill->mutex);
+
+		if (os_atomic_load_bool(&spill->stop))
+			return false;
+	}
+}
+
+static bool write_at(struct replay_spill *spill, uint64_t pos, const uint8_t *data, size_t size)
+{
+	while (size) {
+		uint64_t offset = pos % spill->capacity;
+		size_t chunk = (size_t)spill_min(size, spill->capacity - offset);
+
+		if (os_fseeki64(spill->file, (int64_t)offset, SEEK_SET) != 0)
+			return false;
+		if (fwrite(data, 1, chunk, spill->file) != chunk)
+			return false;
+
+		pos += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+
+	/* readers use their own handles */
+	return fflush(spill->file) == 0;
+}
+
+/* a record continues the newest GOP only if it directly follows it, GOPs
+ * that were evicted while being written are not continued, and a batch that
+ * was discarded while being written only takes up space */
+static void index_batch(struct replay_spill *spill)
+{
+	bool discarded = spill->batch_generation != spill->generation;
+	uint64_t pos = spill->write_pos;
+
+	for (size_t i = 0; i < spill->batch_packets.num; i++) {
+		struct encoder_packet *pkt = &spill->batch_packets.array[i];
+		uint64_t end = pos + sizeof(struct spill_record) + pkt->size;
+		struct spill_gop *gop = discarded ? NULL : newest_gop(spill);
+
+		if (!discarded && pkt->type == OBS_ENCODER_VIDEO && pkt->keyframe) {
+			struct spill_gop new_gop = {.start = pos, .end = end, .dts_usec = pkt->dts_usec};
+			deque_push_back(&spill->gops, &new_gop, sizeof(new_gop));
+		} else if (gop && gop->end == pos) {
+			gop->end = end;
+		}
+
+		pos = end;
+	}
+
+	spill->write_pos = pos;
+}
+
+static void pop_batch(struct replay_spill *spill)
+{
+	for (size_t i = 0; i < spill->batch_packets.num; i++) {
+		struct encoder_packet pkt;
+		deque_pop_front(&spill->pending, &pkt, sizeof(pkt));
+		spill->pending_bytes -= pkt.size;
+		obs_encoder_packet_release(&pkt);
+	}
+
+	spill->writing = 0;
+}
+
+static void write_batch(struct replay_spill *spill)
+{
+	uint64_t size;
+	bool success;
+
+	pthread_mutex_lock(&spill->mutex);
+	size = collect_batch(spill);
+	pthread_mutex_unlock(&spill->mutex);
+
+	if (!spill->batch_packets.num)
+		return;
+
+	/* a single packet that does not fit is dropped */
+	if (size > spill->capacity) {
+		warn("Dropping a %" PRIu64 " byte packet that does not fit the spill file", size);
+		pthread_mutex_lock(&spill->mutex);
+		pop_batch(spill);
+		pthread_mutex_unlock(&spill->mutex);
+		return;
+	}
+
+	serialize_batch(spill);
+
+	pthread_mutex_lock(&spill->mutex);
+	success = make_room(spill, size);
+	pthread_mutex_unlock(&spill->mutex);
+
+	if (!success)
+		return;
+
+	success = write_at(spill, spill->write_pos, spill->batch.array, spill->batch.num);
+
+	pthread_mutex_lock(&spill->mutex);
+	if (success) {
+		index_batch(spill);
+	} else {
+		warn("Failed to write to '%s', older packets are no longer kept", spill->path.array);
+		spill->failed = true;
+	}
+	pop_batch(spill);
+	pthread_mutex_unlock(&spill->mutex);
+}
+
+static void *spill_thread(void *data)
+{
+	struct replay_spill *spill = data;
+
+	os_set_thread_name("replay-buffer: spill_thread");
+
+	while (os_sem_wait(spill->write_sem) == 0) {
+		if (os_atomic_load_bool(&spill->stop))
+			break;
+
+		write_batch(spill);
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------ */
+
+struct replay_spill *replay_spill_create(const char *path, uint64_t capacity)
+{
+	struct replay_spill *spill = bzalloc(sizeof(*spill));
+
+	spill->refs = 1;
+	spill->capacity = capacity;
+	dstr_copy(&spill->path, path);
+
+	if (pthread_mutex_init(&spill->mutex, NULL) != 0) {
+		dstr_free(&spill->path);
+		bfree(spill);
+		return NULL;
+	}
+	if (os_sem_init(&spill->write_sem, 0) != 0)
+		goto fail;
+	if (os_event_init(&spill->unpin_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	spill->file = os_fopen(path, "w+b");
+	if (!spill->file) {
+		warn("Failed to create '%s'", path);
+		goto fail;
+	}
+	if (!lock_file(spill->file))
+		warn("Failed to lock '%s'", path);
+	if (!preallocate(spill->file, capacity)) {
+		warn("Failed to reserve %" PRIu64 " MB for '%s'", capacity / (1024 * 1024), path);
+		goto fail;
+	}
+
+	spill->thread_active = pthread_create(&spill->thread, NULL, spill_thread, spill) == 0;
+	if (!spill->thread_active)
+		goto fail;
+
+	info("Keeping older packets in '%s' (%" PRIu64 " MB)", path, capacity / (1024 * 1024));
+	return spill;
+
+fail:
+	replay_spill_release(spill);
+	return NULL;
+}
+
+void replay_spill_remove_stale(const char *dir)
+{
+	os_dir_t *d = os_opendir(dir);
+	struct os_dirent *ent;
+	struct dstr path = {0};
+
+	if (!d)
+		return;
+
+	while ((ent = os_readdir(d)) != NULL) {
+		const char *ext = os_get_path_extension(ent->d_name);
+
+		if (ent->directory || !ext || strcmp(ext, ".spill") != 0)
+			continue;
+
+		dstr_printf(&path, "%s/%s", dir, ent->d_name);
+		if (remove_unused_file(path.array))
+			info("Removed '%s' left behind by an earlier session", path.array);
+	}
+
+	os_closedir(d);
+	dstr_free(&path);
+}
+
+void replay_spill_release(struct replay_spill *spill)
+{
+	if (!spill || os_atomic_dec_long(&spill->refs) > 0)
+		return;
+
+	if (spill->thread_active) {
+		os_atomic_set_bool(&spill->stop, true);
+		os_sem_post(spill->write_sem);
+		pthread_join(spill->thread, NULL);
+	}
+
+	while (spill->pending.size) {
+		struct encoder_packet pkt;
+		deque_pop_front(&spill->pending, &pkt, sizeof(pkt));
+		obs_encoder_packet_release(&pkt);
+	}
+
+	if (spill->file) {
+		fclose(spill->file);
+		os_unlink(spill->path.array);
+	}
+
+	deque_free(&spill->pending);
+	deque_free(&spill->gops);
+	da_free(spill->readers);
+	da_free(spill->batch_packets);
+	da_free(spill->batch);
+	os_event_destroy(spill->unpin_event);
+	os_sem_destroy(spill->write_sem);
+	pthread_mutex_destroy(&spill->mutex);
+	dstr_free(&spill->path);
+	bfree(spill);
+}
+
+void replay_spill_push(struct replay_spill *spill, struct encoder_packet *packet)
+{
+	struct encoder_packet pkt;
+
+	pthread_mutex_lock(&spill->mutex);
+	if (spill->failed) {
+		pthread_mutex_unlock(&spill->mutex);
+		return;
+	}
+
+	if (packet->type == OBS_ENCODER_VIDEO && packet->track_idx < MAX_OUTPUT_VIDEO_ENCODERS)
+		spill->video[packet->track_idx] = packet->encoder;
+	else if (packet->type == OBS_ENCODER_AUDIO && packet->track_idx < MAX_OUTPUT_AUDIO_ENCODERS)
+		spill->audio[packet->track_idx] = packet->encoder;
+
+	obs_encoder_packet_ref(&pkt, packet);
+	deque_push_back(&spill->pending, &pkt, sizeof(pkt));
+	spill->pending_bytes += pkt.size;
+	pthread_mutex_unlock(&spill->mutex);
+
+	os_sem_post(spill->write_sem);
+}
+
+bool replay_spill_busy(struct replay_spill *spill)
+{
+	bool busy;
+
+	pthread_mutex_lock(&spill->mutex);
+	busy = !spill->failed && spill->pending_bytes >= SPILL_PENDING_MAX;
+	pthread_mutex_unlock(&spill->mutex);
+
+	return busy;
+}
+
+uint64_t replay_spill_discard(struct replay_spill *spill)
+{
+	uint64_t dropped = 0;
+
+	pthread_mutex_lock(&spill->mutex);
+
+	/* the batch that is being written is dropped once it is done */
+	while (spill->pending.size / sizeof(struct encoder_packet) > spill->writing) {
+		struct encoder_packet pkt;
+		deque_pop_back(&spill->pending, &pkt, sizeof(pkt));
+		spill->pending_bytes -= pkt.size;
+		obs_encoder_packet_release(&pkt);
+		dropped++;
+	}
+
+	/* readers only pin file positions, so nothing older is indexed */
+	dropped += spill->writing;
+	deque_pop_front(&spill->gops, NULL, spill->gops.size);
+	spill->generation++;
+
+	pthread_mutex_unlock(&spill->mutex);
+	return dropped;
+}
+
+void replay_spill_trim(struct replay_spill *spill, int64_t dts_usec)
+{
+	struct spill_gop *gop;
+
+	pthread_mutex_lock(&spill->mutex);
+	while ((gop = oldest_gop(spill)) && gop->dts_usec < dts_usec && !gop_pinned(spill, gop))
+		deque_pop_front(&spill->gops, NULL, sizeof(*gop));
+	pthread_mutex_unlock(&spill->mutex);
+}
+
+/* ------------------------------------------------------------------------ */
+/* reader */
+
+struct replay_spill_reader *replay_spill_open(struct replay_spill *spill, int64_t start_dts_usec)
+{
+	const size_t size = sizeof(struct encoder_packet);
+	struct replay_spill_reader *reader = bzalloc(sizeof(*reader));
+	struct spill_gop *start = NULL;
+
+	reader->file = os_fopen(spill->path.array, "rb");
+	if (!reader->file) {
+		warn("Failed to open '%s' for reading", spill->path.array);
+		bfree(reader);
+		return NULL;
+	}
+
+	os_atomic_inc_long(&spill->refs);
+	reader->spill = spill;
+
+	pthread_mutex_lock(&spill->mutex);
+	for (size_t i = 0; i < spill->gops.size / sizeof(struct spill_gop); i++) {
+		struct spill_gop *gop = deque_data(&spill->gops, i * sizeof(struct spill_gop));
+		if (start && gop->dts_usec > start_dts_usec)
+			break;
+		start = gop;
+	}
+
+	reader->pos = start ? start->start : spill->write_pos;
+	reader->end = spill->write_pos;
+
+	da_reserve(reader->pending, spill->pending.size / size);
+	for (size_t i = 0; i < spill->pending.size / size; i++) {
+		struct encoder_packet *pkt = da_push_back_new(reader->pending);
+		obs_encoder_packet_ref(pkt, deque_data(&spill->pending, i * size));
+	}
+
+	da_push_back(spill->readers, &reader);
+	pthread_mutex_unlock(&spill->mutex);
+
+	return reader;
+}
+
+/* refills the buffer so that at least size bytes are available */
+static bool reader_fill(struct replay_spill_reader *reader, size_t size)
+{
+	struct replay_spill *spill = reader->spill;
+	size_t available = reader->buf_end - reader->buf_start;
+
+	if (available >= size)
+		return true;
+	if (reader->end - reader->pos < size - available)
+		return false;
+
+	if (reader->buf_size < size) {
+		reader->buf_size = size > SPILL_READ_SIZE ? size : SPILL_READ_SIZE;
+		reader->buf = brealloc(reader->buf, reader->buf_size);
+	}
+
+	memmove(reader->buf, reader->buf + reader->buf_start, available);
+	reader->buf_start = 0;
+	reader->buf_end = available;
+
+	while (reader->buf_end < size) {
+		uint64_t offset = reader->pos % spill->capacity;
+		size_t chunk = reader->buf_size - reader->buf_end;
+
+		chunk = (size_t)spill_min(chunk, reader->end - reader->pos);
+		chunk = (size_t)spill_min(chunk, spill->capacity - offset);
+
+		if (os_fseeki64(reader->file, (int64_t)offset, SEEK_SET) != 0)
+			return false;
+		if (fread(reader->buf + reader->buf_end, 1, chunk, reader->file) != chunk)
+			return false;
+
+		reader->buf_end += chunk;
+
+		/* everything before the new position may be overwritten now */
+		pthread_mutex_lock(&spill->mutex);
+		reader->pos += chunk;
+		pthread_mutex_unlock(&spill->mutex);
+		os_event_signal(spill->unpin_event);
+	}
+
+	return true;
+}
+
+static bool read_record(struct replay_spill_reader *reader, struct encoder_packet *packet)
+{
+	struct replay_spill *spill = reader->spill;
+	struct spill_record rec;
+	long *refs;
+
+	if (!reader_fill(reader, sizeof(rec)))
+		return false;
+	memcpy(&rec, reader->buf + reader->buf_start, sizeof(rec));
+	reader->buf_start += sizeof(rec);
+
+	if (rec.size > spill->capacity || !reader_fill(reader, rec.size))
+		return false;
+
+	/* same layout as other encoder packets, the reference count directly
+	 * precedes the data */
+	refs = bmalloc(sizeof(long) + rec.size);
+	*refs = 1;
+	memcpy(refs + 1, reader->buf + reader->buf_start, rec.size);
+	reader->buf_start += rec.size;
+
+	memset(packet, 0, sizeof(*packet));
+	packet->data = (uint8_t *)(refs + 1);
+	packet->size = rec.size;
+	packet->pts = rec.pts;
+	packet->dts = rec.dts;
+	packet->timebase_num = rec.timebase_num;
+	packet->timebase_den = rec.timebase_den;
+	packet->type = (enum obs_encoder_type)rec.type;
+	packet->keyframe = rec.keyframe != 0;
+	packet->dts_usec = rec.dts_usec;
+	packet->sys_dts_usec = rec.sys_dts_usec;
+	packet->priority = rec.priority;
+	packet->drop_priority = rec.drop_priority;
+	packet->track_idx = rec.track_idx;
+
+	pthread_mutex_lock(&spill->mutex);
+	if (packet->type == OBS_ENCODER_VIDEO && rec.track_idx < MAX_OUTPUT_VIDEO_ENCODERS)
+		packet->encoder = spill->video[rec.track_idx];
+	else if (packet->type == OBS_ENCODER_AUDIO && rec.track_idx < MAX_OUTPUT_AUDIO_ENCODERS)
+		packet->encoder = spill->audio[rec.track_idx];
+	pthread_mutex_unlock(&spill->mutex);
+
+	return true;
+}
+
+bool replay_spill_read(struct replay_spill_reader *reader, struct encoder_packet *packet)
+{
+	if (!reader->failed && (reader->pos < reader->end || reader->buf_start < reader->buf_end)) {
+		if (read_record(reader, packet))
+			return true;
+
+		warn("Failed to read back '%s'", reader->spill->path.array);
+		reader->failed = true;
+	}
+
+	if (reader->failed || reader->pending_idx >= reader->pending.num)
+		return false;
+
+	/* hands over our reference */
+	*packet = reader->pending.array[reader->pending_idx++];
+	return true;
+}
+
+uint64_t replay_spill_remaining(struct replay_spill_reader *reader)
+{
+	uint64_t size = reader->end - reader->pos + (reader->buf_end - reader->buf_start);
+
+	for (size_t i = reader->pending_idx; i < reader->pending.num; i++)
+		size += reader->pending.array[i].size;
+
+	return size;
+}
+
+bool replay_spill_close(struct replay_spill_reader *reader)
+{
+	struct replay_spill *spill = reader->spill;
+	bool success = !reader->failed;
+
+	pthread_mutex_lock(&spill->mutex);
+	da_erase_item(spill->readers, &reader);
+	pthread_mutex_unlock(&spill->mutex);
+	os_event_signal(spill->unpin_event);
+
+	for (size_t i = reader->pending_idx; i < reader->pending.num; i++)
+		obs_encoder_packet_release(&reader->pending.array[i]);
+	da_free(reader->pending);
+
+	fclose(reader->file);
+	bfree(reader->buf);
+	bfree(reader);
+
+	replay_spill_release(spill);
+	return success;
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <obs.h>
+
+/* On-disk tier of the replay buffer.
+ *
+ * GOPs that no longer fit the memory budget are handed over with
+ * replay_spill_push, and a background thread writes them in large batches
+ * into a preallocated ring file while keeping a keyframe index in memory.
+ * Once the file is full the oldest GOPs are overwritten, unless a save is
+ * still reading them.  While the writer is held up by such a save,
+ * replay_spill_busy tells the caller to keep new GOPs in memory for the time
+ * being.
+ *
+ * A save opens a reader on the packet thread, which pins the selected GOP
+ * range and takes references to the packets that are not on disk yet.  The
+ * save thread then reads the range back with large sequential reads. */
+
+struct replay_spill;
+struct replay_spill_reader;
+
+struct replay_spill *replay_spill_create(const char *path, uint64_t capacity);
+/* the file is closed and deleted once the last reader is closed as well */
+void replay_spill_release(struct replay_spill *spill);
+/* deletes *.spill files in dir that no replay buffer has open, such as the
+ * ones left behind by a crash */
+void replay_spill_remove_stale(const char *dir);
+
+/* takes a new reference to the packet */
+void replay_spill_push(struct replay_spill *spill, struct encoder_packet *packet);
+/* true while too many packets are waiting to be written */
+bool replay_spill_busy(struct replay_spill *spill);
+/* drops everything that was pushed so far, for when the caller has to drop
+ * newer packets and the rest would no longer be contiguous, returns the
+ * number of packets that were not on disk yet */
+uint64_t replay_spill_discard(struct replay_spill *spill);
+/* forgets GOPs that start before dts_usec, without touching the file */
+void replay_spill_trim(struct replay_spill *spill, int64_t dts_usec);
+
+/* starts at the last GOP at or before start_dts_usec, or at the oldest one,
+ * and ends with the packets that are still waiting to be written */
+struct replay_spill_reader *replay_spill_open(struct replay_spill *spill, int64_t start_dts_usec);
+/* the packet has to be released by the caller */
+bool replay_spill_read(struct replay_spill_reader *reader, struct encoder_packet *packet);
+/* number of bytes left to read */
+uint64_t replay_spill_remaining(struct replay_spill_reader *reader);
+/* returns false if a read failed */
+bool replay_spill_close(struct replay_spill_reader *reader);
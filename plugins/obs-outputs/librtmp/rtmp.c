@@ -1576,11 +1576,29 @@ ReadN(RTMP *r, char *buffer, int n)
     return nOriginalSize - n;
 }
 
+static void
+CloseAfterSendError(RTMP *r, int sockerr)
+{
+    struct linger l;
+
+    r->last_error_code = sockerr;
+
+    // Force-close the socket. Sometimes a send() error isn't fatal, so
+    // we could end up writing an unpublish message which some services
+    // treat as a clean shutdown. We need to disable lingering too so
+    // the remote side sees an abortive shutdown (RST).
+    l.l_onoff = 1;
+    l.l_linger = 0;
+    setsockopt(r->m_sb.sb_socket, SOL_SOCKET, SO_LINGER, (char *)&l, sizeof(l));
+    RTMPSockBuf_Close(&r->m_sb);
+
+    RTMP_Close(r);
+}
+
 static int
 WriteN(RTMP *r, const char *buffer, int n)
 {
     const char *ptr = buffer;
-    struct linger l;
 
     while (n > 0)
     {
@@ -1603,18 +1621,7 @@ WriteN(RTMP *r, const char *buffer, int n)
             if (sockerr == EINTR && !RTMP_ctrlC)
                 continue;
 
-            r->last_error_code = sockerr;
-
-            // Force-close the socket. Sometimes a send() error isn't fatal, so
-            // we could end up writing an unpublish message which some services
-            // treat as a clean shutdown. We need to disable lingering too so
-            // the remote side sees an abortive shutdown (RST).
-            l.l_onoff = 1;
-            l.l_linger = 0;
-            setsockopt(r->m_sb.sb_socket, SOL_SOCKET, SO_LINGER, (char *)&l, sizeof(l));
-            RTMPSockBuf_Close(&r->m_sb);
-
-            RTMP_Close(r);
+            CloseAfterSendError(r, sockerr);
             n = 1;
             break;
         }
@@ -4085,22 +4092,12 @@ RTMP_SendChunk(RTMP *r, RTMPChunk *chunk)
     return wrote;
 }
 
-int
-RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+static int
+EnsureChannelsOut(RTMP *r, int channel)
 {
-    const RTMPPacket *prevPacket;
-    uint32_t last = 0;
-    int nSize;
-    int hSize, cSize;
-    char *header, *hptr, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
-    uint32_t t;
-    char *buffer, *tbuf = NULL, *toff = NULL;
-    int nChunkSize;
-    int tlen;
-
-    if (packet->m_nChannel >= r->m_channelsAllocatedOut)
+    if (channel >= r->m_channelsAllocatedOut)
     {
-        int n = packet->m_nChannel + 10;
+        int n = channel + 10;
         RTMPPacket **packets = realloc(r->m_vecChannelsOut, sizeof(RTMPPacket*) * n);
         if (!packets)
         {
@@ -4113,6 +4110,24 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
         memset(r->m_vecChannelsOut + r->m_channelsAllocatedOut, 0, sizeof(RTMPPacket*) * (n - r->m_channelsAllocatedOut));
         r->m_channelsAllocatedOut = n;
     }
+    return TRUE;
+}
+
+/* Picks the header type against the previous packet on the channel and
+ * writes the chunk header of the first chunk to out, which must hold
+ * RTMP_MAX_HEADER_SIZE bytes.  Returns the header size or -1.
+ */
+static int
+EncodePacketHeader(RTMP *r, RTMPPacket *packet, char *out)
+{
+    const RTMPPacket *prevPacket;
+    uint32_t last = 0;
+    int nSize, cSize = 0;
+    char *hptr = out, *hend = out + RTMP_MAX_HEADER_SIZE, c;
+    uint32_t t;
+
+    if (!EnsureChannelsOut(r, packet->m_nChannel))
+        return -1;
 
     prevPacket = r->m_vecChannelsOut[packet->m_nChannel];
     if (prevPacket && packet->m_headerType != RTMP_PACKET_SIZE_LARGE)
@@ -4129,7 +4144,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
          *
          * The type 3 chunks/RTMP_PACKET_SIZE_MINIMUM packets produced here specify the beginning of a new
          * message as opposed to message continuation type 3 chunks that are handled in the loop further down
-         * in this function.
+         * in RTMP_SendPacket.
          */
         uint32_t delta = packet->m_nTimeStamp - prevPacket->m_nTimeStamp;
         if (delta == prevPacket->m_nLastWireTimeStamp
@@ -4142,43 +4157,18 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     {
         RTMP_Log(RTMP_LOGERROR, "sanity failed!! trying to send header of type: 0x%02x.",
                  (unsigned char)packet->m_headerType);
-        return FALSE;
+        return -1;
     }
 
     nSize = packetSize[packet->m_headerType];
-    hSize = nSize;
-    cSize = 0;
     t = packet->m_nTimeStamp - last;
     packet->m_nLastWireTimeStamp = t;
 
-    if (packet->m_body)
-    {
-        header = packet->m_body - nSize;
-        hend = packet->m_body;
-    }
-    else
-    {
-        header = hbuf + 6;
-        hend = hbuf + sizeof(hbuf);
-    }
-
     if (packet->m_nChannel > 319)
         cSize = 2;
     else if (packet->m_nChannel > 63)
         cSize = 1;
-    if (cSize)
-    {
-        header -= cSize;
-        hSize += cSize;
-    }
 
-    if (nSize > 1 && t >= 0xffffff)
-    {
-        header -= 4;
-        hSize += 4;
-    }
-
-    hptr = header;
     c = packet->m_headerType << 6;
     switch (cSize)
     {
@@ -4217,6 +4207,58 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     if (nSize > 1 && t >= 0xffffff)
         hptr = AMF_EncodeInt32(hptr, hend, t);
 
+    return (int)(hptr - out);
+}
+
+/* Type 3 header for the chunks after the first one of a packet, first is the
+ * first byte of the packet's header.  Returns the header size.
+ */
+static int
+EncodeContinuationHeader(const RTMPPacket *packet, char first, char *out)
+{
+    int hSize = 1;
+
+    out[0] = (0xc0 | first);
+    if (packet->m_nChannel > 63)
+    {
+        int tmp = packet->m_nChannel - 64;
+        out[hSize++] = tmp & 0xff;
+        if (packet->m_nChannel > 319)
+            out[hSize++] = tmp >> 8;
+    }
+    if (packet->m_nLastWireTimeStamp >= 0xffffff)
+    {
+        AMF_EncodeInt32(out + hSize, out + hSize + 4, packet->m_nLastWireTimeStamp);
+        hSize += 4;
+    }
+    return hSize;
+}
+
+int
+RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+{
+    int nSize;
+    int hSize;
+    char *header, hbuf[RTMP_MAX_HEADER_SIZE], c;
+    char *buffer, *tbuf = NULL, *toff = NULL;
+    int nChunkSize;
+    int tlen;
+
+    hSize = EncodePacketHeader(r, packet, hbuf);
+    if (hSize < 0)
+        return FALSE;
+
+    c = hbuf[0];
+    if (packet->m_body)
+    {
+        header = packet->m_body - hSize;
+        memcpy(header, hbuf, hSize);
+    }
+    else
+    {
+        header = hbuf;
+    }
+
     nSize = packet->m_nBodySize;
     buffer = packet->m_body;
     nChunkSize = r->m_outChunkSize;
@@ -4229,7 +4271,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
         int chunks = (nSize+nChunkSize-1) / nChunkSize;
         if (chunks > 1)
         {
-            tlen = chunks * (cSize + 1) + nSize + hSize;
+            tlen = chunks * RTMP_MAX_HEADER_SIZE + nSize + hSize;
             tbuf = malloc(tlen);
             if (!tbuf)
                 return FALSE;
@@ -4263,28 +4305,9 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
         // prepare to send off remaining data in Type 3 chunks
         if (nSize > 0)
         {
-            header = buffer - 1;
-            hSize = 1;
-            if (cSize)
-            {
-                header -= cSize;
-                hSize += cSize;
-            }
-            if (t >= 0xffffff)
-            {
-                hSize += 4;
-                header -= 4;
-            }
-            *header = (0xc0 | c);
-            if (cSize)
-            {
-                int tmp = packet->m_nChannel - 64;
-                header[1] = tmp & 0xff;
-                if (cSize == 2)
-                    header[2] = tmp >> 8;
-            }
-            if (t >= 0xffffff)
-                AMF_EncodeInt32(header+hSize-4, header+hSize, t);
+            hSize = EncodeContinuationHeader(packet, c, hbuf);
+            header = buffer - hSize;
+            memcpy(header, hbuf, hSize);
         }
     }
     if (tbuf)
@@ -4372,6 +4395,10 @@ RTMP_Close(RTMP *r)
     r->m_write.m_nBytesRead = 0;
     RTMPPacket_Free(&r->m_write);
 
+    free(r->m_batch.headers);
+    free(r->m_batch.segs);
+    memset(&r->m_batch, 0, sizeof(r->m_batch));
+
     for (i = 0; i < r->m_channelsAllocatedIn; i++)
     {
         if (r->m_vecChannelsIn[i])
@@ -5393,3 +5420,249 @@ RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
     }
     return size+s2;
 }
+
+/* Vectored media writes
+ *
+ * RTMP_WriteBatch takes FLV tags like RTMP_Write, but instead of copying each
+ * tag into m_write and sending chunk by chunk it encodes the chunk headers
+ * into a reusable arena and keeps pointers to the chunk bodies in the
+ * caller's buffer.  RTMP_FlushBatch then sends the queued chunks with as few
+ * sendmsg calls as possible.  The caller's buffers have to stay valid until
+ * the flush.  Only plain TCP sockets can do this, see RTMP_CanBatch.
+ */
+
+#define RTMP_BATCH_IOV 64
+
+int
+RTMP_CanBatch(RTMP *r)
+{
+#ifdef _WIN32
+    (void)r;
+    return FALSE;
+#else
+    return !(r->Link.protocol & RTMP_FEATURE_HTTP) && !r->m_bCustomSend && !r->m_sb.sb_ssl;
+#endif
+}
+
+static int
+BatchAddSegment(RTMP *r, const char *header, int headerSize, const char *body, int bodySize)
+{
+    RTMPBatch *b = &r->m_batch;
+    RTMPBatchSeg *seg;
+
+    if (b->headersLen + headerSize > b->headersSize)
+    {
+        int n = b->headersSize ? b->headersSize * 2 : 4096;
+        char *headers = realloc(b->headers, n);
+        if (!headers)
+            return FALSE;
+        b->headers = headers;
+        b->headersSize = n;
+    }
+    if (b->nSegs == b->segsSize)
+    {
+        int n = b->segsSize ? b->segsSize * 2 : 256;
+        RTMPBatchSeg *segs = realloc(b->segs, sizeof(RTMPBatchSeg) * n);
+        if (!segs)
+            return FALSE;
+        b->segs = segs;
+        b->segsSize = n;
+    }
+
+    seg = &b->segs[b->nSegs++];
+    seg->headerOffset = b->headersLen;
+    seg->headerSize = headerSize;
+    seg->body = body;
+    seg->bodySize = bodySize;
+
+    memcpy(b->headers + b->headersLen, header, headerSize);
+    b->headersLen += headerSize;
+    return TRUE;
+}
+
+static int
+BatchAddPacket(RTMP *r, RTMPPacket *packet)
+{
+    char hbuf[RTMP_MAX_HEADER_SIZE], first;
+    const char *body = packet->m_body;
+    int nSize = packet->m_nBodySize;
+    int hSize;
+
+    hSize = EncodePacketHeader(r, packet, hbuf);
+    if (hSize < 0)
+        return FALSE;
+
+    first = hbuf[0];
+    do
+    {
+        int nChunkSize = nSize < r->m_outChunkSize ? nSize : r->m_outChunkSize;
+
+        if (!BatchAddSegment(r, hbuf, hSize, body, nChunkSize))
+            return FALSE;
+
+        body += nChunkSize;
+        nSize -= nChunkSize;
+        hSize = EncodeContinuationHeader(packet, first, hbuf);
+    }
+    while (nSize > 0);
+
+    if (!r->m_vecChannelsOut[packet->m_nChannel])
+        r->m_vecChannelsOut[packet->m_nChannel] = malloc(sizeof(RTMPPacket));
+    if (!r->m_vecChannelsOut[packet->m_nChannel])
+        return FALSE;
+    memcpy(r->m_vecChannelsOut[packet->m_nChannel], packet, sizeof(RTMPPacket));
+    r->m_vecChannelsOut[packet->m_nChannel]->m_body = NULL;
+    return TRUE;
+}
+
+static void
+BatchClear(RTMP *r)
+{
+    r->m_batch.headersLen = 0;
+    r->m_batch.nSegs = 0;
+}
+
+int
+RTMP_WriteBatch(RTMP *r, const char *buf, int size, int streamIdx)
+{
+    const char *end = buf + size;
+
+    if (r->m_write.m_nBytesRead)
+    {
+        RTMP_Log(RTMP_LOGERROR, "%s, RTMP_Write packet still pending", __FUNCTION__);
+        return -1;
+    }
+
+    if (size >= 13 && buf[0] == 'F' && buf[1] == 'L' && buf[2] == 'V')
+        buf += 13;
+
+    while (end - buf >= 11)
+    {
+        RTMPPacket packet = {0};
+
+        packet.m_nChannel = 0x04;	/* source channel */
+        packet.m_nInfoField2 = r->Link.streams[streamIdx].id;
+        packet.m_packetType = *buf++;
+        packet.m_nBodySize = AMF_DecodeInt24(buf);
+        buf += 3;
+        packet.m_nTimeStamp = AMF_DecodeInt24(buf);
+        buf += 3;
+        packet.m_nTimeStamp |= (uint32_t)(uint8_t)*buf++ << 24;
+        buf += 3;
+
+        if ((size_t)(end - buf) < packet.m_nBodySize)
+        {
+            RTMP_Log(RTMP_LOGERROR, "%s, FLV tag truncated", __FUNCTION__);
+            return -1;
+        }
+
+        if (((packet.m_packetType == RTMP_PACKET_TYPE_AUDIO
+                || packet.m_packetType == RTMP_PACKET_TYPE_VIDEO) &&
+                !packet.m_nTimeStamp) || packet.m_packetType == RTMP_PACKET_TYPE_INFO)
+        {
+            packet.m_headerType = RTMP_PACKET_SIZE_LARGE;
+        }
+        else
+        {
+            packet.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
+        }
+
+        packet.m_body = (char *)buf;
+        if (!BatchAddPacket(r, &packet))
+        {
+            RTMP_Log(RTMP_LOGDEBUG, "%s, failed to queue packet", __FUNCTION__);
+            return -1;
+        }
+
+        /* skip the body and the previous tag size */
+        buf += packet.m_nBodySize + 4;
+    }
+    return size;
+}
+
+int
+RTMP_FlushBatch(RTMP *r)
+{
+#ifdef _WIN32
+    /* nothing is ever queued, RTMP_CanBatch is false here */
+    BatchClear(r);
+    return FALSE;
+#else
+    RTMPBatch *b = &r->m_batch;
+    int idx = 0;
+    int done = 0;	/* bytes of segs[idx] already sent */
+
+    while (idx < b->nSegs)
+    {
+        struct iovec iov[RTMP_BATCH_IOV];
+        struct msghdr msg = {0};
+        ssize_t nBytes;
+        int n = 0;
+
+        for (int i = idx; i < b->nSegs && n < RTMP_BATCH_IOV - 1; i++)
+        {
+            const RTMPBatchSeg *seg = &b->segs[i];
+            int skip = i == idx ? done : 0;
+
+            if (skip < seg->headerSize)
+            {
+                iov[n].iov_base = b->headers + seg->headerOffset + skip;
+                iov[n].iov_len = seg->headerSize - skip;
+                n++;
+                skip = 0;
+            }
+            else
+            {
+                skip -= seg->headerSize;
+            }
+
+            if (skip < seg->bodySize)
+            {
+                iov[n].iov_base = (char *)seg->body + skip;
+                iov[n].iov_len = seg->bodySize - skip;
+                n++;
+            }
+        }
+
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        nBytes = sendmsg(r->m_sb.sb_socket, &msg, MSG_NOSIGNAL);
+
+        if (nBytes < 0)
+        {
+            int sockerr = GetSockError();
+            if (sockerr == EINTR && !RTMP_ctrlC)
+                continue;
+
+            RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d", __FUNCTION__, sockerr);
+            CloseAfterSendError(r, sockerr);
+            BatchClear(r);
+            return FALSE;
+        }
+
+        if (nBytes == 0)
+        {
+            BatchClear(r);
+            return FALSE;
+        }
+
+        while (nBytes > 0 && idx < b->nSegs)
+        {
+            int left = b->segs[idx].headerSize + b->segs[idx].bodySize - done;
+
+            if (nBytes < left)
+            {
+                done += (int)nBytes;
+                break;
+            }
+
+            nBytes -= left;
+            done = 0;
+            idx++;
+        }
+    }
+
+    BatchClear(r);
+    return TRUE;
+#endif
+}
@@ -397,6 +397,25 @@ extern "C"
 
     typedef int (*CUSTOMSEND)(RTMPSockBuf*, const char *, int, void*);
 
+    typedef struct RTMPBatchSeg
+    {
+        int headerOffset;	/* into RTMPBatch.headers */
+        int headerSize;
+        const char *body;	/* points into the caller's FLV data */
+        int bodySize;
+    } RTMPBatchSeg;
+
+    /* chunks queued by RTMP_WriteBatch until RTMP_FlushBatch */
+    typedef struct RTMPBatch
+    {
+        char *headers;
+        int headersLen;
+        int headersSize;
+        RTMPBatchSeg *segs;
+        int nSegs;
+        int segsSize;
+    } RTMPBatch;
+
     typedef struct RTMP
     {
         int m_inChunkSize;
@@ -450,6 +469,7 @@ extern "C"
 
         RTMP_READ m_read;
         RTMPPacket m_write;
+        RTMPBatch m_batch;
         RTMPSockBuf m_sb;
         RTMP_LNK Link;
         int connect_time_ms;
@@ -544,6 +564,10 @@ extern "C"
     int RTMP_Read(RTMP *r, char *buf, int size);
     int RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx);
 
+    int RTMP_CanBatch(RTMP *r);
+    int RTMP_WriteBatch(RTMP *r, const char *buf, int size, int streamIdx);
+    int RTMP_FlushBatch(RTMP *r);
+
 #ifdef USE_HASHSWF
     /* hashswf.c */
     int RTMP_HashSWF(const char *url, unsigned int *size, unsigned char *hash,
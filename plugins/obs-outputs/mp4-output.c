@@ -59,6 +59,10 @@ struct mp4_output {
 	struct mp4_mux *muxer;
 	int flags;
 
+	/* Fragment budget for fragmented streaming mode (0 = default) */
+	int64_t fragment_duration_usec;
+	size_t fragment_size;
+
 	int64_t last_dts_usec;
 	DARRAY(struct chapter) chapters;
 
@@ -219,6 +223,9 @@ static void parse_custom_options(struct mp4_output *out, const char *opts_str)
 {
 	int flags = MP4_USE_NEGATIVE_CTS;
 
+	out->fragment_duration_usec = 0;
+	out->fragment_size = 0;
+
 	struct obs_options opts = obs_parse_options(opts_str);
 
 	for (size_t i = 0; i < opts.count; i++) {
@@ -232,6 +239,12 @@ static void parse_custom_options(struct mp4_output *out, const char *opts_str)
 			apply_flag(&flags, opt.value, MP4_USE_MDTA_KEY_VALUE);
 		} else if (strcmp(opt.name, "use_negative_cts") == 0) {
 			apply_flag(&flags, opt.value, MP4_USE_NEGATIVE_CTS);
+		} else if (strcmp(opt.name, "fragmented_streaming") == 0) {
+			apply_flag(&flags, opt.value, MP4_FRAGMENTED_STREAMING);
+		} else if (strcmp(opt.name, "fragment_duration_ms") == 0) {
+			out->fragment_duration_usec = strtoll(opt.value, 0, 10) * 1000LL;
+		} else if (strcmp(opt.name, "fragment_size") == 0) {
+			out->fragment_size = strtoull(opt.value, 0, 10) * 1048576ULL;
 		} else if (strcmp(opt.name, "buffer_size") == 0) {
 			out->buffer_size = strtoull(opt.value, 0, 10) * 1048576ULL;
 		} else if (strcmp(opt.name, "chunk_size") == 0) {
@@ -288,6 +301,7 @@ static bool mp4_output_start(void *data)
 
 	/* Initialise muxer and start capture */
 	out->muxer = mp4_mux_create(out->output, &out->serializer, out->flags);
+	mp4_mux_set_fragment_limits(out->muxer, out->fragment_duration_usec, out->fragment_size);
 	os_atomic_set_bool(&out->active, true);
 	obs_output_begin_data_capture(out->output, 0);
 
@@ -411,6 +425,7 @@ static bool change_file(struct mp4_output *out, struct encoder_packet *pkt)
 	}
 
 	out->muxer = mp4_mux_create(out->output, &out->serializer, out->flags);
+	mp4_mux_set_fragment_limits(out->muxer, out->fragment_duration_usec, out->fragment_size);
 
 	calldata_t cd = {0};
 	signal_handler_t *sh = obs_output_get_signal_handler(out->output);
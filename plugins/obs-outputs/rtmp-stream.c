@@ -145,6 +145,7 @@ static void rtmp_stream_destroy(void *data)
 
 	if (stream->write_buf)
 		bfree(stream->write_buf);
+	da_free(stream->batch_data);
 	bfree(stream);
 }
 
@@ -497,6 +498,72 @@ static inline bool can_shutdown_stream(struct rtmp_stream *stream, struct encode
 	return timeout || packet->sys_dts_usec >= (int64_t)stream->stop_ts;
 }
 
+static void mux_packet(struct rtmp_stream *stream, struct encoder_packet *packet, uint8_t **data, size_t *size)
+{
+	size_t idx = packet->track_idx;
+
+	if (packet->type == OBS_ENCODER_VIDEO &&
+	    (stream->video_codec[idx] != CODEC_H264 || (stream->video_codec[idx] == CODEC_H264 && idx != 0))) {
+		flv_packet_frames(packet, stream->video_codec[idx], stream->start_dts_offset, data, size, idx);
+	} else if (packet->type == OBS_ENCODER_AUDIO && idx != 0) {
+		flv_packet_audio_frames(packet, stream->audio_codec[idx], stream->start_dts_offset, data, size, idx);
+	} else {
+		flv_packet_mux(packet, stream->start_dts_offset, data, size, false);
+	}
+}
+
+#define MAX_BATCH_PACKETS 64
+
+/* Sends the packet and every other packet that is already queued (up to
+ * MAX_BATCH_PACKETS) with as few socket writes as possible.  Sets
+ * stop_reached when a queued packet reached the stop timestamp. */
+static int send_packet_batch(struct rtmp_stream *stream, struct encoder_packet *packet, bool *stop_reached)
+{
+	int ret = 0;
+
+	if (handle_socket_read(stream)) {
+		obs_encoder_packet_release(packet);
+		return -1;
+	}
+
+	for (;;) {
+		uint8_t *data;
+		size_t size = 0;
+
+		mux_packet(stream, packet, &data, &size);
+		obs_encoder_packet_release(packet);
+
+#ifdef TEST_FRAMEDROPS
+		droptest_cap_data_rate(stream, size);
+#endif
+
+		da_push_back(stream->batch_data, &data);
+		if (RTMP_WriteBatch(&stream->rtmp, (char *)data, (int)size, 0) < 0) {
+			ret = -1;
+			break;
+		}
+		stream->total_bytes_sent += size;
+
+		if (stream->batch_data.num == MAX_BATCH_PACKETS || !get_next_packet(stream, packet))
+			break;
+
+		if (stopping(stream) && can_shutdown_stream(stream, packet)) {
+			obs_encoder_packet_release(packet);
+			*stop_reached = true;
+			break;
+		}
+	}
+
+	if (ret == 0 && !RTMP_FlushBatch(&stream->rtmp))
+		ret = -1;
+
+	for (size_t i = 0; i < stream->batch_data.num; i++)
+		bfree(stream->batch_data.array[i]);
+	stream->batch_data.num = 0;
+
+	return ret;
+}
+
 static void set_output_error(struct rtmp_stream *stream)
 {
 	const char *msg = NULL;
@@ -639,6 +706,7 @@ static void *send_thread(void *data)
 	while (os_sem_wait(stream->send_sem) == 0) {
 		struct encoder_packet packet;
 		struct dbr_frame dbr_frame;
+		bool stop_reached = false;
 
 		if (stopping(stream) && stream->stop_ts == 0) {
 			break;
@@ -667,9 +735,11 @@ static void *send_thread(void *data)
 		}
 
 		int sent;
-		if (packet.type == OBS_ENCODER_VIDEO &&
-		    (stream->video_codec[packet.track_idx] != CODEC_H264 ||
-		     (stream->video_codec[packet.track_idx] == CODEC_H264 && packet.track_idx != 0))) {
+		if (stream->batch_send) {
+			sent = send_packet_batch(stream, &packet, &stop_reached);
+		} else if (packet.type == OBS_ENCODER_VIDEO &&
+			   (stream->video_codec[packet.track_idx] != CODEC_H264 ||
+			    (stream->video_codec[packet.track_idx] == CODEC_H264 && packet.track_idx != 0))) {
 			sent = send_packet_ex(stream, &packet, false, false, packet.track_idx);
 		} else if (packet.type == OBS_ENCODER_AUDIO && packet.track_idx != 0) {
 			sent = send_audio_packet_ex(stream, &packet, false, packet.track_idx);
@@ -682,6 +752,9 @@ static void *send_thread(void *data)
 			break;
 		}
 
+		if (stop_reached)
+			break;
+
 		if (stream->dbr_enabled) {
 			dbr_frame.send_end = os_gettime_ns();
 
@@ -1076,6 +1149,11 @@ static int init_send(struct rtmp_stream *stream)
 #endif
 	}
 
+	/* dynamic bitrate needs the send time of every single frame */
+	stream->batch_send = !stream->dbr_enabled && RTMP_CanBatch(&stream->rtmp);
+	if (stream->batch_send)
+		info("Batched socket writes enabled");
+
 	os_atomic_set_bool(&stream->active, true);
 
 	if (!send_meta_data(stream)) {
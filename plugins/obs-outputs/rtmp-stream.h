@@ -1,5 +1,6 @@
 #include <obs-module.h>
 #include <util/platform.h>
+#include <util/darray.h>
 #include <util/deque.h>
 #include <util/dstr.h>
 #include <util/threading.h>
@@ -131,6 +132,11 @@ struct rtmp_stream {
 	os_event_t *buffer_has_data_event;
 	os_event_t *socket_available_event;
 	os_event_t *send_thread_signaled_exit;
+
+	/* plain sockets: packets that are ready are sent in one vectored
+	 * write, FLV data stays alive here until it has been flushed */
+	bool batch_send;
+	DARRAY(uint8_t *) batch_data;
 };
 
 #ifdef _WIN32
@@ -70,12 +70,14 @@ static void stinger_update(void *data, obs_data_t *settings)
 	const char *path = obs_data_get_string(settings, "path");
 	bool hw_decode = obs_data_get_bool(settings, "hw_decode");
 	bool preload = obs_data_get_bool(settings, "preload");
+	bool compress_preload = obs_data_get_bool(settings, "compress_preload");
 
 	obs_data_t *media_settings = obs_data_create();
 	obs_data_set_string(media_settings, "local_file", path);
 	obs_data_set_bool(media_settings, "hw_decode", hw_decode);
 	obs_data_set_bool(media_settings, "looping", false);
 	obs_data_set_bool(media_settings, "full_decode", preload);
+	obs_data_set_bool(media_settings, "compress_cache", compress_preload);
 	obs_data_set_bool(media_settings, "is_stinger", true);
 	obs_data_set_bool(media_settings, "is_track_matte", s->track_matte_enabled);
 
@@ -679,6 +681,8 @@ static obs_properties_t *stinger_properties(void *data)
 	obs_properties_add_bool(ppts, "hw_decode", obs_module_text("HardwareDecode"));
 	p = obs_properties_add_bool(ppts, "preload", obs_module_text("PreloadVideoToRam"));
 	obs_property_set_long_description(p, obs_module_text("PreloadVideoToRam.Description"));
+	p = obs_properties_add_bool(ppts, "compress_preload", obs_module_text("CompressPreloadedVideo"));
+	obs_property_set_long_description(p, obs_module_text("CompressPreloadedVideo.Description"));
 
 	obs_properties_add_int(ppts, "transition_point", obs_module_text("TransitionPoint"), 0, 120000, 1);
 
@@ -0,0 +1,400 @@
+/* Process-wide glyph atlas shared by all text_ft2_source instances
+ *
+ * Pages are filled row by row like the old per-source texture buffer. A page
+ * keeps its A8 pixels in memory and a dynamic texture that is updated in place
+ * on the next draw after glyphs were added, instead of being recreated. */
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include "glyph-atlas.h"
+
+/* glyphs of a font are looked up in blocks of 256 glyph indices that are
+ * allocated on first use */
+#define GLYPH_BLOCK_BITS 8
+#define GLYPH_BLOCK_SIZE (1 << GLYPH_BLOCK_BITS)
+#define GLYPH_NUM_BLOCKS (65536 / GLYPH_BLOCK_SIZE)
+
+struct atlas_glyph {
+	struct glyph_info info;
+	FT_UInt index;
+	struct glyph_font *font;
+};
+
+struct glyph_font {
+	char *path;
+	FT_Long face_index;
+	uint16_t size;
+	FT_Render_Mode render_mode;
+
+	long refs;
+	size_t num_glyphs;
+	struct atlas_glyph **blocks[GLYPH_NUM_BLOCKS];
+};
+
+struct atlas_page {
+	uint8_t *pixels;
+	gs_texture_t *tex;
+	bool dirty;
+
+	/* current row */
+	uint32_t x, y, row_h;
+
+	uint64_t last_used;
+	uint32_t generation;
+	DARRAY(struct atlas_glyph *) glyphs;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	DARRAY(struct glyph_font *) fonts;
+	struct atlas_page pages[GLYPH_ATLAS_MAX_PAGES];
+	uint32_t num_pages;
+	uint32_t cur_page;
+	/* incremented on every lock, pages used under the current lock are
+	 * never evicted */
+	uint64_t clock;
+	long refs;
+} atlas;
+
+void glyph_atlas_init(void)
+{
+	pthread_mutex_init(&atlas.mutex, NULL);
+}
+
+void glyph_atlas_free(void)
+{
+	pthread_mutex_destroy(&atlas.mutex);
+}
+
+void glyph_atlas_lock(void)
+{
+	pthread_mutex_lock(&atlas.mutex);
+	atlas.clock++;
+}
+
+void glyph_atlas_unlock(void)
+{
+	pthread_mutex_unlock(&atlas.mutex);
+}
+
+static void free_font(struct glyph_font *font)
+{
+	for (size_t i = 0; i < GLYPH_NUM_BLOCKS; i++)
+		bfree(font->blocks[i]);
+
+	bfree(font->path);
+	bfree(font);
+}
+
+static void remove_font(struct glyph_font *font)
+{
+	da_erase_item(atlas.fonts, &font);
+	free_font(font);
+}
+
+static inline struct atlas_glyph **get_glyph_slot(struct glyph_font *font, FT_UInt glyph_index, bool create)
+{
+	struct atlas_glyph ***block = &font->blocks[glyph_index >> GLYPH_BLOCK_BITS];
+
+	if (!*block) {
+		if (!create)
+			return NULL;
+		*block = bzalloc(sizeof(struct atlas_glyph *) * GLYPH_BLOCK_SIZE);
+	}
+
+	return &(*block)[glyph_index & (GLYPH_BLOCK_SIZE - 1)];
+}
+
+static void clear_page_glyphs(struct atlas_page *page, bool remove_fonts)
+{
+	for (size_t i = 0; i < page->glyphs.num; i++) {
+		struct atlas_glyph *glyph = page->glyphs.array[i];
+		struct glyph_font *font = glyph->font;
+
+		*get_glyph_slot(font, glyph->index, false) = NULL;
+		font->num_glyphs--;
+		bfree(glyph);
+
+		if (remove_fonts && !font->refs && !font->num_glyphs)
+			remove_font(font);
+	}
+
+	da_clear(page->glyphs);
+}
+
+/* graphics context required */
+static void free_atlas(void)
+{
+	for (uint32_t i = 0; i < atlas.num_pages; i++) {
+		struct atlas_page *page = &atlas.pages[i];
+
+		clear_page_glyphs(page, false);
+		da_free(page->glyphs);
+		bfree(page->pixels);
+		gs_texture_destroy(page->tex);
+
+		/* keep the generation so stale layouts can never match */
+		uint32_t generation = page->generation + 1;
+		memset(page, 0, sizeof(*page));
+		page->generation = generation;
+	}
+
+	for (size_t i = 0; i < atlas.fonts.num; i++)
+		free_font(atlas.fonts.array[i]);
+
+	da_free(atlas.fonts);
+	atlas.num_pages = 0;
+	atlas.cur_page = 0;
+}
+
+struct glyph_font *glyph_atlas_get_font(const char *path, FT_Long face_index, uint16_t size,
+					FT_Render_Mode render_mode)
+{
+	struct glyph_font *font = NULL;
+
+	pthread_mutex_lock(&atlas.mutex);
+
+	for (size_t i = 0; i < atlas.fonts.num; i++) {
+		struct glyph_font *cur = atlas.fonts.array[i];
+
+		if (cur->face_index == face_index && cur->size == size && cur->render_mode == render_mode &&
+		    strcmp(cur->path, path) == 0) {
+			font = cur;
+			break;
+		}
+	}
+
+	if (!font) {
+		font = bzalloc(sizeof(struct glyph_font));
+		font->path = bstrdup(path);
+		font->face_index = face_index;
+		font->size = size;
+		font->render_mode = render_mode;
+		da_push_back(atlas.fonts, &font);
+	}
+
+	font->refs++;
+	atlas.refs++;
+
+	pthread_mutex_unlock(&atlas.mutex);
+	return font;
+}
+
+void glyph_font_release(struct glyph_font *font)
+{
+	if (!font)
+		return;
+
+	obs_enter_graphics();
+	pthread_mutex_lock(&atlas.mutex);
+
+	font->refs--;
+
+	/* nothing can draw from the atlas anymore, release the pages too */
+	if (--atlas.refs == 0)
+		free_atlas();
+	else if (!font->refs && !font->num_glyphs)
+		remove_font(font);
+
+	pthread_mutex_unlock(&atlas.mutex);
+	obs_leave_graphics();
+}
+
+struct glyph_info *glyph_font_find(struct glyph_font *font, FT_UInt glyph_index)
+{
+	struct atlas_glyph **slot;
+	struct atlas_glyph *glyph;
+
+	if (!font || glyph_index >= 65536)
+		return NULL;
+
+	slot = get_glyph_slot(font, glyph_index, false);
+	glyph = slot ? *slot : NULL;
+	if (!glyph)
+		return NULL;
+
+	atlas.pages[glyph->info.page].last_used = atlas.clock;
+	return &glyph->info;
+}
+
+static bool page_fit(struct atlas_page *page, uint32_t g_w, uint32_t g_h, uint32_t *dx, uint32_t *dy)
+{
+	uint32_t x = page->x;
+	uint32_t y = page->y;
+	uint32_t row_h = page->row_h;
+
+	if (x + g_w >= GLYPH_ATLAS_PAGE_SIZE) {
+		x = 0;
+		y += row_h + 1;
+		row_h = 0;
+	}
+
+	if (y + g_h >= GLYPH_ATLAS_PAGE_SIZE)
+		return false;
+
+	*dx = x;
+	*dy = y;
+
+	page->x = x + g_w + 1;
+	page->y = y;
+	page->row_h = row_h > g_h ? row_h : g_h;
+	return true;
+}
+
+static struct atlas_page *get_lru_page(void)
+{
+	struct atlas_page *lru = NULL;
+
+	for (uint32_t i = 0; i < atlas.num_pages; i++) {
+		struct atlas_page *page = &atlas.pages[i];
+
+		if (page->last_used == atlas.clock)
+			continue;
+		if (!lru || page->last_used < lru->last_used)
+			lru = page;
+	}
+
+	return lru;
+}
+
+static struct atlas_page *find_space(uint32_t g_w, uint32_t g_h, uint32_t *dx, uint32_t *dy)
+{
+	struct atlas_page *page;
+
+	/* would not even fit on an empty page, don't evict one for it */
+	if (g_w >= GLYPH_ATLAS_PAGE_SIZE || g_h >= GLYPH_ATLAS_PAGE_SIZE)
+		return NULL;
+
+	if (atlas.num_pages && page_fit(&atlas.pages[atlas.cur_page], g_w, g_h, dx, dy))
+		return &atlas.pages[atlas.cur_page];
+
+	if (atlas.num_pages < GLYPH_ATLAS_MAX_PAGES) {
+		atlas.cur_page = atlas.num_pages++;
+		page = &atlas.pages[atlas.cur_page];
+		page->pixels = bzalloc(GLYPH_ATLAS_PAGE_SIZE * GLYPH_ATLAS_PAGE_SIZE);
+		page->dirty = true;
+
+	} else {
+		page = get_lru_page();
+		if (!page)
+			return NULL;
+
+		blog(LOG_DEBUG, "Glyph atlas full, evicting page %u", (uint32_t)(page - atlas.pages));
+
+		clear_page_glyphs(page, true);
+		memset(page->pixels, 0, GLYPH_ATLAS_PAGE_SIZE * GLYPH_ATLAS_PAGE_SIZE);
+		page->x = page->y = page->row_h = 0;
+		page->dirty = true;
+		page->generation++;
+		atlas.cur_page = (uint32_t)(page - atlas.pages);
+	}
+
+	return page_fit(page, g_w, g_h, dx, dy) ? page : NULL;
+}
+
+static uint8_t get_pixel_value(const unsigned char *buf_row, FT_Render_Mode render_mode, const uint32_t x)
+{
+	if (render_mode == FT_RENDER_MODE_NORMAL) {
+		return buf_row[x];
+	}
+
+	const uint32_t byte_index = x / 8;
+	const uint8_t bit_index = x % 8;
+	const bool pixel_set = (buf_row[byte_index] >> (7 - bit_index)) & 1;
+	return pixel_set ? 255 : 0;
+}
+
+static void rasterize(struct atlas_page *page, FT_GlyphSlot slot, const FT_Render_Mode render_mode, const uint32_t dx,
+		      const uint32_t dy)
+{
+	/**
+	 * The pitch's absolute value is the number of bytes taken by one bitmap
+	 * row, including padding.
+	 *
+	 * Source: https://www.freetype.org/freetype2/docs/reference/ft2-basic_types.html
+	 */
+	const int pitch = abs(slot->bitmap.pitch);
+
+	for (uint32_t y = 0; y < slot->bitmap.rows; y++) {
+		const uint32_t row_start = y * pitch;
+		const uint32_t row = (dy + y) * GLYPH_ATLAS_PAGE_SIZE;
+
+		for (uint32_t x = 0; x < slot->bitmap.width; x++) {
+			const uint32_t row_pixel_position = dx + x;
+			const uint8_t pixel_value = get_pixel_value(&slot->bitmap.buffer[row_start], render_mode, x);
+			page->pixels[row_pixel_position + row] = pixel_value;
+		}
+	}
+}
+
+struct glyph_info *glyph_font_add(struct glyph_font *font, FT_Face face, FT_UInt glyph_index)
+{
+	const FT_Int32 load_mode = font->render_mode == FT_RENDER_MODE_MONO ? FT_LOAD_TARGET_MONO : FT_LOAD_DEFAULT;
+	FT_GlyphSlot slot = face->glyph;
+	uint32_t dx, dy;
+
+	if (glyph_index >= 65536)
+		return NULL;
+
+	FT_Load_Glyph(face, glyph_index, load_mode);
+	FT_Render_Glyph(slot, font->render_mode);
+
+	const uint32_t g_w = slot->bitmap.width;
+	const uint32_t g_h = slot->bitmap.rows;
+
+	struct atlas_page *page = find_space(g_w, g_h, &dx, &dy);
+	if (!page)
+		return NULL;
+
+	rasterize(page, slot, font->render_mode, dx, dy);
+
+	struct atlas_glyph *glyph = bzalloc(sizeof(struct atlas_glyph));
+	glyph->index = glyph_index;
+	glyph->font = font;
+	glyph->info.u = (float)dx / (float)GLYPH_ATLAS_PAGE_SIZE;
+	glyph->info.u2 = (float)(dx + g_w) / (float)GLYPH_ATLAS_PAGE_SIZE;
+	glyph->info.v = (float)dy / (float)GLYPH_ATLAS_PAGE_SIZE;
+	glyph->info.v2 = (float)(dy + g_h) / (float)GLYPH_ATLAS_PAGE_SIZE;
+	glyph->info.w = g_w;
+	glyph->info.h = g_h;
+	glyph->info.yoff = slot->bitmap_top;
+	glyph->info.xoff = slot->bitmap_left;
+	glyph->info.xadv = slot->advance.x >> 6;
+	glyph->info.page = (uint32_t)(page - atlas.pages);
+
+	*get_glyph_slot(font, glyph_index, true) = glyph;
+	font->num_glyphs++;
+
+	da_push_back(page->glyphs, &glyph);
+	page->last_used = atlas.clock;
+	page->dirty = true;
+
+	return &glyph->info;
+}
+
+uint32_t glyph_atlas_page_generation(uint32_t page)
+{
+	return atlas.pages[page].generation;
+}
+
+gs_texture_t *glyph_atlas_page_texture(uint32_t page_idx)
+{
+	if (page_idx >= atlas.num_pages)
+		return NULL;
+
+	struct atlas_page *page = &atlas.pages[page_idx];
+	page->last_used = atlas.clock;
+
+	if (!page->tex) {
+		page->tex = gs_texture_create(GLYPH_ATLAS_PAGE_SIZE, GLYPH_ATLAS_PAGE_SIZE, GS_A8, 1,
+					      (const uint8_t **)&page->pixels, GS_DYNAMIC);
+		page->dirty = false;
+
+	} else if (page->dirty) {
+		gs_texture_set_image(page->tex, page->pixels, GLYPH_ATLAS_PAGE_SIZE, false);
+		page->dirty = false;
+	}
+
+	return page->tex;
+}
@@ -0,0 +1,47 @@
+/* Process-wide glyph atlas shared by all text_ft2_source instances
+ *
+ * Glyphs are keyed by font (file, face index, pixel size and render mode) and
+ * glyph index, so sources using the same font share their rasterized glyphs.
+ * The atlas is made of up to GLYPH_ATLAS_MAX_PAGES A8 pages that are created
+ * on demand. Once every page is full, the least recently used page is cleared
+ * and its generation bumped, sources drawing from it lay out again.
+ *
+ * All functions except glyph_atlas_get_font/glyph_font_release must be called
+ * with the atlas locked. When the graphics context is needed as well, it has
+ * to be entered before locking the atlas. */
+
+#pragma once
+
+#include <obs-module.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#define GLYPH_ATLAS_PAGE_SIZE 2048
+#define GLYPH_ATLAS_MAX_PAGES 4
+
+struct glyph_info {
+	float u, v, u2, v2;
+	int32_t w, h, xoff, yoff;
+	FT_Pos xadv;
+	uint32_t page;
+};
+
+struct glyph_font;
+
+void glyph_atlas_init(void);
+void glyph_atlas_free(void);
+
+struct glyph_font *glyph_atlas_get_font(const char *path, FT_Long face_index, uint16_t size,
+					FT_Render_Mode render_mode);
+void glyph_font_release(struct glyph_font *font);
+
+void glyph_atlas_lock(void);
+void glyph_atlas_unlock(void);
+
+struct glyph_info *glyph_font_find(struct glyph_font *font, FT_UInt glyph_index);
+/* renders the glyph with face and packs it, returns NULL if it does not fit */
+struct glyph_info *glyph_font_add(struct glyph_font *font, FT_Face face, FT_UInt glyph_index);
+
+uint32_t glyph_atlas_page_generation(uint32_t page);
+/* uploads pending glyphs of the page, graphics context required */
+gs_texture_t *glyph_atlas_page_texture(uint32_t page);
@@ -0,0 +1,653 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Subtitle slideshow source
+ *
+ * Holds a whole deck of subtitle slides (set with the "set_slides" proc).
+ * Slides are laid out and drawn by the same code as text_ft2_source, through
+ * an ft2_source owned by the slideshow, and each one is rendered once into a
+ * texture. Slides closest to the current one are rendered first, so
+ * "set_index" only swaps the texture that is drawn.
+ *
+ * The glyphs of a slide are rasterized into the glyph atlas by a background
+ * task, with a font face of its own, before the video tick lays the slide out
+ * and draws it. Until the current slide is ready the previous one stays on
+ * screen.
+ *
+ * Slide textures are bounded by cache_vram_mb and MAX_CACHED_SLIDES.
+ * Prefetching stops once the budget is used up, and textures of the slides
+ * furthest from the current one are dropped first to make room for closer
+ * ones. */
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/darray.h>
+#include "text-freetype2.h"
+
+#define S_CACHE_VRAM "cache_vram_mb"
+
+/* slides rendered per tick besides the current one, keeps a folder switch from
+ * stalling a single frame with dozens of renders */
+#define MAX_PREFETCH_RENDERS 2
+
+/* slides kept as textures at once, and looked ahead by the background task */
+#define MAX_CACHED_SLIDES 32
+
+struct slide {
+	char *text;
+
+	gs_texrender_t *texrender;
+	uint32_t cx, cy;
+	bool prepared;
+	bool rendered;
+};
+
+struct subtitle_slideshow {
+	obs_source_t *source;
+
+	/* layout and draw state, only touched by the graphics thread */
+	struct ft2_source *text;
+
+	pthread_mutex_t mutex;
+	DARRAY(struct slide) slides;
+	DARRAY(gs_texrender_t *) trash;
+	int current;
+	uint32_t style_generation;
+	bool preparing;
+
+	size_t max_vram;
+	size_t vram_used;
+	size_t num_cached;
+
+	/* glyph rasterization state of the background task, replaced by the
+	 * graphics thread on updates */
+	pthread_mutex_t prepare_mutex;
+	FT_Face face;
+	char *face_path;
+	FT_Long face_index;
+	uint16_t face_size;
+
+	/* only touched by the graphics thread (tick/render) */
+	gs_texrender_t *shown;
+	gs_texture_t *shown_tex;
+	uint32_t cx, cy;
+};
+
+static inline uint32_t slide_distance(const struct subtitle_slideshow *ss, size_t idx)
+{
+	const int cur = ss->current < 0 ? 0 : ss->current;
+	const int d = (int)idx - cur;
+	return (uint32_t)(d < 0 ? -d : d);
+}
+
+static inline size_t slide_vram(const struct slide *slide)
+{
+	return slide->texrender ? (size_t)slide->cx * slide->cy * 4 : 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* cache management (mutex held)                                             */
+
+static void slide_drop_texture(struct subtitle_slideshow *ss, struct slide *slide)
+{
+	if (slide->texrender) {
+		ss->vram_used -= slide_vram(slide);
+		ss->num_cached--;
+		da_push_back(ss->trash, &slide->texrender);
+		slide->texrender = NULL;
+	}
+
+	slide->cx = slide->cy = 0;
+	slide->rendered = false;
+}
+
+/* drops textures of slides further away than max_distance until the budget is
+ * met and another slide fits, returns false if only closer slides are left */
+static bool make_room(struct subtitle_slideshow *ss, uint32_t max_distance)
+{
+	while (ss->vram_used > ss->max_vram || ss->num_cached >= MAX_CACHED_SLIDES) {
+		struct slide *victim = NULL;
+		uint32_t victim_dist = 0;
+
+		for (size_t i = 0; i < ss->slides.num; i++) {
+			struct slide *slide = &ss->slides.array[i];
+			const uint32_t dist = slide_distance(ss, i);
+
+			if (slide->texrender && dist > max_distance && (!victim || dist > victim_dist)) {
+				victim = slide;
+				victim_dist = dist;
+			}
+		}
+
+		if (!victim)
+			return false;
+		slide_drop_texture(ss, victim);
+	}
+
+	return true;
+}
+
+/* finds the closest slide whose glyphs are not rasterized yet (mutex held) */
+static struct slide *next_unprepared(struct subtitle_slideshow *ss)
+{
+	const int num = (int)ss->slides.num;
+	const int cur = ss->current < 0 ? 0 : ss->current;
+	int visited = 0;
+
+	for (int d = 0; d < num && visited < MAX_CACHED_SLIDES; d++) {
+		const int candidates[2] = {cur + d, cur - d};
+
+		for (int c = 0; c < (d ? 2 : 1); c++) {
+			const int idx = candidates[c];
+			if (idx < 0 || idx >= num)
+				continue;
+
+			struct slide *slide = &ss->slides.array[idx];
+			if (!slide->prepared)
+				return slide;
+			visited++;
+		}
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* glyph rasterization (background task)                                     */
+
+/* the atlas is locked per glyph, so text sources drawing in the meantime are
+ * not held up for a whole slide */
+static void rasterize_glyphs(struct subtitle_slideshow *ss, const char *utf8)
+{
+	struct glyph_font *font = ss->text->atlas_font;
+	wchar_t *text = NULL;
+
+	if (!ss->face || !font)
+		return;
+
+	os_utf8_to_wcs_ptr(utf8, strlen(utf8), &text);
+	if (!text)
+		return;
+
+	for (const wchar_t *ch = text; *ch; ch++) {
+		const FT_UInt glyph_index = FT_Get_Char_Index(ss->face, *ch);
+
+		glyph_atlas_lock();
+		if (!glyph_font_find(font, glyph_index))
+			glyph_font_add(font, ss->face, glyph_index);
+		glyph_atlas_unlock();
+	}
+
+	bfree(text);
+}
+
+static void prepare_slides(struct subtitle_slideshow *ss)
+{
+	for (;;) {
+		struct slide *slide;
+		uint32_t generation;
+		char *text;
+
+		pthread_mutex_lock(&ss->mutex);
+		slide = next_unprepared(ss);
+		if (!slide) {
+			ss->preparing = false;
+			pthread_mutex_unlock(&ss->mutex);
+			return;
+		}
+		text = bstrdup(slide->text);
+		generation = ss->style_generation;
+		pthread_mutex_unlock(&ss->mutex);
+
+		if (text && *text) {
+			pthread_mutex_lock(&ss->prepare_mutex);
+			rasterize_glyphs(ss, text);
+			pthread_mutex_unlock(&ss->prepare_mutex);
+		}
+
+		/* the deck may have been replaced in the meantime, slides with
+		 * the same text need the same glyphs */
+		pthread_mutex_lock(&ss->mutex);
+		if (generation == ss->style_generation) {
+			for (size_t i = 0; i < ss->slides.num; i++) {
+				struct slide *cur = &ss->slides.array[i];
+				if (!cur->prepared && cur->text && text && strcmp(cur->text, text) == 0)
+					cur->prepared = true;
+			}
+		}
+		pthread_mutex_unlock(&ss->mutex);
+
+		bfree(text);
+	}
+}
+
+static void prepare_task(void *data)
+{
+	obs_weak_source_t *weak = data;
+	obs_source_t *source = obs_weak_source_get_source(weak);
+
+	if (source) {
+		prepare_slides(obs_obj_get_data(source));
+		obs_source_release(source);
+	}
+
+	obs_weak_source_release(weak);
+}
+
+/* the task keeps running until every slide within reach is prepared, mutex
+ * held */
+static void queue_prepare(struct subtitle_slideshow *ss)
+{
+	if (ss->preparing || !next_unprepared(ss))
+		return;
+
+	ss->preparing = true;
+	obs_queue_task(OBS_TASK_BACKGROUND, prepare_task, obs_source_get_weak_source(ss->source), false);
+}
+
+/* opens a face of its own for the background task, FreeType faces must not be
+ * used by two threads at once (graphics thread, prepare_mutex held) */
+static void update_face(struct subtitle_slideshow *ss)
+{
+	struct ft2_source *text = ss->text;
+
+	if (ss->face && text->font_path && strcmp(ss->face_path, text->font_path) == 0 &&
+	    ss->face_index == text->font_index && ss->face_size == text->font_size)
+		return;
+
+	if (ss->face) {
+		FT_Done_Face(ss->face);
+		ss->face = NULL;
+	}
+	bfree(ss->face_path);
+	ss->face_path = NULL;
+
+	if (!text->font_face || !text->font_path)
+		return;
+	if (FT_New_Face(ft2_lib, text->font_path, text->font_index, &ss->face) != 0) {
+		ss->face = NULL;
+		return;
+	}
+
+	FT_Set_Pixel_Sizes(ss->face, 0, text->font_size);
+	FT_Select_Charmap(ss->face, FT_ENCODING_UNICODE);
+	ss->face_path = bstrdup(text->font_path);
+	ss->face_index = text->font_index;
+	ss->face_size = text->font_size;
+}
+
+/* ------------------------------------------------------------------------- */
+/* rendering (graphics thread, mutex held)                                   */
+
+static void render_slide(struct subtitle_slideshow *ss, struct slide *slide)
+{
+	struct ft2_source *text = ss->text;
+	struct vec4 clear_color;
+
+	slide->rendered = true;
+
+	if (!text->font_face || !slide->text || !*slide->text)
+		return;
+
+	bfree(text->text);
+	text->text = NULL;
+	os_utf8_to_wcs_ptr(slide->text, strlen(slide->text), &text->text);
+
+	cache_glyphs(text, text->text);
+	set_up_vertex_buffer(text);
+	if (!text->vbuf)
+		return;
+
+	/* same size as text_ft2_source reports for this text */
+	const uint32_t cx = text->cx + text->outline_width;
+	const uint32_t cy = text->cy + text->outline_width;
+
+	slide->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	if (!gs_texrender_begin(slide->texrender, cx, cy)) {
+		gs_texrender_destroy(slide->texrender);
+		slide->texrender = NULL;
+		return;
+	}
+
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+	gs_blend_state_push();
+	ft2_source_render(text, NULL);
+	gs_blend_state_pop();
+
+	gs_texrender_end(slide->texrender);
+
+	slide->cx = cx;
+	slide->cy = cy;
+	ss->vram_used += slide_vram(slide);
+	ss->num_cached++;
+}
+
+/* renders the current slide and a few of its neighbours, once their glyphs
+ * are in the atlas */
+static void render_slides(struct subtitle_slideshow *ss)
+{
+	const int num = (int)ss->slides.num;
+	const int cur = ss->current < 0 ? 0 : ss->current;
+	int prefetched = 0;
+
+	for (int d = 0; d < num; d++) {
+		const int candidates[2] = {cur + d, cur - d};
+
+		for (int c = 0; c < (d ? 2 : 1); c++) {
+			const int idx = candidates[c];
+			if (idx < 0 || idx >= num)
+				continue;
+
+			struct slide *slide = &ss->slides.array[idx];
+			if (slide->rendered)
+				continue;
+			if (!slide->prepared)
+				return;
+
+			/* the current slide is always rendered, prefetching
+			 * stops once the budget is used up by closer slides */
+			if (d > 0) {
+				if (prefetched == MAX_PREFETCH_RENDERS)
+					return;
+				if (!make_room(ss, (uint32_t)d) || ss->vram_used >= ss->max_vram)
+					return;
+				prefetched++;
+			}
+
+			render_slide(ss, slide);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* proc handlers                                                             */
+
+static void set_slides_proc(void *data, calldata_t *cd)
+{
+	struct subtitle_slideshow *ss = data;
+	const char *json = calldata_string(cd, "slides");
+	obs_data_t *root = json ? obs_data_create_from_json(json) : NULL;
+	obs_data_array_t *array = obs_data_get_array(root, "slides");
+	const size_t count = obs_data_array_count(array);
+
+	pthread_mutex_lock(&ss->mutex);
+
+	/* keep already rendered slides whose text did not change */
+	DARRAY(struct slide) old;
+	da_init(old);
+	da_move(old, ss->slides);
+	da_reserve(ss->slides, count);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(array, i);
+		const char *text = obs_data_get_string(item, "text");
+		struct slide slide = {0};
+
+		for (size_t j = 0; j < old.num; j++) {
+			if (old.array[j].text && strcmp(old.array[j].text, text) == 0) {
+				slide = old.array[j];
+				memset(&old.array[j], 0, sizeof(old.array[j]));
+				break;
+			}
+		}
+
+		if (!slide.text)
+			slide.text = bstrdup(text);
+		da_push_back(ss->slides, &slide);
+		obs_data_release(item);
+	}
+
+	for (size_t i = 0; i < old.num; i++) {
+		slide_drop_texture(ss, &old.array[i]);
+		bfree(old.array[i].text);
+	}
+	da_free(old);
+
+	if (ss->current >= (int)ss->slides.num)
+		ss->current = -1;
+
+	pthread_mutex_unlock(&ss->mutex);
+
+	obs_data_array_release(array);
+	obs_data_release(root);
+}
+
+static void set_index_proc(void *data, calldata_t *cd)
+{
+	struct subtitle_slideshow *ss = data;
+	long long index = calldata_int(cd, "index");
+
+	pthread_mutex_lock(&ss->mutex);
+	ss->current = (index >= 0 && index < (long long)ss->slides.num) ? (int)index : -1;
+	pthread_mutex_unlock(&ss->mutex);
+}
+
+static void get_index_proc(void *data, calldata_t *cd)
+{
+	struct subtitle_slideshow *ss = data;
+
+	pthread_mutex_lock(&ss->mutex);
+	calldata_set_int(cd, "index", ss->current);
+	pthread_mutex_unlock(&ss->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* source callbacks                                                          */
+
+static const char *ss_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("SubtitleSlideshow");
+}
+
+/* video source updates are deferred to the video tick, so this runs on the
+ * graphics thread like the slide rendering */
+static void ss_update(void *data, obs_data_t *settings)
+{
+	struct subtitle_slideshow *ss = data;
+
+	/* waits for the background task to finish the slide it is on */
+	pthread_mutex_lock(&ss->prepare_mutex);
+	ft2_source_update(ss->text, settings);
+	update_face(ss);
+	pthread_mutex_unlock(&ss->prepare_mutex);
+
+	pthread_mutex_lock(&ss->mutex);
+
+	/* the style may have changed, render every slide again */
+	for (size_t i = 0; i < ss->slides.num; i++) {
+		slide_drop_texture(ss, &ss->slides.array[i]);
+		ss->slides.array[i].prepared = false;
+	}
+	ss->style_generation++;
+
+	ss->max_vram = (size_t)obs_data_get_int(settings, S_CACHE_VRAM) * 1024 * 1024;
+
+	pthread_mutex_unlock(&ss->mutex);
+}
+
+static void *ss_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct subtitle_slideshow *ss = bzalloc(sizeof(*ss));
+	ss->source = source;
+	ss->current = -1;
+	ss->text = ft2_source_alloc(source);
+
+	pthread_mutex_init(&ss->mutex, NULL);
+	pthread_mutex_init(&ss->prepare_mutex, NULL);
+
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	proc_handler_add(ph, "void set_slides(string slides)", set_slides_proc, ss);
+	proc_handler_add(ph, "void set_index(int index)", set_index_proc, ss);
+	proc_handler_add(ph, "void get_index(out int index)", get_index_proc, ss);
+
+	obs_source_update(source, NULL);
+
+	UNUSED_PARAMETER(settings);
+	return ss;
+}
+
+static void ss_destroy(void *data)
+{
+	struct subtitle_slideshow *ss = data;
+
+	obs_enter_graphics();
+	for (size_t i = 0; i < ss->slides.num; i++) {
+		gs_texrender_destroy(ss->slides.array[i].texrender);
+		bfree(ss->slides.array[i].text);
+	}
+	for (size_t i = 0; i < ss->trash.num; i++)
+		gs_texrender_destroy(ss->trash.array[i]);
+	obs_leave_graphics();
+
+	da_free(ss->slides);
+	da_free(ss->trash);
+	if (ss->face)
+		FT_Done_Face(ss->face);
+	bfree(ss->face_path);
+	ft2_source_destroy(ss->text);
+	pthread_mutex_destroy(&ss->prepare_mutex);
+	pthread_mutex_destroy(&ss->mutex);
+	bfree(ss);
+}
+
+static void ss_tick(void *data, float seconds)
+{
+	struct subtitle_slideshow *ss = data;
+
+	pthread_mutex_lock(&ss->mutex);
+	obs_enter_graphics();
+
+	for (size_t i = 0; i < ss->trash.num; i++) {
+		if (ss->trash.array[i] == ss->shown)
+			ss->shown = NULL;
+		gs_texrender_destroy(ss->trash.array[i]);
+	}
+	da_resize(ss->trash, 0);
+
+	queue_prepare(ss);
+	render_slides(ss);
+
+	/* the previous slide stays up until the current one is rendered */
+	if (ss->current < 0) {
+		ss->shown = NULL;
+	} else {
+		const struct slide *slide = &ss->slides.array[ss->current];
+
+		if (slide->texrender) {
+			ss->shown = slide->texrender;
+			ss->cx = slide->cx;
+			ss->cy = slide->cy;
+		} else if (slide->rendered) {
+			ss->shown = NULL;
+		}
+	}
+
+	ss->shown_tex = ss->shown ? gs_texrender_get_texture(ss->shown) : NULL;
+	if (!ss->shown)
+		ss->cx = ss->cy = 0;
+
+	obs_leave_graphics();
+	pthread_mutex_unlock(&ss->mutex);
+
+	UNUSED_PARAMETER(seconds);
+}
+
+/* slide textures hold premultiplied text exactly as text_ft2_source would have
+ * drawn it, so they are drawn without any color space conversion */
+static void ss_render(void *data, gs_effect_t *effect)
+{
+	struct subtitle_slideshow *ss = data;
+	gs_texture_t *const texture = ss->shown_tex;
+	if (!texture)
+		return;
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+
+	gs_eparam_t *const param = gs_effect_get_param_by_name(effect, "image");
+	gs_effect_set_texture(param, texture);
+
+	gs_draw_sprite(texture, 0, ss->cx, ss->cy);
+
+	gs_blend_state_pop();
+}
+
+static uint32_t ss_width(void *data)
+{
+	struct subtitle_slideshow *ss = data;
+	return ss->cx;
+}
+
+static uint32_t ss_height(void *data)
+{
+	struct subtitle_slideshow *ss = data;
+	return ss->cy;
+}
+
+#ifdef _WIN32
+#define DEFAULT_FACE "Arial"
+#elif __APPLE__
+#define DEFAULT_FACE "Helvetica"
+#else
+#define DEFAULT_FACE "Sans Serif"
+#endif
+
+static void ss_defaults(obs_data_t *settings)
+{
+	obs_data_t *font_obj = obs_data_create();
+	obs_data_set_default_string(font_obj, "face", DEFAULT_FACE);
+	obs_data_set_default_int(font_obj, "size", 72);
+	obs_data_set_default_int(font_obj, "flags", 0);
+	obs_data_set_default_string(font_obj, "style", "");
+	obs_data_set_default_obj(settings, "font", font_obj);
+	obs_data_release(font_obj);
+
+	obs_data_set_default_bool(settings, "antialiasing", true);
+	obs_data_set_default_bool(settings, "word_wrap", true);
+	obs_data_set_default_bool(settings, "outline", false);
+	obs_data_set_default_bool(settings, "drop_shadow", true);
+	obs_data_set_default_int(settings, "custom_width", 1600);
+	obs_data_set_default_int(settings, "color1", 0xFFFFFFFF);
+	obs_data_set_default_int(settings, "color2", 0xFFFFFFFF);
+	obs_data_set_default_int(settings, S_CACHE_VRAM, 256);
+}
+
+static obs_properties_t *ss_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_font(props, "font", obs_module_text("Font"));
+	obs_properties_add_bool(props, "antialiasing", obs_module_text("Antialiasing"));
+	obs_properties_add_color_alpha(props, "color1", obs_module_text("Color1"));
+	obs_properties_add_color_alpha(props, "color2", obs_module_text("Color2"));
+	obs_properties_add_bool(props, "outline", obs_module_text("Outline"));
+	obs_properties_add_bool(props, "drop_shadow", obs_module_text("DropShadow"));
+	obs_properties_add_int(props, "custom_width", obs_module_text("CustomWidth"), 0, 4096, 1);
+	obs_properties_add_bool(props, "word_wrap", obs_module_text("WordWrap"));
+	obs_properties_add_int(props, S_CACHE_VRAM, obs_module_text("SlideCache.VideoMemory"), 16, 4096, 16);
+
+	return props;
+}
+
+struct obs_source_info subtitle_slideshow_info = {
+	.id = "subtitle_slideshow_source",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name = ss_getname,
+	.create = ss_create,
+	.destroy = ss_destroy,
+	.update = ss_update,
+	.get_defaults = ss_defaults,
+	.get_properties = ss_properties,
+	.video_tick = ss_tick,
+	.video_render = ss_render,
+	.get_width = ss_width,
+	.get_height = ss_height,
+	.icon_type = OBS_ICON_TYPE_TEXT,
+};
@@ -33,15 +33,10 @@ MODULE_EXPORT const char *obs_module_description(void)
 	return "FreeType2 text source";
 }
 
-uint32_t texbuf_w = 2048, texbuf_h = 2048;
-
 static const char *ft2_source_get_name(void *unused);
 static void *ft2_source_create(obs_data_t *settings, obs_source_t *source);
-static void ft2_source_destroy(void *data);
-static void ft2_source_update(void *data, obs_data_t *settings);
 static obs_missing_files_t *ft2_missing_files(void *data);
 
-static void ft2_source_render(void *data, gs_effect_t *effect);
 static void ft2_video_tick(void *data, float seconds);
 static uint32_t ft2_source_get_width(void *data);
 static uint32_t ft2_source_get_height(void *data);
@@ -120,6 +115,9 @@ bool obs_module_load()
 
 	obs_register_source(&freetype2_source_info_v1);
 	obs_register_source(&freetype2_source_info_v2);
+	obs_register_source(&subtitle_slideshow_info);
+
+	glyph_atlas_init();
 
 	return true;
 }
@@ -130,6 +128,8 @@ void obs_module_unload(void)
 		free_os_font_list();
 		FT_Done_FreeType(ft2_lib);
 	}
+
+	glyph_atlas_free();
 }
 
 static const char *ft2_source_get_name(void *unused)
@@ -215,7 +215,7 @@ static obs_properties_t *ft2_source_properties(void *unused)
 	return props;
 }
 
-static void ft2_source_destroy(void *data)
+void ft2_source_destroy(void *data)
 {
 	struct ft2_source *srcdata = data;
 
@@ -224,30 +224,25 @@ static void ft2_source_destroy(void *data)
 		srcdata->font_face = NULL;
 	}
 
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	glyph_font_release(srcdata->atlas_font);
+	srcdata->atlas_font = NULL;
 
 	if (srcdata->font_name != NULL)
 		bfree(srcdata->font_name);
 	if (srcdata->font_style != NULL)
 		bfree(srcdata->font_style);
+	if (srcdata->font_path != NULL)
+		bfree(srcdata->font_path);
 	if (srcdata->text != NULL)
 		bfree(srcdata->text);
-	if (srcdata->texbuf != NULL)
-		bfree(srcdata->texbuf);
 	if (srcdata->text_file != NULL)
 		bfree(srcdata->text_file);
 
+	dstr_free(&srcdata->pending_text);
+	pthread_mutex_destroy(&srcdata->pending_mutex);
+
 	obs_enter_graphics();
 
-	if (srcdata->tex != NULL) {
-		gs_texture_destroy(srcdata->tex);
-		srcdata->tex = NULL;
-	}
 	if (srcdata->vbuf != NULL) {
 		gs_vertexbuffer_destroy(srcdata->vbuf);
 		srcdata->vbuf = NULL;
@@ -262,33 +257,67 @@ static void ft2_source_destroy(void *data)
 	bfree(srcdata);
 }
 
-static void ft2_source_render(void *data, gs_effect_t *effect)
+void ft2_source_render(void *data, gs_effect_t *effect)
 {
 	struct ft2_source *srcdata = data;
 	if (srcdata == NULL)
 		return;
 
-	if (srcdata->tex == NULL || srcdata->vbuf == NULL)
+	if (srcdata->vbuf == NULL)
 		return;
 	if (srcdata->text == NULL || *srcdata->text == 0)
 		return;
 
+	/* other sources filled the atlas and some of our glyphs were evicted */
+	if (glyphs_evicted(srcdata)) {
+		cache_glyphs(srcdata, srcdata->text);
+		set_up_vertex_buffer(srcdata);
+		if (srcdata->vbuf == NULL)
+			return;
+	}
+
 	gs_reset_blend_state();
 	if (srcdata->outline_text)
 		draw_outlines(srcdata);
 	if (srcdata->drop_shadow)
 		draw_drop_shadow(srcdata);
 
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6, true);
+	draw_glyphs(srcdata, true);
 
 	UNUSED_PARAMETER(effect);
 }
 
+static void apply_pending_text(struct ft2_source *srcdata)
+{
+	if (!os_atomic_exchange_bool(&srcdata->text_pending, false))
+		return;
+	if (srcdata->from_file)
+		return;
+
+	pthread_mutex_lock(&srcdata->pending_mutex);
+
+	bfree(srcdata->text);
+	srcdata->text = NULL;
+	os_utf8_to_wcs_ptr(srcdata->pending_text.array ? srcdata->pending_text.array : "", srcdata->pending_text.len,
+			   &srcdata->text);
+
+	pthread_mutex_unlock(&srcdata->pending_mutex);
+
+	/* only the new string is laid out again, font and effect are kept */
+	if (srcdata->font_face) {
+		cache_glyphs(srcdata, srcdata->text);
+		set_up_vertex_buffer(srcdata);
+	}
+}
+
 static void ft2_video_tick(void *data, float seconds)
 {
 	struct ft2_source *srcdata = data;
 	if (srcdata == NULL)
 		return;
+
+	apply_pending_text(srcdata);
+
 	if (!srcdata->from_file || !srcdata->text_file)
 		return;
 
@@ -328,10 +357,17 @@ static bool init_font(struct ft2_source *srcdata)
 		srcdata->font_face = NULL;
 	}
 
-	return FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
+	if (FT_New_Face(ft2_lib, path, index, &srcdata->font_face) != 0)
+		return false;
+
+	/* glyphs are shared in the atlas by font file, not by name */
+	bfree(srcdata->font_path);
+	srcdata->font_path = bstrdup(path);
+	srcdata->font_index = index;
+	return true;
 }
 
-static void ft2_source_update(void *data, obs_data_t *settings)
+void ft2_source_update(void *data, obs_data_t *settings)
 {
 	struct ft2_source *srcdata = data;
 	obs_data_t *font_obj = obs_data_get_obj(settings, "font");
@@ -402,8 +438,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	if (ft2_lib == NULL)
 		goto error;
 
-	const size_t texbuf_size = (size_t)texbuf_w * (size_t)texbuf_h;
-
 	if (srcdata->draw_effect == NULL) {
 		char *effect_file = NULL;
 		char *error_string = NULL;
@@ -428,9 +462,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	const bool aa_changed = srcdata->antialiasing != new_aa_setting;
 	if (aa_changed) {
 		srcdata->antialiasing = new_aa_setting;
-		if (srcdata->texbuf != NULL) {
-			memset(srcdata->texbuf, 0, texbuf_size);
-		}
 		cache_standard_glyphs(srcdata);
 	}
 
@@ -463,12 +494,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 		FT_Select_Charmap(srcdata->font_face, FT_ENCODING_UNICODE);
 	}
 
-	if (srcdata->texbuf != NULL) {
-		bfree(srcdata->texbuf);
-		srcdata->texbuf = NULL;
-	}
-	srcdata->texbuf = bzalloc(texbuf_size);
-
 	if (srcdata->font_face)
 		cache_standard_glyphs(srcdata);
 
@@ -530,13 +555,48 @@ error:
 #define DEFAULT_FACE "Sans Serif"
 #endif
 
-static void *ft2_source_create(obs_data_t *settings, obs_source_t *source)
+/* Replaces only the displayed text. Unlike obs_source_update this does not
+ * re-read the font, colors or effect, so a subtitle push is just a relayout of
+ * the new string. The text is applied on the next video tick so the render
+ * thread never sees it change mid-frame. */
+static void ft2_set_text_proc(void *data, calldata_t *cd)
+{
+	struct ft2_source *srcdata = data;
+	const char *text = calldata_string(cd, "text");
+
+	if (!text)
+		text = "";
+
+	pthread_mutex_lock(&srcdata->pending_mutex);
+	dstr_copy(&srcdata->pending_text, text);
+	pthread_mutex_unlock(&srcdata->pending_mutex);
+	os_atomic_set_bool(&srcdata->text_pending, true);
+
+	/* keep the saved settings in sync without triggering an update */
+	obs_data_t *settings = obs_source_get_settings(srcdata->src);
+	obs_data_set_string(settings, "text", text);
+	obs_data_release(settings);
+}
+
+struct ft2_source *ft2_source_alloc(obs_source_t *source)
 {
 	struct ft2_source *srcdata = bzalloc(sizeof(struct ft2_source));
 	srcdata->src = source;
 
+	pthread_mutex_init(&srcdata->pending_mutex, NULL);
+
 	init_plugin();
 
+	return srcdata;
+}
+
+static void *ft2_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct ft2_source *srcdata = ft2_source_alloc(source);
+
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	proc_handler_add(ph, "void set_text(string text)", ft2_set_text_proc, srcdata);
+
 	obs_source_update(source, NULL);
 
 	UNUSED_PARAMETER(settings);
@@ -18,20 +18,22 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <obs-module.h>
+#include <util/dstr.h>
+#include <util/threading.h>
 #include <ft2build.h>
+#include "glyph-atlas.h"
 
-#define num_cache_slots 65535
-#define src_glyph srcdata->cacheglyphs[glyph_index]
-
-struct glyph_info {
-	float u, v, u2, v2;
-	int32_t w, h, xoff, yoff;
-	FT_Pos xadv;
+/* vertices drawn from one glyph atlas page */
+struct ft2_page_range {
+	uint32_t start, count;
+	uint32_t generation;
 };
 
 struct ft2_source {
 	char *font_name;
 	char *font_style;
+	char *font_path;
+	FT_Long font_index;
 	uint16_t font_size;
 	uint32_t font_flags;
 
@@ -46,32 +48,44 @@ struct ft2_source {
 
 	uint32_t cx, cy, max_h, custom_width;
 	uint32_t outline_width;
-	uint32_t texbuf_x, texbuf_y;
 	uint32_t color[2];
 
 	int32_t cur_scroll, scroll_speed;
 
-	gs_texture_t *tex;
-
-	struct glyph_info *cacheglyphs[num_cache_slots];
-
 	FT_Face font_face;
+	struct glyph_font *atlas_font;
 
-	uint8_t *texbuf;
 	gs_vertbuffer_t *vbuf;
+	struct ft2_page_range pages[GLYPH_ATLAS_MAX_PAGES];
 
 	gs_effect_t *draw_effect;
 	bool outline_text, drop_shadow;
 	bool log_mode, word_wrap;
 	uint32_t log_lines;
 
+	/* text pushed through the set_text proc, applied on the next tick */
+	pthread_mutex_t pending_mutex;
+	struct dstr pending_text;
+	volatile bool text_pending;
+
 	obs_source_t *src;
 };
 
 extern FT_Library ft2_lib;
 
+extern struct obs_source_info subtitle_slideshow_info;
+
+/* text state without a text_ft2_source around it, the subtitle slideshow
+ * lays out and draws its slides through one of these */
+struct ft2_source *ft2_source_alloc(obs_source_t *source);
+void ft2_source_update(void *data, obs_data_t *settings);
+void ft2_source_render(void *data, gs_effect_t *effect);
+void ft2_source_destroy(void *data);
+
+void draw_glyphs(struct ft2_source *srcdata, bool use_color);
 void draw_outlines(struct ft2_source *srcdata);
 void draw_drop_shadow(struct ft2_source *srcdata);
+bool glyphs_evicted(struct ft2_source *srcdata);
 
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata);
 
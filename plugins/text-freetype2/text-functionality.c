@@ -26,7 +26,22 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 float offsets[16] = {-2.0f, 0.0f, 0.0f, -2.0f, 2.0f,  0.0f, 2.0f,  0.0f,
 		     0.0f,  2.0f, 0.0f, 2.0f,  -2.0f, 0.0f, -2.0f, 0.0f};
 
-extern uint32_t texbuf_w, texbuf_h;
+void draw_glyphs(struct ft2_source *srcdata, bool use_color)
+{
+	for (uint32_t page = 0; page < GLYPH_ATLAS_MAX_PAGES; page++) {
+		const struct ft2_page_range *range = &srcdata->pages[page];
+		gs_texture_t *tex;
+
+		if (!range->count)
+			continue;
+
+		glyph_atlas_lock();
+		tex = glyph_atlas_page_texture(page);
+		glyph_atlas_unlock();
+
+		draw_uv_vbuffer(srcdata->vbuf, tex, srcdata->draw_effect, range->start, range->count, use_color);
+	}
+}
 
 void draw_outlines(struct ft2_source *srcdata)
 {
@@ -36,8 +51,7 @@ void draw_outlines(struct ft2_source *srcdata)
 	gs_matrix_push();
 	for (int32_t i = 0; i < 8; i++) {
 		gs_matrix_translate3f(offsets[i * 2], offsets[(i * 2) + 1], 0.0f);
-		draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6,
-				false);
+		draw_glyphs(srcdata, false);
 	}
 	gs_matrix_identity();
 	gs_matrix_pop();
@@ -50,14 +64,50 @@ void draw_drop_shadow(struct ft2_source *srcdata)
 
 	gs_matrix_push();
 	gs_matrix_translate3f(4.0f, 4.0f, 0.0f);
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6, false);
+	draw_glyphs(srcdata, false);
 	gs_matrix_identity();
 	gs_matrix_pop();
 }
 
+/* true if a page the vertex buffer draws from was cleared for other glyphs */
+bool glyphs_evicted(struct ft2_source *srcdata)
+{
+	bool evicted = false;
+
+	glyph_atlas_lock();
+	for (uint32_t page = 0; page < GLYPH_ATLAS_MAX_PAGES; page++) {
+		const struct ft2_page_range *range = &srcdata->pages[page];
+
+		if (range->count && range->generation != glyph_atlas_page_generation(page))
+			evicted = true;
+	}
+	glyph_atlas_unlock();
+
+	return evicted;
+}
+
+/* Other sources may have evicted the page of a glyph since it was cached, in
+ * that case it is rendered again. Pages used under the current atlas lock are
+ * never evicted, so glyphs found this way stay valid until the atlas is
+ * unlocked. The atlas must be locked. */
+static struct glyph_info *get_glyph(struct ft2_source *srcdata, FT_UInt glyph_index)
+{
+	struct glyph_info *glyph;
+
+	if (!srcdata->atlas_font)
+		return NULL;
+
+	glyph = glyph_font_find(srcdata->atlas_font, glyph_index);
+	if (!glyph)
+		glyph = glyph_font_add(srcdata->atlas_font, srcdata->font_face, glyph_index);
+
+	return glyph;
+}
+
 void set_up_vertex_buffer(struct ft2_source *srcdata)
 {
 	FT_UInt glyph_index = 0;
+	struct glyph_info *glyph;
 	uint32_t x = 0, space_pos = 0, word_width = 0;
 	size_t len;
 
@@ -84,6 +134,8 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 
 	srcdata->vbuf = create_uv_vbuffer((uint32_t)wcslen(srcdata->text) * 6, true);
 
+	glyph_atlas_lock();
+
 	if (srcdata->custom_width <= 100)
 		goto skip_word_wrap;
 	if (!srcdata->word_wrap)
@@ -115,17 +167,39 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 			space_pos = i;
 	next_char:;
 		glyph_index = FT_Get_Char_Index(srcdata->font_face, srcdata->text[i]);
-		if (src_glyph)
-			word_width += src_glyph->xadv;
+		glyph = get_glyph(srcdata, glyph_index);
+		if (glyph)
+			word_width += glyph->xadv;
 	eos_skip:;
 	}
 
 skip_word_wrap:;
 	fill_vertex_buffer(srcdata);
+	glyph_atlas_unlock();
+
 	gs_vertexbuffer_flush(srcdata->vbuf);
 	obs_leave_graphics();
 }
 
+static void count_page_glyphs(struct ft2_source *srcdata, uint32_t *counts)
+{
+	const size_t len = wcslen(srcdata->text);
+
+	for (size_t i = 0; i < len; i++) {
+		if (srcdata->text[i] == L'\n' || srcdata->text[i] == L'\r')
+			continue;
+
+		FT_UInt glyph_index = FT_Get_Char_Index(srcdata->font_face, srcdata->text[i]);
+		struct glyph_info *glyph = get_glyph(srcdata, glyph_index);
+		if (glyph)
+			counts[glyph->page]++;
+	}
+}
+
+/* Glyphs are grouped by atlas page in the vertex buffer so every page is
+ * drawn with a single call. Counting the glyphs brings back evicted ones, so
+ * every glyph that fits in the atlas is found below. The atlas must be
+ * locked. */
 void fill_vertex_buffer(struct ft2_source *srcdata)
 {
 	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(srcdata->vbuf);
@@ -136,12 +210,26 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 	uint32_t *col = (uint32_t *)vdata->colors;
 
 	FT_UInt glyph_index = 0;
+	struct glyph_info *glyph;
 
 	uint32_t dx = 0, dy = srcdata->max_h, max_y = dy;
+	uint32_t page_glyphs[GLYPH_ATLAS_MAX_PAGES] = {0};
+	uint32_t next_glyph[GLYPH_ATLAS_MAX_PAGES];
 	uint32_t cur_glyph = 0;
 	uint32_t offset = 0;
 	size_t len = wcslen(srcdata->text);
 
+	count_page_glyphs(srcdata, page_glyphs);
+
+	for (uint32_t page = 0; page < GLYPH_ATLAS_MAX_PAGES; page++) {
+		srcdata->pages[page].start = cur_glyph * 6;
+		srcdata->pages[page].count = page_glyphs[page] * 6;
+		srcdata->pages[page].generation = glyph_atlas_page_generation(page);
+
+		next_glyph[page] = cur_glyph;
+		cur_glyph += page_glyphs[page];
+	}
+
 	if (srcdata->outline_text) {
 		offset = 2;
 		dx = offset;
@@ -164,50 +252,35 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 			goto skip_glyph;
 
 		glyph_index = FT_Get_Char_Index(srcdata->font_face, srcdata->text[i]);
-		if (src_glyph == NULL)
+		glyph = glyph_font_find(srcdata->atlas_font, glyph_index);
+		if (glyph == NULL)
 			goto skip_glyph;
 
 		if (srcdata->custom_width < 100)
 			goto skip_custom_width;
 
-		if (dx + src_glyph->xadv > srcdata->custom_width) {
+		if (dx + glyph->xadv > srcdata->custom_width) {
 			dx = offset;
 			dy += srcdata->max_h + 4;
 		}
 
 	skip_custom_width:;
 
-		set_v3_rect(vdata->points + (cur_glyph * 6), (float)dx + (float)src_glyph->xoff,
-			    (float)dy - (float)src_glyph->yoff, (float)src_glyph->w, (float)src_glyph->h);
-		set_v2_uv(tvarray + (cur_glyph * 6), src_glyph->u, src_glyph->v, src_glyph->u2, src_glyph->v2);
+		cur_glyph = next_glyph[glyph->page]++;
+
+		set_v3_rect(vdata->points + (cur_glyph * 6), (float)dx + (float)glyph->xoff,
+			    (float)dy - (float)glyph->yoff, (float)glyph->w, (float)glyph->h);
+		set_v2_uv(tvarray + (cur_glyph * 6), glyph->u, glyph->v, glyph->u2, glyph->v2);
 		set_rect_colors2(col + (cur_glyph * 6), srcdata->color[0], srcdata->color[1]);
-		dx += src_glyph->xadv;
-		if (dy - (float)src_glyph->yoff + src_glyph->h > max_y)
-			max_y = dy - src_glyph->yoff + src_glyph->h;
-		cur_glyph++;
+		dx += glyph->xadv;
+		if (dy - (float)glyph->yoff + glyph->h > max_y)
+			max_y = dy - glyph->yoff + glyph->h;
 	skip_glyph:;
 	}
 
 	srcdata->cy = max_y;
 }
 
-void cache_standard_glyphs(struct ft2_source *srcdata)
-{
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
-
-	srcdata->texbuf_x = 0;
-	srcdata->texbuf_y = 0;
-
-	cache_glyphs(srcdata, L"abcdefghijklmnopqrstuvwxyz"
-			      L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
-			      L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
-}
-
 FT_Render_Mode get_render_mode(struct ft2_source *srcdata)
 {
 	return srcdata->antialiasing ? FT_RENDER_MODE_NORMAL : FT_RENDER_MODE_MONO;
@@ -219,129 +292,52 @@ void load_glyph(struct ft2_source *srcdata, const FT_UInt glyph_index, const FT_
 	FT_Load_Glyph(srcdata->font_face, glyph_index, load_mode);
 }
 
-struct glyph_info *init_glyph(FT_GlyphSlot slot, const uint32_t dx, const uint32_t dy, const uint32_t g_w,
-			      const uint32_t g_h)
-{
-	struct glyph_info *glyph = bzalloc(sizeof(struct glyph_info));
-	glyph->u = (float)dx / (float)texbuf_w;
-	glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
-	glyph->v = (float)dy / (float)texbuf_h;
-	glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
-	glyph->w = g_w;
-	glyph->h = g_h;
-	glyph->yoff = slot->bitmap_top;
-	glyph->xoff = slot->bitmap_left;
-	glyph->xadv = slot->advance.x >> 6;
-
-	return glyph;
-}
-
-uint8_t get_pixel_value(const unsigned char *buf_row, FT_Render_Mode render_mode, const uint32_t x)
+void cache_standard_glyphs(struct ft2_source *srcdata)
 {
-	if (render_mode == FT_RENDER_MODE_NORMAL) {
-		return buf_row[x];
-	}
+	struct glyph_font *old_font = srcdata->atlas_font;
 
-	const uint32_t byte_index = x / 8;
-	const uint8_t bit_index = x % 8;
-	const bool pixel_set = (buf_row[byte_index] >> (7 - bit_index)) & 1;
-	return pixel_set ? 255 : 0;
-}
+	/* get the new font before releasing the old one, so the atlas is not
+	 * freed in between if this is the only source */
+	srcdata->atlas_font = NULL;
+	if (srcdata->font_path)
+		srcdata->atlas_font = glyph_atlas_get_font(srcdata->font_path, srcdata->font_index,
+							   srcdata->font_size, get_render_mode(srcdata));
+	glyph_font_release(old_font);
 
-void rasterize(struct ft2_source *srcdata, FT_GlyphSlot slot, const FT_Render_Mode render_mode, const uint32_t dx,
-	       const uint32_t dy)
-{
-	/**
-	 * The pitch's absolute value is the number of bytes taken by one bitmap
-	 * row, including padding.
-	 *
-	 * Source: https://www.freetype.org/freetype2/docs/reference/ft2-basic_types.html
-	 */
-	const int pitch = abs(slot->bitmap.pitch);
-
-	for (uint32_t y = 0; y < slot->bitmap.rows; y++) {
-		const uint32_t row_start = y * pitch;
-		const uint32_t row = (dy + y) * texbuf_w;
-
-		for (uint32_t x = 0; x < slot->bitmap.width; x++) {
-			const uint32_t row_pixel_position = dx + x;
-			const uint8_t pixel_value = get_pixel_value(&slot->bitmap.buffer[row_start], render_mode, x);
-			srcdata->texbuf[row_pixel_position + row] = pixel_value;
-		}
-	}
+	cache_glyphs(srcdata, L"abcdefghijklmnopqrstuvwxyz"
+			      L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
+			      L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
 }
 
 void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
 {
-	if (!srcdata->font_face || !cache_glyphs)
+	if (!srcdata->font_face || !srcdata->atlas_font || !cache_glyphs)
 		return;
 
-	FT_GlyphSlot slot = srcdata->font_face->glyph;
-
-	uint32_t dx = srcdata->texbuf_x;
-	uint32_t dy = srcdata->texbuf_y;
-
-	int32_t cached_glyphs = 0;
 	const size_t len = wcslen(cache_glyphs);
+	bool warned = false;
 
-	const FT_Render_Mode render_mode = get_render_mode(srcdata);
+	glyph_atlas_lock();
 
 	for (size_t i = 0; i < len; i++) {
 		const FT_UInt glyph_index = FT_Get_Char_Index(srcdata->font_face, cache_glyphs[i]);
-
-		if (src_glyph != NULL) {
+		struct glyph_info *glyph = get_glyph(srcdata, glyph_index);
+
+		/* too large for a page, or the text needs more pages than
+		 * the atlas has */
+		if (glyph == NULL) {
+			if (!warned)
+				blog(LOG_WARNING, "Out of space trying to render glyphs");
+			warned = true;
 			continue;
 		}
 
-		load_glyph(srcdata, glyph_index, render_mode);
-		FT_Render_Glyph(slot, render_mode);
-
-		const uint32_t g_w = slot->bitmap.width;
-		const uint32_t g_h = slot->bitmap.rows;
-
-		if (srcdata->max_h < g_h) {
-			srcdata->max_h = g_h;
-		}
-
-		if (dx + g_w >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h + 1;
+		if (srcdata->max_h < (uint32_t)glyph->h) {
+			srcdata->max_h = glyph->h;
 		}
-
-		if (dy + g_h >= texbuf_h) {
-			blog(LOG_WARNING, "Out of space trying to render glyphs");
-			break;
-		}
-
-		src_glyph = init_glyph(slot, dx, dy, g_w, g_h);
-		rasterize(srcdata, slot, render_mode, dx, dy);
-
-		dx += (g_w + 1);
-		if (dx >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h;
-		}
-
-		cached_glyphs++;
 	}
 
-	srcdata->texbuf_x = dx;
-	srcdata->texbuf_y = dy;
-
-	if (cached_glyphs > 0) {
-
-		obs_enter_graphics();
-
-		if (srcdata->tex != NULL) {
-			gs_texture_t *tmp_texture = srcdata->tex;
-			srcdata->tex = NULL;
-			gs_texture_destroy(tmp_texture);
-		}
-
-		srcdata->tex = gs_texture_create(texbuf_w, texbuf_h, GS_A8, 1, (const uint8_t **)&srcdata->texbuf, 0);
-
-		obs_leave_graphics();
-	}
+	glyph_atlas_unlock();
 }
 
 time_t get_modified_timestamp(char *filename)
@@ -511,15 +507,20 @@ uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
 	FT_GlyphSlot slot = srcdata->font_face->glyph;
 	uint32_t w = 0, max_w = 0;
 	const size_t len = wcslen(text);
+
+	glyph_atlas_lock();
+
 	for (size_t i = 0; i < len; i++) {
 		const FT_UInt glyph_index = FT_Get_Char_Index(srcdata->font_face, text[i]);
 
 		if (text[i] == L'\n')
 			w = 0;
 		else {
-			if (src_glyph) {
+			struct glyph_info *glyph = glyph_font_find(srcdata->atlas_font, glyph_index);
+
+			if (glyph) {
 				// Use the cached values.
-				w += src_glyph->xadv;
+				w += glyph->xadv;
 			} else {
 				load_glyph(srcdata, glyph_index, get_render_mode(srcdata));
 				w += slot->advance.x >> 6;
@@ -529,5 +530,7 @@ uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
 		}
 	}
 
+	glyph_atlas_unlock();
+
 	return max_w;
 }
@@ -17,6 +17,9 @@
 #include <media-io/audio-io.h>
 #include <util/platform.h>
 
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+
 #include "media-playback.h"
 #include "cache.h"
 #include "media.h"
@@ -140,6 +143,354 @@ fail:
 	return success;
 }
 
+/* ------------------------------------------------------------------------- */
+/* compressed frames                                                         */
+
+static enum AVPixelFormat pack_format(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+		return AV_PIX_FMT_YUV420P;
+	case VIDEO_FORMAT_I422:
+		return AV_PIX_FMT_YUV422P;
+	case VIDEO_FORMAT_I444:
+		return AV_PIX_FMT_YUV444P;
+	case VIDEO_FORMAT_I40A:
+		return AV_PIX_FMT_YUVA420P;
+	case VIDEO_FORMAT_I42A:
+		return AV_PIX_FMT_YUVA422P;
+	case VIDEO_FORMAT_YUVA:
+		return AV_PIX_FMT_YUVA444P;
+	default:
+		return AV_PIX_FMT_NONE;
+	}
+}
+
+/* NV12 is split into planes, everything else is stored as it is */
+static inline enum video_format unpacked_format(enum video_format format)
+{
+	return format == VIDEO_FORMAT_NV12 ? VIDEO_FORMAT_I420 : format;
+}
+
+static bool mp_cache_open_encoder(mp_cache_t *c, const struct obs_source_frame *frame)
+{
+	/* FFV Huffyuv is lossless, intra-only and fast enough to keep up with
+	 * decoding in both directions */
+	const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_FFVHUFF);
+	enum AVPixelFormat format = pack_format(frame->format);
+	int ret;
+
+	if (!codec || format == AV_PIX_FMT_NONE)
+		return false;
+
+	c->encoder = avcodec_alloc_context3(codec);
+	if (!c->encoder)
+		return false;
+
+	c->encoder->width = (int)frame->width;
+	c->encoder->height = (int)frame->height;
+	c->encoder->pix_fmt = format;
+	c->encoder->time_base = (AVRational){1, 1000000000};
+
+	ret = avcodec_open2(c->encoder, codec, NULL);
+	if (ret < 0) {
+		blog(LOG_INFO, "MP: Cannot compress cached frames, storing them uncompressed: %s", av_err2str(ret));
+		avcodec_free_context(&c->encoder);
+		return false;
+	}
+
+	c->pack_frame = av_frame_alloc();
+	if (!c->pack_frame) {
+		avcodec_free_context(&c->encoder);
+		return false;
+	}
+
+	c->pack_frame->format = format;
+	c->pack_frame->width = (int)frame->width;
+	c->pack_frame->height = (int)frame->height;
+
+	/* NV12 gets split into a buffer of its own, other frames are passed on
+	 * directly */
+	if (frame->format == VIDEO_FORMAT_NV12 && av_frame_get_buffer(c->pack_frame, 0) < 0) {
+		av_frame_free(&c->pack_frame);
+		avcodec_free_context(&c->encoder);
+		return false;
+	}
+
+	return true;
+}
+
+static void split_nv12(AVFrame *dst, const struct obs_source_frame *frame)
+{
+	const uint32_t cx = frame->width;
+	const uint32_t cy = frame->height;
+
+	for (uint32_t y = 0; y < cy; y++)
+		memcpy(dst->data[0] + y * dst->linesize[0], frame->data[0] + y * frame->linesize[0], cx);
+
+	for (uint32_t y = 0; y < (cy + 1) / 2; y++) {
+		const uint8_t *uv = frame->data[1] + y * frame->linesize[1];
+		uint8_t *u = dst->data[1] + y * dst->linesize[1];
+		uint8_t *v = dst->data[2] + y * dst->linesize[2];
+
+		for (uint32_t x = 0; x < (cx + 1) / 2; x++) {
+			u[x] = uv[x * 2];
+			v[x] = uv[x * 2 + 1];
+		}
+	}
+}
+
+static AVPacket *mp_cache_pack(mp_cache_t *c, const struct obs_source_frame *frame)
+{
+	AVFrame *in;
+	AVPacket *packet;
+	int ret;
+
+	if (!c->compress || c->pack_failed)
+		return NULL;
+	if (!c->encoder && !mp_cache_open_encoder(c, frame)) {
+		c->pack_failed = true;
+		return NULL;
+	}
+
+	if (c->encoder->width != (int)frame->width || c->encoder->height != (int)frame->height ||
+	    c->encoder->pix_fmt != pack_format(frame->format))
+		return NULL;
+
+	in = c->pack_frame;
+	if (in->buf[0]) {
+		if (frame->format != VIDEO_FORMAT_NV12 || av_frame_make_writable(in) < 0)
+			return NULL;
+		split_nv12(in, frame);
+	} else {
+		if (frame->format == VIDEO_FORMAT_NV12)
+			return NULL;
+		for (size_t i = 0; i < MAX_AV_PLANES && i < AV_NUM_DATA_POINTERS; i++) {
+			in->data[i] = frame->data[i];
+			in->linesize[i] = (int)frame->linesize[i];
+		}
+	}
+
+	in->pts = (int64_t)frame->timestamp;
+
+	/* the encoder has no delay, every frame comes straight back out */
+	ret = avcodec_send_frame(c->encoder, in);
+	if (ret < 0)
+		return NULL;
+
+	packet = av_packet_alloc();
+	ret = avcodec_receive_packet(c->encoder, packet);
+	if (ret < 0) {
+		av_packet_free(&packet);
+		return NULL;
+	}
+
+	c->packed_size += (size_t)packet->size;
+	c->raw_size += (size_t)av_image_get_buffer_size(c->encoder->pix_fmt, c->encoder->width, c->encoder->height, 1);
+	return packet;
+}
+
+static bool unpack_frame(AVCodecContext *decoder, AVFrame *tmp, AVPacket *packet, struct obs_source_frame *frame)
+{
+	const AVPixFmtDescriptor *desc;
+	int ret;
+
+	ret = avcodec_send_packet(decoder, packet);
+	if (ret == 0)
+		ret = avcodec_receive_frame(decoder, tmp);
+	if (ret < 0)
+		return false;
+
+	desc = av_pix_fmt_desc_get(tmp->format);
+
+	for (int i = 0; i < AV_NUM_DATA_POINTERS && i < MAX_AV_PLANES && tmp->data[i]; i++) {
+		const bool chroma = i == 1 || i == 2;
+		const int rows = chroma ? AV_CEIL_RSHIFT(tmp->height, desc->log2_chroma_h) : tmp->height;
+		const int size = av_image_get_linesize(tmp->format, tmp->width, i);
+
+		av_image_copy_plane(frame->data[i], (int)frame->linesize[i], tmp->data[i], tmp->linesize[i], size,
+				    rows);
+	}
+
+	av_frame_unref(tmp);
+	return true;
+}
+
+static void *unpack_thread(void *opaque)
+{
+	mp_cache_t *c = opaque;
+	struct mp_cache_unpack *u = &c->unpack;
+	const size_t num = c->video_packets.num;
+	size_t misses = 0;
+
+	os_set_thread_name("mp_cache_unpack");
+
+	while (!os_atomic_load_bool(&u->stop)) {
+		struct mp_cache_slot *slot;
+		uint64_t generation;
+		AVPacket *packet;
+		size_t idx;
+		bool full;
+		bool ok;
+
+		pthread_mutex_lock(&u->mutex);
+		full = u->queued == MP_CACHE_UNPACK_FRAMES - 1;
+		slot = &u->slots[(u->cur + u->queued + 1) % MP_CACHE_UNPACK_FRAMES];
+		idx = u->next_idx;
+		generation = u->generation;
+		pthread_mutex_unlock(&u->mutex);
+
+		/* also rests if nothing in a full pass could be decoded */
+		if (full || misses == num) {
+			os_event_wait(u->event);
+			misses = 0;
+			continue;
+		}
+
+		packet = c->video_packets.array[idx];
+		ok = packet && unpack_frame(u->decoder, u->frame, packet, &slot->frame);
+		misses = ok ? 0 : misses + 1;
+
+		pthread_mutex_lock(&u->mutex);
+		if (generation == u->generation) {
+			u->next_idx = (idx + 1) % num;
+			if (ok) {
+				slot->idx = idx;
+				u->queued++;
+			}
+		}
+		pthread_mutex_unlock(&u->mutex);
+	}
+
+	return NULL;
+}
+
+static AVCodecContext *open_unpack_decoder(void)
+{
+	const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_FFVHUFF);
+	AVCodecContext *decoder;
+
+	if (!codec)
+		return NULL;
+
+	decoder = avcodec_alloc_context3(codec);
+	if (decoder && avcodec_open2(decoder, codec, NULL) < 0)
+		avcodec_free_context(&decoder);
+	return decoder;
+}
+
+static bool mp_cache_start_unpack(mp_cache_t *c)
+{
+	struct mp_cache_unpack *u = &c->unpack;
+	enum video_format format = VIDEO_FORMAT_NONE;
+	uint32_t cx = 0, cy = 0;
+
+	for (size_t i = 0; i < c->video_packets.num; i++) {
+		if (c->video_packets.array[i]) {
+			struct obs_source_frame *frame = &c->video_frames.array[i];
+			format = frame->format;
+			cx = frame->width;
+			cy = frame->height;
+			break;
+		}
+	}
+
+	if (format == VIDEO_FORMAT_NONE)
+		return true;
+
+	blog(LOG_INFO, "MP: Compressed cached video from %zu MB to %zu MB", c->raw_size / (1024 * 1024),
+	     c->packed_size / (1024 * 1024));
+
+	u->decoder = open_unpack_decoder();
+	u->sync_decoder = open_unpack_decoder();
+	u->frame = av_frame_alloc();
+	u->sync_frame = av_frame_alloc();
+	if (!u->decoder || !u->sync_decoder || !u->frame || !u->sync_frame)
+		return false;
+
+	for (size_t i = 0; i < MP_CACHE_UNPACK_FRAMES; i++) {
+		obs_source_frame_init(&u->slots[i].frame, format, cx, cy);
+		u->slots[i].idx = SIZE_MAX;
+	}
+
+	if (pthread_mutex_init(&u->mutex, NULL) != 0)
+		return false;
+	if (os_event_init(&u->event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+	if (pthread_create(&u->thread, NULL, unpack_thread, c) != 0)
+		return false;
+
+	u->thread_valid = true;
+	return true;
+}
+
+static void mp_cache_stop_unpack(mp_cache_t *c)
+{
+	struct mp_cache_unpack *u = &c->unpack;
+
+	if (u->thread_valid) {
+		os_atomic_set_bool(&u->stop, true);
+		os_event_signal(u->event);
+		pthread_join(u->thread, NULL);
+		pthread_mutex_destroy(&u->mutex);
+	}
+
+	os_event_destroy(u->event);
+	avcodec_free_context(&u->decoder);
+	avcodec_free_context(&u->sync_decoder);
+	av_frame_free(&u->frame);
+	av_frame_free(&u->sync_frame);
+
+	for (size_t i = 0; i < MP_CACHE_UNPACK_FRAMES; i++)
+		obs_source_frame_free(&u->slots[i].frame);
+}
+
+/* returns the frame with its data, valid until the next call */
+static bool mp_cache_get_video(mp_cache_t *c, size_t idx, struct obs_source_frame *dup)
+{
+	struct mp_cache_unpack *u = &c->unpack;
+	struct obs_source_frame *frame = NULL;
+	size_t next;
+
+	*dup = c->video_frames.array[idx];
+	if (!c->video_packets.num || !c->video_packets.array[idx])
+		return true;
+	if (!u->thread_valid)
+		return false;
+
+	pthread_mutex_lock(&u->mutex);
+	next = (u->cur + 1) % MP_CACHE_UNPACK_FRAMES;
+	if (u->queued && u->slots[next].idx == idx) {
+		u->cur = next;
+		u->queued--;
+		frame = &u->slots[next].frame;
+	} else {
+		/* seeked, or got ahead of the worker, start over from here */
+		u->queued = 0;
+		u->generation++;
+		u->next_idx = (idx + 1) % c->video_packets.num;
+	}
+	pthread_mutex_unlock(&u->mutex);
+
+	os_event_signal(u->event);
+
+	if (!frame) {
+		frame = &u->slots[u->cur].frame;
+		u->slots[u->cur].idx = idx;
+
+		if (!unpack_frame(u->sync_decoder, u->sync_frame, c->video_packets.array[idx], frame))
+			return false;
+	}
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		dup->data[i] = frame->data[i];
+		dup->linesize[i] = frame->linesize[i];
+	}
+
+	return true;
+}
+
 static void seek_to(mp_cache_t *c, int64_t pos)
 {
 	size_t new_v_idx = 0;
@@ -241,22 +592,24 @@ static void mp_cache_next_video(mp_cache_t *c, bool preload)
 	}
 
 	struct obs_source_frame *frame = &c->video_frames.array[c->next_v_idx];
-	struct obs_source_frame dup = *frame;
+	struct obs_source_frame dup;
+	bool valid;
+
+	if (!preload && !mp_media_can_play_video(c))
+		return;
 
+	valid = mp_cache_get_video(c, c->next_v_idx, &dup);
 	dup.timestamp = c->base_ts + dup.timestamp - c->start_ts + c->play_sys_ts - base_sys_ts;
 
 	if (!preload) {
-		if (!mp_media_can_play_video(c))
-			return;
-
-		if (c->v_cb)
+		if (valid && c->v_cb)
 			c->v_cb(c->opaque, &dup);
 
 		if (c->cur_v_idx < c->next_v_idx)
 			++c->cur_v_idx;
 		++c->next_v_idx;
 		calc_next_v_ts(c, frame);
-	} else {
+	} else if (valid) {
 		if (c->seek_next_ts && c->v_seek_cb) {
 			c->v_seek_cb(c->opaque, &dup);
 		} else if (!c->request_preload) {
@@ -372,6 +725,10 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 	if (!mp_cache_decode(c)) {
 		return false;
 	}
+	if (!mp_cache_start_unpack(c)) {
+		blog(LOG_WARNING, "MP: Failed to start unpacking compressed frames");
+		return false;
+	}
 
 	for (;;) {
 		bool reset, kill, is_active, seek, pause, reset_time, preload_frame;
@@ -432,8 +789,11 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 		if (pause)
 			continue;
 
-		if (preload_frame)
-			c->v_preload_cb(c->opaque, &c->video_frames.array[0]);
+		if (preload_frame) {
+			struct obs_source_frame frame;
+			if (mp_cache_get_video(c, 0, &frame))
+				c->v_preload_cb(c->opaque, &frame);
+		}
 
 		/* frames are ready */
 		if (is_active && !timeout) {
@@ -469,14 +829,25 @@ static void fill_video(void *data, struct obs_source_frame *frame)
 {
 	mp_cache_t *c = data;
 	struct obs_source_frame dup;
+	AVPacket *packet = mp_cache_pack(c, frame);
 
-	obs_source_frame_init(&dup, frame->format, frame->width, frame->height);
-	obs_source_frame_copy(&dup, frame);
+	if (packet) {
+		dup = *frame;
+		dup.format = unpacked_format(frame->format);
+		memset(dup.data, 0, sizeof(dup.data));
+		memset(dup.linesize, 0, sizeof(dup.linesize));
+	} else {
+		obs_source_frame_init(&dup, frame->format, frame->width, frame->height);
+		obs_source_frame_copy(&dup, frame);
+	}
 
 	dup.timestamp = frame->timestamp;
 
 	c->final_v_duration = c->m.v.last_duration;
 
+	if (c->compress)
+		da_push_back(c->video_packets, &packet);
+
 	da_push_back(c->video_frames, &dup);
 }
 
@@ -566,6 +937,7 @@ bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
 	c->v_preload_cb = info->v_preload_cb;
 	c->request_preload = info->request_preload;
 	c->speed = info->speed;
+	c->compress = info->compress_cache;
 	c->media_duration = m->fmt->duration;
 
 	c->has_video = m->has_video;
@@ -601,6 +973,7 @@ void mp_cache_free(mp_cache_t *c)
 
 	mp_cache_stop(c);
 	mp_kill_thread(c);
+	mp_cache_stop_unpack(c);
 
 	if (c->m.fmt)
 		mp_media_free(&c->m);
@@ -613,8 +986,13 @@ void mp_cache_free(mp_cache_t *c)
 		struct obs_source_audio *a = &c->audio_segments.array[i];
 		bfree((void *)a->data[0]);
 	}
+	for (size_t i = 0; i < c->video_packets.num; i++)
+		av_packet_free(&c->video_packets.array[i]);
 	da_free(c->video_frames);
 	da_free(c->audio_segments);
+	da_free(c->video_packets);
+	avcodec_free_context(&c->encoder);
+	av_frame_free(&c->pack_frame);
 
 	bfree(c->path);
 	bfree(c->format_name);
@@ -22,6 +22,34 @@
 
 #include "media.h"
 
+#define MP_CACHE_UNPACK_FRAMES 6
+
+struct mp_cache_slot {
+	struct obs_source_frame frame;
+	size_t idx;
+};
+
+/* decode-ahead of compressed cache frames, the slot at cur is owned by the
+ * cache thread and the queued slots after it hold the next frames */
+struct mp_cache_unpack {
+	AVCodecContext *decoder;
+	AVCodecContext *sync_decoder;
+	AVFrame *frame;
+	AVFrame *sync_frame;
+
+	pthread_mutex_t mutex;
+	os_event_t *event;
+	struct mp_cache_slot slots[MP_CACHE_UNPACK_FRAMES];
+	size_t cur;
+	size_t queued;
+	size_t next_idx;
+	uint64_t generation;
+	volatile bool stop;
+
+	bool thread_valid;
+	pthread_t thread;
+};
+
 struct mp_cache {
 	mp_video_cb v_preload_cb;
 	mp_video_cb v_seek_cb;
@@ -54,6 +82,18 @@ struct mp_cache {
 	DARRAY(struct obs_source_frame) video_frames;
 	DARRAY(struct obs_source_audio) audio_segments;
 
+	/* with compress set, frames in a supported format are stored as
+	 * lossless intra-only packets, in which case the matching entry in
+	 * video_frames only carries the frame properties */
+	bool compress;
+	bool pack_failed;
+	AVCodecContext *encoder;
+	AVFrame *pack_frame;
+	DARRAY(AVPacket *) video_packets;
+	size_t packed_size;
+	size_t raw_size;
+	struct mp_cache_unpack unpack;
+
 	size_t cur_v_idx;
 	size_t cur_a_idx;
 	size_t next_v_idx;
@@ -78,6 +78,7 @@ struct fragment_sample {
 	uint32_t size;
 	int32_t offset;
 	uint32_t duration;
+	bool keyframe;
 };
 
 struct mp4_track {
@@ -142,6 +143,14 @@ struct mp4_mux {
 	/* PTS where next fragmentation should take place */
 	int64_t next_frag_pts;
 
+	/* Fragment budget for MP4_FRAGMENTED_STREAMING */
+	int64_t max_frag_duration;
+	size_t max_frag_size;
+	/* PTS of the last fragment cut (in usec) */
+	int64_t frag_start_pts;
+	/* Size of packets queued but not yet written to a fragment */
+	size_t pending_size;
+
 	/* Creation time (seconds since Jan 1 1904) */
 	uint64_t creation_time;
 
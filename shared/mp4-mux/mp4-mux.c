@@ -43,6 +43,10 @@
 #define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
 #define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
 
+/* Fragment budget used with MP4_FRAGMENTED_STREAMING */
+#define DEFAULT_FRAGMENT_DURATION_USEC 2000000LL
+#define DEFAULT_FRAGMENT_SIZE (32 * 1024 * 1024)
+
 /* Helper to overwrite placeholder size and return total size. */
 static inline size_t write_box_size(struct serializer *s, int64_t start)
 {
@@ -2112,8 +2116,13 @@ static size_t mp4_write_trun(struct mp4_mux *mux, struct mp4_track *track, uint3
 	if (track->sample_size)
 		return write_box_size(s, start);
 
-	if (track->type == TRACK_VIDEO)
-		s_wb32(s, SAMPLE_FLAG_DEPENDS_NO); // first_sample_flags
+	// first_sample_flags
+	if (track->type == TRACK_VIDEO) {
+		if (track->fragment_samples.array[0].keyframe)
+			s_wb32(s, SAMPLE_FLAG_DEPENDS_NO);
+		else
+			s_wb32(s, SAMPLE_FLAG_DEPENDS_YES | SAMPLE_FLAG_IS_NON_SYNC);
+	}
 
 	for (size_t idx = 0; idx < sample_count; idx++) {
 		struct fragment_sample *smp = &track->fragment_samples.array[idx];
@@ -2265,7 +2274,7 @@ static void process_packets(struct mp4_mux *mux, struct mp4_track *track, uint64
 
 		/* When using negative CTS, subtract DTS-PTS offset. */
 		if (track->type == TRACK_VIDEO && mux->flags & MP4_USE_NEGATIVE_CTS) {
-			if (!track->offsets.num)
+			if (!track->samples)
 				track->dts_offset = offset;
 
 			offset -= track->dts_offset;
@@ -2276,6 +2285,7 @@ static void process_packets(struct mp4_mux *mux, struct mp4_track *track, uint64
 		smp->size = size;
 		smp->offset = offset;
 		smp->duration = duration;
+		smp->keyframe = pkt->keyframe;
 
 		*mdat_size += size;
 
@@ -2293,6 +2303,11 @@ static void process_packets(struct mp4_mux *mux, struct mp4_track *track, uint64
 
 		track->samples += sample_count;
 
+		/* Streaming files never get a full moov, so do not keep tables
+		 * that would grow for the whole length of the recording. */
+		if (mux->flags & MP4_FRAGMENTED_STREAMING)
+			continue;
+
 		/* If delta (duration) matche sprevious, increment counter,
 		 * otherwise create a new entry. */
 		if (track->deltas.num == 0 || track->deltas.array[track->deltas.num - 1].delta != duration) {
@@ -2337,17 +2352,27 @@ static void write_packets(struct mp4_mux *mux, struct mp4_track *track)
 	if (!count || !track->fragment_samples.num)
 		return;
 
-	struct chunk *chk = da_push_back_new(track->chunks);
-	chk->offset = serializer_get_pos(s);
-	chk->samples = (uint32_t)track->fragment_samples.num;
+	int64_t offset = serializer_get_pos(s);
 
 	for (size_t i = 0; i < track->fragment_samples.num; i++) {
 		struct encoder_packet pkt;
 		deque_pop_front(&track->packets, &pkt, sizeof(struct encoder_packet));
 		s_write(s, pkt.data, pkt.size);
+
+		if (track != mux->chapter_track)
+			mux->pending_size -= pkt.size;
+
 		obs_encoder_packet_release(&pkt);
 	}
 
+	if (mux->flags & MP4_FRAGMENTED_STREAMING) {
+		da_clear(track->fragment_samples);
+		return;
+	}
+
+	struct chunk *chk = da_push_back_new(track->chunks);
+	chk->offset = offset;
+	chk->samples = (uint32_t)track->fragment_samples.num;
 	chk->size = (uint32_t)(serializer_get_pos(s) - chk->offset);
 
 	/* Fixup sample count for fixed-size codecs */
@@ -2439,6 +2464,9 @@ static void mp4_flush_fragment(struct mp4_mux *mux)
 	if (!mux->next_frag_pts && mux->chapter_track)
 		write_packets(mux, mux->chapter_track);
 
+	if (mux->next_frag_pts)
+		mux->frag_start_pts = mux->next_frag_pts;
+
 	mux->next_frag_pts = 0;
 }
 
@@ -2583,6 +2611,19 @@ static inline void free_track(struct mp4_track *track)
 /* ===========================================================================*/
 /* API */
 
+/* Cut fragments on non-keyframes if the encoder's keyframe interval would
+ * keep too much data queued, only checked on the first (video) track. */
+static inline void check_fragment_budget(struct mp4_mux *mux, struct encoder_packet *pkt)
+{
+	int64_t pts_usec = packet_pts_usec(pkt);
+
+	if (mux->next_frag_pts || pts_usec <= mux->frag_start_pts)
+		return;
+
+	if (pts_usec - mux->frag_start_pts >= mux->max_frag_duration || mux->pending_size >= mux->max_frag_size)
+		mux->next_frag_pts = pts_usec;
+}
+
 struct mp4_mux *mp4_mux_create(obs_output_t *output, struct serializer *serializer, enum mp4_mux_flags flags)
 {
 	struct mp4_mux *mux = bzalloc(sizeof(struct mp4_mux));
@@ -2607,9 +2648,21 @@ struct mp4_mux *mp4_mux_create(obs_output_t *output, struct serializer *serializ
 		add_track(mux, enc);
 	}
 
+	/* Only used with MP4_FRAGMENTED_STREAMING */
+	mux->max_frag_duration = DEFAULT_FRAGMENT_DURATION_USEC;
+	mux->max_frag_size = DEFAULT_FRAGMENT_SIZE;
+
 	return mux;
 }
 
+void mp4_mux_set_fragment_limits(struct mp4_mux *mux, int64_t duration_usec, size_t size)
+{
+	if (duration_usec > 0)
+		mux->max_frag_duration = duration_usec;
+	if (size > 0)
+		mux->max_frag_size = size;
+}
+
 void mp4_mux_destroy(struct mp4_mux *mux)
 {
 	for (size_t i = 0; i < mux->tracks.num; i++)
@@ -2666,6 +2719,10 @@ bool mp4_mux_submit_packet(struct mp4_mux *mux, struct encoder_packet *pkt)
 	}
 
 	track_insert_packet(track, &parsed_packet);
+	mux->pending_size += parsed_packet.size;
+
+	if (mux->flags & MP4_FRAGMENTED_STREAMING && track == mux->tracks.array)
+		check_fragment_budget(mux, &parsed_packet);
 
 	return true;
 }
@@ -2705,6 +2762,11 @@ bool mp4_mux_finalise(struct mp4_mux *mux)
 
 	info("Number of fragments: %u", mux->fragments_written);
 
+	if (mux->flags & MP4_FRAGMENTED_STREAMING) {
+		info("Leaving file fragmented (streaming mode)");
+		return true;
+	}
+
 	if (mux->flags & MP4_SKIP_FINALISATION) {
 		warn("Skipping MP4 finalization!");
 		return true;
@@ -31,10 +31,15 @@ enum mp4_mux_flags {
 	MP4_SKIP_FINALISATION = 1 << 2,
 	/* Use negative CTS instead of edit lists */
 	MP4_USE_NEGATIVE_CTS = 1 << 3,
+	/* Only write fragments and keep no sample tables for a full moov,
+	 * fragments are also cut on a duration/size budget (implies
+	 * MP4_SKIP_FINALISATION) */
+	MP4_FRAGMENTED_STREAMING = 1 << 4,
 };
 
 struct mp4_mux *mp4_mux_create(obs_output_t *output, struct serializer *serializer, enum mp4_mux_flags flags);
 void mp4_mux_destroy(struct mp4_mux *mux);
 bool mp4_mux_submit_packet(struct mp4_mux *mux, struct encoder_packet *pkt);
+void mp4_mux_set_fragment_limits(struct mp4_mux *mux, int64_t duration_usec, size_t size);
 bool mp4_mux_add_chapter(struct mp4_mux *mux, int64_t dts_usec, const char *name);
 bool mp4_mux_finalise(struct mp4_mux *mux);
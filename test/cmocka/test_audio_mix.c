@@ -0,0 +1,193 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <media-io/audio-io.h>
+#include <media-io/audio-mix.h>
+#include <util/bmem.h>
+
+/* Checks the mix kernels against the scalar loops they replaced, on their own
+ * and for one audio tick of a busy scene collection: every source is scaled
+ * by its volume, then added to each of the six mixes, which are clamped. */
+
+#define TICK_SOURCES 30
+#define TICK_CHANNELS 2
+
+/* odd so the scalar tail is exercised as well */
+#define TEST_COUNT (AUDIO_OUTPUT_FRAMES + 7)
+
+static void fill_random(float *data, size_t count, float range)
+{
+	for (size_t i = 0; i < count; i++)
+		data[i] = ((float)rand() / (float)RAND_MAX * 2.0f - 1.0f) * range;
+}
+
+static void scalar_add(float *dst, const float *src, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i];
+}
+
+static void scalar_scale(float *data, float vol, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		data[i] *= vol;
+}
+
+static void scalar_clamp(float *data, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		float val = data[i];
+		val = (val == val) ? val : 0.0f;
+		val = (val > 1.0f) ? 1.0f : val;
+		val = (val < -1.0f) ? -1.0f : val;
+		data[i] = val;
+	}
+}
+
+static void mix_kernels_test(void **state)
+{
+	float *src = bmalloc(TEST_COUNT * sizeof(float));
+	float *gain = bmalloc(TEST_COUNT * sizeof(float));
+	float *expected = bmalloc(TEST_COUNT * sizeof(float));
+	float *result = bmalloc(TEST_COUNT * sizeof(float));
+
+	UNUSED_PARAMETER(state);
+
+	srand(1);
+	fill_random(src, TEST_COUNT, 1.0f);
+	fill_random(gain, TEST_COUNT, 1.0f);
+
+	for (size_t count = 0; count <= TEST_COUNT; count += count < 32 ? 1 : 97) {
+		fill_random(expected, count, 2.0f);
+		memcpy(result, expected, count * sizeof(float));
+		scalar_add(expected, src, count);
+		audio_mix_add(result, src, count);
+		assert_memory_equal(expected, result, count * sizeof(float));
+
+		fill_random(expected, count, 2.0f);
+		memcpy(result, expected, count * sizeof(float));
+		for (size_t i = 0; i < count; i++)
+			expected[i] += src[i] * gain[i];
+		audio_mix_add_gain(result, src, gain, count);
+		for (size_t i = 0; i < count; i++)
+			assert_true(fabsf(expected[i] - result[i]) <= 1e-6f);
+
+		memcpy(result, expected, count * sizeof(float));
+		scalar_scale(expected, 0.3f, count);
+		audio_mix_scale(result, 0.3f, count);
+		assert_memory_equal(expected, result, count * sizeof(float));
+
+		memcpy(result, expected, count * sizeof(float));
+		for (size_t i = 0; i < count; i++)
+			expected[i] *= gain[i];
+		audio_mix_mul(result, gain, count);
+		assert_memory_equal(expected, result, count * sizeof(float));
+	}
+
+	bfree(src);
+	bfree(gain);
+	bfree(expected);
+	bfree(result);
+}
+
+static void mix_clamp_test(void **state)
+{
+	float data[] = {0.5f, -0.5f, 1.5f, -1.5f, NAN, INFINITY, -INFINITY, 1.0f, -1.0f, 0.0f, -NAN};
+	float expected[] = {0.5f, -0.5f, 1.0f, -1.0f, 0.0f, 1.0f, -1.0f, 1.0f, -1.0f, 0.0f, 0.0f};
+	const size_t count = sizeof(data) / sizeof(data[0]);
+
+	UNUSED_PARAMETER(state);
+
+	audio_mix_clamp(data, count);
+	for (size_t i = 0; i < count; i++)
+		assert_true(data[i] == expected[i]);
+}
+
+struct tick_buffers {
+	float *sources[TICK_SOURCES];
+	float *mixes[MAX_AUDIO_MIXES];
+};
+
+static void init_tick(struct tick_buffers *buf)
+{
+	const size_t count = AUDIO_OUTPUT_FRAMES * TICK_CHANNELS;
+
+	srand(2);
+	for (size_t i = 0; i < TICK_SOURCES; i++) {
+		buf->sources[i] = bmalloc(count * sizeof(float));
+		fill_random(buf->sources[i], count, 0.5f);
+	}
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++)
+		buf->mixes[mix] = bzalloc(count * sizeof(float));
+}
+
+static void free_tick(struct tick_buffers *buf)
+{
+	for (size_t i = 0; i < TICK_SOURCES; i++)
+		bfree(buf->sources[i]);
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++)
+		bfree(buf->mixes[mix]);
+}
+
+static void run_tick(struct tick_buffers *buf, bool kernels)
+{
+	const size_t count = AUDIO_OUTPUT_FRAMES * TICK_CHANNELS;
+
+	for (size_t i = 0; i < TICK_SOURCES; i++) {
+		if (kernels)
+			audio_mix_scale(buf->sources[i], 0.5f, count);
+		else
+			scalar_scale(buf->sources[i], 0.5f, count);
+
+		for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+			if (kernels)
+				audio_mix_add(buf->mixes[mix], buf->sources[i], count);
+			else
+				scalar_add(buf->mixes[mix], buf->sources[i], count);
+		}
+	}
+
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+		if (kernels)
+			audio_mix_clamp(buf->mixes[mix], count);
+		else
+			scalar_clamp(buf->mixes[mix], count);
+	}
+}
+
+/* enough sources to push the mixes past the clamp */
+static void mix_tick_test(void **state)
+{
+	const size_t count = AUDIO_OUTPUT_FRAMES * TICK_CHANNELS;
+	struct tick_buffers scalar;
+	struct tick_buffers kernels;
+
+	UNUSED_PARAMETER(state);
+
+	init_tick(&scalar);
+	init_tick(&kernels);
+
+	run_tick(&scalar, false);
+	run_tick(&kernels, true);
+
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++)
+		assert_memory_equal(scalar.mixes[mix], kernels.mixes[mix], count * sizeof(float));
+
+	free_tick(&scalar);
+	free_tick(&kernels);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(mix_kernels_test),
+		cmocka_unit_test(mix_clamp_test),
+		cmocka_unit_test(mix_tick_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,348 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jansson.h>
+
+#include <obs-data.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+
+#define COLLECTION_SOURCES 500
+
+/* ------------------------------------------------------------------------- */
+/* the jansson based conversion obs_data used before, kept as the reference */
+
+static void legacy_add_item(obs_data_t *data, const char *key, json_t *json);
+
+static void legacy_add_object_data(obs_data_t *data, json_t *jobj)
+{
+	const char *item_key;
+	json_t *jitem;
+
+	json_object_foreach (jobj, item_key, jitem) {
+		legacy_add_item(data, item_key, jitem);
+	}
+}
+
+static void legacy_add_item(obs_data_t *data, const char *key, json_t *json)
+{
+	if (json_is_object(json)) {
+		obs_data_t *sub_obj = obs_data_create();
+		legacy_add_object_data(sub_obj, json);
+		obs_data_set_obj(data, key, sub_obj);
+		obs_data_release(sub_obj);
+
+	} else if (json_is_array(json)) {
+		obs_data_array_t *array = obs_data_array_create();
+		size_t idx;
+		json_t *jitem;
+
+		json_array_foreach (json, idx, jitem) {
+			if (!json_is_object(jitem))
+				continue;
+
+			obs_data_t *item = obs_data_create();
+			legacy_add_object_data(item, jitem);
+			obs_data_array_push_back(array, item);
+			obs_data_release(item);
+		}
+
+		obs_data_set_array(data, key, array);
+		obs_data_array_release(array);
+
+	} else if (json_is_string(json)) {
+		obs_data_set_string(data, key, json_string_value(json));
+	} else if (json_is_integer(json)) {
+		obs_data_set_int(data, key, json_integer_value(json));
+	} else if (json_is_real(json)) {
+		obs_data_set_double(data, key, json_real_value(json));
+	} else if (json_is_true(json)) {
+		obs_data_set_bool(data, key, true);
+	} else if (json_is_false(json)) {
+		obs_data_set_bool(data, key, false);
+	}
+}
+
+static obs_data_t *legacy_load(const char *str)
+{
+	json_error_t error;
+	json_t *root = json_loads(str, JSON_REJECT_DUPLICATES, &error);
+	if (!root)
+		return NULL;
+
+	obs_data_t *data = obs_data_create();
+	legacy_add_object_data(data, root);
+	json_decref(root);
+	return data;
+}
+
+static json_t *legacy_to_json(obs_data_t *data)
+{
+	json_t *json = json_object();
+	obs_data_item_t *item = obs_data_first(data);
+
+	for (; item; obs_data_item_next(&item)) {
+		enum obs_data_type type = obs_data_item_gettype(item);
+		const char *name = obs_data_item_get_name(item);
+
+		if (!obs_data_item_has_user_value(item))
+			continue;
+
+		if (type == OBS_DATA_STRING) {
+			json_object_set_new(json, name, json_string(obs_data_item_get_string(item)));
+		} else if (type == OBS_DATA_NUMBER) {
+			if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT)
+				json_object_set_new(json, name, json_integer(obs_data_item_get_int(item)));
+			else
+				json_object_set_new(json, name, json_real(obs_data_item_get_double(item)));
+		} else if (type == OBS_DATA_BOOLEAN) {
+			json_object_set_new(json, name, obs_data_item_get_bool(item) ? json_true() : json_false());
+		} else if (type == OBS_DATA_OBJECT) {
+			obs_data_t *obj = obs_data_item_get_obj(item);
+			json_object_set_new(json, name, legacy_to_json(obj));
+			obs_data_release(obj);
+		} else if (type == OBS_DATA_ARRAY) {
+			obs_data_array_t *array = obs_data_item_get_array(item);
+			json_t *jarray = json_array();
+
+			for (size_t idx = 0; idx < obs_data_array_count(array); idx++) {
+				obs_data_t *sub_item = obs_data_array_item(array, idx);
+				json_array_append_new(jarray, legacy_to_json(sub_item));
+				obs_data_release(sub_item);
+			}
+
+			json_object_set_new(json, name, jarray);
+			obs_data_array_release(array);
+		}
+	}
+
+	return json;
+}
+
+static char *legacy_dump(obs_data_t *data, bool pretty)
+{
+	json_t *root = legacy_to_json(data);
+	char *str = json_dumps(root, JSON_PRESERVE_ORDER | (pretty ? JSON_INDENT(4) : JSON_COMPACT));
+	json_decref(root);
+	return str;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const char *valid_docs[] = {
+	"{}",
+	" {\"a\" : 1 , \"b\":[ ], \"c\":{}, \"d\":null, \"e\":true, \"f\":false} ",
+	"{\"arr\":[{\"x\":1},2,\"s\",[{\"y\":1}],{\"z\":{\"w\":[]}}]}",
+	"{\"d\":1.5,\"e\":1e5,\"f\":-0.0,\"g\":1E-7,\"h\":0.1,\"i\":-9223372036854775808,\"j\":1e308,\"k\":1e-400}",
+	"{\"s\":\"q\\\"b\\\\s\\/n\\nt\\tr\\rb\\bf\\f\\u0001\\u001f\\u00e9\\u20AC\\ud83d\\ude00\"}",
+	"{\"\xc3\xa9\":\"\xe2\x82\xac\",\"\":1}",
+	"[1, 2, {\"a\": 1}]",
+};
+
+static const char *invalid_docs[] = {
+	"",
+	"   ",
+	"1",
+	"\"s\"",
+	"{\"a\":1,\"a\":2}",
+	"{\"o\":{\"a\":1,\"a\":2}}",
+	"{\"arr\":[[{\"a\":1,\"a\":2}]]}",
+	"{} x",
+	"{\"a\":1,}",
+	"{\"a\" 1}",
+	"{\"a\":01}",
+	"{\"a\":-}",
+	"{\"a\":1.}",
+	"{\"a\":1e}",
+	"{\"a\":.5}",
+	"{\"a\":9223372036854775808}",
+	"{\"a\":1e400}",
+	"{\"a\":\"\\u0000\"}",
+	"{\"a\":\"\\ud800\"}",
+	"{\"a\":\"\\udc00\"}",
+	"{\"a\":\"\\x\"}",
+	"{\"a\":\"tab\there\"}",
+	"{\"a\":\"unterminated",
+	"{\"a\":\"\xc0\x80\"}",
+	"{\"a\":\"\xed\xa0\x80\"}",
+	"{\"a\":tru}",
+	"{\"a\":[1 2]}",
+	"{",
+	"\xef\xbb\xbf{}",
+};
+
+static void check_matches_legacy(obs_data_t *data)
+{
+	char *compact = legacy_dump(data, false);
+	char *pretty = legacy_dump(data, true);
+
+	assert_string_equal(obs_data_get_json(data), compact);
+	assert_string_equal(obs_data_get_json_pretty(data), pretty);
+
+	free(compact);
+	free(pretty);
+}
+
+static void json_read_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create_from_json(valid_docs[1]);
+	assert_non_null(data);
+	assert_int_equal(obs_data_get_int(data, "a"), 1);
+	assert_true(obs_data_get_bool(data, "e"));
+	assert_false(obs_data_has_user_value(data, "d"));
+	assert_string_equal(obs_data_get_json(data), "{\"a\":1,\"b\":[],\"c\":{},\"e\":true,\"f\":false}");
+	obs_data_release(data);
+
+	data = obs_data_create_from_json(valid_docs[4]);
+	assert_non_null(data);
+	assert_string_equal(obs_data_get_string(data, "s"),
+			    "q\"b\\s/n\nt\tr\rb\bf\f\x01\x1f\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+	obs_data_release(data);
+
+	for (size_t i = 0; i < sizeof(valid_docs) / sizeof(valid_docs[0]); i++) {
+		obs_data_t *legacy = legacy_load(valid_docs[i]);
+		data = obs_data_create_from_json(valid_docs[i]);
+
+		assert_non_null(legacy);
+		assert_non_null(data);
+		assert_string_equal(obs_data_get_json(data), obs_data_get_json(legacy));
+		check_matches_legacy(data);
+
+		obs_data_release(legacy);
+		obs_data_release(data);
+	}
+
+	for (size_t i = 0; i < sizeof(invalid_docs) / sizeof(invalid_docs[0]); i++) {
+		assert_null(legacy_load(invalid_docs[i]));
+		assert_null(obs_data_create_from_json(invalid_docs[i]));
+	}
+}
+
+static void json_write_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create();
+	obs_data_t *sub = obs_data_create();
+	obs_data_array_t *array = obs_data_array_create();
+
+	obs_data_set_string(data, "ok", "v");
+	obs_data_set_string(data, "bad", "\xff");
+	obs_data_set_double(data, "nan", NAN);
+	obs_data_set_default_int(data, "def", 5);
+	obs_data_set_obj(data, "sub", sub);
+	obs_data_array_push_back(array, sub);
+	obs_data_array_push_back(array, sub);
+	obs_data_set_array(data, "arr", array);
+
+	/* values JSON can't hold are left out */
+	assert_string_equal(obs_data_get_json(data), "{\"ok\":\"v\",\"sub\":{},\"arr\":[{},{}]}");
+	assert_string_equal(obs_data_get_json_pretty(data),
+			    "{\n    \"ok\": \"v\",\n    \"sub\": {},\n    \"arr\": [\n        {},\n        {}\n    ]\n}");
+	check_matches_legacy(data);
+
+	assert_true(obs_data_save_json_safe(data, "test_data_json.json", "tmp", "bak"));
+	char *file = os_quick_read_utf8_file("test_data_json.json");
+	assert_non_null(file);
+	assert_string_equal(file, obs_data_get_json(data));
+	bfree(file);
+
+	os_unlink("test_data_json.json");
+	os_unlink("test_data_json.json.bak");
+
+	obs_data_array_release(array);
+	obs_data_release(sub);
+	obs_data_release(data);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static char *make_collection(void)
+{
+	obs_data_t *root = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+	struct dstr name = {0};
+
+	for (int i = 0; i < COLLECTION_SOURCES; i++) {
+		obs_data_t *source = obs_data_create();
+		obs_data_t *settings = obs_data_create();
+		obs_data_array_t *filters = obs_data_array_create();
+
+		dstr_printf(&name, "Source %d \"copy\"", i);
+		obs_data_set_string(source, "name", name.array);
+		obs_data_set_string(source, "id", "image_source");
+		obs_data_set_string(source, "uuid", "8f2c6a9e-2c55-4d5c-9a0b-0e3a4cbd7f11");
+		obs_data_set_double(source, "volume", 1.0 / (i + 1));
+		obs_data_set_bool(source, "enabled", true);
+		obs_data_set_int(source, "mixers", 255);
+
+		dstr_printf(&name, "C:\\Users\\obs\\Pictures\\slide %d.png", i);
+		obs_data_set_string(settings, "file", name.array);
+		obs_data_set_obj(source, "settings", settings);
+
+		for (int j = 0; j < 3; j++) {
+			obs_data_t *filter = obs_data_create();
+			obs_data_set_string(filter, "name", "Color Correction");
+			obs_data_set_double(filter, "gamma", j * 0.25);
+			obs_data_array_push_back(filters, filter);
+			obs_data_release(filter);
+		}
+		obs_data_set_array(source, "filters", filters);
+
+		obs_data_array_push_back(sources, source);
+		obs_data_array_release(filters);
+		obs_data_release(settings);
+		obs_data_release(source);
+	}
+
+	obs_data_set_array(root, "sources", sources);
+	char *json = bstrdup(obs_data_get_json_pretty(root));
+
+	dstr_free(&name);
+	obs_data_array_release(sources);
+	obs_data_release(root);
+	return json;
+}
+
+/* set OBS_DATA_JSON_FILE to run the comparison on a real collection */
+static void json_collection_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const char *path = getenv("OBS_DATA_JSON_FILE");
+	char *json = path ? os_quick_read_utf8_file(path) : make_collection();
+
+	assert_non_null(json);
+
+	obs_data_t *legacy = legacy_load(json);
+	char *legacy_json = legacy_dump(legacy, true);
+	obs_data_t *data = obs_data_create_from_json(json);
+
+	assert_string_equal(obs_data_get_json_pretty(data), legacy_json);
+
+	free(legacy_json);
+	obs_data_release(legacy);
+	obs_data_release(data);
+	bfree(json);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(json_read_test),
+		cmocka_unit_test(json_write_test),
+		cmocka_unit_test(json_collection_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
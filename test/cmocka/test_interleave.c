@@ -0,0 +1,296 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <obs.h>
+#include <obs-interleave.h>
+#include <util/darray.h>
+#include <util/platform.h>
+
+/* Replays an encoder packet timeline through the output interleaver.
+ *
+ * Set OBS_INTERLEAVE_TIMELINE to a captured timeline to replay it, one packet
+ * per line in arrival order: "<v|a> <track> <dts_usec>".  Without it a
+ * multitrack timeline is generated (3 video tracks, 6 audio tracks) where the
+ * first video track stalls and then delivers its backlog in one burst. */
+
+#define VIDEO_TRACKS 3
+#define AUDIO_TRACKS 6
+#define TIMELINE_SEC 30
+#define STALL_START_SEC 5
+#define STALL_SEC 10
+#define VIDEO_INTERVAL_USEC 16667
+#define AUDIO_INTERVAL_USEC 21333
+
+struct timeline {
+	DARRAY(struct encoder_packet) packets;
+};
+
+static void add_track(struct timeline *timeline, enum obs_encoder_type type, size_t track, int64_t interval)
+{
+	for (int64_t dts = 0; dts < TIMELINE_SEC * 1000000LL; dts += interval) {
+		struct encoder_packet *packet = da_push_back_new(timeline->packets);
+		packet->type = type;
+		packet->track_idx = track;
+		packet->dts_usec = dts;
+	}
+}
+
+static int64_t arrival_time(const struct encoder_packet *packet)
+{
+	const int64_t stall_start = STALL_START_SEC * 1000000LL;
+	const int64_t stall_end = stall_start + STALL_SEC * 1000000LL;
+
+	if (packet->type == OBS_ENCODER_VIDEO && packet->track_idx == 0 && packet->dts_usec >= stall_start &&
+	    packet->dts_usec < stall_end)
+		return stall_end;
+	return packet->dts_usec;
+}
+
+static int compare_arrival(const void *a_ptr, const void *b_ptr)
+{
+	const struct encoder_packet *a = a_ptr;
+	const struct encoder_packet *b = b_ptr;
+	int64_t a_time = arrival_time(a);
+	int64_t b_time = arrival_time(b);
+
+	if (a_time != b_time)
+		return a_time < b_time ? -1 : 1;
+	if (a->dts_usec != b->dts_usec)
+		return a->dts_usec < b->dts_usec ? -1 : 1;
+	if (a->type != b->type)
+		return a->type == OBS_ENCODER_VIDEO ? -1 : 1;
+	return a->track_idx < b->track_idx ? -1 : (a->track_idx > b->track_idx);
+}
+
+static void generate_timeline(struct timeline *timeline)
+{
+	for (size_t i = 0; i < VIDEO_TRACKS; i++)
+		add_track(timeline, OBS_ENCODER_VIDEO, i, VIDEO_INTERVAL_USEC);
+	for (size_t i = 0; i < AUDIO_TRACKS; i++)
+		add_track(timeline, OBS_ENCODER_AUDIO, i, AUDIO_INTERVAL_USEC);
+
+	qsort(timeline->packets.array, timeline->packets.num, sizeof(struct encoder_packet), compare_arrival);
+}
+
+static bool load_timeline(struct timeline *timeline, const char *path)
+{
+	FILE *file = os_fopen(path, "r");
+	char type;
+	size_t track;
+	int64_t dts_usec;
+
+	if (!file)
+		return false;
+
+	while (fscanf(file, " %c %zu %" SCNd64, &type, &track, &dts_usec) == 3) {
+		struct encoder_packet *packet;
+
+		if ((type != 'v' && type != 'a') ||
+		    track >= (type == 'v' ? MAX_OUTPUT_VIDEO_ENCODERS : MAX_OUTPUT_AUDIO_ENCODERS))
+			continue;
+
+		packet = da_push_back_new(timeline->packets);
+		packet->type = type == 'v' ? OBS_ENCODER_VIDEO : OBS_ENCODER_AUDIO;
+		packet->track_idx = track;
+		packet->dts_usec = dts_usec;
+	}
+
+	fclose(file);
+	return timeline->packets.num > 0;
+}
+
+/* packets can be sent once every track has delivered something newer, which
+ * is what has_higher_opposing_ts checks in obs-output.c */
+struct watermark {
+	int64_t last_dts[MAX_INTERLEAVE_TRACKS];
+	bool seen[MAX_INTERLEAVE_TRACKS];
+	size_t num_tracks;
+};
+
+static void init_watermark(struct watermark *wm, const struct timeline *timeline)
+{
+	memset(wm, 0, sizeof(*wm));
+	for (size_t i = 0; i < timeline->packets.num; i++) {
+		size_t slot = interleave_track_slot(&timeline->packets.array[i]);
+		if (!wm->seen[slot]) {
+			wm->seen[slot] = true;
+			wm->num_tracks++;
+		}
+	}
+	memset(wm->seen, 0, sizeof(wm->seen));
+}
+
+static int64_t update_watermark(struct watermark *wm, size_t *seen_tracks, const struct encoder_packet *packet)
+{
+	size_t slot = interleave_track_slot(packet);
+	int64_t lowest = INT64_MAX;
+
+	if (!wm->seen[slot]) {
+		wm->seen[slot] = true;
+		(*seen_tracks)++;
+	}
+	wm->last_dts[slot] = packet->dts_usec;
+
+	if (*seen_tracks < wm->num_tracks)
+		return INT64_MIN;
+
+	for (size_t i = 0; i < MAX_INTERLEAVE_TRACKS; i++) {
+		if (wm->seen[i] && wm->last_dts[i] < lowest)
+			lowest = wm->last_dts[i];
+	}
+	return lowest;
+}
+
+struct replay_result {
+	DARRAY(struct encoder_packet) sent;
+};
+
+/* previous interleaver: linear scan for the insert position plus erasing from
+ * the front of a single array */
+static void replay_linear(const struct timeline *timeline, struct replay_result *result)
+{
+	DARRAY(struct encoder_packet) buffer;
+	struct watermark wm;
+	size_t seen_tracks = 0;
+
+	da_init(buffer);
+	init_watermark(&wm, timeline);
+
+	for (size_t i = 0; i < timeline->packets.num; i++) {
+		struct encoder_packet *out = &timeline->packets.array[i];
+		int64_t lowest = update_watermark(&wm, &seen_tracks, out);
+		size_t idx;
+
+		for (idx = 0; idx < buffer.num; idx++) {
+			struct encoder_packet *cur_packet = buffer.array + idx;
+
+			if (out->dts_usec == cur_packet->dts_usec && out->type == OBS_ENCODER_VIDEO &&
+			    cur_packet->type == OBS_ENCODER_VIDEO && out->track_idx > cur_packet->track_idx)
+				continue;
+
+			if (out->dts_usec == cur_packet->dts_usec && out->type == OBS_ENCODER_VIDEO)
+				break;
+			else if (out->dts_usec < cur_packet->dts_usec)
+				break;
+		}
+
+		da_insert(buffer, idx, out);
+
+		while (buffer.num && buffer.array[0].dts_usec < lowest) {
+			da_push_back(result->sent, &buffer.array[0]);
+			da_erase(buffer, 0);
+		}
+	}
+
+	da_free(buffer);
+}
+
+static void replay_queue(const struct timeline *timeline, struct replay_result *result)
+{
+	struct interleave_queue iq = {0};
+	struct watermark wm;
+	size_t seen_tracks = 0;
+
+	init_watermark(&wm, timeline);
+
+	for (size_t i = 0; i < timeline->packets.num; i++) {
+		struct encoder_packet *out = &timeline->packets.array[i];
+		int64_t lowest = update_watermark(&wm, &seen_tracks, out);
+		struct encoder_packet *next;
+
+		interleave_queue_push(&iq, out);
+
+		while ((next = interleave_queue_peek(&iq)) && next->dts_usec < lowest) {
+			struct encoder_packet packet;
+			interleave_queue_pop(&iq, &packet);
+			da_push_back(result->sent, &packet);
+		}
+	}
+
+	interleave_queue_free(&iq);
+}
+
+static void interleave_replay_test(void **state)
+{
+	const char *path = getenv("OBS_INTERLEAVE_TIMELINE");
+	struct timeline timeline = {0};
+	struct replay_result linear = {0};
+	struct replay_result queue = {0};
+
+	UNUSED_PARAMETER(state);
+
+	if (path && *path)
+		assert_true(load_timeline(&timeline, path));
+	else
+		generate_timeline(&timeline);
+
+	replay_linear(&timeline, &linear);
+	replay_queue(&timeline, &queue);
+
+	/* same send order; audio packets with the same dts on different tracks
+	 * may be swapped, which does not matter to the muxers */
+	assert_int_equal(linear.sent.num, queue.sent.num);
+	for (size_t i = 0; i < linear.sent.num; i++) {
+		struct encoder_packet *a = &linear.sent.array[i];
+		struct encoder_packet *b = &queue.sent.array[i];
+
+		assert_int_equal(a->dts_usec, b->dts_usec);
+		assert_int_equal(a->type, b->type);
+		if (a->type == OBS_ENCODER_VIDEO)
+			assert_int_equal(a->track_idx, b->track_idx);
+	}
+
+	da_free(linear.sent);
+	da_free(queue.sent);
+	da_free(timeline.packets);
+}
+
+/* pop order must follow dts, then video before audio, then video track */
+static void interleave_order_test(void **state)
+{
+	struct interleave_queue iq = {0};
+	struct encoder_packet packets[] = {
+		{.type = OBS_ENCODER_AUDIO, .track_idx = 1, .dts_usec = 100},
+		{.type = OBS_ENCODER_VIDEO, .track_idx = 2, .dts_usec = 100},
+		{.type = OBS_ENCODER_AUDIO, .track_idx = 0, .dts_usec = 50},
+		{.type = OBS_ENCODER_VIDEO, .track_idx = 0, .dts_usec = 100},
+		{.type = OBS_ENCODER_VIDEO, .track_idx = 0, .dts_usec = 200},
+	};
+	struct encoder_packet packet;
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < sizeof(packets) / sizeof(packets[0]); i++)
+		interleave_queue_push(&iq, &packets[i]);
+
+	assert_int_equal(iq.num_packets, 5);
+
+	assert_true(interleave_queue_pop(&iq, &packet));
+	assert_int_equal(packet.dts_usec, 50);
+	assert_true(interleave_queue_pop(&iq, &packet));
+	assert_true(packet.type == OBS_ENCODER_VIDEO && packet.track_idx == 0 && packet.dts_usec == 100);
+	assert_true(interleave_queue_pop(&iq, &packet));
+	assert_true(packet.type == OBS_ENCODER_VIDEO && packet.track_idx == 2);
+	assert_true(interleave_queue_pop(&iq, &packet));
+	assert_true(packet.type == OBS_ENCODER_AUDIO && packet.dts_usec == 100);
+	assert_true(interleave_queue_pop(&iq, &packet));
+	assert_int_equal(packet.dts_usec, 200);
+	assert_false(interleave_queue_pop(&iq, &packet));
+
+	interleave_queue_free(&iq);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(interleave_order_test),
+		cmocka_unit_test(interleave_replay_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
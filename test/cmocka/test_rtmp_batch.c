@@ -0,0 +1,216 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/darray.h>
+#include <util/threading.h>
+
+#include "librtmp/rtmp_sys.h"
+#include "librtmp/rtmp.h"
+
+/* Loopback RTMP sink: media tags are written into a TCP connection on
+ * 127.0.0.1 the way rtmp-stream's send_thread does, once with RTMP_Write per
+ * packet and once with RTMP_WriteBatch/RTMP_FlushBatch.  The sink only reads.
+ *
+ * The traffic mimics a 4K60 stream at ~50 Mbps: one ~1 MB keyframe every two
+ * seconds, ~100 KB frames in between, and AAC sized audio tags. */
+
+#define VIDEO_FRAMES 600
+#define FRAME_SIZE (100 * 1024)
+#define KEYFRAME_SIZE (1024 * 1024)
+#define KEYFRAME_INTERVAL 120
+#define AUDIO_SIZE 400
+#define BATCH_PACKETS 8
+#define VERIFY_FRAMES 60
+
+struct flv_tag {
+	uint8_t *data;
+	size_t size;
+};
+
+struct timeline {
+	DARRAY(struct flv_tag) tags;
+};
+
+struct sink {
+	SOCKET fd;
+	pthread_t thread;
+	uint64_t bytes;
+	bool keep;
+	DARRAY(uint8_t) received;
+};
+
+static void put_be24(uint8_t *p, uint32_t val)
+{
+	p[0] = (uint8_t)(val >> 16);
+	p[1] = (uint8_t)(val >> 8);
+	p[2] = (uint8_t)val;
+}
+
+static void make_tag(struct flv_tag *tag, uint8_t type, size_t body_size, uint32_t ts)
+{
+	tag->size = 11 + body_size + 4;
+	tag->data = bzalloc(tag->size);
+
+	tag->data[0] = type;
+	put_be24(tag->data + 1, (uint32_t)body_size);
+	put_be24(tag->data + 4, ts & 0xFFFFFF);
+	tag->data[7] = (uint8_t)(ts >> 24);
+
+	for (size_t i = 0; i < body_size; i++)
+		tag->data[11 + i] = (uint8_t)(i * 31 + ts);
+}
+
+static void make_timeline(struct timeline *timeline, int frames)
+{
+	uint32_t audio_ts = 0;
+
+	for (int i = 0; i < frames; i++) {
+		uint32_t video_ts = (uint32_t)(i * 1000 / 60);
+		size_t size = i % KEYFRAME_INTERVAL == 0 ? KEYFRAME_SIZE : FRAME_SIZE;
+
+		make_tag(da_push_back_new(timeline->tags), RTMP_PACKET_TYPE_VIDEO, size, video_ts);
+
+		while (audio_ts <= video_ts) {
+			make_tag(da_push_back_new(timeline->tags), RTMP_PACKET_TYPE_AUDIO, AUDIO_SIZE, audio_ts);
+			audio_ts += 21;
+		}
+	}
+}
+
+static void *sink_thread(void *data)
+{
+	struct sink *sink = data;
+	char buf[65536];
+	int ret;
+
+	while ((ret = (int)recv(sink->fd, buf, sizeof(buf), 0)) > 0) {
+		sink->bytes += ret;
+		if (sink->keep)
+			da_push_back_array(sink->received, (uint8_t *)buf, ret);
+	}
+	return NULL;
+}
+
+/* connects rtmp to a sink thread over loopback TCP, as if publishing had
+ * already been set up */
+static void open_sink(RTMP *rtmp, struct sink *sink, bool keep)
+{
+	struct sockaddr_in addr = {0};
+	socklen_t addr_len = sizeof(addr);
+	SOCKET listener = socket(AF_INET, SOCK_STREAM, 0);
+	SOCKET fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	assert_true(listener >= 0 && fd >= 0);
+	assert_int_equal(bind(listener, (struct sockaddr *)&addr, sizeof(addr)), 0);
+	assert_int_equal(listen(listener, 1), 0);
+	assert_int_equal(getsockname(listener, (struct sockaddr *)&addr, &addr_len), 0);
+	assert_int_equal(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+
+	memset(sink, 0, sizeof(*sink));
+	sink->keep = keep;
+	sink->fd = accept(listener, NULL, NULL);
+	assert_true(sink->fd >= 0);
+	closesocket(listener);
+	assert_int_equal(pthread_create(&sink->thread, NULL, sink_thread, sink), 0);
+
+	RTMP_Init(rtmp);
+	rtmp->m_sb.sb_socket = fd;
+	rtmp->m_outChunkSize = 4096;
+	rtmp->Link.nStreams = 1;
+	rtmp->Link.streams[0].id = 1;
+}
+
+static void close_sink(RTMP *rtmp, struct sink *sink)
+{
+	shutdown(rtmp->m_sb.sb_socket, SHUT_WR);
+	pthread_join(sink->thread, NULL);
+	closesocket(sink->fd);
+
+	/* not a real session, don't send unpublish/deleteStream */
+	rtmp->Link.streams[0].id = 0;
+	RTMP_Close(rtmp);
+}
+
+static void send_tags(const struct flv_tag *tags, size_t num, bool batch, bool keep, struct sink *sink)
+{
+	RTMP rtmp;
+
+	open_sink(&rtmp, sink, keep);
+	if (batch)
+		assert_true(RTMP_CanBatch(&rtmp));
+
+	for (size_t i = 0; i < num; i++) {
+		if (!batch) {
+			assert_true(RTMP_Write(&rtmp, (char *)tags[i].data, (int)tags[i].size, 0) > 0);
+			continue;
+		}
+
+		assert_true(RTMP_WriteBatch(&rtmp, (char *)tags[i].data, (int)tags[i].size, 0) > 0);
+		if ((i + 1) % BATCH_PACKETS == 0 || i + 1 == num)
+			assert_true(RTMP_FlushBatch(&rtmp));
+	}
+
+	close_sink(&rtmp, sink);
+}
+
+static void free_timeline(struct timeline *timeline)
+{
+	for (size_t i = 0; i < timeline->tags.num; i++)
+		bfree(timeline->tags.array[i].data);
+	da_free(timeline->tags);
+}
+
+/* both paths must put the same bytes on the wire */
+static void batch_matches_write_test(void **state)
+{
+	struct timeline timeline = {0};
+	struct sink single_sink, batched_sink;
+
+	UNUSED_PARAMETER(state);
+
+	make_timeline(&timeline, VERIFY_FRAMES);
+
+	send_tags(timeline.tags.array, timeline.tags.num, false, true, &single_sink);
+	send_tags(timeline.tags.array, timeline.tags.num, true, true, &batched_sink);
+
+	assert_true(single_sink.bytes > 0);
+	assert_int_equal(single_sink.received.num, batched_sink.received.num);
+	assert_memory_equal(single_sink.received.array, batched_sink.received.array, single_sink.received.num);
+
+	da_free(single_sink.received);
+	da_free(batched_sink.received);
+	free_timeline(&timeline);
+}
+
+/* a longer stream with several keyframes, only the byte counts are kept */
+static void batch_stream_test(void **state)
+{
+	struct timeline timeline = {0};
+	struct sink single, batched;
+
+	UNUSED_PARAMETER(state);
+
+	make_timeline(&timeline, VIDEO_FRAMES);
+
+	send_tags(timeline.tags.array, timeline.tags.num, false, false, &single);
+	send_tags(timeline.tags.array, timeline.tags.num, true, false, &batched);
+
+	assert_true(single.bytes > 0);
+	assert_int_equal(single.bytes, batched.bytes);
+	free_timeline(&timeline);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(batch_matches_write_test),
+		cmocka_unit_test(batch_stream_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
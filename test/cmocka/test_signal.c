@@ -0,0 +1,220 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <callback/signal.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+struct counter {
+	volatile long calls;
+	volatile bool freed;
+	signal_handler_t *handler;
+};
+
+static void count_cb(void *data, calldata_t *params)
+{
+	struct counter *c = data;
+	UNUSED_PARAMETER(params);
+
+	assert_false(os_atomic_load_bool(&c->freed));
+	os_atomic_inc_long(&c->calls);
+}
+
+static void remove_self_cb(void *data, calldata_t *params)
+{
+	count_cb(data, params);
+	signal_handler_remove_current();
+}
+
+static void disconnect_self_cb(void *data, calldata_t *params)
+{
+	struct counter *c = data;
+
+	count_cb(data, params);
+	signal_handler_disconnect(c->handler, "test", disconnect_self_cb, c);
+}
+
+static signal_handler_t *create_handler(void)
+{
+	signal_handler_t *handler = signal_handler_create();
+	assert_non_null(handler);
+	assert_true(signal_handler_add(handler, "void test()"));
+	assert_true(signal_handler_add(handler, "void other(int value)"));
+	assert_false(signal_handler_add(handler, "void test()"));
+	return handler;
+}
+
+static void signal_basic_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = create_handler();
+	struct signal_info *test = signal_handler_get_signal(handler, "test");
+	struct counter a = {0}, b = {0};
+
+	assert_non_null(test);
+	assert_null(signal_handler_get_signal(handler, "missing"));
+
+	signal_handler_connect(handler, "test", count_cb, &a);
+	signal_handler_connect(handler, "test", count_cb, &a);
+	signal_handler_connect(handler, "other", count_cb, &b);
+
+	signal_handler_signal(handler, "test", NULL);
+	signal_handler_emit(handler, test, NULL);
+	assert_int_equal(a.calls, 2);
+	assert_int_equal(b.calls, 0);
+
+	signal_handler_disconnect(handler, "test", count_cb, &a);
+	signal_handler_signal(handler, "test", NULL);
+	signal_handler_signal(handler, "other", NULL);
+	assert_int_equal(a.calls, 2);
+	assert_int_equal(b.calls, 1);
+
+	signal_handler_destroy(handler);
+}
+
+static void signal_remove_current_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = create_handler();
+	struct counter a = {0}, b = {0}, c = {0};
+
+	a.handler = b.handler = c.handler = handler;
+	signal_handler_connect(handler, "test", remove_self_cb, &a);
+	signal_handler_connect(handler, "test", disconnect_self_cb, &b);
+	signal_handler_connect(handler, "test", count_cb, &c);
+
+	signal_handler_signal(handler, "test", NULL);
+	signal_handler_signal(handler, "test", NULL);
+
+	assert_int_equal(a.calls, 1);
+	assert_int_equal(b.calls, 1);
+	assert_int_equal(c.calls, 2);
+
+	signal_handler_destroy(handler);
+}
+
+struct emitter {
+	signal_handler_t *handler;
+	volatile bool stop;
+};
+
+static void *emit_thread(void *data)
+{
+	struct emitter *e = data;
+	struct signal_info *test = signal_handler_get_signal(e->handler, "test");
+
+	while (!os_atomic_load_bool(&e->stop))
+		signal_handler_emit(e->handler, test, NULL);
+	return NULL;
+}
+
+/* once disconnect returns, no emission on another thread may still call
+ * into the callback */
+static void signal_concurrent_disconnect_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = create_handler();
+	struct emitter e = {handler, false};
+	pthread_t threads[4];
+
+	for (size_t i = 0; i < 4; i++)
+		assert_int_equal(pthread_create(&threads[i], NULL, emit_thread, &e), 0);
+
+	for (int i = 0; i < 2000; i++) {
+		struct counter *c = bzalloc(sizeof(*c));
+
+		signal_handler_connect(handler, "test", count_cb, c);
+		while (!os_atomic_load_long(&c->calls))
+			os_sleep_ms(0);
+		signal_handler_disconnect(handler, "test", count_cb, c);
+
+		os_atomic_set_bool(&c->freed, true);
+		long calls = os_atomic_load_long(&c->calls);
+		os_sleep_ms(0);
+		assert_int_equal(os_atomic_load_long(&c->calls), calls);
+		bfree(c);
+	}
+
+	os_atomic_set_bool(&e.stop, true);
+	for (size_t i = 0; i < 4; i++)
+		pthread_join(threads[i], NULL);
+
+	signal_handler_destroy(handler);
+}
+
+struct blocker {
+	signal_handler_t *handler;
+	os_event_t *entered;
+	os_event_t *release;
+};
+
+static void block_cb(void *data, calldata_t *params)
+{
+	struct blocker *b = data;
+	UNUSED_PARAMETER(params);
+
+	os_event_signal(b->entered);
+	os_event_wait(b->release);
+}
+
+static void *block_thread(void *data)
+{
+	struct blocker *b = data;
+
+	signal_handler_signal(b->handler, "test", NULL);
+	return NULL;
+}
+
+/* replaced callback lists are freed while an emission of the same signal is
+ * still running */
+static void signal_reclaim_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = create_handler();
+	struct blocker b = {handler};
+	struct counter c = {0};
+	pthread_t thread;
+	long allocs;
+
+	assert_int_equal(os_event_init(&b.entered, OS_EVENT_TYPE_MANUAL), 0);
+	assert_int_equal(os_event_init(&b.release, OS_EVENT_TYPE_MANUAL), 0);
+
+	signal_handler_connect(handler, "test", block_cb, &b);
+	assert_int_equal(pthread_create(&thread, NULL, block_thread, &b), 0);
+	os_event_wait(b.entered);
+
+	allocs = bnum_allocs();
+
+	for (int i = 0; i < 1000; i++) {
+		signal_handler_connect(handler, "test", count_cb, &c);
+		signal_handler_disconnect(handler, "test", count_cb, &c);
+	}
+
+	assert_true(bnum_allocs() < allocs + 16);
+
+	os_event_signal(b.release);
+	pthread_join(thread, NULL);
+
+	os_event_destroy(b.entered);
+	os_event_destroy(b.release);
+	signal_handler_destroy(handler);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(signal_basic_test),
+		cmocka_unit_test(signal_remove_current_test),
+		cmocka_unit_test(signal_concurrent_disconnect_test),
+		cmocka_unit_test(signal_reclaim_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,126 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/task.h>
+#include <util/threading.h>
+
+#define NUM_TASKS 2000
+
+struct counter {
+	os_task_pool_t *pool;
+	volatile long done;
+	volatile long running;
+	volatile long inside;
+	long order[NUM_TASKS];
+	long next;
+};
+
+static void count_task(void *param)
+{
+	struct counter *c = param;
+
+	if (os_task_pool_inside(c->pool))
+		os_atomic_inc_long(&c->inside);
+	os_atomic_inc_long(&c->done);
+}
+
+static void spawn_task(void *param)
+{
+	struct counter *c = param;
+
+	for (size_t i = 0; i < 10; i++)
+		os_task_pool_queue_task(c->pool, count_task, c, OS_TASK_PRIORITY_NORMAL, NULL);
+	count_task(c);
+}
+
+struct ordered {
+	struct counter *c;
+	long idx;
+};
+
+static void ordered_task(void *param)
+{
+	struct ordered *o = param;
+	struct counter *c = o->c;
+
+	/* tasks with the same key never overlap */
+	assert_true(os_task_pool_inside_affinity(c->pool, c));
+	assert_int_equal(os_atomic_inc_long(&c->running), 1);
+	c->order[c->next++] = o->idx;
+	os_atomic_dec_long(&c->running);
+	os_atomic_inc_long(&c->done);
+}
+
+static void task_pool_basic_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct counter c = {0};
+	c.pool = os_task_pool_create(4);
+	assert_non_null(c.pool);
+
+	assert_false(os_task_pool_inside(c.pool));
+	assert_false(os_task_pool_inside_affinity(c.pool, &c));
+	assert_false(os_task_pool_wait(c.pool));
+
+	for (size_t i = 0; i < NUM_TASKS; i++) {
+		enum os_task_priority priority = (enum os_task_priority)(i % 3);
+		assert_true(os_task_pool_queue_task(c.pool, count_task, &c, priority, NULL));
+	}
+
+	os_task_pool_wait(c.pool);
+	assert_int_equal(os_atomic_load_long(&c.done), NUM_TASKS);
+	assert_int_equal(os_atomic_load_long(&c.inside), NUM_TASKS);
+
+	/* tasks queued from inside a task are waited for as well */
+	c.done = 0;
+	for (size_t i = 0; i < 100; i++)
+		os_task_pool_queue_task(c.pool, spawn_task, &c, OS_TASK_PRIORITY_HIGH, NULL);
+
+	assert_true(os_task_pool_wait(c.pool));
+	assert_int_equal(os_atomic_load_long(&c.done), 100 * 11);
+
+	os_task_pool_destroy(c.pool);
+}
+
+static void task_pool_affinity_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct counter c = {0};
+	struct counter other = {0};
+	struct ordered *tasks = bmalloc(sizeof(struct ordered) * NUM_TASKS);
+	c.pool = other.pool = os_task_pool_create(4);
+	assert_non_null(c.pool);
+
+	for (long i = 0; i < NUM_TASKS; i++) {
+		tasks[i].c = &c;
+		tasks[i].idx = i;
+		os_task_pool_queue_task(c.pool, ordered_task, &tasks[i], OS_TASK_PRIORITY_NORMAL, &c);
+		os_task_pool_queue_task(c.pool, count_task, &other, OS_TASK_PRIORITY_NORMAL, NULL);
+	}
+
+	/* destroying runs the remaining tasks */
+	os_task_pool_destroy(c.pool);
+
+	assert_int_equal(c.done, NUM_TASKS);
+	assert_int_equal(other.done, NUM_TASKS);
+	for (long i = 0; i < NUM_TASKS; i++)
+		assert_int_equal(c.order[i], i);
+
+	bfree(tasks);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(task_pool_basic_test),
+		cmocka_unit_test(task_pool_affinity_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
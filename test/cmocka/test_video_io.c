@@ -0,0 +1,313 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <media-io/video-io.h>
+#include <media-io/video-frame.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define OUTPUT_NAME "video-io-contention"
+#define FRAMES 600
+#define SLOW_CALLBACK_MS 20
+#define SLOW_CALLBACK_INTERVAL 30
+
+struct slow_input {
+	volatile long frames;
+};
+
+/* mimics an encoder that occasionally takes longer than a frame */
+static void slow_callback(void *param, struct video_data *frame)
+{
+	struct slow_input *input = param;
+
+	if (os_atomic_inc_long(&input->frames) % SLOW_CALLBACK_INTERVAL == 0)
+		os_sleep_ms(SLOW_CALLBACK_MS);
+
+	UNUSED_PARAMETER(frame);
+}
+
+/* The graphics thread side (lock/unlock) must never wait on the video thread,
+ * even while an input callback is stalled: frames that do not fit in the cache
+ * become repeats of the newest frame and are counted as skipped. */
+static void lock_frame_contention_test(void **state)
+{
+	struct video_output_info info = {
+		.name = OUTPUT_NAME,
+		.format = VIDEO_FORMAT_BGRA,
+		.fps_num = 60,
+		.fps_den = 1,
+		.width = 320,
+		.height = 180,
+		.cache_size = 3,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+	};
+	struct slow_input input = {0};
+	long not_locked = 0;
+	video_t *video;
+
+	UNUSED_PARAMETER(state);
+
+	assert_int_equal(video_output_open(&video, &info), VIDEO_OUTPUT_SUCCESS);
+	assert_true(video_output_connect(video, NULL, slow_callback, &input));
+
+	for (int i = 0; i < FRAMES; i++) {
+		struct video_frame frame;
+
+		if (video_output_lock_frame(video, &frame, 1, os_gettime_ns())) {
+			memset(frame.data[0], i & 0xFF, frame.linesize[0]);
+			video_output_unlock_frame(video);
+		} else {
+			not_locked++;
+		}
+
+		os_sleep_ms(1);
+	}
+
+	/* every frame is delivered at most once, and the ones that were not
+	 * delivered were dropped and counted as skipped */
+	for (int i = 0; i < 1000 && os_atomic_load_long(&input.frames) + video_output_get_skipped_frames(video) < FRAMES;
+	     i++)
+		os_sleep_ms(10);
+
+	assert_true(os_atomic_load_long(&input.frames) <= FRAMES);
+	assert_true(os_atomic_load_long(&input.frames) + video_output_get_skipped_frames(video) >= FRAMES);
+	assert_true(video_output_get_skipped_frames(video) <= (uint32_t)not_locked);
+
+	video_output_disconnect(video, slow_callback, &input);
+	video_output_close(video);
+}
+
+struct parallel_input {
+	volatile long frames;
+	pthread_t thread;
+	int sleep_ms;
+};
+
+static void parallel_callback(void *param, struct video_data *frame)
+{
+	struct parallel_input *input = param;
+
+	input->thread = pthread_self();
+	os_atomic_inc_long(&input->frames);
+	if (input->sleep_ms)
+		os_sleep_ms(input->sleep_ms);
+
+	UNUSED_PARAMETER(frame);
+}
+
+/* A slow input in parallel mode only skips its own frames */
+static void parallel_inputs_test(void **state)
+{
+	struct video_output_info info = {
+		.name = OUTPUT_NAME "-parallel",
+		.format = VIDEO_FORMAT_BGRA,
+		.fps_num = 60,
+		.fps_den = 1,
+		.width = 320,
+		.height = 180,
+		.cache_size = 6,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+	};
+	struct parallel_input fast = {0};
+	struct parallel_input slow = {.sleep_ms = 10};
+	long locked = 0;
+	video_t *video;
+
+	UNUSED_PARAMETER(state);
+
+	assert_int_equal(video_output_open(&video, &info), VIDEO_OUTPUT_SUCCESS);
+	video_output_set_parallel_inputs(video, true);
+	assert_true(video_output_connect(video, NULL, parallel_callback, &fast));
+	assert_true(video_output_connect(video, NULL, parallel_callback, &slow));
+
+	for (int i = 0; i < 120; i++) {
+		struct video_frame frame;
+
+		if (video_output_lock_frame(video, &frame, 1, os_gettime_ns())) {
+			video_output_unlock_frame(video);
+			locked++;
+		}
+		os_sleep_ms(2);
+	}
+
+	/* the fast input keeps up, wait until it has seen every frame */
+	for (int i = 0; i < 1000 && os_atomic_load_long(&fast.frames) < locked; i++)
+		os_sleep_ms(10);
+
+	video_output_disconnect(video, parallel_callback, &fast);
+	video_output_disconnect(video, parallel_callback, &slow);
+
+	assert_true(fast.frames > 0);
+	assert_true(slow.frames > 0);
+	assert_false(pthread_equal(fast.thread, slow.thread));
+
+	video_output_close(video);
+}
+
+struct blocked_input {
+	os_event_t *resume;
+	volatile long frames;
+};
+
+static void blocked_callback(void *param, struct video_data *frame)
+{
+	struct blocked_input *input = param;
+
+	if (os_atomic_inc_long(&input->frames) == 1)
+		os_event_wait(input->resume);
+
+	UNUSED_PARAMETER(frame);
+}
+
+/* An input that holds the oldest cache slot in parallel mode makes the
+ * graphics thread drop frames, it must not wait for the slot */
+static void parallel_blocked_slot_test(void **state)
+{
+	struct video_output_info info = {
+		.name = OUTPUT_NAME "-blocked",
+		.format = VIDEO_FORMAT_BGRA,
+		.fps_num = 60,
+		.fps_den = 1,
+		.width = 320,
+		.height = 180,
+		.cache_size = 4,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+	};
+	struct blocked_input input = {0};
+	uint32_t skipped;
+	bool locked = false;
+	video_t *video;
+
+	UNUSED_PARAMETER(state);
+
+	assert_int_equal(os_event_init(&input.resume, OS_EVENT_TYPE_MANUAL), 0);
+	assert_int_equal(video_output_open(&video, &info), VIDEO_OUTPUT_SUCCESS);
+	video_output_set_parallel_inputs(video, true);
+	assert_true(video_output_connect(video, NULL, blocked_callback, &input));
+
+	/* fill the cache while the input is stuck on its first frame */
+	for (int i = 0; i < 10; i++) {
+		struct video_frame frame;
+
+		if (video_output_lock_frame(video, &frame, 1, os_gettime_ns()))
+			video_output_unlock_frame(video);
+		os_sleep_ms(10);
+	}
+
+	skipped = video_output_get_skipped_frames(video);
+	for (int i = 0; i < 10; i++) {
+		struct video_frame frame;
+		assert_false(video_output_lock_frame(video, &frame, 1, os_gettime_ns()));
+	}
+	assert_int_equal(video_output_get_skipped_frames(video), skipped + 10);
+
+	/* the slots come back once the input catches up */
+	os_event_signal(input.resume);
+	for (int i = 0; i < 1000 && !locked; i++) {
+		struct video_frame frame;
+
+		locked = video_output_lock_frame(video, &frame, 1, os_gettime_ns());
+		if (locked)
+			video_output_unlock_frame(video);
+		else
+			os_sleep_ms(10);
+	}
+	assert_true(locked);
+
+	video_output_disconnect(video, blocked_callback, &input);
+	video_output_close(video);
+	os_event_destroy(input.resume);
+}
+
+struct failing_input {
+	video_t *video;
+	volatile long frames;
+	volatile bool disconnected;
+};
+
+/* mimics an encoder that fails and stops its outputs from inside its own
+ * callback */
+static void failing_callback(void *param, struct video_data *frame)
+{
+	struct failing_input *input = param;
+
+	if (os_atomic_inc_long(&input->frames) == 10) {
+		assert_true(video_output_disconnect2(input->video, failing_callback, input));
+		os_atomic_set_bool(&input->disconnected, true);
+	}
+
+	UNUSED_PARAMETER(frame);
+}
+
+/* A parallel input disconnecting from its own worker must not join itself */
+static void parallel_self_disconnect_test(void **state)
+{
+	struct video_output_info info = {
+		.name = OUTPUT_NAME "-self-disconnect",
+		.format = VIDEO_FORMAT_BGRA,
+		.fps_num = 60,
+		.fps_den = 1,
+		.width = 320,
+		.height = 180,
+		.cache_size = 4,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+	};
+	struct failing_input input = {0};
+
+	UNUSED_PARAMETER(state);
+
+	assert_int_equal(video_output_open(&input.video, &info), VIDEO_OUTPUT_SUCCESS);
+	video_output_set_parallel_inputs(input.video, true);
+	assert_true(video_output_connect(input.video, NULL, failing_callback, &input));
+
+	for (int i = 0; i < 60; i++) {
+		struct video_frame frame;
+
+		if (video_output_lock_frame(input.video, &frame, 1, os_gettime_ns()))
+			video_output_unlock_frame(input.video);
+		os_sleep_ms(2);
+	}
+
+	for (int i = 0; i < 1000 && !os_atomic_load_bool(&input.disconnected); i++)
+		os_sleep_ms(10);
+
+	assert_true(os_atomic_load_bool(&input.disconnected));
+	assert_int_equal(os_atomic_load_long(&input.frames), 10);
+	assert_false(video_output_active(input.video));
+
+	video_output_close(input.video);
+}
+
+static int setup(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	return obs_startup("en-US", NULL, NULL) ? 0 : -1;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_shutdown();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(lock_frame_contention_test),
+		cmocka_unit_test(parallel_inputs_test),
+		cmocka_unit_test(parallel_blocked_slot_test),
+		cmocka_unit_test(parallel_self_disconnect_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}